@@ -10,6 +10,7 @@
 #include <QApplication>
 #include <QThread>
 #include <QMessageBox>
+#include <QSettings>
 
 Application::Application(QApplication & qApplication) :
     m_sequenceNumber(0),
@@ -32,6 +33,7 @@ Application::Application(QApplication & qApplication) :
     m_outputSettingsModel.setHeight(720);
     m_outputSettingsModel.setGamma(2.8f);
     m_PPMSettingsModel.setPPMInitialRadius(0.20);
+    loadPhotonMapSettings();
 
     connect(&m_outputSettingsModel, SIGNAL(resolutionUpdated()), this, SLOT(onOutputSettingsUpdated()));
     connect(&m_PPMSettingsModel, SIGNAL(updated()), this, SLOT(onPPMSettingsUpdated()));
@@ -157,9 +159,29 @@ void Application::onOutputSettingsUpdated()
 
 void Application::onPPMSettingsUpdated()
 {
+    savePhotonMapSettings();
     incrementSequenceNumber();
 }
 
+// The photon map build settings are kept between sessions, the initial radius comes from the scene
+void Application::loadPhotonMapSettings()
+{
+    QSettings settings;
+    m_PPMSettingsModel.setBuildPhotonMapOnCPU(settings.value("photonMap/buildOnCPU", false).toBool());
+    m_PPMSettingsModel.setPersistentPhotonGrid(settings.value("photonMap/persistentGrid", false).toBool());
+    m_PPMSettingsModel.setPhotonGatherMode((PhotonGatherMode::E)settings.value("photonMap/gatherMode", (int)PhotonGatherMode::FIXED_RADIUS).toInt(),
+        settings.value("photonMap/nearestPhotons", 16).toUInt());
+}
+
+void Application::savePhotonMapSettings()
+{
+    QSettings settings;
+    settings.setValue("photonMap/buildOnCPU", m_PPMSettingsModel.getBuildPhotonMapOnCPU());
+    settings.setValue("photonMap/persistentGrid", m_PPMSettingsModel.getPersistentPhotonGrid());
+    settings.setValue("photonMap/gatherMode", (int)m_PPMSettingsModel.getPhotonGatherMode());
+    settings.setValue("photonMap/nearestPhotons", m_PPMSettingsModel.getNearestPhotons());
+}
+
 RenderStatisticsModel & Application::getRenderStatisticsModel()
 {
     return m_renderStatisticsModel;
@@ -214,7 +236,7 @@ void Application::onSceneLoadError(QString error)
     emit applicationError(error);
 }
 
-void Application::onNewFrameReadyForDisplay(const float*, unsigned long long )
+void Application::onNewFrameReadyForDisplay(const float*, unsigned long long, unsigned int, unsigned int )
 {
     m_renderStatisticsModel.incrementNumPreviewedIterations();
 }
@@ -70,14 +70,16 @@ private slots:
     void onSceneLoadingNew();
     void onSceneUpdated();
     void onSceneLoadError(QString);
-    void onNewFrameReadyForDisplay(const float*, unsigned long long);
+    void onNewFrameReadyForDisplay(const float*, unsigned long long, unsigned int, unsigned int);
 
 signals:
     void runningStatusChanged();
     void rendererStatusChanged();
     void renderMethodChanged();
     void cameraUpdated();
-    void newFrameReadyForDisplay(const float*, unsigned long long);
+    void newFrameReadyForDisplay(const float*, unsigned long long, unsigned int, unsigned int);
+    // The display is done with the buffer of the last newFrameReadyForDisplay, which can then be reused
+    void frameDisplayed();
     void sequenceNumberIncremented();
     void applicationError(QString);
 
@@ -96,6 +98,8 @@ private:
     Camera m_camera;
     Camera m_defaultCamera;
     unsigned long long m_sequenceNumber;
+    void loadPhotonMapSettings();
+    void savePhotonMapSettings();
     void resetRenderTime();
     void pauseRenderTime();
     void resumeRenderTime();
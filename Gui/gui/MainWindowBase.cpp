@@ -93,9 +93,10 @@ MainWindowBase::MainWindowBase(Application& application)
     m_renderWidget = new RenderWidget(centralwidget, application.getCamera(), application.getOutputSettingsModel());
     gridLayout->addWidget(m_renderWidget, 0, 0, 1, 1);
     connect(m_renderWidget, SIGNAL(cameraUpdated()), &application, SLOT(onCameraUpdated()));
-    connect(&application, SIGNAL(newFrameReadyForDisplay(const float*, unsigned long long)), 
-            m_renderWidget, SLOT(onNewFrameReadyForDisplay(const float*, unsigned long long)),
+    connect(&application, SIGNAL(newFrameReadyForDisplay(const float*, unsigned long long, unsigned int, unsigned int)), 
+            m_renderWidget, SLOT(onNewFrameReadyForDisplay(const float*, unsigned long long, unsigned int, unsigned int)),
             Qt::QueuedConnection);
+    connect(m_renderWidget, SIGNAL(frameDisplayed()), &application, SIGNAL(frameDisplayed()));
 
     connect(&application, SIGNAL(runningStatusChanged()), this, SLOT(onRunningStatusChanged()));
     connect(&application, SIGNAL(renderMethodChanged()), this, SLOT(onRenderMethodChanged()));
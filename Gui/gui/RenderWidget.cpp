@@ -34,7 +34,6 @@ RenderWidget::RenderWidget( QWidget *parent, Camera & camera, const OutputSettin
 {
     this->resize(outputSettings.getWidth(), outputSettings.getHeight());
     setMouseTracking(false);
-    m_displayBufferCpu = new float[2000*2000*3];
 
     m_iterationNumberLabel = new QLabel(this);
     m_iterationNumberLabel->setStyleSheet("background:rgb(51,51,51); font-size:20pt; color:rgb(170,170,170);");
@@ -50,8 +49,6 @@ RenderWidget::RenderWidget( QWidget *parent, Camera & camera, const OutputSettin
 
 RenderWidget::~RenderWidget()
 {
-    delete m_displayBufferCpu;
-    m_displayBufferCpu = NULL;
 }
 
 void RenderWidget::initializeGL()
@@ -71,37 +68,37 @@ void RenderWidget::initializeGL()
     }
 }
 
-void RenderWidget::displayFrame(const float* cpuBuffer, unsigned long long iterationNumber)
+void RenderWidget::displayFrame(const float* cpuBuffer, unsigned long long iterationNumber, unsigned int width, unsigned int height)
 {
     glClear(GL_COLOR_BUFFER_BIT);
 
     // Draw the resulting image
 
     //assert(cpuBuffer);
-    //memcpy(m_displayBufferCpu, cpuBuffer, getDisplayBufferSizeBytes());
 
 	m_openFileLabel->hide();
 
-    int offsetX = ((int)size().width() - (int)m_outputSettingsModel.getWidth())/2;
-    int offsetY = ((int)size().height() - (int)m_outputSettingsModel.getHeight())/2;
+    // Use the size of the frame, the output settings may already have changed for the next one
+    int offsetX = ((int)size().width() - (int)width)/2;
+    int offsetY = ((int)size().height() - (int)height)/2;
 
     if(offsetY > 20)
     {
         m_iterationNumberLabel->show();
         m_iterationNumberLabel->setText(QString::number(iterationNumber));
-        m_iterationNumberLabel->setGeometry(offsetX+m_outputSettingsModel.getWidth() - 250,
-                                            offsetY+m_outputSettingsModel.getHeight() + 5, 250, 30);
+        m_iterationNumberLabel->setGeometry(offsetX+width - 250,
+                                            offsetY+height + 5, 250, 30);
     }
     else
     {
         m_iterationNumberLabel->hide();
     }
 
-    glViewport(offsetX, offsetY, (GLint)m_outputSettingsModel.getWidth(), (GLint)m_outputSettingsModel.getHeight());
+    glViewport(offsetX, offsetY, (GLint)width, (GLint)height);
 
     glBindTexture(GL_TEXTURE_2D, m_GLOutputBufferTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, m_outputSettingsModel.getWidth(), 
-        m_outputSettingsModel.getHeight(), 0, GL_RGB, GL_FLOAT, (GLvoid*)cpuBuffer);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, width, 
+        height, 0, GL_RGB, GL_FLOAT, (GLvoid*)cpuBuffer);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -135,10 +132,11 @@ void RenderWidget::displayFrame(const float* cpuBuffer, unsigned long long itera
 	m_frameRendered = true;
 }
 
-void RenderWidget::onNewFrameReadyForDisplay(const float* cpuBuffer, unsigned long long iterationNumber)
+void RenderWidget::onNewFrameReadyForDisplay(const float* cpuBuffer, unsigned long long iterationNumber, unsigned int width, unsigned int height)
 {
-    displayFrame(cpuBuffer, iterationNumber);
+    displayFrame(cpuBuffer, iterationNumber, width, height);
     updateGL();
+    emit frameDisplayed();
 }
 
 void RenderWidget::resizeGL( int w, int h )
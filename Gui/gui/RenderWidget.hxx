@@ -35,15 +35,17 @@ public:
 
 signals:
     void cameraUpdated();
+    // Emitted once the frame of onNewFrameReadyForDisplay has been copied and its buffer is not read anymore
+    void frameDisplayed();
 
 public slots:
-    void onNewFrameReadyForDisplay(const float* cpuBuffer, unsigned long long iterationNumber);
+    void onNewFrameReadyForDisplay(const float* cpuBuffer, unsigned long long iterationNumber, unsigned int width, unsigned int height);
 
 protected:
     virtual void initializeGL();
     virtual void resizeGL(int w, int h);
     virtual void paintGL();
-    void displayFrame(const float* cpuBuffer, unsigned long long iterationNumber);
+    void displayFrame(const float* cpuBuffer, unsigned long long iterationNumber, unsigned int width, unsigned int height);
     QPair<int, int> getDisplayBufferSize();
     virtual void mousePressEvent(QMouseEvent* event);
     virtual void mouseMoveEvent( QMouseEvent* event );
@@ -52,7 +54,6 @@ protected:
 private:
     void initializeOpenGLShaders();
     Mouse m_mouse;
-    float* m_displayBufferCpu;
     Camera & m_camera;
     const OutputSettingsModel & m_outputSettingsModel;
     bool m_hasLoadedGLShaders;
@@ -32,7 +32,17 @@ PPMDock::~PPMDock()
 
 void PPMDock::onFormSubmitted()
 {
-    m_PPMSettingsModel.setPPMInitialRadius(ui->ppmInitialRadiusEdit->value());
+    // Every setter updates the form from the model, so read the form first
+    double PPMInitialRadius = ui->ppmInitialRadiusEdit->value();
+    bool buildPhotonMapOnCPU = ui->buildPhotonMapOnCPUCheckBox->isChecked();
+    bool persistentPhotonGrid = ui->persistentPhotonGridCheckBox->isChecked();
+    PhotonGatherMode::E photonGatherMode = ui->photonGatherModeComboBox->currentIndex() == 1 ? PhotonGatherMode::K_NEAREST_NEIGHBOURS
+        : PhotonGatherMode::FIXED_RADIUS;
+    unsigned int nearestPhotons = ui->nearestPhotonsEdit->value();
+    m_PPMSettingsModel.setBuildPhotonMapOnCPU(buildPhotonMapOnCPU);
+    m_PPMSettingsModel.setPersistentPhotonGrid(persistentPhotonGrid);
+    m_PPMSettingsModel.setPhotonGatherMode(photonGatherMode, nearestPhotons);
+    m_PPMSettingsModel.setPPMInitialRadius(PPMInitialRadius);
 }
 
 void PPMDock::onRenderStatisticsUpdated()
@@ -54,4 +64,8 @@ void PPMDock::onRenderStatisticsUpdated()
 void PPMDock::onModelUpdated()
 {
     ui->ppmInitialRadiusEdit->setValue(m_PPMSettingsModel.getPPMInitialRadius());
+    ui->buildPhotonMapOnCPUCheckBox->setChecked(m_PPMSettingsModel.getBuildPhotonMapOnCPU());
+    ui->persistentPhotonGridCheckBox->setChecked(m_PPMSettingsModel.getPersistentPhotonGrid());
+    ui->photonGatherModeComboBox->setCurrentIndex(m_PPMSettingsModel.getPhotonGatherMode() == PhotonGatherMode::K_NEAREST_NEIGHBOURS ? 1 : 0);
+    ui->nearestPhotonsEdit->setValue(m_PPMSettingsModel.getNearestPhotons());
 }
@@ -85,12 +85,13 @@ void RenderInformationDock::onUpdateRenderTime()
     
     if(m_application.getRenderTimeSeconds() > 0.5 && m_renderStatisticsModel.getNumIterations() > 0)
     {
-        float iterationsPerSecond = m_renderStatisticsModel.getNumIterations()/m_application.getRenderTimeSeconds();
-        ui->iterationsPerSecondLabel->setText(QString("%1").arg(iterationsPerSecond, 0, 'f', 4));
+        ui->iterationsPerSecondLabel->setText(QString("%1").arg(m_renderStatisticsModel.getIterationsPerSecond(), 0, 'f', 4));
+        ui->displayedFramesPerSecondLabel->setText(QString("%1").arg(m_renderStatisticsModel.getDisplayedFramesPerSecond(), 0, 'f', 1));
     }
     else
     {
         ui->iterationsPerSecondLabel->setText("");
+        ui->displayedFramesPerSecondLabel->setText("");
     }
 
 }
@@ -7,7 +7,11 @@
 #include "PPMSettingsModel.hxx"
 
 PPMSettingsModel::PPMSettingsModel(void)
-    : m_PPMInitialRadius(0.0f)
+    : m_PPMInitialRadius(0.0f),
+      m_buildPhotonMapOnCPU(false),
+      m_persistentPhotonGrid(false),
+      m_photonGatherMode(PhotonGatherMode::FIXED_RADIUS),
+      m_nearestPhotons(16)
 {
 }
 
@@ -25,3 +29,42 @@ void PPMSettingsModel::setPPMInitialRadius( double PPMInitialRadius )
     m_PPMInitialRadius = PPMInitialRadius;
     emit updated();
 }
+
+bool PPMSettingsModel::getBuildPhotonMapOnCPU() const
+{
+    return m_buildPhotonMapOnCPU;
+}
+
+void PPMSettingsModel::setBuildPhotonMapOnCPU( bool buildPhotonMapOnCPU )
+{
+    m_buildPhotonMapOnCPU = buildPhotonMapOnCPU;
+    emit updated();
+}
+
+bool PPMSettingsModel::getPersistentPhotonGrid() const
+{
+    return m_persistentPhotonGrid;
+}
+
+void PPMSettingsModel::setPersistentPhotonGrid( bool persistentPhotonGrid )
+{
+    m_persistentPhotonGrid = persistentPhotonGrid;
+    emit updated();
+}
+
+PhotonGatherMode::E PPMSettingsModel::getPhotonGatherMode() const
+{
+    return m_photonGatherMode;
+}
+
+unsigned int PPMSettingsModel::getNearestPhotons() const
+{
+    return m_nearestPhotons;
+}
+
+void PPMSettingsModel::setPhotonGatherMode( PhotonGatherMode::E photonGatherMode, unsigned int nearestPhotons )
+{
+    m_photonGatherMode = photonGatherMode;
+    m_nearestPhotons = nearestPhotons;
+    emit updated();
+}
@@ -7,6 +7,7 @@
 #pragma once
 #include <QObject>
 #include "gui_export_api.h"
+#include "renderer/PhotonGatherMode.h"
 class PPMSettingsModel : public QObject
 {
     Q_OBJECT;
@@ -16,11 +17,25 @@ public:
     GUI_EXPORT_API ~PPMSettingsModel(void);
     GUI_EXPORT_API double getPPMInitialRadius() const;
     GUI_EXPORT_API void setPPMInitialRadius(double PPMInitialRadius);
+    // Build the photon map on the host instead of on the device. Renderers take it when they are created.
+    GUI_EXPORT_API bool getBuildPhotonMapOnCPU() const;
+    GUI_EXPORT_API void setBuildPhotonMapOnCPU(bool buildPhotonMapOnCPU);
+    // Keep the photon grid between iterations of the progressive photon mapping renderer, taken when it is created
+    GUI_EXPORT_API bool getPersistentPhotonGrid() const;
+    GUI_EXPORT_API void setPersistentPhotonGrid(bool persistentPhotonGrid);
+    // The number of nearest photons only applies to PhotonGatherMode::K_NEAREST_NEIGHBOURS
+    GUI_EXPORT_API PhotonGatherMode::E getPhotonGatherMode() const;
+    GUI_EXPORT_API unsigned int getNearestPhotons() const;
+    GUI_EXPORT_API void setPhotonGatherMode(PhotonGatherMode::E photonGatherMode, unsigned int nearestPhotons);
 
 signals:
     void updated();
 
 private:
     double m_PPMInitialRadius;
+    bool m_buildPhotonMapOnCPU;
+    bool m_persistentPhotonGrid;
+    PhotonGatherMode::E m_photonGatherMode;
+    unsigned int m_nearestPhotons;
 };
 
@@ -11,7 +11,9 @@ RenderStatisticsModel::RenderStatisticsModel(void)
       m_numIterations(0),
       m_numPreviewedIterations(0),
       m_numEmittedPhotons(0),
-      m_numEmittedPhotonsPerIteration(0)
+      m_numEmittedPhotonsPerIteration(0),
+      m_iterationsPerSecond(0),
+      m_displayedFramesPerSecond(0)
 {
 }
 
@@ -84,3 +86,23 @@ void RenderStatisticsModel::incrementNumPreviewedIterations()
 {
     m_numPreviewedIterations++;
 }
+
+double RenderStatisticsModel::getIterationsPerSecond() const
+{
+    return m_iterationsPerSecond;
+}
+
+void RenderStatisticsModel::setIterationsPerSecond( double iterationsPerSecond )
+{
+    m_iterationsPerSecond = iterationsPerSecond;
+}
+
+double RenderStatisticsModel::getDisplayedFramesPerSecond() const
+{
+    return m_displayedFramesPerSecond;
+}
+
+void RenderStatisticsModel::setDisplayedFramesPerSecond( double displayedFramesPerSecond )
+{
+    m_displayedFramesPerSecond = displayedFramesPerSecond;
+}
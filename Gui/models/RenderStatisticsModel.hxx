@@ -31,6 +31,11 @@ public:
     GUI_EXPORT_API double getCurrentPPMRadius() const;
     GUI_EXPORT_API void setCurrentPPMRadius(double currentPPMRadius); 
     GUI_EXPORT_API void incrementNumPreviewedIterations();
+    // Rates over the last second, iterations are rendered faster than frames are displayed
+    GUI_EXPORT_API double getIterationsPerSecond() const;
+    GUI_EXPORT_API void setIterationsPerSecond(double iterationsPerSecond);
+    GUI_EXPORT_API double getDisplayedFramesPerSecond() const;
+    GUI_EXPORT_API void setDisplayedFramesPerSecond(double displayedFramesPerSecond);
 
 signals:
     void updated();
@@ -42,5 +47,7 @@ private:
     unsigned long long m_numPhotonsInEstimate;
     unsigned long long m_numIterations;
     unsigned long long m_numPreviewedIterations;
+    double m_iterationsPerSecond;
+    double m_displayedFramesPerSecond;
 };
 
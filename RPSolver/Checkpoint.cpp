@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2014 Ignacio Avas
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "Problem.h"
+#include "Random.h"
+#include "EvaluationStore.h"
+#include "logging/Logger.h"
+#include "util/sutil.h"
+#include "conditions/Condition.h"
+#include "conditions/ConditionPosition.h"
+#include "optimizations/SurfaceRadiosityEvaluation.h"
+#include <QDataStream>
+#include <QSaveFile>
+
+static const quint32 checkpointMagic = 0x43535052; // "RPSC"
+static const quint32 checkpointVersion = 5;
+// seconds between checkpoints
+static const double checkpointInterval = 60.0;
+
+static void saveEvaluation(QDataStream &out, const SurfaceRadiosityEvaluation *evaluation)
+{
+	out << evaluation->val() << evaluation->radius() << (qint32)evaluation->photons()
+		<< evaluation->isMaxQuality() << evaluation->valid();
+}
+
+static SurfaceRadiosityEvaluation *loadEvaluation(QDataStream &in)
+{
+	float val, radius;
+	qint32 photons;
+	bool isMaxQuality, valid;
+	in >> val >> radius >> photons >> isMaxQuality >> valid;
+	return new SurfaceRadiosityEvaluation(val, radius, photons, isMaxQuality, valid);
+}
+
+QString Problem::getCheckpointFileName()
+{
+	return outputDir.filePath(QString("checkpoint-%1.bin").arg(QString(problemKey.toHex().left(16))));
+}
+
+void Problem::saveCheckpointIfDue()
+{
+	if(sutilCurrentTime() - lastCheckpointTime >= checkpointInterval){
+		saveCheckpoint();
+	}
+}
+
+// The evaluations are in the evaluation store, the checkpoint keeps how many records it had so that
+// evaluations done after the checkpoint don't change the course of a resumed optimization
+void Problem::saveCheckpoint()
+{
+	QSaveFile file(getCheckpointFileName());
+	if(!file.open(QIODevice::WriteOnly)){
+		throw std::logic_error(("Couldn't open checkpoint file: " + file.errorString()).toStdString().c_str());
+	}
+
+	QDataStream out(&file);
+	out << checkpointMagic << checkpointVersion << problemKey
+		<< seed << getSolverRandomState()
+		<< (qint32)currentIteration << currentRadius << (sutilCurrentTime() - startTime)
+		<< statistics.evaluationTime << (qint32)statistics.evaluations << statistics.photons
+		<< (qint32)statistics.evaluationHits << (qint32)statistics.evaluationMisses
+		<< (qint32)statistics.belowIsocStops << (qint32)statistics.narrowIntervalStops
+		<< (qint32)(evaluationStore ? evaluationStore->size() : -1)
+		<< siIsoc.center() << siIsoc.radius();
+	// the photons each renderer traces next
+	out << (qint32)evaluators.size();
+	for(auto evaluator: evaluators){
+		out << (quint64)evaluator->getLaunchNumber();
+	}
+	out << (qint32)isoc.size();
+	for(auto configuration: isoc){
+		saveEvaluation(out, configuration.evaluation());
+		for(auto position: configuration.positions()){
+			position->save(out);
+		}
+	}
+
+	// the previous checkpoint is only replaced by a complete one
+	if(!file.commit()){
+		throw std::logic_error(("Couldn't write checkpoint file: " + file.errorString()).toStdString().c_str());
+	}
+	lastCheckpointTime = sutilCurrentTime();
+}
+
+bool Problem::resume()
+{
+	QFile file(getCheckpointFileName());
+	if(!file.exists()){
+		return false;
+	}
+	if(!file.open(QIODevice::ReadOnly)){
+		throw std::logic_error(("Couldn't open checkpoint file: " + file.errorString()).toStdString().c_str());
+	}
+
+	QDataStream in(&file);
+	quint32 magic, version;
+	QByteArray key;
+	in >> magic >> version >> key;
+	if(magic != checkpointMagic || version != checkpointVersion || key != problemKey){
+		throw std::logic_error("The checkpoint belongs to another problem or version");
+	}
+
+	unsigned int checkpointSeed;
+	QByteArray randomState;
+	qint32 iteration, evaluationCount, evaluationHits, evaluationMisses, belowIsocStops, narrowIntervalStops;
+	qint32 storeRecords, numEvaluators, isocSize;
+	float checkpointRadius, siIsocCenter, siIsocRadius;
+	double elapsedTime, evaluationTime, photons;
+	in >> checkpointSeed >> randomState
+		>> iteration >> checkpointRadius >> elapsedTime
+		>> evaluationTime >> evaluationCount >> photons
+		>> evaluationHits >> evaluationMisses
+		>> belowIsocStops >> narrowIntervalStops
+		>> storeRecords
+		>> siIsocCenter >> siIsocRadius
+		>> numEvaluators;
+	if(in.status() != QDataStream::Ok || numEvaluators < 0){
+		throw std::logic_error("The checkpoint is corrupt");
+	}
+	if(numEvaluators != evaluators.size()){
+		throw std::logic_error("The checkpoint was taken with another number of evaluators");
+	}
+	QVector<quint64> launchNumbers(numEvaluators);
+	for(int i = 0; i < numEvaluators; ++i){
+		in >> launchNumbers[i];
+	}
+	in >> isocSize;
+	if(in.status() != QDataStream::Ok || isocSize < 0){
+		throw std::logic_error("The checkpoint is corrupt");
+	}
+
+	QList<Configuration> checkpointIsoc;
+	for(int i = 0; i < isocSize && in.status() == QDataStream::Ok; ++i){
+		auto evaluation = loadEvaluation(in);
+		QVector<ConditionPosition *> positions;
+		for(auto condition: conditions){
+			positions.append(condition->loadPosition(in));
+		}
+		checkpointIsoc.append(Configuration(evaluation, positions));
+	}
+	if(in.status() != QDataStream::Ok){
+		throw std::logic_error("The checkpoint is corrupt");
+	}
+
+	seed = checkpointSeed;
+	setSolverRandomState(randomState);
+	currentIteration = iteration;
+	currentRadius = checkpointRadius;
+	startTime = sutilCurrentTime() - elapsedTime;
+	statistics.evaluationTime = evaluationTime;
+	statistics.evaluations = evaluationCount;
+	statistics.photons = photons;
+	statistics.evaluationHits = evaluationHits;
+	statistics.evaluationMisses = evaluationMisses;
+	statistics.belowIsocStops = belowIsocStops;
+	statistics.narrowIntervalStops = narrowIntervalStops;
+	siIsoc = Interval(siIsocCenter, siIsocRadius);
+	isoc = checkpointIsoc;
+	for(int i = 0; i < numEvaluators; ++i){
+		evaluators.at(i)->setLaunchNumber(launchNumbers.at(i));
+	}
+
+	if(evaluationStore && storeRecords >= 0){
+		qDeleteAll(evaluations);
+		evaluations = evaluationStore->load(storeRecords);
+		statistics.storedEvaluations = evaluations.size();
+	}
+
+	resumed = true;
+	logger->log("Resuming iteration %d with seed %u from %s\n", currentIteration, seed, qPrintable(file.fileName()));
+	return true;
+}
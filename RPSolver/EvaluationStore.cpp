@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2014 Ignacio Avas
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "EvaluationStore.h"
+#include "optimizations/SurfaceRadiosityEvaluation.h"
+#include <QFileInfo>
+#include <QDir>
+#include <QtEndian>
+#include <cstring>
+#include <stdexcept>
+
+const quint32 EvaluationStore::magic = 0x45535052; // "RPSE"
+// version 1 didn't flag the evaluations that stopped early and version 2 radii were computed from an
+// emitted power that counted green twice, their records can't be reused
+const quint32 EvaluationStore::version = 3;
+
+static const quint32 maxQualityFlag = 1;
+static const quint32 validFlag = 2;
+static const quint32 stoppedEarlyFlag = 4;
+
+static void writeFloat(float value, uchar *dest)
+{
+	quint32 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	qToLittleEndian(bits, dest);
+}
+
+static float readFloat(const uchar *src)
+{
+	quint32 bits = qFromLittleEndian<quint32>(src);
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+EvaluationStore::EvaluationStore(const QString &path, const QByteArray &key, int dimensions):
+	file(path),
+	key(key),
+	dimensions(dimensions),
+	records(0)
+{
+}
+
+// magic, version, dimensions, key size and key
+int EvaluationStore::headerSize() const
+{
+	return 4 * sizeof(quint32) + key.size();
+}
+
+// mapped positions, value, radius, photons and flags
+int EvaluationStore::recordSize() const
+{
+	return (dimensions + 4) * sizeof(quint32);
+}
+
+bool EvaluationStore::readHeader(const uchar *data, qint64 size) const
+{
+	if(size < headerSize()){
+		return false;
+	}
+	return qFromLittleEndian<quint32>(data) == magic
+		&& qFromLittleEndian<quint32>(data + 4) == version
+		&& qFromLittleEndian<quint32>(data + 8) == (quint32)dimensions
+		&& qFromLittleEndian<quint32>(data + 12) == (quint32)key.size()
+		&& memcmp(data + 16, key.constData(), key.size()) == 0;
+}
+
+void EvaluationStore::writeHeader()
+{
+	QByteArray header(headerSize(), Qt::Uninitialized);
+	auto data = (uchar *)header.data();
+	qToLittleEndian(magic, data);
+	qToLittleEndian(version, data + 4);
+	qToLittleEndian((quint32)dimensions, data + 8);
+	qToLittleEndian((quint32)key.size(), data + 12);
+	memcpy(data + 16, key.constData(), key.size());
+	file.write(header);
+}
+
+QHash<QVector<int>, SurfaceRadiosityEvaluation *> EvaluationStore::load(int maxRecords)
+{
+	QHash<QVector<int>, SurfaceRadiosityEvaluation *> evaluations;
+
+	if(file.isOpen()){
+		file.close();
+	}
+	QFileInfo(file).dir().mkpath(".");
+	if(!file.open(QIODevice::ReadWrite)){
+		throw std::logic_error(("Couldn't open evaluation store: " + file.errorString()).toStdString().c_str());
+	}
+
+	qint64 fileSize = file.size();
+	const uchar *data = fileSize > 0 ? file.map(0, fileSize) : NULL;
+	if(!data || !readHeader(data, fileSize)){
+		if(data){
+			file.unmap((uchar *)data);
+		}
+		file.resize(0);
+		file.seek(0);
+		writeHeader();
+		file.flush();
+		records = 0;
+		return evaluations;
+	}
+
+	// a record cut by the end of an earlier run is dropped
+	records = (fileSize - headerSize()) / recordSize();
+	if(maxRecords >= 0 && maxRecords < records){
+		records = maxRecords;
+	}
+	for(int i = 0; i < records; ++i){
+		auto record = data + headerSize() + (qint64)i * recordSize();
+		QVector<int> mappedPositions(dimensions);
+		for(int dimension = 0; dimension < dimensions; ++dimension){
+			mappedPositions[dimension] = qFromLittleEndian<qint32>(record + 4 * dimension);
+		}
+		record += 4 * dimensions;
+		quint32 flags = qFromLittleEndian<quint32>(record + 12);
+		auto evaluation = new SurfaceRadiosityEvaluation(
+			readFloat(record),
+			readFloat(record + 4),
+			qFromLittleEndian<qint32>(record + 8),
+			(flags & maxQualityFlag) != 0,
+			(flags & validFlag) != 0,
+			(flags & stoppedEarlyFlag) != 0
+		);
+		delete evaluations.value(mappedPositions);
+		evaluations[mappedPositions] = evaluation;
+	}
+	file.unmap((uchar *)data);
+
+	file.resize(headerSize() + (qint64)records * recordSize());
+	file.seek(file.size());
+	return evaluations;
+}
+
+void EvaluationStore::append(const QVector<int> &mappedPositions, const SurfaceRadiosityEvaluation *evaluation)
+{
+	if(mappedPositions.size() != dimensions){
+		throw std::logic_error("Mapped positions don't match the evaluation store dimensions");
+	}
+
+	QByteArray record(recordSize(), Qt::Uninitialized);
+	auto data = (uchar *)record.data();
+	for(int dimension = 0; dimension < dimensions; ++dimension){
+		qToLittleEndian((qint32)mappedPositions.at(dimension), data + 4 * dimension);
+	}
+	data += 4 * dimensions;
+	writeFloat(evaluation->val(), data);
+	writeFloat(evaluation->radius(), data + 4);
+	qToLittleEndian((qint32)evaluation->photons(), data + 8);
+	quint32 flags = (evaluation->isMaxQuality() ? maxQualityFlag : 0) | (evaluation->valid() ? validFlag : 0)
+		| (evaluation->isStoppedEarly() ? stoppedEarlyFlag : 0);
+	qToLittleEndian(flags, data + 12);
+
+	if(file.write(record) != record.size()){
+		throw std::logic_error(("Couldn't write evaluation store: " + file.errorString()).toStdString().c_str());
+	}
+	++records;
+}
+
+void EvaluationStore::flush()
+{
+	file.flush();
+}
+
+int EvaluationStore::size() const
+{
+	return records;
+}
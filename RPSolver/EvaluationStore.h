@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2014 Ignacio Avas
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QVector>
+
+class SurfaceRadiosityEvaluation;
+
+/*
+  Evaluations of a problem kept on disk, so that later runs of the same problem skip the mapped positions
+  evaluated before. The file starts with the key of the problem, followed by fixed size records that are
+  appended as evaluations are done. A later record of some mapped positions replaces the earlier ones.
+  Records keep whether the evaluation stopped early, see SurfaceRadiosityEvaluation::isStoppedEarly.
+*/
+class EvaluationStore
+{
+public:
+	EvaluationStore(const QString &path, const QByteArray &key, int dimensions);
+	// Maps the file and returns its evaluations. A file of another problem is started again.
+	// With maxRecords the later records are dropped, to go back to the store of a checkpoint.
+	QHash<QVector<int>, SurfaceRadiosityEvaluation *> load(int maxRecords = -1);
+	void append(const QVector<int> &mappedPositions, const SurfaceRadiosityEvaluation *evaluation);
+	// Writes the appended records to disk, so they survive the process
+	void flush();
+	int size() const;
+private:
+	static const quint32 magic;
+	static const quint32 version;
+
+	int headerSize() const;
+	int recordSize() const;
+	bool readHeader(const uchar *data, qint64 size) const;
+	void writeHeader();
+
+	QFile file;
+	QByteArray key;
+	int dimensions;
+	int records;
+};
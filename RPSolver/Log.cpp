@@ -129,6 +129,16 @@ void Problem::logStatistics()
 	logger->log("Time per iteration\t%s\n", toString(timePerIteration).c_str());
 
 	logger->log("Evaluation time\t%s\n", toString(statistics.evaluationTime).c_str());
+
+	auto photonsPerEvaluation = statistics.evaluations > 0 ? statistics.photons / statistics.evaluations : 0.0;
+	logger->log("Photons per evaluation\t%s\n", toString(photonsPerEvaluation).c_str());
+	logger->log("Evaluations stopped below ISOC\t%d\n", statistics.belowIsocStops);
+	logger->log("Evaluations stopped with a narrow interval\t%d\n", statistics.narrowIntervalStops);
+	logger->log("Evaluators\t%d\n", evaluators.size());
+	logger->log("Stored evaluations loaded\t%d\n", statistics.storedEvaluations);
+	logger->log("Evaluation cache hits\t%d\n", statistics.evaluationHits);
+	logger->log("Evaluation cache misses\t%d\n", statistics.evaluationMisses);
+	logger->log("Batch size\t%d\n", batchSize);
 	
 	auto rendererStatistics = renderer->getStatistics();
 	logger->log("Recalculate Acceleration Structures\t%s\n", toString(rendererStatistics.recalcAccelerationStructures).c_str());
@@ -145,6 +155,13 @@ void Problem::logStatistics()
 		+ rendererStatistics.recalcAccelerationStructures);
 
 	logger->log("Other\t%s\n", toString(otherTime).c_str());
+
+	auto sceneLoadStatistics = scene->getLoadStatistics();
+	logger->log("Scene Read File\t%s\n", toString(sceneLoadStatistics.readFileTime).c_str());
+	logger->log("Scene Normalize Meshes\t%s\n", toString(sceneLoadStatistics.normalizeMeshesTime).c_str());
+	logger->log("Scene Object Areas\t%s\n", toString(sceneLoadStatistics.objectAreaTime).c_str());
+	logger->log("Scene AABB\t%s\n", toString(sceneLoadStatistics.aabbTime).c_str());
+	logger->log("Scene Load Total\t%s\n", toString(sceneLoadStatistics.totalTime).c_str());
 }
 
 void Problem::logStrategy()
@@ -6,16 +6,22 @@
 #include <QCoreApplication>
 #include <QCommandLineParser>
 #include "renderer/PMOptixRenderer.h"
+#include "renderer/PMCPURenderer.h"
 #include "logging/DummyLogger.h"
 #include "scene/Scene.h"
 #include "FileLogger.h"
 #include "Problem.h"
 
 
-Main::Main(QObject *parent, const QString &filePath, const ComputeDevice &device):
+Main::Main(QObject *parent, const QString &filePath, const QVector<ComputeDevice> &devices, bool useCPU, int batchSize,
+		unsigned int seed, bool resume):
 	QObject(parent),
 	filePath(filePath),
-	device(device)
+	devices(devices),
+	useCPU(useCPU),
+	batchSize(batchSize),
+	seed(seed),
+	resume(resume)
 {
 }
 
@@ -31,18 +37,51 @@ void Main::run()
 		std::cerr << "Could not initialize logger: " << ex.what() << std::endl;
 		return;
 	}
-	renderer.initialize(device, &logger);
+	renderer.initialize(devices.first(), &logger);
+
+	// other renderers evaluate candidates at the same time as the first one
+	QVector<PhotonRenderer *> extraRenderers;
+	for(int i = 1; i < devices.size(); ++i)
+	{
+		auto extraRenderer = new PMOptixRenderer();
+		extraRenderers.append(extraRenderer);
+		extraRenderer->initialize(devices.at(i), &logger);
+	}
+	if(useCPU)
+	{
+		auto cpuRenderer = new PMCPURenderer();
+		extraRenderers.append(cpuRenderer);
+		cpuRenderer->initialize(devices.first(), &logger);
+	}
 	
 	Problem problem;
 	try {
 		logger.log("Load definition XML & Scene\n");
-		problem = Problem::fromFile(&logger, filePath, &renderer);
+		problem = Problem::fromFile(&logger, filePath, &renderer, extraRenderers);
+		problem.setBatchSize(batchSize);
+		problem.setSeed(seed);
 	} catch(std::exception& ex){
 		logger.log("Error reading file: %s\n", ex.what());
+		qDeleteAll(extraRenderers);
 		emit finished();
 		return;
 	}
 
+	if(resume)
+	{
+		try {
+			if(!problem.resume())
+			{
+				logger.log("No checkpoint to resume, starting from the beginning\n");
+			}
+		} catch(std::exception& ex){
+			logger.log("Error resuming: %s\n", ex.what());
+			qDeleteAll(extraRenderers);
+			emit finished();
+			return;
+		}
+	}
+
 	try {
 		logger.log("Optimizing\n");
 		problem.optimize();
@@ -52,6 +91,7 @@ void Main::run()
 	
 	logger.log("Cleaning up\n");
 	QThreadPool::globalInstance()->waitForDone();
+	qDeleteAll(extraRenderers);
 	emit finished();
 }
 
@@ -82,10 +122,18 @@ int main(int argc, char **argv)
     parser.addHelpOption();
     parser.addVersionOption();
 	parser.addPositionalArgument("source", "Problem definition input file.");
-	QCommandLineOption deviceOption(QStringList() << "d" << "device", "Device number id. Use -l to list devices.", "device", "0");
+	QCommandLineOption deviceOption(QStringList() << "d" << "device", "Device number ids, separated by commas. Candidates are evaluated on all of them. Use -l to list devices.", "device", "0");
 	QCommandLineOption listOption(QStringList() << "l" << "list", "List present CUDA devices in the machine.");
+	QCommandLineOption cpuOption(QStringList() << "c" << "cpu", "Also evaluate candidates on the CPU.");
+	QCommandLineOption batchSizeOption(QStringList() << "b" << "batch-size", "Candidates evaluated at once. Defaults to one per device.", "batch-size", "0");
 	parser.addOption(deviceOption);
 	parser.addOption(listOption);
+	QCommandLineOption seedOption(QStringList() << "s" << "seed", "Random seed. Defaults to the current time.", "seed");
+	QCommandLineOption resumeOption(QStringList() << "r" << "resume", "Resume the optimization from its last checkpoint.");
+	parser.addOption(cpuOption);
+	parser.addOption(batchSizeOption);
+	parser.addOption(seedOption);
+	parser.addOption(resumeOption);
 
 	parser.process(app);
 	const QStringList args = parser.positionalArguments();
@@ -104,19 +152,46 @@ int main(int argc, char **argv)
 	}
 	
 	// parse -d option
+	QVector<int> deviceNumbers;
+	for(auto deviceNumberStr: parser.value(deviceOption).split(','))
+	{
+		bool parseOk;
+		int deviceNumber = deviceNumberStr.trimmed().toInt(&parseOk);
+		if(!parseOk)
+		{
+			std::cerr << "Expect a number for device option." << std::endl;
+			parser.showHelp(1);
+		}
+		if(deviceNumber < 0)
+		{
+			std::cerr << "Option --device(-d) can't be negative." << std::endl;
+			parser.showHelp(1);
+		}
+		deviceNumbers.append(deviceNumber);
+	}
+
+	// parse -b option
 	bool parseOk;
-	int deviceNumber = parser.value(deviceOption).toInt(&parseOk);
-	if(!parseOk)
+	int batchSize = parser.value(batchSizeOption).toInt(&parseOk);
+	if(!parseOk || batchSize < 0)
 	{
-		std::cerr << "Expect a number for device option." << std::endl;
+		std::cerr << "Option --batch-size(-b) must be a non-negative number." << std::endl;
 		parser.showHelp(1);
 	}
-	if(deviceNumber < 0)
+
+	// parse -s option
+	unsigned int seed = std::time(NULL);
+	if(parser.isSet(seedOption))
 	{
-		std::cerr << "Option --device(-d) can't be negative." << std::endl;
-		parser.showHelp(1);
+		seed = parser.value(seedOption).toUInt(&parseOk);
+		if(!parseOk)
+		{
+			std::cerr << "Option --seed(-s) must be a non-negative number." << std::endl;
+			parser.showHelp(1);
+		}
 	}
-	// find and check selected device
+
+	// find and check selected devices
 	ComputeDeviceRepository repository;
 	const std::vector<ComputeDevice> & repo = repository.getComputeDevices();
 	if(repo.empty())
@@ -127,18 +202,21 @@ int main(int argc, char **argv)
 			"list of all supported devices." << std::endl;
 		exit(1);
 	}
-	if(deviceNumber >= repo.size())
+	QVector<ComputeDevice> devices;
+	for(auto deviceNumber: deviceNumbers)
 	{
-		std::cerr << "Invalid device number " << deviceNumber << "." << std::endl
-			<<  "Try -l to list available computing devices." << std::endl;
-		exit(1);
+		if(deviceNumber >= repo.size())
+		{
+			std::cerr << "Invalid device number " << deviceNumber << "." << std::endl
+				<<  "Try -l to list available computing devices." << std::endl;
+			exit(1);
+		}
+		devices.append(repo.at(deviceNumber));
 	}
 
-	ComputeDevice device = repo.at(deviceNumber);
-
 	// Task parented to the application so that it
     // will be deleted by the application.
-	Main *main = new Main(&app, inputPath, device);
+	Main *main = new Main(&app, inputPath, devices, parser.isSet(cpuOption), batchSize, seed, parser.isSet(resumeOption));
 
     // This will cause the application to exit when
     // the task signals finished.    
@@ -6,12 +6,19 @@ class Main : public QObject
 {
     Q_OBJECT
 public:
-    Main(QObject *parent, const QString &filePath, const ComputeDevice &device);
+    Main(QObject *parent, const QString &filePath, const QVector<ComputeDevice> &devices, bool useCPU, int batchSize,
+        unsigned int seed, bool resume);
 public slots:
     void run();
 signals:
     void finished();
 private:
 	QString filePath;
-	ComputeDevice device;
+	// candidates are evaluated on all the devices, and on the CPU if useCPU is set
+	QVector<ComputeDevice> devices;
+	bool useCPU;
+	int batchSize;
+	unsigned int seed;
+	// goes on from the last checkpoint of the problem, if there is one
+	bool resume;
 };
@@ -7,11 +7,14 @@
 #include "Problem.h"
 #include "logging/Logger.h"
 #include "util/sutil.h"
+#include "util/ParallelFor.h"
 #include "conditions/Condition.h"
 #include "conditions/ConditionPosition.h"
 #include "optimizations/SurfaceRadiosity.h"
 #include "optimizations/SurfaceRadiosityEvaluation.h"
 #include "Configuration.h"
+#include "EvaluationStore.h"
+#include "Random.h"
 #include <algorithm>
 #include <iterator>     
 #include <ctime>
@@ -22,9 +25,15 @@
 Problem::Problem():
 	scene(NULL),
 	optimizationFunction(NULL),
+	evaluationStore(NULL),
 	currentIteration(0),
+	currentRadius(0.05f),
+	seed(std::time(NULL)),
+	resumed(false),
+	lastCheckpointTime(0),
 	logger(NULL),
 	renderer(NULL),
+	batchSize(1),
 	inited(false),
 	siIsoc(0, 0),
 	startTime(0)
@@ -58,33 +67,45 @@ void Problem::optimize()
 		throw std::logic_error("Problem is not inited");
 	}
 
-	qsrand(std::time(NULL));
-	
-	startTime = sutilCurrentTime();
+	// the photons of the renderers also follow the seed, each evaluator with its own
+	for(int i = 0; i < evaluators.size(); ++i){
+		evaluators.at(i)->setRandomSeed(seed + i);
+	}
+
+	if(!resumed)
+	{
+		solverSrand(seed);
+		logger->log("Random seed %u\n", seed);
 
-	// first solution
-	processInitialConfiguration();
+		startTime = sutilCurrentTime();
+
+		// first solution
+		processInitialConfiguration();
+		currentRadius = 0.05f;
+	}
+	lastCheckpointTime = sutilCurrentTime();
 
 	// apply Problem
 	while(currentIteration < maxIterations)
 	{
-		float radius = 0.05f;
-		while(radius < 1.0f){
+		while(currentRadius < 1.0f){
 			float suffleRadius = getShuffleRadius(
 				(float) currentIteration / maxIterations
 			);
 			bool improvementFound = findFirstImprovement(
-				radius,
+				currentRadius,
 				suffleRadius,
-				getRetriesForRadius(radius)
+				getRetriesForRadius(currentRadius)
 				);
 			if(improvementFound){
-				radius = 0.05f;
+				currentRadius = 0.05f;
 			} else {
-				radius += 0.05;
+				currentRadius += 0.05;
 			}
+			saveCheckpointIfDue();
 		}
 		logger->log("Done navigating whole neighbourhood: %d\n", currentIteration);
+		currentRadius = 0.05f;
 	}
 
 	finishingISOCRefinement();
@@ -98,6 +119,9 @@ void Problem::optimize()
 	logStatistics();
 
 	logBestConfigurations();
+
+	// the optimization is over, there is nothing left to resume
+	QFile::remove(getCheckpointFileName());
 }
 
 void Problem::finishingISOCRefinement()
@@ -126,6 +150,7 @@ void Problem::finishingISOCRefinement()
 		auto totalTime = sutilCurrentTime() - startTime;
 		statistics.evaluationTime += totalTime;
 		statistics.evaluations++;
+		statistics.photons += evaluation->photons();
 	
 
 		maxQualityISOCCandidates.append(PositionEvalResult{
@@ -184,6 +209,7 @@ Configuration Problem::processInitialConfiguration()
 	auto totalTime = sutilCurrentTime() - startTime;
 	statistics.evaluationTime += totalTime;
 	statistics.evaluations++;
+	statistics.photons += evaluation->photons();
 	auto initialEval = EvaluateSolutionResult(evaluation, totalTime);
 
 
@@ -226,9 +252,20 @@ bool Problem::recalcISOC(
 	const QVector<ConditionPosition *> &positions,
 	Problem::EvaluateSolutionResult eval)
 {
+	// a cached evaluation skips the render only. A repeated candidate of the batch takes the evaluation
+	// the first one left, which may have been reevaluated with max quality.
 	if (eval.isCached) {
-		++currentIteration;
-		return false;
+		eval.evaluation = evaluations.value(eval.mappedPositions);
+		for(auto configuration: isoc){
+			if(configuration.evaluation() == eval.evaluation){
+				++currentIteration;
+				logIterationResults(positions, eval.evaluation, "IN-ISOC", eval.timeEvaluation);
+				for (auto p : positions){
+					delete p;
+				}
+				return false;
+			}
+		}
 	}
 
 	if (!eval.evaluation->valid())
@@ -254,7 +291,7 @@ bool Problem::recalcISOC(
 	{
 		if (!eval.evaluation->isMaxQuality()) {
 			delete eval.evaluation;
-			auto reevaluatedSolution = reevalMaxQuality();
+			auto reevaluatedSolution = reevalMaxQuality(positions);
 			setEvaluation(eval.mappedPositions, reevaluatedSolution.evaluation);
 
 			eval = reevaluatedSolution;
@@ -303,40 +340,74 @@ bool Problem::recalcISOC(
 	return false;
 }
 
-bool Problem::findFirstImprovement(float maxRadius, float shuffleRadius, int retries)
+void Problem::setSeed(unsigned int seed)
+{
+	this->seed = seed;
+}
+
+void Problem::setBatchSize(int batchSize)
+{
+	if(batchSize < 0){
+		throw std::invalid_argument("batch size can't be negative");
+	}
+	this->batchSize = batchSize == 0 ? evaluators.size() : batchSize;
+}
+
+QVector<ConditionPosition *> Problem::findCandidate(float maxRadius, float shuffleRadius)
 {
 	static const int neighbourhoodRetries = 20;
 
-	while(retries-- > 0){
-		// move the reference point to some element of the configuration file
-		int someConfigIdx = rand() % isoc.length();
-		auto positions = isoc.at(someConfigIdx).positions();
-
-		// shuffle condition positions a bit
-		int shuffled;
-		for(shuffled = 0; shuffled < positions.size(); ++shuffled){
-			auto currentShuffleRadius = shuffleRadius * qrand() / RAND_MAX;
-			auto neighbour = conditions.at(shuffled)->findNeighbour(
-				positions.at(shuffled), currentShuffleRadius, neighbourhoodRetries
-			);
-			if(!neighbour){
-				break; // can't shuffle
-			}
-			positions[shuffled] = neighbour;
+	// move the reference point to some element of the configuration file
+	int someConfigIdx = solverRand() % isoc.length();
+	auto positions = isoc.at(someConfigIdx).positions();
+
+	// shuffle condition positions a bit
+	int shuffled;
+	for(shuffled = 0; shuffled < positions.size(); ++shuffled){
+		auto currentShuffleRadius = shuffleRadius * solverRand() / RAND_MAX;
+		auto neighbour = conditions.at(shuffled)->findNeighbour(
+			positions.at(shuffled), currentShuffleRadius, neighbourhoodRetries
+		);
+		if(!neighbour){
+			break; // can't shuffle
 		}
-		if(shuffled < positions.size()){
-			continue; // can't shuffle
+		positions[shuffled] = neighbour;
+	}
+	if(shuffled < positions.size()){
+		return QVector<ConditionPosition *>(); // can't shuffle
+	}
+
+	// find neighbours, empty if there are none
+	return findAllNeighbours(positions, neighbourhoodRetries, maxRadius);
+}
+
+bool Problem::findFirstImprovement(float maxRadius, float shuffleRadius, int retries)
+{
+	while(retries > 0){
+		// candidates are drawn on this thread, so the random sequence doesn't depend on the evaluators
+		QVector<QVector<ConditionPosition *>> candidates;
+		while(retries > 0 && candidates.size() < batchSize){
+			--retries;
+			auto candidate = findCandidate(maxRadius, shuffleRadius);
+			if(!candidate.empty()){
+				candidates.append(candidate);
+			}
 		}
-		
-		// find neighbours
-		auto neighbourPosition = findAllNeighbours(positions, neighbourhoodRetries, maxRadius);
-		if(neighbourPosition.empty()){
-			continue; // no neighbours
+		if(candidates.empty()){
+			continue;
 		}
 
-		auto eval = evaluateSolution(neighbourPosition);
-		bool isImprovement = recalcISOC(neighbourPosition, eval);
-		if(isImprovement)
+		auto evals = evaluateSolutions(candidates);
+
+		// in the order the candidates were drawn, whichever evaluator finished first. The rest of
+		// the batch is still used after an improvement, it has been evaluated already.
+		bool improvementFound = false;
+		for(int i = 0; i < candidates.size(); ++i){
+			if(recalcISOC(candidates.at(i), evals.at(i))){
+				improvementFound = true;
+			}
+		}
+		if(improvementFound)
 		{
 			return true;
 		}
@@ -372,55 +443,105 @@ QVector<int> Problem::getMappedPosition(const QVector<ConditionPosition *>& posi
 }
 
 
-Problem::EvaluateSolutionResult Problem::evaluateSolution(const QVector<ConditionPosition *>& positions)
+QVector<Problem::EvaluateSolutionResult> Problem::evaluateSolutions(
+	const QVector<QVector<ConditionPosition *>>& candidates)
 {
 	double startTime = sutilCurrentTime();
-	auto mappedPositions = getMappedPosition(positions);
-	auto evaluation = evaluations[mappedPositions];
-	if(evaluation)
-	{
-		//qDebug() << "Returning saved evaluation for " << mappedPositionsStr.join(", ") << ": " << evaluation->infoShort() << "\n";
-		return EvaluateSolutionResult(true, mappedPositions, evaluation, sutilCurrentTime() - startTime);
+	QVector<EvaluateSolutionResult> results(candidates.size());
+
+	// candidates which are neither saved nor repeated in the batch are evaluated. An evaluation that
+	// stopped early is only reused while it is still below the ISOC, which is all it tells.
+	auto threshold = siIsoc;
+	QVector<int> pending;
+	QHash<QVector<int>, int> pendingMappedPositions;
+	for(int i = 0; i < candidates.size(); ++i){
+		auto mappedPositions = getMappedPosition(candidates.at(i));
+		auto evaluation = evaluations.value(mappedPositions);
+		if(evaluation && (!evaluation->isStoppedEarly() || evaluation->interval() < threshold)){
+			results[i] = EvaluateSolutionResult(true, mappedPositions, evaluation, sutilCurrentTime() - startTime);
+			statistics.evaluationHits++;
+		} else {
+			results[i].mappedPositions = mappedPositions;
+			if(!pendingMappedPositions.contains(mappedPositions)){
+				pendingMappedPositions[mappedPositions] = i;
+				pending.append(i);
+				statistics.evaluationMisses++;
+			} else {
+				statistics.evaluationHits++;
+			}
+		}
 	}
-	else
-	{
-		//qDebug() << "Calculating evaluation for " << mappedPositionsStr.join(", ") << "\n";
 
-		for(auto position: positions) {
-			position->apply(renderer);
+	// each evaluator takes the next pending candidate when it is done with the previous one. Candidates
+	// stop tracing photons once they are certainly below the ISOC, as recalcISOC would discard them.
+	float quality = evalConfigurationQuality();
+	EvaluateSolutionResult *resultsData = results.data();
+	QVector<RadiosityEstimate::StopReason> stopReasons(candidates.size(), RadiosityEstimate::CONTINUE);
+	RadiosityEstimate::StopReason *stopReasonsData = stopReasons.data();
+	int numEvaluators = std::min(evaluators.size(), pending.size());
+	parallelForDynamic(0, pending.size(), numEvaluators, 1, [&](int evaluatorIdx, int begin, int end){
+		// each worker thread has its own evaluator, and the CUDA device is selected per thread
+		auto evaluator = evaluators.at(evaluatorIdx);
+		evaluator->makeCurrent();
+		for(int i = begin; i < end; ++i){
+			auto candidateIdx = pending.at(i);
+			double evaluationStartTime = sutilCurrentTime();
+			for(auto position: candidates.at(candidateIdx)) {
+				position->apply(evaluator);
+			}
+			auto evaluation = optimizationFunction->evaluateSequential(evaluator, quality, threshold, &stopReasonsData[candidateIdx]);
+			resultsData[candidateIdx].evaluation = evaluation;
+			resultsData[candidateIdx].timeEvaluation = sutilCurrentTime() - evaluationStartTime;
 		}
+	});
+
+	for(auto candidateIdx: pending){
+		evaluations[results.at(candidateIdx).mappedPositions] = results.at(candidateIdx).evaluation;
+		statistics.photons += results.at(candidateIdx).evaluation->photons();
+		statistics.belowIsocStops += stopReasons.at(candidateIdx) == RadiosityEstimate::BELOW_THRESHOLD;
+		statistics.narrowIntervalStops += stopReasons.at(candidateIdx) == RadiosityEstimate::NARROW_ENOUGH;
+		if(evaluationStore){
+			evaluationStore->append(results.at(candidateIdx).mappedPositions, results.at(candidateIdx).evaluation);
+		}
+	}
+	if(evaluationStore){
+		evaluationStore->flush();
+	}
 
-		// TODO use evaluate fast
-		auto candidate = optimizationFunction->evaluateFast(evalConfigurationQuality());
-		/*auto candidate = optimizationFunction->evaluateRadiosity();
-		auto imagePath = outputDir.filePath(
-			QString("solution-%1.png").arg(currentIteration, 4, 10, QLatin1Char('0'))
-		);
-		optimizationFunction->saveImage(imagePath);*/
-		
-		evaluations[mappedPositions] = candidate;
-
-		evaluation = candidate;
-
-		auto totalTime = sutilCurrentTime() - startTime;
-		statistics.evaluationTime += totalTime;
-		statistics.evaluations++;
-		return EvaluateSolutionResult(false, mappedPositions, evaluation, totalTime);
+	// repeated candidates take the evaluation of the first one
+	for(int i = 0; i < candidates.size(); ++i){
+		if(!results.at(i).evaluation){
+			auto mappedPositions = results.at(i).mappedPositions;
+			results[i] = EvaluateSolutionResult(true, mappedPositions, evaluations.value(mappedPositions), 0);
+		}
 	}
+
+	statistics.evaluationTime += sutilCurrentTime() - startTime;
+	statistics.evaluations += pending.size();
+	return results;
 }
 
 void Problem::setEvaluation(const QVector<int>& mappedPositions, SurfaceRadiosityEvaluation *evaluation)
 {
 	evaluations[mappedPositions] = evaluation;
+	if(evaluationStore){
+		evaluationStore->append(mappedPositions, evaluation);
+		evaluationStore->flush();
+	}
 }
 
-Problem::EvaluateSolutionResult Problem::reevalMaxQuality()
+Problem::EvaluateSolutionResult Problem::reevalMaxQuality(const QVector<ConditionPosition *>& positions)
 {
 	double startTime = sutilCurrentTime();
+	// the candidate may have been evaluated on another renderer
+	for(auto position: positions) {
+		position->apply(renderer);
+	}
 	auto evaluation = optimizationFunction->evaluateFast(1.0f);
 	auto totalTime = sutilCurrentTime() - startTime;
 	statistics.evaluationTime += totalTime;
 	statistics.evaluations++;
+	statistics.photons += evaluation->photons();
 	return EvaluateSolutionResult(evaluation, totalTime);
 }
 
@@ -432,12 +553,12 @@ QVector<ConditionPosition *> Problem::findAllNeighbours(
 {
 	QVector<ConditionPosition *> res;
 
-	float radius = maxRadius * qrand() / RAND_MAX;
+	float radius = maxRadius * solverRand() / RAND_MAX;
 
 	// generate partitions
 	auto corradius = QVector<float>() << 0.0f;
 	for(int i = 0; i < conditions.size()-1; ++i){
-		corradius.append(radius * qrand() / RAND_MAX);
+		corradius.append(radius * solverRand() / RAND_MAX);
 	}
 	corradius << radius;
 	qSort(corradius);
@@ -14,6 +14,7 @@
 #include <QHash>
 
 class Logger;
+class PhotonRenderer;
 class QFile;
 class QString;
 class Condition;
@@ -22,6 +23,7 @@ class SurfaceRadiosityEvaluation;
 class QDomDocument;
 class QDomElement;
 class Configuration;
+class EvaluationStore;
 
 
 uint qHash(const QVector<int> &key, uint seed);
@@ -61,11 +63,31 @@ private:
 	struct Statistics {
 		double evaluationTime;
 		int evaluations;
+		// photons traced by the evaluations
+		double photons;
 		double totalTime;
+		// lookups of mapped positions in the evaluations, which include the stored ones
+		int evaluationHits;
+		int evaluationMisses;
+		int storedEvaluations;
+		// evaluations that stopped tracing photons below the ISOC or with a narrow enough interval
+		int belowIsocStops;
+		int narrowIntervalStops;
 	};
 public:
 	Problem();
-	static Problem fromFile(Logger *logger, const QString& filePath, PMOptixRenderer *renderer);
+	// Candidates are evaluated on renderer and on each of extraRenderers, which must be initialized
+	static Problem fromFile(
+		Logger *logger,
+		const QString& filePath,
+		PMOptixRenderer *renderer,
+		const QVector<PhotonRenderer *> &extraRenderers = QVector<PhotonRenderer *>()
+	);
+	// Number of candidates drawn and evaluated at once, 0 for one per renderer
+	void setBatchSize(int batchSize);
+	void setSeed(unsigned int seed);
+	// Restores the state of the last checkpoint, if there is one, so that optimize goes on from there
+	bool resume();
 	void optimize();
 private:
 	// scene reading
@@ -75,6 +97,7 @@ private:
 	void readOptimizationFunctionBaseAttrs(QDomElement& element);
 	void readOptimizationFunctionChild(QDomElement& element);
 	void readOutputPath(const QString &fileName, QDomDocument& doc);
+	void readEvaluationStore(QDomDocument& doc);
 
 	// misc
 	QString getImageFileName();
@@ -92,6 +115,11 @@ private:
 	void logStatistics();
 	void logStrategy();
 
+	// checkpoints
+	QString getCheckpointFileName();
+	void saveCheckpoint();
+	void saveCheckpointIfDue();
+
 	// optimization
 	Configuration processInitialConfiguration();
 	float initialConfigurationQuality();
@@ -107,8 +135,9 @@ private:
 		const QVector<int>& mappedPositions,
 		SurfaceRadiosityEvaluation *evaluation
 		);
-	EvaluateSolutionResult evaluateSolution(const QVector<ConditionPosition *>& positions);
-	EvaluateSolutionResult reevalMaxQuality();
+	QVector<EvaluateSolutionResult> evaluateSolutions(const QVector<QVector<ConditionPosition *>>& candidates);
+	EvaluateSolutionResult reevalMaxQuality(const QVector<ConditionPosition *>& positions);
+	QVector<ConditionPosition *> findCandidate(float maxRadius, float shuffleRadius);
 	QVector<ConditionPosition *> findAllNeighbours(
 		QVector<ConditionPosition *> &currentPositions,
 		int retries, float maxRadius
@@ -120,14 +149,25 @@ private:
 	QVector<Condition *> conditions;
 	QList<int> meshSize;
 	QHash<QVector<int>, SurfaceRadiosityEvaluation *> evaluations;
+	EvaluationStore *evaluationStore;
 	
 	QList<Configuration> isoc;
 	Interval siIsoc;
 
 	SurfaceRadiosity *optimizationFunction;
 	PMOptixRenderer *renderer;
+	// renderer first, then the extra renderers
+	QVector<PhotonRenderer *> evaluators;
+	int batchSize;
 	int currentIteration;
 	int maxIterations;
+	// neighbourhood radius explored by optimize
+	float currentRadius;
+	unsigned int seed;
+	bool resumed;
+	double lastCheckpointTime;
+	// identifies the scene, conditions and objectives, see readEvaluationStore
+	QByteArray problemKey;
 	float fastEvaluationQuality;
 	double startTime;
 	Logger *logger;
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2014 Ignacio Avas
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "Random.h"
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+static std::mt19937 solverRandomEngine;
+
+void solverSrand(unsigned int seed)
+{
+	solverRandomEngine.seed(seed);
+}
+
+int solverRand()
+{
+	return (int)(solverRandomEngine() % ((unsigned int)RAND_MAX + 1));
+}
+
+QByteArray getSolverRandomState()
+{
+	std::ostringstream state;
+	state << solverRandomEngine;
+	return QByteArray::fromStdString(state.str());
+}
+
+void setSolverRandomState(const QByteArray &state)
+{
+	std::istringstream stateStream(state.toStdString());
+	std::mt19937 engine;
+	stateStream >> engine;
+	if(stateStream.fail()){
+		throw std::invalid_argument("Invalid random state");
+	}
+	solverRandomEngine = engine;
+}
@@ -0,0 +1,16 @@
+/*
+ * Copyright (c) 2014 Ignacio Avas
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+#pragma once
+
+#include <QByteArray>
+
+// Random numbers of the optimization, used instead of qrand because their state can be saved in a
+// checkpoint and restored, so that a resumed optimization goes on with the same sequence.
+void solverSrand(unsigned int seed);
+// Like qrand, a number between 0 and RAND_MAX
+int solverRand();
+QByteArray getSolverRandomState();
+void setSolverRandomState(const QByteArray &state);
@@ -13,6 +13,10 @@
 #include "conditions/DirectionalLight.h"
 #include "conditions/ColorCondition.h"
 #include "optimizations/SurfaceRadiosity.h"
+#include "EvaluationStore.h"
+#include "clientserver/SceneTransferMessage.h"
+#include <QCryptographicHash>
+#include <QTextStream>
 
 
 void Problem::readScene(QFile &file, const QString& fileName)
@@ -221,6 +225,50 @@ void Problem::readOutputPath(const QString &fileName, QDomDocument& xml)
 	throw std::logic_error("No output path set");
 }
 
+void Problem::readEvaluationStore(QDomDocument& xml)
+{
+	// the key covers everything an evaluation depends on: the scene files, the conditions with
+	// the mesh size, the objective with the evaluation quality and the photons of the renderer
+	auto sceneFiles = scene->getSceneFiles();
+	QDir sceneDir = QFileInfo(sceneFiles.first()).dir();
+	QStringList relativeSceneFiles;
+	for(auto sceneFile: sceneFiles){
+		auto relativeSceneFile = sceneDir.relativeFilePath(sceneFile);
+		if(!relativeSceneFiles.contains(relativeSceneFile))
+			relativeSceneFiles.append(relativeSceneFile);
+	}
+	auto sceneHash = hashSceneFiles(sceneDir.absolutePath(), relativeSceneFiles);
+	if(sceneHash.isEmpty())
+		throw std::logic_error("Couldn't read the scene files");
+
+	QCryptographicHash keyHash(QCryptographicHash::Sha1);
+	keyHash.addData(sceneHash);
+	auto nodes = xml.documentElement().childNodes();
+	for(int i = 0; i < nodes.length(); ++i)
+	{
+		auto element = nodes.at(i).toElement();
+		if(element.tagName() != "conditions" && element.tagName() != "objectives")
+			continue;
+		QString elementStr;
+		QTextStream elementStream(&elementStr);
+		element.save(elementStream, 0);
+		keyHash.addData(elementStr.toUtf8());
+	}
+	keyHash.addData(QByteArray::number(renderer->getMaxPhotonWidth()));
+	auto key = keyHash.result();
+	problemKey = key;
+
+	int dimensions = 0;
+	for(auto condition: conditions)
+		dimensions += condition->dimensions().length();
+
+	auto storePath = outputDir.filePath(QString("evaluations-%1.cache").arg(QString(key.toHex().left(16))));
+	evaluationStore = new EvaluationStore(storePath, key, dimensions);
+	evaluations = evaluationStore->load();
+	statistics.storedEvaluations = evaluations.size();
+	logger->log("Evaluation store %s with %d evaluations\n", qPrintable(storePath), evaluations.size());
+}
+
 void Problem::readOptimizationFunction(QDomDocument& xml)
 {
 	auto nodes = xml.documentElement().childNodes();
@@ -317,13 +365,28 @@ void Problem::readOptimizationFunctionChild(QDomElement& maximizeRadianceNode)
 			throw std::logic_error("Invalid value for maxRadiosity");
 	}
 
-	optimizationFunction = new SurfaceRadiosity(logger, renderer, scene, surface, maxRadiosityVal);
+	// width of the radiosity interval at which a candidate evaluation can stop tracing photons
+	QString maxIntervalWidth = maximizeRadianceNode.attribute("maxIntervalWidth");
+	float maxIntervalWidthVal = 0;
+	if (!maxIntervalWidth.isEmpty())
+	{
+		bool ok;
+		maxIntervalWidthVal = maxIntervalWidth.toFloat(&ok);
+		if (!ok || maxIntervalWidthVal < 0)
+			throw std::logic_error("Invalid value for maxIntervalWidth");
+	}
+
+	optimizationFunction = new SurfaceRadiosity(logger, renderer, scene, surface, maxRadiosityVal, maxIntervalWidthVal);
 
 	qDebug("objective: maximize Surface Radiosity on %s. Max value %f", qPrintable(surface), maxRadiosityVal);
 }
 
 
-Problem Problem::fromFile(Logger *logger, const QString& filePath, PMOptixRenderer *renderer)
+Problem Problem::fromFile(
+	Logger *logger,
+	const QString& filePath,
+	PMOptixRenderer *renderer,
+	const QVector<PhotonRenderer *> &extraRenderers)
 {
 	Problem res;
 
@@ -348,11 +411,22 @@ Problem Problem::fromFile(Logger *logger, const QString& filePath, PMOptixRender
 
 	res.logger = logger;
 	res.renderer = renderer;
+	res.evaluators = QVector<PhotonRenderer *>() << renderer << extraRenderers;
+	// evaluators run at the same time, a renderer can't be used by two of them
+	for(int i = 0; i < res.evaluators.size(); ++i){
+		if(res.evaluators.indexOf(res.evaluators.at(i)) != i){
+			throw std::invalid_argument("the same renderer can't evaluate twice at once");
+		}
+	}
+	res.batchSize = res.evaluators.size();
 	res.readScene(file, filePath);
 	res.readConditions(xml);
 	res.readOptimizationFunction(xml);
-	res.renderer->initScene(*res.scene);
+	for(auto evaluator: res.evaluators){
+		evaluator->initScene(*res.scene);
+	}
 	res.readOutputPath(filePath, xml);
+	res.readEvaluationStore(xml);
 
 	return res;
 }
@@ -1,5 +1,6 @@
 #include "ColorCondition.h"
 #include "ColorConditionPosition.h"
+#include "Random.h"
 
 static float to_0_maxInterval(float v, float max)
 {
@@ -20,7 +21,7 @@ ConditionPosition *ColorCondition::findNeighbour(ConditionPosition *from, float
 	auto color = position->hsvColor();
 
 	while (retries > 0){
-		auto displacement = (2 * qrand() / (float)RAND_MAX - 1.f)  *  radius;
+		auto displacement = (2 * solverRand() / (float)RAND_MAX - 1.f)  *  radius;
 		auto value = color.z + displacement;
 
 		if (value >= 0 && value <= 1.0)
@@ -50,3 +51,7 @@ QStringList ColorCondition::header() const
 	return QStringList() << (node + "(r)") << (node + "(g)") << (node + "(b)");
 }
 
+ConditionPosition *ColorCondition::loadPosition(QDataStream &in) const
+{
+	return ColorConditionPosition::load(in);
+}
@@ -10,6 +10,7 @@ public:
 	ColorCondition(const QString& node, const float saturation, const float hue);
 	virtual ConditionPosition *findNeighbour(ConditionPosition *from, float radius, unsigned int retries) const;
 	virtual ConditionPosition *initial() const;
+	virtual ConditionPosition *loadPosition(QDataStream &in) const;
 	virtual QVector<float> dimensions() const;
 	virtual QStringList header() const;
 private:
@@ -1,5 +1,6 @@
 #include "ColorConditionPosition.h"
-#include "renderer/PMOptixRenderer.h"
+#include "renderer/PhotonRenderer.h"
+#include <QDataStream>
 #include <QLocale>
 #include <QVector>
 #include <QColor>
@@ -18,7 +19,7 @@ optix::float3 ColorConditionPosition::rgbColor() const
 	return optix::make_float3(color.redF(), color.greenF(), color.blueF());
 }
 
-void ColorConditionPosition::apply(PMOptixRenderer *renderer) const
+void ColorConditionPosition::apply(PhotonRenderer *renderer) const
 {
 	renderer->setNodeDiffuseMaterialKd(m_node, rgbColor());
 }
@@ -51,4 +52,17 @@ QStringList ColorConditionPosition::info() const
 	auto y = locale.toString(color.y, 'f', 2);
 	auto z = locale.toString(color.z, 'f', 2);
 	return QStringList() << x << y << z;
-}
\ No newline at end of file
+}
+
+void ColorConditionPosition::save(QDataStream &out) const
+{
+	out << m_node << m_hsvColor.x << m_hsvColor.y << m_hsvColor.z;
+}
+
+ColorConditionPosition *ColorConditionPosition::load(QDataStream &in)
+{
+	QString node;
+	optix::float3 hsvColor;
+	in >> node >> hsvColor.x >> hsvColor.y >> hsvColor.z;
+	return new ColorConditionPosition(node, hsvColor);
+}
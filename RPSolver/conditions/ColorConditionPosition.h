@@ -11,8 +11,10 @@ public:
 	virtual QVector<float> normalizedPosition() const;
 	optix::float3 hsvColor() const;
 	optix::float3 rgbColor() const;
-	virtual void apply(PMOptixRenderer *) const;
+	virtual void apply(PhotonRenderer *) const;
 	virtual QStringList info() const;
+	virtual void save(QDataStream &out) const;
+	static ColorConditionPosition *load(QDataStream &in);
 private:
 	float value() const;	
 
@@ -2,12 +2,15 @@
 
 #include <QStringList>
 class ConditionPosition;
+class QDataStream;
 
 class Condition
 {
 public:
 	virtual ConditionPosition *findNeighbour(ConditionPosition *from, float radius, unsigned int retries) const = 0;
 	virtual ConditionPosition *initial() const = 0;
+	// reads a position written by ConditionPosition::save
+	virtual ConditionPosition *loadPosition(QDataStream &in) const = 0;
 	virtual QVector<float> dimensions() const = 0;
 	virtual QStringList header() const = 0;
 	virtual ~Condition(void) {};
@@ -3,14 +3,17 @@
 #include <QStringList>
 #include <QVector>
 
-class PMOptixRenderer;
+class PhotonRenderer;
+class QDataStream;
 
 class ConditionPosition
 {
 public:
-	virtual void apply(PMOptixRenderer *) const = 0;
+	virtual void apply(PhotonRenderer *) const = 0;
 	virtual QVector<float> normalizedPosition() const = 0;
 	virtual QStringList info() const = 0;
+	// the Condition of the position reads it back with loadPosition
+	virtual void save(QDataStream &out) const = 0;
 	virtual ~ConditionPosition(void) { };
 };
 
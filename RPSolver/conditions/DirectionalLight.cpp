@@ -1,5 +1,6 @@
 #include "DirectionalLight.h"
 #include "DirectionalLightPosition.h"
+#include "Random.h"
 #include "scene/Scene.h"
 
 DirectionalLight::DirectionalLight(Scene *scene, const QString& lightId):
@@ -54,7 +55,7 @@ ConditionPosition *DirectionalLight::findNeighbour(ConditionPosition *from, floa
 	auto directionalLightPosition = (DirectionalLightPosition *)from;
 	auto sphericalDirection = toSphericalCoord(directionalLightPosition->direction());
 
-	auto sample = qrand() / (float) RAND_MAX;
+	auto sample = solverRand() / (float) RAND_MAX;
 	auto rotation = 2.0f * M_PI * radius * (optix::make_float2(sample, 1.0f - sample) - 0.5f);
 	
 	return new DirectionalLightPosition(
@@ -71,4 +72,9 @@ ConditionPosition *DirectionalLight::initial() const
 QStringList DirectionalLight::header() const
 {
 	return QStringList() << (m_lightId + "(x)") << (m_lightId + "(y)") << (m_lightId + "(z)");
-}
\ No newline at end of file
+}
+
+ConditionPosition *DirectionalLight::loadPosition(QDataStream &in) const
+{
+	return DirectionalLightPosition::load(in);
+}
@@ -11,6 +11,7 @@ public:
 	DirectionalLight(Scene *scene, const QString& lightId);
 	virtual ConditionPosition *findNeighbour(ConditionPosition *from, float radius, unsigned int retries) const;
 	virtual ConditionPosition *initial() const;
+	virtual ConditionPosition *loadPosition(QDataStream &in) const;
 	virtual QVector<float> dimensions() const;
 	virtual QStringList header() const;
 private:
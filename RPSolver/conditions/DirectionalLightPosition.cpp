@@ -1,5 +1,6 @@
 #include "DirectionalLightPosition.h"
-#include "renderer/PMOptixRenderer.h"
+#include "renderer/PhotonRenderer.h"
+#include <QDataStream>
 #include <QLocale>
 #include <QVector>
 
@@ -9,7 +10,7 @@ DirectionalLightPosition::DirectionalLightPosition(const QString& lightId, const
 {
 }
 
-void DirectionalLightPosition::apply(PMOptixRenderer *renderer) const
+void DirectionalLightPosition::apply(PhotonRenderer *renderer) const
 {
 	renderer->setLightDirection(m_lightId, m_direction);
 }
@@ -39,4 +40,17 @@ QStringList DirectionalLightPosition::info() const
 	auto y = locale.toString(m_direction.y, 'f', 2);
 	auto z = locale.toString(m_direction.z, 'f', 2);
 	return QStringList() << x << y << z;
-}
\ No newline at end of file
+}
+
+void DirectionalLightPosition::save(QDataStream &out) const
+{
+	out << m_lightId << m_direction.x << m_direction.y << m_direction.z;
+}
+
+DirectionalLightPosition *DirectionalLightPosition::load(QDataStream &in)
+{
+	QString lightId;
+	optix::float3 direction;
+	in >> lightId >> direction.x >> direction.y >> direction.z;
+	return new DirectionalLightPosition(lightId, direction);
+}
@@ -8,12 +8,14 @@ class DirectionalLightPosition: public ConditionPosition
 public:
 	DirectionalLightPosition(const QString& lightId, const optix::float3& direction);
 	virtual QVector<float> normalizedPosition() const;
-	virtual void apply(PMOptixRenderer *) const;
+	virtual void apply(PhotonRenderer *) const;
 	
 	optix::float3 direction() const;
 	QString lightId() const;
 
 	virtual QStringList info() const;
+	virtual void save(QDataStream &out) const;
+	static DirectionalLightPosition *load(QDataStream &in);
 private:
 	QString m_lightId;
 	optix::float3 m_direction;
@@ -1,5 +1,6 @@
 #include "LightInSurface.h"
 #include "LightInSurfacePosition.h"
+#include "Random.h"
 #include <cmath>
 #include <limits>
 
@@ -85,7 +86,7 @@ optix::float3 LightInSurface::generatePointNeighbourhood(optix::float3 centerWor
 
 	optix::float2 res;
 	while(retries > 0) {
-		float angle = 2.0f * M_PI * qrand() / RAND_MAX; // random angle
+		float angle = 2.0f * M_PI * solverRand() / RAND_MAX; // random angle
 		res = center + relativeRadius * optix::make_float2(cosf(angle), sinf(angle)); // res in uv coordinates
 		if(pointInSurface(res)){
 			return res.x * u + res.y * v + base; // res in world coordinates
@@ -129,3 +130,8 @@ QStringList LightInSurface::header() const
 LightInSurface::~LightInSurface()
 {
 }
+
+ConditionPosition *LightInSurface::loadPosition(QDataStream &in) const
+{
+	return LightInSurfacePosition::load(in);
+}
@@ -1,5 +1,6 @@
 #include "LightInSurfacePosition.h"
-#include "renderer/PMOptixRenderer.h"
+#include "renderer/PhotonRenderer.h"
+#include <QDataStream>
 #include <QLocale>
 
 LightInSurfacePosition::LightInSurfacePosition(const QString &lightId, optix::float3 initialPosition, const optix::Matrix4x4 &transformation, const QVector<float>& normalizedPosition):
@@ -15,7 +16,7 @@ optix::Matrix4x4 LightInSurfacePosition::transformation() const
 	return m_transformation;
 }
 
- void LightInSurfacePosition::apply(PMOptixRenderer *renderer) const
+ void LightInSurfacePosition::apply(PhotonRenderer *renderer) const
  {
 	 renderer->setNodeTransformation(lightId, m_transformation);	
  }
@@ -35,4 +36,27 @@ QVector<float> LightInSurfacePosition::normalizedPosition() const
 	auto y = locale.toString(position.y, 'f', 2);
 	auto z = locale.toString(position.z, 'f', 2);
 	return QStringList() << x << y << z;
-}
\ No newline at end of file
+}
+
+void LightInSurfacePosition::save(QDataStream &out) const
+{
+	out << lightId << initialPosition.x << initialPosition.y << initialPosition.z;
+	for(int i = 0; i < 16; ++i){
+		out << m_transformation.getData()[i];
+	}
+	out << m_normalizedPosition;
+}
+
+LightInSurfacePosition *LightInSurfacePosition::load(QDataStream &in)
+{
+	QString lightId;
+	optix::float3 initialPosition;
+	float transformation[16];
+	QVector<float> normalizedPosition;
+	in >> lightId >> initialPosition.x >> initialPosition.y >> initialPosition.z;
+	for(int i = 0; i < 16; ++i){
+		in >> transformation[i];
+	}
+	in >> normalizedPosition;
+	return new LightInSurfacePosition(lightId, initialPosition, optix::Matrix4x4(transformation), normalizedPosition);
+}
@@ -4,7 +4,7 @@
 #include <optixu_matrix_namespace.h>
 #include <QStringList>
 
-class PMOptixRenderer;
+class PhotonRenderer;
 
 class LightInSurfacePosition: public ConditionPosition
 {
@@ -12,8 +12,10 @@ public:
 	LightInSurfacePosition(const QString &lightId, optix::float3 initialPosition, const optix::Matrix4x4 &transformation, const QVector<float>& normalizedPosition);
 	virtual QVector<float> normalizedPosition() const;
 	QStringList info() const;
+	virtual void save(QDataStream &out) const;
+	static LightInSurfacePosition *load(QDataStream &in);
 	optix::Matrix4x4 transformation() const; 
-	virtual void apply(PMOptixRenderer *) const;
+	virtual void apply(PhotonRenderer *) const;
 private:
 	QString lightId;
 	optix::float3 initialPosition;
@@ -1,5 +1,6 @@
 #include "ObjectInSurface.h"
 #include "ObjectInSurfacePosition.h"
+#include "Random.h"
 #include <cmath>
 #include <qDebug>
 
@@ -121,7 +122,7 @@ ConditionPosition *ObjectInSurface::findNeighbour(ConditionPosition *from, float
 
 static float getRandomAngle()
 {
-	return 2.0f * M_PI * qrand() / RAND_MAX;
+	return 2.0f * M_PI * solverRand() / RAND_MAX;
 }
 
 optix::float3 ObjectInSurface::generatePointNeighbourhood(optix::float3 centerWorldCoordinates, float radius, unsigned int& retries) const
@@ -170,4 +171,9 @@ ConditionPosition *ObjectInSurface::initial() const
 QStringList ObjectInSurface::header() const
 {
 	return QStringList() << (m_nodeId + "(x)") << (m_nodeId + "(y)") << (m_nodeId + "(z)");
-}
\ No newline at end of file
+}
+
+ConditionPosition *ObjectInSurface::loadPosition(QDataStream &in) const
+{
+	return ObjectInSurfacePosition::load(in);
+}
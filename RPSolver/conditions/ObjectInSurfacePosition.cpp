@@ -1,5 +1,6 @@
 #include "ObjectInSurfacePosition.h"
-#include "renderer/PMOptixRenderer.h"
+#include "renderer/PhotonRenderer.h"
+#include <QDataStream>
 #include <QLocale>
 
 
@@ -21,7 +22,7 @@ QVector<float> ObjectInSurfacePosition::normalizedPosition() const
 	return m_normalizedPosition;
 }
 
-void ObjectInSurfacePosition::apply(PMOptixRenderer *renderer) const
+void ObjectInSurfacePosition::apply(PhotonRenderer *renderer) const
 {
 	auto position = this->position() - initialPosition;
 	renderer->setNodeTransformation(nodeName, m_transformation);
@@ -41,4 +42,27 @@ QStringList ObjectInSurfacePosition::info() const
 	auto y = locale.toString(position.y, 'f', 2);
 	auto z = locale.toString(position.z, 'f', 2);
 	return QStringList() << x << y << z;
-}
\ No newline at end of file
+}
+
+void ObjectInSurfacePosition::save(QDataStream &out) const
+{
+	out << nodeName << initialPosition.x << initialPosition.y << initialPosition.z;
+	for(int i = 0; i < 16; ++i){
+		out << m_transformation.getData()[i];
+	}
+	out << m_normalizedPosition;
+}
+
+ObjectInSurfacePosition *ObjectInSurfacePosition::load(QDataStream &in)
+{
+	QString nodeName;
+	optix::float3 initialPosition;
+	float transformation[16];
+	QVector<float> normalizedPosition;
+	in >> nodeName >> initialPosition.x >> initialPosition.y >> initialPosition.z;
+	for(int i = 0; i < 16; ++i){
+		in >> transformation[i];
+	}
+	in >> normalizedPosition;
+	return new ObjectInSurfacePosition(nodeName, initialPosition, optix::Matrix4x4(transformation), normalizedPosition);
+}
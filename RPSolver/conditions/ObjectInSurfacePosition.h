@@ -3,16 +3,18 @@
 #include "ConditionPosition.h"
 #include <optixu_matrix_namespace.h>
 
-class PMOptixRenderer;
+class PhotonRenderer;
 
 class ObjectInSurfacePosition : public ConditionPosition
 {
 public:
 	ObjectInSurfacePosition(const QString& nodeName, optix::float3 initialPosition, const optix::Matrix4x4 &transformation, const QVector<float>& normalizedPosition);
 	virtual QVector<float> normalizedPosition() const;
-	virtual void apply(PMOptixRenderer *) const;
+	virtual void apply(PhotonRenderer *) const;
 	optix::Matrix4x4 transformation() const;
 	virtual QStringList info() const;
+	virtual void save(QDataStream &out) const;
+	static ObjectInSurfacePosition *load(QDataStream &in);
 	optix::float3 position() const;
 private:
 	QString nodeName;
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2014 Ignacio Avas
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "RadiosityEstimate.h"
+#include <algorithm>
+#include <cmath>
+
+// 95% confidence
+static const float z = 1.96f;
+
+RadiosityEstimate::RadiosityEstimate(float surfaceArea):
+	m_surfaceArea(surfaceArea),
+	m_hitCount(0),
+	m_totalPhotons(0),
+	m_radianceSum(0),
+	m_emittedPowerSum(0)
+{
+}
+
+void RadiosityEstimate::addLaunch(unsigned int hitCount, unsigned int photons, float radiance, float emittedPower)
+{
+	m_hitCount += hitCount;
+	m_totalPhotons += photons;
+	m_radianceSum += (double)radiance * photons;
+	m_emittedPowerSum += (double)emittedPower * photons;
+}
+
+unsigned int RadiosityEstimate::hitCount() const
+{
+	return m_hitCount;
+}
+
+unsigned int RadiosityEstimate::totalPhotons() const
+{
+	return m_totalPhotons;
+}
+
+float RadiosityEstimate::probability() const
+{
+	return (float) m_hitCount / m_totalPhotons;
+}
+
+float RadiosityEstimate::radiosity() const
+{
+	return (float)(m_radianceSum / m_totalPhotons) / m_surfaceArea;
+}
+
+float RadiosityEstimate::emittedRadiosity() const
+{
+	return (float)(m_emittedPowerSum / m_totalPhotons) / m_surfaceArea;
+}
+
+float RadiosityEstimate::normalRadius() const
+{
+	float p = probability();
+	return z * emittedRadiosity() * sqrtf(p * (1 - p) / m_totalPhotons);
+}
+
+float RadiosityEstimate::wilsonProbabilityRadius() const
+{
+	float p = probability();
+	float zz = z * z / m_totalPhotons;
+	return z * sqrtf(p * (1 - p) / m_totalPhotons + zz / (4 * m_totalPhotons)) / (1 + zz);
+}
+
+float RadiosityEstimate::wilsonRadius() const
+{
+	return emittedRadiosity() * wilsonProbabilityRadius();
+}
+
+bool RadiosityEstimate::isBelow(const Interval &threshold) const
+{
+	float p = probability();
+	float r = radiosity();
+	float normalTop = r + normalRadius();
+
+	// the Wilson interval is centered away from p, towards 1/2
+	float zz = z * z / m_totalPhotons;
+	float wilsonTop = (p + zz / 2) / (1 + zz) + wilsonProbabilityRadius();
+	float wilsonRadiosityTop = r + emittedRadiosity() * (wilsonTop - p);
+
+	return std::max(normalTop, wilsonRadiosityTop) < threshold.bottom();
+}
+
+bool RadiosityEstimate::isNarrowerThan(float maxWidth) const
+{
+	return 2 * std::max(normalRadius(), wilsonRadius()) < maxWidth;
+}
+
+RadiosityEstimate::StopReason RadiosityEstimate::getStopReason(const Interval &threshold, float maxWidth) const
+{
+	if(isBelow(threshold))
+		return BELOW_THRESHOLD;
+	if(isNarrowerThan(maxWidth))
+		return NARROW_ENOUGH;
+	return CONTINUE;
+}
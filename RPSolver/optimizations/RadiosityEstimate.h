@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2014 Ignacio Avas
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+#pragma once
+
+#include "Interval.h"
+
+/*
+  Radiosity of a surface estimated from the photons traced so far, which can come from several launches,
+  with its 95% confidence intervals. evaluateSequential stops tracing photons when the radiosity is
+  certainly below the ISOC or when the interval is as narrow as requested.
+*/
+class RadiosityEstimate
+{
+public:
+	enum StopReason {
+		CONTINUE,
+		BELOW_THRESHOLD,
+		NARROW_ENOUGH
+	};
+
+	RadiosityEstimate(float surfaceArea);
+	// radiance and emitted power as given by the renderer for a launch of photons photons
+	void addLaunch(unsigned int hitCount, unsigned int photons, float radiance, float emittedPower);
+
+	unsigned int hitCount() const;
+	unsigned int totalPhotons() const;
+	float radiosity() const;
+	// half width of the normal interval around radiosity
+	float normalRadius() const;
+	// half width of the Wilson score interval of the hit probability, in radiosity. Unlike the normal
+	// one it doesn't collapse to zero when there are few hits.
+	float wilsonRadius() const;
+	// the tops of both intervals are below threshold
+	bool isBelow(const Interval &threshold) const;
+	// the wider of both intervals is narrower than maxWidth. A maxWidth of 0 never is.
+	bool isNarrowerThan(float maxWidth) const;
+	// below threshold takes precedence, as SurfaceRadiosityEvaluation::isStoppedEarly tells it
+	StopReason getStopReason(const Interval &threshold, float maxWidth) const;
+private:
+	float probability() const;
+	float wilsonProbabilityRadius() const;
+	float emittedRadiosity() const;
+
+	float m_surfaceArea;
+	unsigned int m_hitCount;
+	unsigned int m_totalPhotons;
+	// the renderer scales the photon power to the photons of a launch, so the radiance and the
+	// emitted power of the launches are averaged weighted by their photons
+	double m_radianceSum;
+	double m_emittedPowerSum;
+};
@@ -14,10 +14,12 @@
 const unsigned int SurfaceRadiosity::sampleImageHeight = 768;
 const unsigned int SurfaceRadiosity::sampleImageWidth = 1024;
 const unsigned int SurfaceRadiosity::minPhotonWidth = 16;
+// evaluateSequential traces up to sequentialChunksPerWidth^2 launches of a width that many times smaller
+const unsigned int SurfaceRadiosity::sequentialChunksPerWidth = 4;
 const float SurfaceRadiosity::gammaCorrection = 2.8f;
 
 SurfaceRadiosity::SurfaceRadiosity(Logger *logger, PMOptixRenderer *renderer,
-		Scene *scene, const QString &surfaceId, float maxRadiosity):
+		Scene *scene, const QString &surfaceId, float maxRadiosity, float maxIntervalWidth):
 	m_renderer(renderer),
 	scene(scene),
 	logger(logger),
@@ -25,7 +27,8 @@ SurfaceRadiosity::SurfaceRadiosity(Logger *logger, PMOptixRenderer *renderer,
 	maxPhotonWidth(renderer->getMaxPhotonWidth()),
 	surfaceId(surfaceId),
 	objectId(scene->getObjectId(surfaceId)),
-	maxRadiosity(maxRadiosity)
+	maxRadiosity(maxRadiosity),
+	maxIntervalWidth(maxIntervalWidth)
 {
 	if(objectId < 0)
 		throw std::invalid_argument(("There isn't any object named " + surfaceId + " in the scene").toStdString());
@@ -33,24 +36,30 @@ SurfaceRadiosity::SurfaceRadiosity(Logger *logger, PMOptixRenderer *renderer,
 }
 
 
-SurfaceRadiosityEvaluation *SurfaceRadiosity::genEvaluation(int nPhotons)
+SurfaceRadiosityEvaluation *SurfaceRadiosity::genEvaluation(PhotonRenderer *renderer, int nPhotons) const
 {
-	const static float z = 1.96f;
+	RadiosityEstimate estimate(surfaceArea);
+	estimate.addLaunch(
+		renderer->getHitCount().at(objectId),
+		renderer->totalPhotons(),
+		renderer->getRadiance().at(objectId),
+		renderer->getEmittedPower()
+	);
+	return createEvaluation(estimate, nPhotons);
+}
 
-	// n is the hit count at the surface
-	unsigned int n  = m_renderer->getHitCount().at(objectId);
-	// p is the probability estimate n / (total hits on surfaces)
-	float p = (float) n / m_renderer->totalPhotons();
+SurfaceRadiosityEvaluation *SurfaceRadiosity::createEvaluation(const RadiosityEstimate &estimate, int nPhotons,
+	bool stoppedEarly) const
+{
 	// r is the surface radiosity estimate
-	float r = m_renderer->getRadiance().at(objectId) / (surfaceArea);
-	float R = m_renderer->getEmittedPower() / (surfaceArea);
+	float r = estimate.radiosity();
 
 	// radius is the confidence radius given by equations 
-	float radius = z * R * sqrtf( p*(1-p) /   m_renderer->totalPhotons()  );
+	float radius = estimate.normalRadius();
 
 	bool valid = r - radius <= maxRadiosity;
 
-	return new SurfaceRadiosityEvaluation(r, radius, nPhotons, nPhotons >= maxPhotonWidth * maxPhotonWidth, valid);
+	return new SurfaceRadiosityEvaluation(r, radius, nPhotons, nPhotons >= maxPhotonWidth * maxPhotonWidth, valid, stoppedEarly);
 }
 
 
@@ -68,12 +77,18 @@ SurfaceRadiosity::~SurfaceRadiosity()
 SurfaceRadiosityEvaluation *SurfaceRadiosity::evaluateRadiosity()
 {
 	m_renderer->render(maxPhotonWidth, sampleImageHeight, sampleImageWidth, *sampleCamera, true, true);
-	return genEvaluation(maxPhotonWidth * maxPhotonWidth);
+	return genEvaluation(m_renderer, maxPhotonWidth * maxPhotonWidth);
 }
 
 SurfaceRadiosityEvaluation *SurfaceRadiosity::evaluateFast(float quality)
 {
-	int photonWidth = std::max(
+	return evaluateFast(m_renderer, quality);
+}
+
+unsigned int SurfaceRadiosity::getPhotonWidth(float quality) const
+{
+	// the photons are counted without a photon buffer, so every renderer traces the width of the main one
+	return std::max(
 				std::min(
 					// is good that the photon width is a multiple of 16
 					(unsigned int)(maxPhotonWidth * sqrtf(quality)) & ~0xF, 
@@ -81,9 +96,46 @@ SurfaceRadiosityEvaluation *SurfaceRadiosity::evaluateFast(float quality)
 				),
 				minPhotonWidth
 			);
+}
 
-	m_renderer->buildPhotonBuffer(photonWidth);
-	return genEvaluation(photonWidth * photonWidth);
+SurfaceRadiosityEvaluation *SurfaceRadiosity::evaluateFast(PhotonRenderer *renderer, float quality) const
+{
+	unsigned int photonWidth = getPhotonWidth(quality);
+	renderer->tracePhotonStatistics(photonWidth);
+	return genEvaluation(renderer, photonWidth * photonWidth);
+}
+
+SurfaceRadiosityEvaluation *SurfaceRadiosity::evaluateSequential(PhotonRenderer *renderer, float quality,
+	const Interval &threshold, RadiosityEstimate::StopReason *stopReason) const
+{
+	unsigned int photonWidth = getPhotonWidth(quality);
+	// the number of chunks comes first and the width follows from it, so a chunk can't be rounded into
+	// more chunks than that. Chunks are at least minPhotonWidth wide, narrow widths take fewer of them.
+	unsigned int chunksPerWidth = std::max(1u, std::min(sequentialChunksPerWidth, photonWidth / minPhotonWidth));
+	unsigned int numChunks = chunksPerWidth * chunksPerWidth;
+	unsigned int chunkWidth = photonWidth / chunksPerWidth;
+
+	RadiosityEstimate estimate(surfaceArea);
+	RadiosityEstimate::StopReason reason = RadiosityEstimate::CONTINUE;
+	for(unsigned int chunk = 0; chunk < numChunks && reason == RadiosityEstimate::CONTINUE; ++chunk){
+		renderer->tracePhotonStatistics(chunkWidth);
+		estimate.addLaunch(
+			renderer->getHitCount().at(objectId),
+			renderer->totalPhotons(),
+			renderer->getRadiance().at(objectId),
+			renderer->getEmittedPower()
+		);
+		if(chunk + 1 < numChunks){
+			reason = estimate.getStopReason(threshold, maxIntervalWidth);
+		}
+	}
+
+	if(stopReason){
+		*stopReason = reason;
+	}
+	// an interval as narrow as requested is as good as that of all the photons, only one which stopped
+	// below the threshold can't be used for anything else
+	return createEvaluation(estimate, estimate.totalPhotons(), reason == RadiosityEstimate::BELOW_THRESHOLD);
 }
 
 
@@ -2,9 +2,12 @@
 
 #include <vector_types.h>
 #include <QStringList>
+#include "Interval.h"
+#include "RadiosityEstimate.h"
 
 class Logger;
 class PMOptixRenderer;
+class PhotonRenderer;
 class Scene;
 class Camera;
 class QImage;
@@ -15,14 +18,26 @@ class SurfaceRadiosityEvaluation;
 class SurfaceRadiosity
 {
 public:
-	SurfaceRadiosity(Logger *logger, PMOptixRenderer *renderer, Scene *scene, const QString &surfaceId, float maxRadiosity);
+	// maxIntervalWidth is the width of the radiosity interval at which evaluateSequential stops, 0 to
+	// always trace the photons of the quality
+	SurfaceRadiosity(Logger *logger, PMOptixRenderer *renderer, Scene *scene, const QString &surfaceId, float maxRadiosity,
+		float maxIntervalWidth = 0);
 	SurfaceRadiosityEvaluation *evaluateRadiosity();
 	SurfaceRadiosityEvaluation *evaluateFast(float quality);
+	// Evaluates on another renderer with the same scene, which can run concurrently with the others
+	SurfaceRadiosityEvaluation *evaluateFast(PhotonRenderer *renderer, float quality) const;
+	// Like evaluateFast, but traces the photons in chunks and stops as soon as the radiosity is
+	// certainly below threshold, which is the case of most candidates, or its interval is narrower
+	// than maxIntervalWidth. stopReason, if given, tells which one stopped it.
+	SurfaceRadiosityEvaluation *evaluateSequential(PhotonRenderer *renderer, float quality, const Interval &threshold,
+		RadiosityEstimate::StopReason *stopReason = NULL) const;
 	void saveImage(const QString &fileName);	
 	virtual QStringList header();
 	virtual ~SurfaceRadiosity();
 private:
-	virtual SurfaceRadiosityEvaluation *genEvaluation(int nPhotons);
+	virtual SurfaceRadiosityEvaluation *genEvaluation(PhotonRenderer *renderer, int nPhotons) const;
+	SurfaceRadiosityEvaluation *createEvaluation(const RadiosityEstimate &estimate, int nPhotons, bool stoppedEarly = false) const;
+	unsigned int getPhotonWidth(float quality) const;
 	void saveImageAsync(const QString& fileName, QImage* image);
 private:
 	QString surfaceId;
@@ -31,10 +46,12 @@ private:
 	static const unsigned int sampleImageWidth;
 	static const unsigned int sampleImageHeight;
 	static const unsigned int minPhotonWidth;
+	static const unsigned int sequentialChunksPerWidth;
 	unsigned int maxPhotonWidth;
 	static const float gammaCorrection;
 
 	float maxRadiosity;
+	float maxIntervalWidth;
 	PMOptixRenderer *m_renderer;
 	Scene *scene;
 	Logger *logger;
@@ -2,13 +2,14 @@
 #include <QLocale>
 
 SurfaceRadiosityEvaluation::SurfaceRadiosityEvaluation(float val, float radius,
-		int photons, bool isMaxQuality, bool isValid):
+		int photons, bool isMaxQuality, bool isValid, bool isStoppedEarly):
  m_val(val),
  m_radius(radius),
  m_photons(photons),
  m_interval(val, radius),
  m_isMaxQuality(isMaxQuality),
- m_isValid(isValid)
+ m_isValid(isValid),
+ m_isStoppedEarly(isStoppedEarly)
 {
 }
 
@@ -42,6 +43,11 @@ bool SurfaceRadiosityEvaluation::isMaxQuality() const
 	return m_isMaxQuality;
 }
 
+bool SurfaceRadiosityEvaluation::isStoppedEarly() const
+{
+	return m_isStoppedEarly;
+}
+
 
 QString SurfaceRadiosityEvaluation:: info() const
 {
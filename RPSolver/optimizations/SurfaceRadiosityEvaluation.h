@@ -13,8 +13,9 @@ private:
 	Interval m_interval;
 	bool m_isMaxQuality;
 	bool m_isValid;
+	bool m_isStoppedEarly;
 public:
-	SurfaceRadiosityEvaluation(float val, float radius, int photons, bool isMaxQuality, bool isValid);
+	SurfaceRadiosityEvaluation(float val, float radius, int photons, bool isMaxQuality, bool isValid, bool isStoppedEarly = false);
 
 	bool valid() const;
 	float val() const;
@@ -22,6 +23,9 @@ public:
 	int photons() const;
 	Interval interval () const;
 	bool isMaxQuality() const;
+	// traced less than its photon budget because it was below a threshold, the interval is only
+	// good for telling it is below that threshold
+	bool isStoppedEarly() const;
 	virtual QString info() const;
 	virtual QString infoShort() const;
 };
\ No newline at end of file
@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "RenderIterationScheduler.h"
+#include "RenderResultPacket.h"
+#include <stdexcept>
+#include <algorithm>
+
+// Requests a server may have at once, so that it has the next one queued while sending the last
+static const int MAX_REQUESTS_PER_SERVER = 2;
+static const int MAX_BATCH_SIZE = 64;
+// Weight of the newest packet in the measured times of a server
+static const double MEASUREMENT_WEIGHT = 0.3;
+// Expected time of a request to a server we have no packets from yet
+static const double UNMEASURED_EXPECTED_SECONDS = 5.0;
+// A request is taken over by an idle server when it has taken this many times longer than expected
+static const double STEAL_FACTOR = 2.0;
+
+RenderIterationScheduler::RenderIterationScheduler( int maxRequestsInFlight, double targetPacketSeconds ) :
+    m_maxRequestsInFlight(maxRequestsInFlight),
+    m_targetPacketSeconds(targetPacketSeconds),
+    m_sequenceNumber(0),
+    m_nextIterationNumber(0),
+    m_numStolenRequests(0)
+{
+    m_timer.start();
+}
+
+void RenderIterationScheduler::addServer( int serverId )
+{
+    if(!m_servers.contains(serverId))
+    {
+        m_servers.insert(serverId, ServerState());
+    }
+}
+
+void RenderIterationScheduler::removeServer( int serverId )
+{
+    QMap<unsigned long long, Request>::iterator request = m_requests.begin();
+    while(request != m_requests.end())
+    {
+        request->serverIds.removeAll(serverId);
+        if(request->serverIds.isEmpty())
+        {
+            QVector<unsigned long long> iterationNumbers;
+            for(int i = 0; i < request->iterationNumbers.size(); ++i)
+            {
+                if(!request->receivedIterations.testBit(i))
+                {
+                    iterationNumbers.append(request->iterationNumbers[i]);
+                }
+            }
+            m_returnedIterations.append(iterationNumbers);
+            request = m_requests.erase(request);
+        }
+        else
+        {
+            ++request;
+        }
+    }
+    m_servers.remove(serverId);
+}
+
+void RenderIterationScheduler::reset( unsigned long long sequenceNumber )
+{
+    m_sequenceNumber = sequenceNumber;
+    m_nextIterationNumber = 0;
+    m_requests.clear();
+    m_returnedIterations.clear();
+    for(QMap<int, ServerState>::iterator server = m_servers.begin(); server != m_servers.end(); ++server)
+    {
+        server->requestsInFlight = 0;
+    }
+}
+
+QVector<unsigned long long> RenderIterationScheduler::getNextIterations( int serverId )
+{
+    if(!m_servers.contains(serverId))
+    {
+        throw std::invalid_argument("RenderIterationScheduler::getNextIterations: unknown server.");
+    }
+    if(m_servers[serverId].requestsInFlight >= MAX_REQUESTS_PER_SERVER)
+    {
+        return QVector<unsigned long long>();
+    }
+
+    Request request;
+    if(!m_returnedIterations.isEmpty())
+    {
+        request.iterationNumbers = m_returnedIterations.first();
+        m_returnedIterations.remove(0);
+    }
+    else if(m_requests.size() < m_maxRequestsInFlight)
+    {
+        int batchSize = getBatchSize(serverId);
+        request.iterationNumbers.reserve(batchSize);
+        for(int i = 0; i < batchSize; ++i)
+        {
+            request.iterationNumbers.append(m_nextIterationNumber++);
+        }
+    }
+    else if(m_servers[serverId].requestsInFlight == 0)
+    {
+        return stealRequest(serverId);
+    }
+    else
+    {
+        return QVector<unsigned long long>();
+    }
+
+    sendRequest(serverId, request);
+    return request.iterationNumbers;
+}
+
+// Marks the iterations of the packet as received in the request. Fails without marking any if one of them is not
+// an iteration of the request or was received before.
+static bool receiveIterations( const QVector<unsigned long long> & requestIterations, QBitArray & receivedIterations,
+    const QVector<unsigned long long> & packetIterations )
+{
+    QBitArray received = receivedIterations;
+    for(int i = 0; i < packetIterations.size(); ++i)
+    {
+        const unsigned long long* iteration = std::lower_bound(requestIterations.constBegin(), requestIterations.constEnd(), packetIterations[i]);
+        if(iteration == requestIterations.constEnd() || *iteration != packetIterations[i])
+        {
+            return false;
+        }
+        int index = (int)(iteration - requestIterations.constBegin());
+        if(received.testBit(index))
+        {
+            return false;
+        }
+        received.setBit(index);
+    }
+    receivedIterations = received;
+    return true;
+}
+
+bool RenderIterationScheduler::onPacketReceived( int serverId, const RenderResultPacket & packet )
+{
+    if(packet.getSequenceNumber() != m_sequenceNumber || packet.getNumIterationsInPacket() == 0)
+    {
+        return false;
+    }
+
+    // The request of the packet is the last one that starts at or before its smallest iteration
+    const QVector<unsigned long long> & packetIterations = packet.getIterationNumbersInPacket();
+    unsigned long long firstIteration = *std::min_element(packetIterations.constBegin(), packetIterations.constEnd());
+    QMap<unsigned long long, Request>::iterator request = m_requests.upperBound(firstIteration);
+    if(request == m_requests.begin())
+    {
+        return false;
+    }
+    --request;
+    if(!request->serverIds.contains(serverId)
+        || !receiveIterations(request->iterationNumbers, request->receivedIterations, packetIterations))
+    {
+        return false;
+    }
+    request->numReceivedIterations += packetIterations.size();
+
+    if(m_servers.contains(serverId))
+    {
+        ServerState & server = m_servers[serverId];
+        double secondsPerIteration = packet.getRenderTimeSeconds()/packet.getNumIterationsInPacket();
+        double overheadSeconds = qMax(0.0, (double)packet.getTotalTimeSeconds() - packet.getRenderTimeSeconds());
+        if(server.hasMeasurements)
+        {
+            server.secondsPerIteration += MEASUREMENT_WEIGHT*(secondsPerIteration - server.secondsPerIteration);
+            server.overheadSeconds += MEASUREMENT_WEIGHT*(overheadSeconds - server.overheadSeconds);
+        }
+        else
+        {
+            server.secondsPerIteration = secondsPerIteration;
+            server.overheadSeconds = overheadSeconds;
+            server.hasMeasurements = true;
+        }
+    }
+
+    if(request->numReceivedIterations < request->iterationNumbers.size())
+    {
+        return true;
+    }
+
+    // The answers of servers that took over the request, or that it was taken from, are dropped when they come
+    for(int i = 0; i < request->serverIds.size(); ++i)
+    {
+        if(m_servers.contains(request->serverIds[i]))
+        {
+            m_servers[request->serverIds[i]].requestsInFlight--;
+        }
+    }
+    m_requests.erase(request);
+    return true;
+}
+
+int RenderIterationScheduler::getBatchSize( int serverId ) const
+{
+    const ServerState server = m_servers.value(serverId);
+    if(!server.hasMeasurements || server.secondsPerIteration <= 0)
+    {
+        return 1;
+    }
+    double iterations = (m_targetPacketSeconds - server.overheadSeconds)/server.secondsPerIteration;
+    return (int)qBound(1.0, iterations, (double)MAX_BATCH_SIZE);
+}
+
+int RenderIterationScheduler::getNumRequestsInFlight() const
+{
+    return m_requests.size();
+}
+
+unsigned long long RenderIterationScheduler::getNumStolenRequests() const
+{
+    return m_numStolenRequests;
+}
+
+void RenderIterationScheduler::setClock( const std::function<double ()> & clock )
+{
+    m_clock = clock;
+}
+
+double RenderIterationScheduler::getSeconds() const
+{
+    return m_clock ? m_clock() : m_timer.elapsed()/1000.0;
+}
+
+double RenderIterationScheduler::getExpectedSeconds( const ServerState & server, int numIterations ) const
+{
+    if(!server.hasMeasurements)
+    {
+        return UNMEASURED_EXPECTED_SECONDS;
+    }
+    return server.overheadSeconds + numIterations*server.secondsPerIteration;
+}
+
+// Takes over the request that is furthest past its expected time, if any is past it by STEAL_FACTOR
+QVector<unsigned long long> RenderIterationScheduler::stealRequest( int serverId )
+{
+    double now = getSeconds();
+    Request* slowest = NULL;
+    double slowestOverdue = STEAL_FACTOR;
+    for(QMap<unsigned long long, Request>::iterator request = m_requests.begin(); request != m_requests.end(); ++request)
+    {
+        // Each request is taken over once at most, and not once part of it was received
+        if(request->serverIds.size() > 1 || request->numReceivedIterations > 0)
+        {
+            continue;
+        }
+        double overdue = (now - request->sentTime)/qMax(request->expectedSeconds, 1e-3);
+        if(overdue > slowestOverdue)
+        {
+            slowest = &request.value();
+            slowestOverdue = overdue;
+        }
+    }
+    if(slowest == NULL)
+    {
+        return QVector<unsigned long long>();
+    }
+
+    slowest->serverIds.append(serverId);
+    m_servers[serverId].requestsInFlight++;
+    m_numStolenRequests++;
+    return slowest->iterationNumbers;
+}
+
+void RenderIterationScheduler::sendRequest( int serverId, Request & request )
+{
+    ServerState & server = m_servers[serverId];
+    request.serverIds.append(serverId);
+    request.receivedIterations = QBitArray(request.iterationNumbers.size());
+    request.numReceivedIterations = 0;
+    request.sentTime = getSeconds();
+    request.expectedSeconds = getExpectedSeconds(server, request.iterationNumbers.size());
+    server.requestsInFlight++;
+    m_requests.insert(request.iterationNumbers.first(), request);
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include "render_engine_export_api.h"
+#include <QElapsedTimer>
+#include <QMap>
+#include <QVector>
+#include <QBitArray>
+#include <functional>
+
+class RenderResultPacket;
+
+/*
+Decides which iterations the client asks each server to render. Every server gets batches sized so that a packet
+takes about the target time to render, measured from the render and total times of the packets it sent. When no new
+work should be handed out, an idle server takes over the oldest request of a server that is well past its expected
+time. Whichever of the two answers comes first is used and the other is dropped. The number of requests in flight is
+bounded, since every answer is a full output buffer on the client.
+
+Iteration numbers are counted from zero for every sequence number, see reset. A packet is accepted when all of its
+iterations belong to one request and none of them was received before. A request is done once all its iterations
+were received, so a server may answer it in several packets, see RenderResultPacketCoalescer. Requests with part of
+their iterations received are not taken over, since the whole answer of the other server would overlap them.
+*/
+
+class RenderIterationScheduler
+{
+public:
+    RENDER_ENGINE_EXPORT_API RenderIterationScheduler(int maxRequestsInFlight = 8, double targetPacketSeconds = 0.25);
+
+    RENDER_ENGINE_EXPORT_API void addServer(int serverId);
+    // Forgets the server and hands its outstanding iterations to the others
+    RENDER_ENGINE_EXPORT_API void removeServer(int serverId);
+    // Starts over at iteration 0 when the client changes sequence number, outstanding requests are forgotten
+    RENDER_ENGINE_EXPORT_API void reset(unsigned long long sequenceNumber);
+
+    // Iteration numbers of the next request for the server, empty when it should not get more work for now
+    RENDER_ENGINE_EXPORT_API QVector<unsigned long long> getNextIterations(int serverId);
+    // Returns false if the packet is from an old sequence, is not within one request or has iterations that were
+    // already received
+    RENDER_ENGINE_EXPORT_API bool onPacketReceived(int serverId, const RenderResultPacket & packet);
+
+    RENDER_ENGINE_EXPORT_API int getBatchSize(int serverId) const;
+    RENDER_ENGINE_EXPORT_API int getNumRequestsInFlight() const;
+    RENDER_ENGINE_EXPORT_API unsigned long long getNumStolenRequests() const;
+    // Seconds from any fixed point, the time since the scheduler was created by default. Simulations set their own.
+    RENDER_ENGINE_EXPORT_API void setClock(const std::function<double ()> & clock);
+
+private:
+    struct ServerState
+    {
+        ServerState() : secondsPerIteration(0), overheadSeconds(0), requestsInFlight(0), hasMeasurements(false) {}
+        double secondsPerIteration;
+        double overheadSeconds;
+        int requestsInFlight;
+        bool hasMeasurements;
+    };
+
+    struct Request
+    {
+        QVector<unsigned long long> iterationNumbers;
+        QVector<int> serverIds;
+        QBitArray receivedIterations;
+        int numReceivedIterations;
+        double sentTime;
+        double expectedSeconds;
+    };
+
+    double getSeconds() const;
+    double getExpectedSeconds(const ServerState & server, int numIterations) const;
+    QVector<unsigned long long> stealRequest(int serverId);
+    void sendRequest(int serverId, Request & request);
+
+    int m_maxRequestsInFlight;
+    double m_targetPacketSeconds;
+    unsigned long long m_sequenceNumber;
+    unsigned long long m_nextIterationNumber;
+    unsigned long long m_numStolenRequests;
+    QMap<int, ServerState> m_servers;
+    // Outstanding requests by their first iteration number
+    QMap<unsigned long long, Request> m_requests;
+    // Iterations of removed servers, handed out before new ones
+    QVector<QVector<unsigned long long> > m_returnedIterations;
+    QElapsedTimer m_timer;
+    std::function<double ()> m_clock;
+};
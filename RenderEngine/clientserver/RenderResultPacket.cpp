@@ -5,10 +5,15 @@
 */
 
 #include "RenderResultPacket.h"
-#include <QDataStream>
 #include <QVector>
+#include "util/ParallelFor.h"
+#include <exception>
+#include <emmintrin.h>
 
-RenderResultPacket::RenderResultPacket()
+RenderResultPacket::RenderResultPacket() :
+    m_sequenceNumber(0),
+    m_renderTimeSeconds(0),
+    m_totalTimeSeconds(0)
 {
 
 }
@@ -60,6 +65,17 @@ const QByteArray & RenderResultPacket::getOutput() const
     return m_output;
 }
 
+// Encoding of the output when the packet is sent
+const RenderResultPacketEncoding & RenderResultPacket::getEncoding() const
+{
+    return m_encoding;
+}
+
+void RenderResultPacket::setEncoding( const RenderResultPacketEncoding & encoding )
+{
+    m_encoding = encoding;
+}
+
 // Return a list of iteration numbers in packet which is sorted
 const QVector<unsigned long long> & RenderResultPacket::getIterationNumbersInPacket() const
 {
@@ -86,65 +102,107 @@ unsigned long long RenderResultPacket::getLastIterationNumber() const
     return m_iterationNumbersInPacket.last();
 }
 
-// Merge other into this render result packet
+// Minimum number of floats merged per thread, smaller outputs are merged on the calling thread only
+static const int MERGE_CHUNK_SIZE = 1 << 18;
 
-void RenderResultPacket::merge( const RenderResultPacket & other )
+// output = (outputWeight*output + sum of inputWeights[i]*inputs[i]) * scale over the floats [from, to), four
+// at a time with SSE. With one input it does the same operations in the same order as the old scalar merge.
+static void mergeFloats(float* output, float outputWeight, const QVector<const float*> & inputs, const QVector<float> & inputWeights,
+    float scale, int from, int to)
 {
-    int thisIterations = this->getIterationNumbersInPacket().size();
-    int otherIterations = other.getIterationNumbersInPacket().size();
-    int numPixels = this->getOutput().size()/sizeof(float);
-    const float* inputData = (const float*)other.getOutput().constData();
-    float* outputData = (float*)this->getOutput().data();
-    float scale = 1.f/(thisIterations+otherIterations);
-    for(unsigned int i = 0; i < numPixels; i += 3)
+    const __m128 outputWeight4 = _mm_set1_ps(outputWeight);
+    const __m128 scale4 = _mm_set1_ps(scale);
+    int i = from;
+    for(; i + 4 <= to; i += 4)
+    {
+        __m128 sum = _mm_mul_ps(outputWeight4, _mm_loadu_ps(output + i));
+        for(int input = 0; input < inputs.size(); ++input)
+        {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(inputWeights[input]), _mm_loadu_ps(inputs[input] + i)));
+        }
+        _mm_storeu_ps(output + i, _mm_mul_ps(sum, scale4));
+    }
+    for(; i < to; ++i)
     {
-        outputData[i]   = (thisIterations*outputData[i]   + otherIterations*inputData[i]  ) * scale;
-        outputData[i+1] = (thisIterations*outputData[i+1] + otherIterations*inputData[i+1]) * scale;
-        outputData[i+2] = (thisIterations*outputData[i+2] + otherIterations*inputData[i+2]) * scale;
+        float sum = outputWeight*output[i];
+        for(int input = 0; input < inputs.size(); ++input)
+        {
+            sum += inputWeights[input]*inputs[input][i];
+        }
+        output[i] = sum * scale;
     }
-    m_iterationNumbersInPacket += other.getIterationNumbersInPacket();
 }
 
-QDataStream & operator<<( QDataStream & out, const RenderResultPacket & results )
+// Merge other into this render result packet
+
+void RenderResultPacket::merge( const RenderResultPacket & other )
 {
-    QByteArray output = results.getOutput();
-    QVector<unsigned long long> iterationNumbersInPacket = results.getIterationNumbersInPacket();
-    qSort(iterationNumbersInPacket);
+    QVector<RenderResultPacket> others;
+    others.append(other);
+    mergeMany(others);
+}
 
-    // Send size of packet as the first 64 bits so that receiver knows how much data to expect
-    // The size of the different values are listed in http://qt-project.org/doc/qt-4.8/datastreamformat.html
+// A packet without iterations or output, like a default constructed one, is the identity of merging
+static bool isEmptyPacket(const RenderResultPacket & packet)
+{
+    return packet.getNumIterationsInPacket() == 0 && packet.getOutput().isEmpty();
+}
 
-    quint64 sizeOutputBuffer = (quint64)(output.size() + sizeof(quint32));
-    quint64 sizeIterationNumbersInPacketVector = (quint64)(iterationNumbersInPacket.size()*sizeof(unsigned long long) + sizeof(quint32));
+// Merge all the others into this packet at once, weighting each packet by its number of iterations. Empty packets
+// are skipped and an empty packet becomes the first non-empty one of others, only two non-empty packets of
+// different sizes can not be merged.
 
-    quint64 size = sizeOutputBuffer + sizeIterationNumbersInPacketVector;
-    size += (quint64)sizeof(quint64) + 2*(quint64)sizeof(float);
+void RenderResultPacket::mergeMany( const QVector<RenderResultPacket> & others )
+{
+    int first = 0;
+    if(isEmptyPacket(*this))
+    {
+        while(first < others.size() && isEmptyPacket(others[first]))
+        {
+            ++first;
+        }
+        if(first == others.size())
+        {
+            return;
+        }
+        *this = others[first];
+        ++first;
+    }
 
-    out << size 
-        << (quint64)results.getSequenceNumber()
-        << iterationNumbersInPacket
-        << results.getRenderTimeSeconds() 
-        << results.getTotalTimeSeconds()
-        << output;
-    return out;
-}
+    int totalIterations = this->getNumIterationsInPacket();
+    QVector<const float*> inputs;
+    QVector<float> inputWeights;
+    for(int i = first; i < others.size(); ++i)
+    {
+        if(isEmptyPacket(others[i]))
+        {
+            continue;
+        }
+        if(others[i].getOutput().size() != m_output.size())
+        {
+            throw std::exception("RenderResultPacket::mergeMany: packets have different output sizes");
+        }
+        inputs.append((const float*)others[i].getOutput().constData());
+        inputWeights.append((float)others[i].getNumIterationsInPacket());
+        totalIterations += others[i].getNumIterationsInPacket();
+    }
+    if(inputs.isEmpty())
+    {
+        return;
+    }
 
-QDataStream & operator>>( QDataStream & in, RenderResultPacket & results )
-{
-    unsigned long long sequenceNumber;
-    QVector<unsigned long long> iterationNumbersInPacket;
-    QByteArray output;
-    float renderTimeSeconds;
-    float totalTimeSeconds;
+    float outputWeight = (float)this->getNumIterationsInPacket();
+    float scale = 1.f/totalIterations;
+    int numFloats = m_output.size()/sizeof(float);
+    // data() detaches the output from other packets sharing it
+    float* outputData = (float*)m_output.data();
+    parallelForChunks(0, numFloats, getHardwareThreadCount(), MERGE_CHUNK_SIZE, [&](int chunk, int from, int to)
+    {
+        mergeFloats(outputData, outputWeight, inputs, inputWeights, scale, from, to);
+    });
 
-    in >> (quint64)sequenceNumber;
-    in >> iterationNumbersInPacket;
-    in >> renderTimeSeconds;
-    in >> totalTimeSeconds;
-    in >> output;
-    
-    results = RenderResultPacket(sequenceNumber, iterationNumbersInPacket, output);
-    results.setRenderTimeSeconds(renderTimeSeconds);
-    results.setTotalTimeSeconds(totalTimeSeconds);
-    return in;
+    for(int i = first; i < others.size(); ++i)
+    {
+        m_iterationNumbersInPacket += others[i].getIterationNumbersInPacket();
+    }
 }
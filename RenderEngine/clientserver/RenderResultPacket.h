@@ -8,11 +8,13 @@
 #include "render_engine_export_api.h"
 #include <QByteArray>
 #include <QVector>
+#include "RenderResultPacketEncoding.h"
 
 /*
 A RenderResultPacket is what we send from server to client with the rendered image.
 A packet can consist of several iterations of the algorithm combined in a single image/frame to save space.
 There is a vector of iteration numbers in each packet which says what this packet contains.
+Packets are sent and received through the RenderResultPacketCodec of their connection.
 */
 
 class RenderResultPacket
@@ -33,17 +35,20 @@ public:
     RENDER_ENGINE_EXPORT_API unsigned long long getFirstIterationNumber() const;
     RENDER_ENGINE_EXPORT_API unsigned long long getLastIterationNumber() const;
     RENDER_ENGINE_EXPORT_API const QByteArray & getOutput() const;
+    RENDER_ENGINE_EXPORT_API const RenderResultPacketEncoding & getEncoding() const;
+    RENDER_ENGINE_EXPORT_API void setEncoding(const RenderResultPacketEncoding & encoding);
     RENDER_ENGINE_EXPORT_API void merge(const RenderResultPacket & other);
+    RENDER_ENGINE_EXPORT_API void mergeMany(const QVector<RenderResultPacket> & others);
     RENDER_ENGINE_EXPORT_API bool operator < (const RenderResultPacket & other) const;
 
 private:
+    // Reads received packets into the fields of an existing packet to reuse its buffers
+    friend class RenderResultPacketCodec;
+
     unsigned long long m_sequenceNumber;
     QVector<unsigned long long> m_iterationNumbersInPacket;
     QByteArray m_output;
     float m_renderTimeSeconds;
     float m_totalTimeSeconds;
+    RenderResultPacketEncoding m_encoding;
 };
-
-class QDataStream;
-RENDER_ENGINE_EXPORT_API QDataStream & operator << (QDataStream & out, const RenderResultPacket & renderRequest);
-RENDER_ENGINE_EXPORT_API QDataStream & operator >> (QDataStream & in, RenderResultPacket & renderFrameCommand);
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "RenderResultPacketCoalescer.h"
+
+RenderResultPacketCoalescer::RenderResultPacketCoalescer( const RenderResultPacketCoalescingPolicy & policy ) :
+    m_policy(policy),
+    m_hasPending(false),
+    m_pendingRequestId(0),
+    m_numFlushedIterations(0),
+    m_numFlushedPackets(0)
+{
+
+}
+
+void RenderResultPacketCoalescer::add( const RenderResultPacket & packet, unsigned long long requestId )
+{
+    if(m_hasPending && m_pending.getSequenceNumber() == packet.getSequenceNumber() && m_pendingRequestId == requestId
+        && m_pending.getOutput().size() == packet.getOutput().size())
+    {
+        float renderTimeSeconds = m_pending.getRenderTimeSeconds() + packet.getRenderTimeSeconds();
+        float totalTimeSeconds = m_pending.getTotalTimeSeconds() + packet.getTotalTimeSeconds();
+        m_pending.merge(packet);
+        m_pending.setRenderTimeSeconds(renderTimeSeconds);
+        m_pending.setTotalTimeSeconds(totalTimeSeconds);
+        return;
+    }
+
+    if(m_hasPending && m_pending.getSequenceNumber() == packet.getSequenceNumber())
+    {
+        m_finished.append(m_pending);
+    }
+    else
+    {
+        m_finished.clear();
+    }
+    m_pending = packet;
+    m_pendingRequestId = requestId;
+    m_hasPending = true;
+    m_pendingTimer.start();
+}
+
+bool RenderResultPacketCoalescer::hasPending() const
+{
+    return m_hasPending || !m_finished.isEmpty();
+}
+
+bool RenderResultPacketCoalescer::shouldFlush() const
+{
+    if(!m_finished.isEmpty())
+    {
+        return true;
+    }
+    if(!m_hasPending)
+    {
+        return false;
+    }
+    int numIterations = m_pending.getNumIterationsInPacket();
+    return numIterations >= m_policy.maxIterations
+        || (qint64)numIterations*m_pending.getOutput().size() >= m_policy.maxOutputBytes
+        || m_pendingTimer.elapsed() >= m_policy.maxDelaySeconds*1000;
+}
+
+RenderResultPacket RenderResultPacketCoalescer::flush()
+{
+    if(!m_finished.isEmpty())
+    {
+        RenderResultPacket packet = m_finished.first();
+        m_finished.remove(0);
+        countFlushed(packet);
+        return packet;
+    }
+
+    RenderResultPacket packet = m_pending;
+    if(m_hasPending)
+    {
+        countFlushed(packet);
+    }
+    m_pending = RenderResultPacket();
+    m_hasPending = false;
+    return packet;
+}
+
+void RenderResultPacketCoalescer::countFlushed( const RenderResultPacket & packet )
+{
+    m_numFlushedIterations += packet.getNumIterationsInPacket();
+    m_numFlushedPackets++;
+}
+
+const RenderResultPacketCoalescingPolicy & RenderResultPacketCoalescer::getPolicy() const
+{
+    return m_policy;
+}
+
+void RenderResultPacketCoalescer::setPolicy( const RenderResultPacketCoalescingPolicy & policy )
+{
+    m_policy = policy;
+}
+
+double RenderResultPacketCoalescer::getCoalescingRatio() const
+{
+    return m_numFlushedPackets > 0 ? (double)m_numFlushedIterations/m_numFlushedPackets : 0.0;
+}
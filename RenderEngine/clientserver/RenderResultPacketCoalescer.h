@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include "render_engine_export_api.h"
+#include "RenderResultPacket.h"
+#include <QElapsedTimer>
+#include <QVector>
+
+// When a RenderResultPacketCoalescer sends what it has gathered
+struct RenderResultPacketCoalescingPolicy
+{
+    RenderResultPacketCoalescingPolicy(int maxIterations = 16, qint64 maxOutputBytes = 64*1024*1024, double maxDelaySeconds = 0.1) :
+        maxIterations(maxIterations),
+        maxOutputBytes(maxOutputBytes),
+        maxDelaySeconds(maxDelaySeconds)
+    {
+
+    }
+
+    // Iterations in one packet, 1 sends every iteration on its own
+    int maxIterations;
+    // Bytes the gathered iterations would have taken as separate packets
+    qint64 maxOutputBytes;
+    // Time since the first gathered iteration was added
+    double maxDelaySeconds;
+};
+
+/*
+Gathers the packets of consecutive iterations on a server into one with RenderResultPacket::merge and hands it out
+for sending when the policy says so. Short iterations then share the serialization and network cost of a packet.
+Render and total times of the gathered packets are summed.
+
+The client accepts a packet only if its iterations are within one request, see RenderIterationScheduler, so packets
+of different requests are never merged. When a packet of another request or of another output size is added, what
+was gathered is kept as a packet of its own and shouldFlush is true until it is flushed. Adding a packet of a new
+sequence number drops everything of the old one, since the client ignores those packets anyway.
+
+A server adds the packet of each iteration with the request it belongs to, sends while shouldFlush is true, and
+sends while hasPending is true once the last iteration of a request is done.
+*/
+
+class RenderResultPacketCoalescer
+{
+public:
+    RENDER_ENGINE_EXPORT_API RenderResultPacketCoalescer(const RenderResultPacketCoalescingPolicy & policy = RenderResultPacketCoalescingPolicy());
+    RENDER_ENGINE_EXPORT_API void add(const RenderResultPacket & packet, unsigned long long requestId);
+    RENDER_ENGINE_EXPORT_API bool hasPending() const;
+    RENDER_ENGINE_EXPORT_API bool shouldFlush() const;
+    // Returns the oldest packet of a finished request if any, else the gathered packet and starts over
+    RENDER_ENGINE_EXPORT_API RenderResultPacket flush();
+    RENDER_ENGINE_EXPORT_API const RenderResultPacketCoalescingPolicy & getPolicy() const;
+    RENDER_ENGINE_EXPORT_API void setPolicy(const RenderResultPacketCoalescingPolicy & policy);
+    // Iterations per flushed packet so far
+    RENDER_ENGINE_EXPORT_API double getCoalescingRatio() const;
+
+private:
+    RenderResultPacketCoalescingPolicy m_policy;
+    void countFlushed(const RenderResultPacket & packet);
+
+    RenderResultPacket m_pending;
+    bool m_hasPending;
+    unsigned long long m_pendingRequestId;
+    // Gathered packets of requests that were followed by another one, oldest first
+    QVector<RenderResultPacket> m_finished;
+    QElapsedTimer m_pendingTimer;
+    unsigned long long m_numFlushedIterations;
+    unsigned long long m_numFlushedPackets;
+};
@@ -0,0 +1,474 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "RenderResultPacketCodec.h"
+#include "RenderResultPacket.h"
+#include <QDataStream>
+#include <QVector>
+#include <QtEndian>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// Flags of the encoded output on the wire
+static const quint8 PACKET_DELTA_CODING = 1 << 0;
+static const quint8 PACKET_DELTA_FRAME = 1 << 1;
+static const quint8 PACKET_COMPRESSED = 1 << 2;
+
+// Fastest zlib level, the links are the bottleneck but the render nodes should not wait on the codec either
+static const int COMPRESSION_LEVEL = 1;
+
+// Limits on what read accepts from the stream before it allocates for it
+static const quint32 MAX_ITERATIONS_IN_PACKET = 1 << 20;
+static const quint32 MAX_ENCODED_OUTPUT_SIZE = 1 << 28;
+
+// IEEE half precision conversions, rounding to nearest even like the F16C instructions
+static quint16 floatToHalf(float value)
+{
+    quint32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    quint32 sign = (bits >> 16) & 0x8000;
+    quint32 magnitude = bits & 0x7FFFFFFF;
+
+    // Infinity and NaN
+    if(magnitude >= 0x7F800000)
+    {
+        return (quint16)(sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0));
+    }
+    // Rounds to a value above 65504
+    if(magnitude >= 0x477FF000)
+    {
+        return (quint16)(sign | 0x7C00);
+    }
+    // Subnormal halfs, with round to nearest even of the shifted out bits
+    if(magnitude < 0x38800000)
+    {
+        if(magnitude <= 0x33000000)
+        {
+            return (quint16)sign;
+        }
+        quint32 mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+        quint32 shift = 126 - (magnitude >> 23);
+        quint32 half = mantissa >> shift;
+        quint32 remainder = mantissa & ((1u << shift) - 1);
+        quint32 midpoint = 1u << (shift - 1);
+        if(remainder > midpoint || (remainder == midpoint && (half & 1)))
+        {
+            half++;
+        }
+        return (quint16)(sign | half);
+    }
+    magnitude -= 0x38000000;
+    return (quint16)(sign | ((magnitude + 0xFFF + ((magnitude >> 13) & 1)) >> 13));
+}
+
+static float halfToFloat(quint16 half)
+{
+    quint32 sign = (quint32)(half & 0x8000) << 16;
+    quint32 exponent = (half >> 10) & 0x1F;
+    quint32 mantissa = half & 0x3FF;
+    quint32 bits;
+    if(exponent == 0)
+    {
+        float value = mantissa * (1.0f/16777216.0f);
+        memcpy(&bits, &value, sizeof(bits));
+        bits |= sign;
+    }
+    else if(exponent == 31)
+    {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    }
+    else
+    {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Shared exponent encoding of EXT_texture_shared_exponent, 9 bit mantissas and a 5 bit exponent with bias 15
+static quint32 floatToRGB9E5(float r, float g, float b)
+{
+    const float maxValue = 65408.0f;
+    // The comparisons are written so that NaN becomes 0
+    r = r > 0.0f ? (r < maxValue ? r : maxValue) : 0.0f;
+    g = g > 0.0f ? (g < maxValue ? g : maxValue) : 0.0f;
+    b = b > 0.0f ? (b < maxValue ? b : maxValue) : 0.0f;
+    float maxComponent = std::max(r, std::max(g, b));
+
+    int exponent;
+    frexp(maxComponent, &exponent);
+    // frexp returns floor(log2(maxComponent)) + 1, and 0 for 0
+    int sharedExponent = std::max(-16, exponent - 1) + 16;
+    float scale = ldexpf(1.0f, 15 + 9 - sharedExponent);
+    if((quint32)floorf(maxComponent*scale + 0.5f) == 512)
+    {
+        scale *= 0.5f;
+        sharedExponent++;
+    }
+
+    quint32 rm = (quint32)floorf(r*scale + 0.5f);
+    quint32 gm = (quint32)floorf(g*scale + 0.5f);
+    quint32 bm = (quint32)floorf(b*scale + 0.5f);
+    return rm | (gm << 9) | (bm << 18) | ((quint32)sharedExponent << 27);
+}
+
+static void rgb9e5ToFloat(quint32 packed, float* rgb)
+{
+    float scale = ldexpf(1.0f, (int)(packed >> 27) - 15 - 9);
+    rgb[0] = (packed & 0x1FF) * scale;
+    rgb[1] = ((packed >> 9) & 0x1FF) * scale;
+    rgb[2] = ((packed >> 18) & 0x1FF) * scale;
+}
+
+static int getPixelSize(PixelEncoding::E pixelEncoding)
+{
+    return pixelEncoding == PixelEncoding::FLOAT32 ? 12 : pixelEncoding == PixelEncoding::HALF_FLOAT ? 6 : 4;
+}
+
+// Encodes the float output into pixels, which keeps its buffer while the size stays the same
+static void encodePixels(const QByteArray & output, PixelEncoding::E pixelEncoding, QByteArray & pixels)
+{
+    const float* values = (const float*)output.constData();
+    int numPixels = output.size()/(3*sizeof(float));
+    pixels.resize(numPixels*getPixelSize(pixelEncoding));
+    if(pixelEncoding == PixelEncoding::FLOAT32)
+    {
+        memcpy(pixels.data(), values, numPixels*3*sizeof(float));
+    }
+    else if(pixelEncoding == PixelEncoding::HALF_FLOAT)
+    {
+        quint16* halfs = (quint16*)pixels.data();
+        for(int i = 0; i < 3*numPixels; ++i)
+        {
+            halfs[i] = floatToHalf(values[i]);
+        }
+    }
+    else
+    {
+        quint32* packed = (quint32*)pixels.data();
+        for(int i = 0; i < numPixels; ++i)
+        {
+            packed[i] = floatToRGB9E5(values[3*i], values[3*i+1], values[3*i+2]);
+        }
+    }
+}
+
+// Decodes numPixels pixels into the float output values
+static void decodePixels(const char* pixels, int numPixels, PixelEncoding::E pixelEncoding, float* values)
+{
+    if(pixelEncoding == PixelEncoding::FLOAT32)
+    {
+        memcpy(values, pixels, numPixels*3*sizeof(float));
+    }
+    else if(pixelEncoding == PixelEncoding::HALF_FLOAT)
+    {
+        const quint16* halfs = (const quint16*)pixels;
+        for(int i = 0; i < 3*numPixels; ++i)
+        {
+            values[i] = halfToFloat(halfs[i]);
+        }
+    }
+    else
+    {
+        const quint32* packed = (const quint32*)pixels;
+        for(int i = 0; i < numPixels; ++i)
+        {
+            rgb9e5ToFloat(packed[i], values + 3*i);
+        }
+    }
+}
+
+/*
+// Differences of the encoded values as integers, which are small and repeat a lot between two iterations of
+// the same image. Works on 16 bit words for halfs and 32 bit words otherwise, wrapping around on overflow.
+*/
+template<class T> static void subtractWords(QByteArray & pixels, const QByteArray & previous)
+{
+    T* words = (T*)pixels.data();
+    const T* previousWords = (const T*)previous.constData();
+    int numWords = pixels.size()/sizeof(T);
+    for(int i = 0; i < numWords; ++i)
+    {
+        words[i] = (T)(words[i] - previousWords[i]);
+    }
+}
+
+template<class T> static void addWords(QByteArray & pixels, const QByteArray & previous)
+{
+    T* words = (T*)pixels.data();
+    const T* previousWords = (const T*)previous.constData();
+    int numWords = pixels.size()/sizeof(T);
+    for(int i = 0; i < numWords; ++i)
+    {
+        words[i] = (T)(words[i] + previousWords[i]);
+    }
+}
+
+RenderResultPacketCodec::RenderResultPacketCodec() :
+    m_hasPreviousPixels(false),
+    m_previousSequenceNumber(0),
+    m_previousPixelEncoding(PixelEncoding::FLOAT32),
+    m_outputBytes(0),
+    m_encodedBytes(0)
+{
+
+}
+
+bool RenderResultPacketCodec::canDeltaCode( unsigned long long sequenceNumber, PixelEncoding::E pixelEncoding, int size ) const
+{
+    return m_hasPreviousPixels && m_previousSequenceNumber == sequenceNumber && m_previousPixelEncoding == pixelEncoding
+        && m_previousPixels.size() == size;
+}
+
+void RenderResultPacketCodec::setPreviousPixels( unsigned long long sequenceNumber, PixelEncoding::E pixelEncoding, const QByteArray & pixels )
+{
+    m_hasPreviousPixels = true;
+    m_previousSequenceNumber = sequenceNumber;
+    m_previousPixelEncoding = pixelEncoding;
+    // Copy into our own buffer, which is reused while the size stays the same, instead of holding on to a
+    // buffer of a packet or of the pool
+    m_previousPixels.resize(pixels.size());
+    memcpy(m_previousPixels.data(), pixels.constData(), pixels.size());
+}
+
+/*
+// Writes the packet with the buffers of the codec, so that writing uncompressed frames of the same size does not
+// allocate after the first one. Plain float output without delta coding is written as it is.
+*/
+void RenderResultPacketCodec::write( QDataStream & out, const RenderResultPacket & results )
+{
+    const RenderResultPacketEncoding & encoding = results.getEncoding();
+    PixelEncoding::E pixelEncoding = encoding.getPixelEncoding();
+    const QByteArray* pixels = &results.getOutput();
+    if(pixelEncoding != PixelEncoding::FLOAT32)
+    {
+        encodePixels(results.getOutput(), pixelEncoding, m_pixelBuffer);
+        pixels = &m_pixelBuffer;
+    }
+
+    quint8 flags = 0;
+    const QByteArray* encodedOutput = pixels;
+    if(encoding.getDeltaCoding())
+    {
+        flags |= PACKET_DELTA_CODING;
+        if(canDeltaCode(results.getSequenceNumber(), pixelEncoding, pixels->size()))
+        {
+            flags |= PACKET_DELTA_FRAME;
+            m_deltaBuffer.resize(pixels->size());
+            memcpy(m_deltaBuffer.data(), pixels->constData(), pixels->size());
+            if(pixelEncoding == PixelEncoding::HALF_FLOAT)
+            {
+                subtractWords<quint16>(m_deltaBuffer, m_previousPixels);
+            }
+            else
+            {
+                subtractWords<quint32>(m_deltaBuffer, m_previousPixels);
+            }
+            encodedOutput = &m_deltaBuffer;
+        }
+        setPreviousPixels(results.getSequenceNumber(), pixelEncoding, *pixels);
+    }
+    QByteArray compressedOutput;
+    if(encoding.getCompression())
+    {
+        flags |= PACKET_COMPRESSED;
+        compressedOutput = qCompress(*encodedOutput, COMPRESSION_LEVEL);
+        encodedOutput = &compressedOutput;
+    }
+
+    m_outputBytes += results.getOutput().size();
+    m_encodedBytes += encodedOutput->size();
+
+    const QVector<unsigned long long> & iterationNumbers = results.getIterationNumbersInPacket();
+    m_iterationNumbers.resize(iterationNumbers.size());
+    qCopy(iterationNumbers.constBegin(), iterationNumbers.constEnd(), m_iterationNumbers.begin());
+    qSort(m_iterationNumbers);
+    const QVector<unsigned long long> & iterationNumbersInPacket = m_iterationNumbers;
+
+    // Send size of packet as the first 64 bits so that receiver knows how much data to expect
+    // The size of the different values are listed in http://qt-project.org/doc/qt-4.8/datastreamformat.html
+
+    quint64 sizeOutputBuffer = (quint64)(encodedOutput->size() + sizeof(quint32));
+    quint64 sizeIterationNumbersInPacketVector = (quint64)(iterationNumbersInPacket.size()*sizeof(unsigned long long) + sizeof(quint32));
+
+    quint64 size = sizeOutputBuffer + sizeIterationNumbersInPacketVector;
+    size += (quint64)sizeof(quint64) + 2*(quint64)sizeof(float) + 2*(quint64)sizeof(quint8);
+
+    out << size 
+        << (quint64)results.getSequenceNumber()
+        << iterationNumbersInPacket
+        << results.getRenderTimeSeconds() 
+        << results.getTotalTimeSeconds()
+        << (quint8)pixelEncoding
+        << flags
+        << *encodedOutput;
+}
+
+/*
+// Reads the packet after its size into the fields of results. The iteration numbers are read into the vector the
+// packet already has and the output goes straight from the stream into a buffer of the pool, which gets the
+// previous output of the packet first, so reading a frame of uncompressed pixels does not allocate once the pool
+// has buffers of its size. Compressed frames are still uncompressed into a new buffer by qUncompress.
+*/
+void RenderResultPacketCodec::read( QDataStream & in, RenderResultPacket & results )
+{
+    quint64 sequenceNumber;
+    quint32 numIterations;
+    in >> sequenceNumber;
+    in >> numIterations;
+    if(in.status() != QDataStream::Ok || numIterations > MAX_ITERATIONS_IN_PACKET)
+    {
+        in.setStatus(QDataStream::ReadCorruptData);
+        printf("Error in RenderResultPacketCodec::read.\n");
+        return;
+    }
+    results.m_iterationNumbersInPacket.resize(numIterations);
+    for(quint32 i = 0; i < numIterations; ++i)
+    {
+        quint64 iterationNumber;
+        in >> iterationNumber;
+        results.m_iterationNumbersInPacket[i] = iterationNumber;
+    }
+
+    float renderTimeSeconds;
+    float totalTimeSeconds;
+    quint8 pixelEncodingValue;
+    quint8 flags;
+    quint32 encodedSize;
+    in >> renderTimeSeconds;
+    in >> totalTimeSeconds;
+    in >> pixelEncodingValue;
+    in >> flags;
+    in >> encodedSize;
+    // Null QByteArrays are written with the size 0xFFFFFFFF
+    if(encodedSize == 0xFFFFFFFF)
+    {
+        encodedSize = 0;
+    }
+
+    if(in.status() != QDataStream::Ok || pixelEncodingValue > PixelEncoding::RGB9E5 || encodedSize > MAX_ENCODED_OUTPUT_SIZE)
+    {
+        in.setStatus(QDataStream::ReadCorruptData);
+        printf("Error in RenderResultPacketCodec::read.\n");
+        return;
+    }
+    PixelEncoding::E pixelEncoding = (PixelEncoding::E)pixelEncodingValue;
+    bool compressed = (flags & PACKET_COMPRESSED) != 0;
+    bool deltaFrame = (flags & PACKET_DELTA_FRAME) != 0;
+
+    // The current output of the packet goes back to the pool first, so that reading into the same packet reuses
+    // it once the client has dropped its other references
+    m_pool.release(results.m_output);
+    results.m_output = QByteArray();
+
+    // Plain float frames are read straight into the output buffer, everything else goes through the encoded buffer
+    QByteArray & encoded = !compressed && pixelEncoding == PixelEncoding::FLOAT32 ? results.m_output : m_encodedBuffer;
+    if(&encoded == &results.m_output)
+    {
+        results.m_output = m_pool.acquire(encodedSize);
+    }
+    else
+    {
+        m_encodedBuffer.resize(encodedSize);
+    }
+    if(in.readRawData(encoded.data(), encodedSize) != (int)encodedSize)
+    {
+        in.setStatus(QDataStream::ReadPastEnd);
+        printf("Error in RenderResultPacketCodec::read: frame ended before its output.\n");
+        return;
+    }
+    m_encodedBytes += encodedSize;
+
+    QByteArray uncompressed;
+    if(compressed)
+    {
+        // qCompress stores the uncompressed size big endian in front of the zlib data. It is checked before
+        // qUncompress allocates for it, and qUncompress returns less than that when the data is corrupt.
+        quint32 expectedSize = encodedSize >= sizeof(quint32) ? qFromBigEndian<quint32>((const uchar*)m_encodedBuffer.constData()) : 0;
+        if(encodedSize < sizeof(quint32) || expectedSize > MAX_ENCODED_OUTPUT_SIZE)
+        {
+            in.setStatus(QDataStream::ReadCorruptData);
+            printf("Error in RenderResultPacketCodec::read: invalid compressed output.\n");
+            return;
+        }
+        uncompressed = qUncompress(m_encodedBuffer);
+        if(uncompressed.size() != (int)expectedSize)
+        {
+            in.setStatus(QDataStream::ReadCorruptData);
+            printf("Error in RenderResultPacketCodec::read: compressed output uncompressed to %d bytes instead of %u.\n",
+                uncompressed.size(), expectedSize);
+            return;
+        }
+    }
+    QByteArray & pixels = compressed ? uncompressed : encoded;
+    if(pixels.size() % getPixelSize(pixelEncoding) != 0)
+    {
+        in.setStatus(QDataStream::ReadCorruptData);
+        printf("Error in RenderResultPacketCodec::read: output is not a whole number of pixels.\n");
+        return;
+    }
+
+    if(deltaFrame)
+    {
+        if(!canDeltaCode(sequenceNumber, pixelEncoding, pixels.size()))
+        {
+            in.setStatus(QDataStream::ReadCorruptData);
+            printf("Error in RenderResultPacketCodec::read: delta frame without the previous packet of sequence %llu.\n", sequenceNumber);
+            return;
+        }
+        if(pixelEncoding == PixelEncoding::HALF_FLOAT)
+        {
+            addWords<quint16>(pixels, m_previousPixels);
+        }
+        else
+        {
+            addWords<quint32>(pixels, m_previousPixels);
+        }
+    }
+    if(flags & PACKET_DELTA_CODING)
+    {
+        setPreviousPixels(sequenceNumber, pixelEncoding, pixels);
+    }
+
+    if(&pixels != &results.m_output)
+    {
+        if(compressed && pixelEncoding == PixelEncoding::FLOAT32)
+        {
+            results.m_output = uncompressed;
+        }
+        else
+        {
+            int numPixels = pixels.size()/getPixelSize(pixelEncoding);
+            results.m_output = m_pool.acquire(numPixels*3*sizeof(float));
+            decodePixels(pixels.constData(), numPixels, pixelEncoding, (float*)results.m_output.data());
+        }
+    }
+    m_outputBytes += results.m_output.size();
+
+    results.m_sequenceNumber = sequenceNumber;
+    results.m_renderTimeSeconds = renderTimeSeconds;
+    results.m_totalTimeSeconds = totalTimeSeconds;
+    results.m_encoding = RenderResultPacketEncoding(pixelEncoding, (flags & PACKET_DELTA_CODING) != 0, compressed);
+}
+
+// Give the output of a packet the client is done with back to the pool for the next frames of its size
+void RenderResultPacketCodec::recycle( const RenderResultPacket & results )
+{
+    m_pool.release(results.getOutput());
+}
+
+quint64 RenderResultPacketCodec::getOutputBytes() const
+{
+    return m_outputBytes;
+}
+
+quint64 RenderResultPacketCodec::getEncodedBytes() const
+{
+    return m_encodedBytes;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include "render_engine_export_api.h"
+#include "RenderResultPacketEncoding.h"
+#include "RenderResultPacketPool.h"
+#include <QByteArray>
+#include <QVector>
+
+class RenderResultPacket;
+class QDataStream;
+
+/*
+Writes and reads RenderResultPackets in the encoding set on each packet. The pixels are converted to the pixel
+encoding, then optionally delta coded against the previous packet with the same sequence number and compressed
+with zlib at its fastest level.
+
+Delta coding needs the previous packet on both ends and the buffers of the codec are reused from frame to frame,
+so each connection keeps one codec for writing on the server and one for reading on the client, and passes it
+every packet. Packets have no QDataStream operators for this reason.
+
+Reading reuses the output buffers given back with recycle and the output of the packet read into, see
+RenderResultPacketPool. Once the buffers have grown to the frame size, writing and reading frames that are not
+compressed does not allocate.
+*/
+
+class RenderResultPacketCodec
+{
+public:
+    RENDER_ENGINE_EXPORT_API RenderResultPacketCodec();
+    RENDER_ENGINE_EXPORT_API void write(QDataStream & out, const RenderResultPacket & packet);
+    RENDER_ENGINE_EXPORT_API void read(QDataStream & in, RenderResultPacket & packet);
+    RENDER_ENGINE_EXPORT_API void recycle(const RenderResultPacket & packet);
+
+    // Bytes of float output given to or returned by the codec, and bytes of encoded output on the wire
+    RENDER_ENGINE_EXPORT_API quint64 getOutputBytes() const;
+    RENDER_ENGINE_EXPORT_API quint64 getEncodedBytes() const;
+
+private:
+    bool canDeltaCode(unsigned long long sequenceNumber, PixelEncoding::E pixelEncoding, int size) const;
+    void setPreviousPixels(unsigned long long sequenceNumber, PixelEncoding::E pixelEncoding, const QByteArray & pixels);
+
+    bool m_hasPreviousPixels;
+    unsigned long long m_previousSequenceNumber;
+    PixelEncoding::E m_previousPixelEncoding;
+    QByteArray m_previousPixels;
+    QByteArray m_encodedBuffer;
+    QByteArray m_pixelBuffer;
+    QByteArray m_deltaBuffer;
+    QVector<unsigned long long> m_iterationNumbers;
+    RenderResultPacketPool m_pool;
+    quint64 m_outputBytes;
+    quint64 m_encodedBytes;
+};
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "RenderResultPacketEncoding.h"
+#include <QDataStream>
+#include <cstdio>
+
+RenderResultPacketEncoding::RenderResultPacketEncoding() :
+    m_pixelEncoding(PixelEncoding::FLOAT32), m_deltaCoding(false), m_compression(false)
+{
+
+}
+
+RenderResultPacketEncoding::RenderResultPacketEncoding( PixelEncoding::E pixelEncoding, bool deltaCoding, bool compression ) :
+    m_pixelEncoding(pixelEncoding), m_deltaCoding(deltaCoding), m_compression(compression)
+{
+
+}
+
+PixelEncoding::E RenderResultPacketEncoding::getPixelEncoding() const
+{
+    return m_pixelEncoding;
+}
+
+bool RenderResultPacketEncoding::getDeltaCoding() const
+{
+    return m_deltaCoding;
+}
+
+bool RenderResultPacketEncoding::getCompression() const
+{
+    return m_compression;
+}
+
+QDataStream & operator<<( QDataStream & out, const RenderResultPacketEncoding & encoding )
+{
+    out << (quint8)encoding.getPixelEncoding()
+        << encoding.getDeltaCoding()
+        << encoding.getCompression();
+    return out;
+}
+
+QDataStream & operator>>( QDataStream & in, RenderResultPacketEncoding & encoding )
+{
+    quint8 pixelEncoding;
+    bool deltaCoding;
+    bool compression;
+    in >> pixelEncoding >> deltaCoding >> compression;
+
+    if(pixelEncoding > PixelEncoding::RGB9E5)
+    {
+        in.setStatus(QDataStream::ReadCorruptData);
+        printf("Error in RenderResultPacketEncoding operator >>: unknown pixel encoding %d.\n", pixelEncoding);
+        pixelEncoding = PixelEncoding::FLOAT32;
+    }
+
+    encoding = RenderResultPacketEncoding((PixelEncoding::E)pixelEncoding, deltaCoding, compression);
+    return in;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include "render_engine_export_api.h"
+
+namespace PixelEncoding
+{
+    enum E
+    {
+        // 12 bytes per pixel, the output buffer as it is
+        FLOAT32,
+        // 6 bytes per pixel
+        HALF_FLOAT,
+        // 4 bytes per pixel, shared exponent RGB. Negative values are sent as 0.
+        RGB9E5
+    };
+}
+
+/*
+How a server encodes the output of the RenderResultPackets it sends. The client asks for an encoding in the
+RenderServerRenderRequestDetails of its requests and the server uses it for the results of those requests.
+Delta coding only takes effect when packets go through the same RenderResultPacketCodec, see there.
+*/
+
+class RenderResultPacketEncoding
+{
+public:
+    RENDER_ENGINE_EXPORT_API RenderResultPacketEncoding();
+    RENDER_ENGINE_EXPORT_API RenderResultPacketEncoding(PixelEncoding::E pixelEncoding, bool deltaCoding, bool compression);
+    RENDER_ENGINE_EXPORT_API PixelEncoding::E getPixelEncoding() const;
+    RENDER_ENGINE_EXPORT_API bool getDeltaCoding() const;
+    RENDER_ENGINE_EXPORT_API bool getCompression() const;
+
+private:
+    PixelEncoding::E m_pixelEncoding;
+    bool m_deltaCoding;
+    bool m_compression;
+};
+
+class QDataStream;
+RENDER_ENGINE_EXPORT_API QDataStream & operator << (QDataStream & out, const RenderResultPacketEncoding & encoding);
+RENDER_ENGINE_EXPORT_API QDataStream & operator >> (QDataStream & in, RenderResultPacketEncoding & encoding);
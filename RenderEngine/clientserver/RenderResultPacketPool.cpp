@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "RenderResultPacketPool.h"
+
+// Buffers kept per size, enough for the packets a client holds on to while merging
+static const int MAX_BUFFERS_PER_SIZE = 8;
+
+RenderResultPacketPool::RenderResultPacketPool() :
+    m_numAllocations(0)
+{
+
+}
+
+QByteArray RenderResultPacketPool::acquire( int size )
+{
+    QHash<int, QVector<QByteArray> >::iterator buffers = m_buffers.find(size);
+    if(buffers != m_buffers.end())
+    {
+        for(int i = 0; i < buffers->size(); ++i)
+        {
+            if((*buffers)[i].isDetached())
+            {
+                // Take it out of the pool so that the caller holds the only reference and can write to it without a copy
+                QByteArray buffer;
+                buffer.swap((*buffers)[i]);
+                (*buffers)[i].swap(buffers->last());
+                buffers->removeLast();
+                return buffer;
+            }
+        }
+    }
+    m_numAllocations++;
+    return QByteArray(size, Qt::Uninitialized);
+}
+
+void RenderResultPacketPool::release( const QByteArray & buffer )
+{
+    if(buffer.isEmpty())
+    {
+        return;
+    }
+    QVector<QByteArray> & buffers = m_buffers[buffer.size()];
+    for(int i = 0; i < buffers.size(); ++i)
+    {
+        if(buffers[i].constData() == buffer.constData())
+        {
+            return;
+        }
+    }
+    if(buffers.size() < MAX_BUFFERS_PER_SIZE)
+    {
+        buffers.append(buffer);
+    }
+}
+
+quint64 RenderResultPacketPool::getNumAllocations() const
+{
+    return m_numAllocations;
+}
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include "render_engine_export_api.h"
+#include <QByteArray>
+#include <QHash>
+#include <QVector>
+
+/*
+Output buffers of received RenderResultPackets for reuse, keyed by their size. Frames of the same image all have
+the same size, so once a client gives back the buffers of the packets it is done with, receiving a frame no longer
+allocates. A released buffer is only handed out again when the pool holds its last reference, so it is safe to
+release the output of a packet that is still in use.
+*/
+
+class RenderResultPacketPool
+{
+public:
+    RENDER_ENGINE_EXPORT_API RenderResultPacketPool();
+    // Returns a buffer of size bytes that no one else references
+    RENDER_ENGINE_EXPORT_API QByteArray acquire(int size);
+    RENDER_ENGINE_EXPORT_API void release(const QByteArray & buffer);
+    // Number of buffers acquire had to allocate
+    RENDER_ENGINE_EXPORT_API quint64 getNumAllocations() const;
+
+private:
+    QHash<int, QVector<QByteArray> > m_buffers;
+    quint64 m_numAllocations;
+};
@@ -73,22 +73,22 @@ QDataStream & operator<<( QDataStream & out, const RenderServerRenderRequest & r
 
 QDataStream & operator>>( QDataStream & in, RenderServerRenderRequest & renderRequest )
 {
-    QByteArray array;
-    in >> array;
-    QDataStream arrayStream(&array, QIODevice::ReadWrite);
+    // The fields are written into a byte array, whose size we skip so that they can be read straight into the
+    // request instead of copying the array and every field once more. Floating point values are read like the
+    // array's own stream wrote them.
+    quint32 arraySize;
+    in >> arraySize;
+    QDataStream::FloatingPointPrecision precision = in.floatingPointPrecision();
+    in.setFloatingPointPrecision(QDataStream::DoublePrecision);
 
     quint64 sequenceNumber;
-    QVector<unsigned long long> iterationNumbers;
-    QVector<double> ppmRadii;
-    RenderServerRenderRequestDetails details;
-
-    arrayStream >> sequenceNumber 
-                >> iterationNumbers
-                >> ppmRadii 
-                >> details;
+    in >> sequenceNumber
+       >> renderRequest.m_iterationNumbers
+       >> renderRequest.m_ppmRadii
+       >> renderRequest.m_details;
+    renderRequest.m_sequenceNumber = (unsigned long long)sequenceNumber;
 
-    renderRequest = RenderServerRenderRequest((unsigned long long)sequenceNumber, iterationNumbers, 
-                        ppmRadii, details);
+    in.setFloatingPointPrecision(precision);
 
     if(in.status() != QDataStream::Ok)
     {
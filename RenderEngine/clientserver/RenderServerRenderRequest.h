@@ -9,6 +9,8 @@
 #include <QVector>
 #include "RenderServerRenderRequestDetails.h"
 
+class QDataStream;
+
 class RenderServerRenderRequest
 {
 public:
@@ -25,12 +27,13 @@ public:
     RENDER_ENGINE_EXPORT_API const RenderServerRenderRequestDetails & getDetails() const;
 
 private:
+    friend RENDER_ENGINE_EXPORT_API QDataStream & operator >> (QDataStream & in, RenderServerRenderRequest & renderRequest);
+
     unsigned long long m_sequenceNumber;
     QVector<unsigned long long> m_iterationNumbers;
     QVector<double> m_ppmRadii;
     RenderServerRenderRequestDetails m_details;
 };
 
-class QDataStream;
 RENDER_ENGINE_EXPORT_API QDataStream & operator << (QDataStream & out, const RenderServerRenderRequest & renderRequest);
 RENDER_ENGINE_EXPORT_API QDataStream & operator >> (QDataStream & in, RenderServerRenderRequest & renderRequest);
@@ -13,8 +13,11 @@ RenderServerRenderRequestDetails::RenderServerRenderRequestDetails()
 }
 
 RenderServerRenderRequestDetails::RenderServerRenderRequestDetails( const Camera & camera, QByteArray sceneName, RenderMethod::E renderMethod, 
-                                                                    unsigned int width, unsigned int height, double ppmAlpha ) :
-  m_camera(camera), m_sceneName(sceneName), m_renderMethod(renderMethod), m_width(width), m_height(height), m_ppmAlpha(ppmAlpha)
+                                                                    unsigned int width, unsigned int height, double ppmAlpha,
+                                                                    const RenderResultPacketEncoding & resultEncoding, const QRect & tile,
+                                                                    const QByteArray & sceneHash ) :
+  m_camera(camera), m_sceneName(sceneName), m_renderMethod(renderMethod), m_width(width), m_height(height), m_ppmAlpha(ppmAlpha),
+  m_resultEncoding(resultEncoding), m_tile(tile), m_sceneHash(sceneHash)
 {
 
 }
@@ -50,6 +53,30 @@ const QByteArray & RenderServerRenderRequestDetails::getSceneName() const
     return m_sceneName;
 }
 
+const RenderResultPacketEncoding & RenderServerRenderRequestDetails::getResultEncoding() const
+{
+    return m_resultEncoding;
+}
+
+QRect RenderServerRenderRequestDetails::getTile() const
+{
+    if(m_tile.isNull())
+    {
+        return QRect(0, 0, m_width, m_height);
+    }
+    return m_tile;
+}
+
+bool RenderServerRenderRequestDetails::isTiled() const
+{
+    return !m_tile.isNull();
+}
+
+const QByteArray & RenderServerRenderRequestDetails::getSceneHash() const
+{
+    return m_sceneHash;
+}
+
 QDataStream & operator<<( QDataStream & out, const RenderServerRenderRequestDetails & details )
 {
     QByteArray array;
@@ -59,7 +86,10 @@ QDataStream & operator<<( QDataStream & out, const RenderServerRenderRequestDeta
         << (quint32)details.getRenderMethod()
         << (quint32)details.getWidth() 
         << (quint32)details.getHeight()
-        << (double)details.getPPMAlpha();
+        << (double)details.getPPMAlpha()
+        << details.getResultEncoding()
+        << (details.isTiled() ? details.getTile() : QRect())
+        << details.getSceneHash();
 
     out << array;
     return out;
@@ -76,6 +106,9 @@ QDataStream & operator>>( QDataStream & in, RenderServerRenderRequestDetails & d
     quint32 renderMethod;
     quint32 width, height;
     double ppmAlpha;
+    RenderResultPacketEncoding resultEncoding;
+    QRect tile;
+    QByteArray sceneHash;
 
     arrayStream 
         >> camera 
@@ -83,9 +116,12 @@ QDataStream & operator>>( QDataStream & in, RenderServerRenderRequestDetails & d
         >> renderMethod 
         >> width 
         >> height
-        >> ppmAlpha;
+        >> ppmAlpha
+        >> resultEncoding
+        >> tile
+        >> sceneHash;
 
-    details = RenderServerRenderRequestDetails(camera, sceneName, (RenderMethod::E)renderMethod, width, height, ppmAlpha);
+    details = RenderServerRenderRequestDetails(camera, sceneName, (RenderMethod::E)renderMethod, width, height, ppmAlpha, resultEncoding, tile, sceneHash);
 
     if(in.status() != QDataStream::Ok)
     {
@@ -9,20 +9,32 @@
 #include "render_engine_export_api.h"
 #include "renderer/Camera.h"
 #include "renderer/RenderMethod.h"
+#include "RenderResultPacketEncoding.h"
 #include <QString>
 #include <QByteArray>
+#include <QRect>
 
 class RenderServerRenderRequestDetails
 {
 public:
     RENDER_ENGINE_EXPORT_API RenderServerRenderRequestDetails();
-    RENDER_ENGINE_EXPORT_API RenderServerRenderRequestDetails(const Camera & camera, QByteArray sceneName, RenderMethod::E renderMethod, unsigned int width, unsigned int height, double ppmAlpha);
+    RENDER_ENGINE_EXPORT_API RenderServerRenderRequestDetails(const Camera & camera, QByteArray sceneName, RenderMethod::E renderMethod, unsigned int width, unsigned int height, double ppmAlpha,
+                                                             const RenderResultPacketEncoding & resultEncoding = RenderResultPacketEncoding(), const QRect & tile = QRect(),
+                                                             const QByteArray & sceneHash = QByteArray());
     RENDER_ENGINE_EXPORT_API unsigned int getWidth() const;
     RENDER_ENGINE_EXPORT_API unsigned int getHeight() const;
     RENDER_ENGINE_EXPORT_API double getPPMAlpha() const;
     RENDER_ENGINE_EXPORT_API const Camera & getCamera() const;
     RENDER_ENGINE_EXPORT_API const QByteArray & getSceneName() const;
     RENDER_ENGINE_EXPORT_API const RenderMethod::E getRenderMethod() const;
+    // Encoding the client wants for the RenderResultPackets answering this request
+    RENDER_ENGINE_EXPORT_API const RenderResultPacketEncoding & getResultEncoding() const;
+    // Part of the width x height image the server should send back, the whole image unless a tile was given
+    RENDER_ENGINE_EXPORT_API QRect getTile() const;
+    RENDER_ENGINE_EXPORT_API bool isTiled() const;
+    // Hash of the scene files for servers without the scene file at the scene name, see SceneTransferMessage.
+    // Empty when the client did not send it.
+    RENDER_ENGINE_EXPORT_API const QByteArray & getSceneHash() const;
 private:
     Camera m_camera;
     RenderMethod::E m_renderMethod;
@@ -30,6 +42,9 @@ private:
     unsigned int m_height;
     double m_ppmAlpha;
     QByteArray m_sceneName;
+    RenderResultPacketEncoding m_resultEncoding;
+    QRect m_tile;
+    QByteArray m_sceneHash;
 };
 
 class QDataStream;
@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "RenderServerSceneCache.h"
+#include <QDateTime>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+// File in each scene directory holding the path of the scene file. It is rewritten on use, its time orders the LRU.
+static const char* SCENE_INFO_FILE = ".scene";
+
+// Scene hashes are SHA-1 digests, see hashSceneFiles. Anything else must not become part of a path.
+static const int SCENE_HASH_SIZE = 20;
+
+static bool isValidSceneHash(const QByteArray & sceneHash)
+{
+    return sceneHash.size() == SCENE_HASH_SIZE;
+}
+
+static qint64 getDirectorySize(const QString & directory)
+{
+    qint64 size = 0;
+    QDirIterator it(directory, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+    while(it.hasNext())
+    {
+        it.next();
+        size += it.fileInfo().size();
+    }
+    return size;
+}
+
+static QStringList getRelativeFilePaths(const QString & directory)
+{
+    QDir root(directory);
+    QStringList paths;
+    QDirIterator it(directory, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+    while(it.hasNext())
+    {
+        paths.append(root.relativeFilePath(it.next()));
+    }
+    paths.removeAll(SCENE_INFO_FILE);
+    return paths;
+}
+
+RenderServerSceneCache::RenderServerSceneCache( const QString & cacheDirectory, qint64 maxSizeBytes ) :
+    m_cacheDirectory(cacheDirectory),
+    m_maxSizeBytes(maxSizeBytes)
+{
+    m_cacheDirectory.mkpath(".");
+    // Transfers that were not finished before a restart are never finished
+    QStringList partialDirectories = m_cacheDirectory.entryList(QStringList("*.partial"), QDir::Dirs | QDir::NoDotAndDotDot);
+    for(int i = 0; i < partialDirectories.size(); ++i)
+    {
+        QDir(m_cacheDirectory.filePath(partialDirectories[i])).removeRecursively();
+    }
+}
+
+SceneTransferMessage RenderServerSceneCache::answerQuery( const SceneTransferMessage & query )
+{
+    if(!isValidSceneHash(query.getSceneHash()))
+    {
+        return SceneTransferMessage(SceneTransferMessageType::TRANSFER_FAILED, query.getSceneHash());
+    }
+    if(!getSceneFile(query.getSceneHash()).isEmpty())
+    {
+        return SceneTransferMessage(SceneTransferMessageType::CACHE_HIT, query.getSceneHash());
+    }
+    if(!isSafeScenePath(query.getPath()))
+    {
+        return SceneTransferMessage(SceneTransferMessageType::TRANSFER_FAILED, query.getSceneHash());
+    }
+
+    abortTransfer(query.getSceneHash());
+    m_transfers.insert(query.getSceneHash(), query.getPath());
+    QDir().mkpath(getPartialDirectory(query.getSceneHash()));
+    return SceneTransferMessage(SceneTransferMessageType::CACHE_MISS, query.getSceneHash());
+}
+
+SceneTransferMessage RenderServerSceneCache::receive( const SceneTransferMessage & message, bool & answerNeeded )
+{
+    const QByteArray & sceneHash = message.getSceneHash();
+    answerNeeded = true;
+    SceneTransferMessage failed(SceneTransferMessageType::TRANSFER_FAILED, sceneHash);
+    if(!m_transfers.contains(sceneHash))
+    {
+        return failed;
+    }
+
+    if(message.getType() == SceneTransferMessageType::TRANSFER_DONE)
+    {
+        if(!finishTransfer(sceneHash))
+        {
+            abortTransfer(sceneHash);
+            return failed;
+        }
+        return SceneTransferMessage(SceneTransferMessageType::CACHE_HIT, sceneHash);
+    }
+
+    if(message.getType() != SceneTransferMessageType::FILE_CHUNK || !isSafeScenePath(message.getPath())
+        || QDir::cleanPath(message.getPath()) == SCENE_INFO_FILE)
+    {
+        abortTransfer(sceneHash);
+        return failed;
+    }
+
+    QString filePath = QDir(getPartialDirectory(sceneHash)).filePath(QDir::cleanPath(message.getPath()));
+    QDir().mkpath(QFileInfo(filePath).absolutePath());
+    QFile file(filePath);
+    bool opened = message.getOffset() == 0 ? file.open(QIODevice::WriteOnly | QIODevice::Truncate) : file.open(QIODevice::Append);
+    if(!opened || file.size() != message.getOffset() || file.write(message.getData()) != message.getData().size())
+    {
+        printf("RenderServerSceneCache: could not write %s.\n", filePath.toLatin1().constData());
+        abortTransfer(sceneHash);
+        return failed;
+    }
+
+    answerNeeded = false;
+    return SceneTransferMessage();
+}
+
+QString RenderServerSceneCache::getSceneFile( const QByteArray & sceneHash )
+{
+    if(!isValidSceneHash(sceneHash))
+    {
+        return QString();
+    }
+    QString sceneDirectory = getSceneDirectory(sceneHash);
+    QFile info(QDir(sceneDirectory).filePath(SCENE_INFO_FILE));
+    if(!info.open(QIODevice::ReadOnly))
+    {
+        return QString();
+    }
+    QString sceneFile = QString::fromUtf8(info.readAll());
+    info.close();
+    touch(sceneDirectory);
+    return QDir(sceneDirectory).absoluteFilePath(sceneFile);
+}
+
+QString RenderServerSceneCache::getSceneDirectory( const QByteArray & sceneHash ) const
+{
+    if(!isValidSceneHash(sceneHash))
+    {
+        throw std::invalid_argument("RenderServerSceneCache: scene hash is not a SHA-1 digest.");
+    }
+    return m_cacheDirectory.absoluteFilePath(QString::fromLatin1(sceneHash.toHex()));
+}
+
+QString RenderServerSceneCache::getPartialDirectory( const QByteArray & sceneHash ) const
+{
+    return getSceneDirectory(sceneHash) + ".partial";
+}
+
+void RenderServerSceneCache::touch( const QString & sceneDirectory )
+{
+    QFile info(QDir(sceneDirectory).filePath(SCENE_INFO_FILE));
+    if(info.open(QIODevice::ReadOnly))
+    {
+        QByteArray sceneFile = info.readAll();
+        info.close();
+        if(info.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            info.write(sceneFile);
+        }
+    }
+}
+
+// Checks the received files against the hash and moves them into the cache
+bool RenderServerSceneCache::finishTransfer( const QByteArray & sceneHash )
+{
+    QString partialDirectory = getPartialDirectory(sceneHash);
+    QString sceneFile = m_transfers.value(sceneHash);
+    if(hashSceneFiles(partialDirectory, getRelativeFilePaths(partialDirectory)) != sceneHash
+        || !QFile::exists(QDir(partialDirectory).filePath(sceneFile)))
+    {
+        printf("RenderServerSceneCache: received scene does not match its hash.\n");
+        return false;
+    }
+
+    QFile info(QDir(partialDirectory).filePath(SCENE_INFO_FILE));
+    if(!info.open(QIODevice::WriteOnly | QIODevice::Truncate) || info.write(sceneFile.toUtf8()) < 0)
+    {
+        return false;
+    }
+    info.close();
+
+    QString sceneDirectory = getSceneDirectory(sceneHash);
+    QDir(sceneDirectory).removeRecursively();
+    if(!QDir().rename(partialDirectory, sceneDirectory))
+    {
+        return false;
+    }
+    m_transfers.remove(sceneHash);
+    evict(sceneDirectory);
+    return true;
+}
+
+void RenderServerSceneCache::abortTransfer( const QByteArray & sceneHash )
+{
+    if(!isValidSceneHash(sceneHash))
+    {
+        return;
+    }
+    QDir(getPartialDirectory(sceneHash)).removeRecursively();
+    m_transfers.remove(sceneHash);
+}
+
+// Removes the least recently used scenes until the cache fits in its size, except for the one just added
+void RenderServerSceneCache::evict( const QString & keptSceneDirectory )
+{
+    QList<QPair<QDateTime, QString> > scenes;
+    qint64 totalSize = 0;
+    QFileInfoList directories = m_cacheDirectory.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for(int i = 0; i < directories.size(); ++i)
+    {
+        QString directory = directories[i].absoluteFilePath();
+        QFileInfo info(QDir(directory).filePath(SCENE_INFO_FILE));
+        if(!info.exists())
+        {
+            continue;
+        }
+        totalSize += getDirectorySize(directory);
+        scenes.append(qMakePair(info.lastModified(), directory));
+    }
+
+    std::sort(scenes.begin(), scenes.end());
+    for(int i = 0; i < scenes.size() && totalSize > m_maxSizeBytes; ++i)
+    {
+        if(QFileInfo(scenes[i].second) == QFileInfo(keptSceneDirectory))
+        {
+            continue;
+        }
+        totalSize -= getDirectorySize(scenes[i].second);
+        QDir(scenes[i].second).removeRecursively();
+    }
+}
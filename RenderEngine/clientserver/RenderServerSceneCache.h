@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include "render_engine_export_api.h"
+#include "SceneTransferMessage.h"
+#include <QDir>
+#include <QMap>
+
+/*
+Server side of the scene transfer, an on-disk cache of the scenes clients have sent. Every scene is a directory
+named by the hex hash of its files. Scenes are written to a .partial directory first and only become visible
+once their hash has been checked. When the cache grows past its size, the least recently used scenes are removed.
+*/
+
+class RenderServerSceneCache
+{
+public:
+    RENDER_ENGINE_EXPORT_API RenderServerSceneCache(const QString & cacheDirectory, qint64 maxSizeBytes);
+    // Answers TRANSFER_FAILED to hashes that are not a SHA-1 digest, since the hash names the scene directory
+    RENDER_ENGINE_EXPORT_API SceneTransferMessage answerQuery(const SceneTransferMessage & query);
+    // Stores a FILE_CHUNK or finishes a scene on TRANSFER_DONE. Returns the answer to send, which is only
+    // needed for TRANSFER_DONE or when the message could not be used.
+    RENDER_ENGINE_EXPORT_API SceneTransferMessage receive(const SceneTransferMessage & message, bool & answerNeeded);
+    // Absolute path of the scene file of a cached scene, empty if it is not in the cache
+    RENDER_ENGINE_EXPORT_API QString getSceneFile(const QByteArray & sceneHash);
+
+private:
+    QString getSceneDirectory(const QByteArray & sceneHash) const;
+    QString getPartialDirectory(const QByteArray & sceneHash) const;
+    void touch(const QString & sceneDirectory);
+    bool finishTransfer(const QByteArray & sceneHash);
+    void abortTransfer(const QByteArray & sceneHash);
+    void evict(const QString & keptSceneDirectory);
+
+    QDir m_cacheDirectory;
+    qint64 m_maxSizeBytes;
+    // Scene file of the transfers in progress
+    QMap<QByteArray, QString> m_transfers;
+};
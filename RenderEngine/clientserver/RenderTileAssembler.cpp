@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "RenderTileAssembler.h"
+#include "RenderResultPacket.h"
+#include <cstring>
+#include <stdexcept>
+
+static const int PIXEL_SIZE = 3*sizeof(float);
+
+static bool isInsideImage(const QRect & tile, unsigned int width, unsigned int height)
+{
+    return !tile.isEmpty() && tile.left() >= 0 && tile.top() >= 0
+        && (unsigned int)tile.right() < width && (unsigned int)tile.bottom() < height;
+}
+
+RenderTileAssembler::RenderTileAssembler( unsigned int width, unsigned int height ) :
+    m_width(width),
+    m_height(height),
+    m_output(width*height*PIXEL_SIZE, '\0')
+{
+
+}
+
+QVector<QRect> RenderTileAssembler::splitImage( unsigned int width, unsigned int height, int numTiles )
+{
+    numTiles = qBound(1, numTiles, (int)qMax(1u, height));
+    QVector<QRect> tiles;
+    for(int i = 0; i < numTiles; ++i)
+    {
+        int top = (int)((unsigned long long)height*i/numTiles);
+        int bottom = (int)((unsigned long long)height*(i+1)/numTiles);
+        tiles.append(QRect(0, top, width, bottom - top));
+    }
+    return tiles;
+}
+
+QByteArray RenderTileAssembler::extractTile( const QByteArray & imageOutput, unsigned int width, const QRect & tile )
+{
+    unsigned int height = width > 0 ? imageOutput.size()/(width*PIXEL_SIZE) : 0;
+    if(!isInsideImage(tile, width, height))
+    {
+        throw std::invalid_argument("RenderTileAssembler::extractTile: tile is outside the image.");
+    }
+
+    int rowSize = tile.width()*PIXEL_SIZE;
+    QByteArray tileOutput(tile.height()*rowSize, Qt::Uninitialized);
+    for(int row = 0; row < tile.height(); ++row)
+    {
+        const char* source = imageOutput.constData() + ((tile.top() + row)*width + tile.left())*PIXEL_SIZE;
+        memcpy(tileOutput.data() + row*rowSize, source, rowSize);
+    }
+    return tileOutput;
+}
+
+void RenderTileAssembler::addTile( const QRect & tile, const RenderResultPacket & packet )
+{
+    addTile(tile, packet.getOutput());
+}
+
+void RenderTileAssembler::addTile( const QRect & tile, const QByteArray & tileOutput )
+{
+    if(!isInsideImage(tile, m_width, m_height))
+    {
+        throw std::invalid_argument("RenderTileAssembler::addTile: tile is outside the image.");
+    }
+    int rowSize = tile.width()*PIXEL_SIZE;
+    if(tileOutput.size() != tile.height()*rowSize)
+    {
+        throw std::invalid_argument("RenderTileAssembler::addTile: output size does not match the tile.");
+    }
+
+    char* output = m_output.data();
+    for(int row = 0; row < tile.height(); ++row)
+    {
+        memcpy(output + ((tile.top() + row)*m_width + tile.left())*PIXEL_SIZE, tileOutput.constData() + row*rowSize, rowSize);
+    }
+}
+
+const QByteArray & RenderTileAssembler::getOutput() const
+{
+    return m_output;
+}
+
+unsigned int RenderTileAssembler::getWidth() const
+{
+    return m_width;
+}
+
+unsigned int RenderTileAssembler::getHeight() const
+{
+    return m_height;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include "render_engine_export_api.h"
+#include <QByteArray>
+#include <QRect>
+#include <QVector>
+
+class RenderResultPacket;
+
+/*
+Tiled rendering of a single image over several servers. The client splits the image with splitImage and sends
+each server requests for its own tile in the RenderServerRenderRequestDetails. The renderers trace only the tile of
+the request and their output buffer is the tile, see OptixRenderer::renderNextIteration, so the work of each server
+and its packets shrink with the number of tiles. extractTile cuts a tile out of the output of a whole image. The
+client stitches the RenderResultPackets of the tiles into the output buffer of the whole image with addTile.
+
+Output buffers hold three floats per pixel, row by row.
+*/
+
+class RenderTileAssembler
+{
+public:
+    RENDER_ENGINE_EXPORT_API RenderTileAssembler(unsigned int width, unsigned int height);
+
+    // Splits a width x height image into numTiles bands of whole rows, which are contiguous in the output buffer
+    RENDER_ENGINE_EXPORT_API static QVector<QRect> splitImage(unsigned int width, unsigned int height, int numTiles);
+    // Copies the pixels of tile out of the output buffer of a whole image of the given width
+    RENDER_ENGINE_EXPORT_API static QByteArray extractTile(const QByteArray & imageOutput, unsigned int width, const QRect & tile);
+
+    // Writes the output of a packet rendered for tile into the image, replacing what the tile had before
+    RENDER_ENGINE_EXPORT_API void addTile(const QRect & tile, const RenderResultPacket & packet);
+    RENDER_ENGINE_EXPORT_API void addTile(const QRect & tile, const QByteArray & tileOutput);
+    RENDER_ENGINE_EXPORT_API const QByteArray & getOutput() const;
+    RENDER_ENGINE_EXPORT_API unsigned int getWidth() const;
+    RENDER_ENGINE_EXPORT_API unsigned int getHeight() const;
+
+private:
+    unsigned int m_width;
+    unsigned int m_height;
+    QByteArray m_output;
+};
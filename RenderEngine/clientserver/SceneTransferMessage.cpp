@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "SceneTransferMessage.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <cstdio>
+
+// Largest chunk a server accepts
+static const int MAX_CHUNK_SIZE = 16*1024*1024;
+
+SceneTransferMessage::SceneTransferMessage() :
+    m_type(SceneTransferMessageType::QUERY),
+    m_offset(0),
+    m_size(0)
+{
+
+}
+
+SceneTransferMessage::SceneTransferMessage( SceneTransferMessageType::E type, const QByteArray & sceneHash, const QString & path,
+                                            qint64 offset, qint64 size, const QByteArray & data ) :
+    m_type(type),
+    m_sceneHash(sceneHash),
+    m_path(path),
+    m_offset(offset),
+    m_size(size),
+    m_data(data)
+{
+
+}
+
+SceneTransferMessageType::E SceneTransferMessage::getType() const
+{
+    return m_type;
+}
+
+const QByteArray & SceneTransferMessage::getSceneHash() const
+{
+    return m_sceneHash;
+}
+
+const QString & SceneTransferMessage::getPath() const
+{
+    return m_path;
+}
+
+qint64 SceneTransferMessage::getOffset() const
+{
+    return m_offset;
+}
+
+qint64 SceneTransferMessage::getSize() const
+{
+    return m_size;
+}
+
+const QByteArray & SceneTransferMessage::getData() const
+{
+    return m_data;
+}
+
+QByteArray hashSceneFiles( const QString & rootDirectory, QStringList relativePaths )
+{
+    relativePaths.sort();
+    QDir root(rootDirectory);
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    QByteArray buffer(1 << 20, Qt::Uninitialized);
+    for(int i = 0; i < relativePaths.size(); ++i)
+    {
+        QFile file(root.filePath(relativePaths[i]));
+        if(!file.open(QIODevice::ReadOnly))
+        {
+            return QByteArray();
+        }
+        QByteArray header;
+        QDataStream headerStream(&header, QIODevice::WriteOnly);
+        headerStream << relativePaths[i] << (qint64)file.size();
+        hash.addData(header);
+        qint64 bytesRead;
+        while((bytesRead = file.read(buffer.data(), buffer.size())) > 0)
+        {
+            hash.addData(buffer.constData(), (int)bytesRead);
+        }
+    }
+    return hash.result();
+}
+
+bool isSafeScenePath( const QString & relativePath )
+{
+    QString cleanPath = QDir::cleanPath(relativePath);
+    return !cleanPath.isEmpty() && QDir::isRelativePath(cleanPath) && !cleanPath.contains(':')
+        && cleanPath != ".." && !cleanPath.startsWith("../");
+}
+
+QDataStream & operator<<( QDataStream & out, const SceneTransferMessage & message )
+{
+    out << (quint8)message.getType()
+        << message.getSceneHash()
+        << message.getPath()
+        << message.getOffset()
+        << message.getSize()
+        << message.getData();
+    return out;
+}
+
+QDataStream & operator>>( QDataStream & in, SceneTransferMessage & message )
+{
+    quint8 type;
+    QByteArray sceneHash;
+    QString path;
+    qint64 offset;
+    qint64 size;
+    quint32 dataSize;
+    in >> type >> sceneHash >> path >> offset >> size >> dataSize;
+
+    // Check the size before QByteArray allocates it
+    if(in.status() != QDataStream::Ok || type > SceneTransferMessageType::TRANSFER_FAILED
+        || (dataSize != 0xFFFFFFFF && dataSize > (quint32)MAX_CHUNK_SIZE))
+    {
+        in.setStatus(QDataStream::ReadCorruptData);
+        printf("Error in SceneTransferMessage operator >>.\n");
+        return in;
+    }
+    QByteArray data;
+    if(dataSize != 0xFFFFFFFF)
+    {
+        data.resize(dataSize);
+        if(in.readRawData(data.data(), dataSize) != (int)dataSize)
+        {
+            in.setStatus(QDataStream::ReadPastEnd);
+            printf("Error in SceneTransferMessage operator >>.\n");
+            return in;
+        }
+    }
+
+    message = SceneTransferMessage((SceneTransferMessageType::E)type, sceneHash, path, offset, size, data);
+    return in;
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include "render_engine_export_api.h"
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+namespace SceneTransferMessageType
+{
+    enum E
+    {
+        // Client asks if the server has the scene with the hash, path is the scene file and size the bytes of all files
+        QUERY,
+        CACHE_HIT,
+        CACHE_MISS,
+        // Client sends data of the file at path, starting at offset, in a file of the given size
+        FILE_CHUNK,
+        // Client has sent all files of the scene
+        TRANSFER_DONE,
+        // Server could not store the scene, it must be sent again
+        TRANSFER_FAILED
+    };
+}
+
+/*
+Messages of the scene transfer between a client and a render server. Scenes are addressed by the SHA-1 of their
+files, see hashSceneFiles, which the client sends along in RenderServerRenderRequestDetails. A client queries the
+server with the hash and on a miss streams every file in chunks, the server answers the query and the end of the
+transfer. Paths are relative to the directory of the scene file.
+*/
+
+class SceneTransferMessage
+{
+public:
+    RENDER_ENGINE_EXPORT_API SceneTransferMessage();
+    RENDER_ENGINE_EXPORT_API SceneTransferMessage(SceneTransferMessageType::E type, const QByteArray & sceneHash, const QString & path = QString(),
+        qint64 offset = 0, qint64 size = 0, const QByteArray & data = QByteArray());
+    RENDER_ENGINE_EXPORT_API SceneTransferMessageType::E getType() const;
+    RENDER_ENGINE_EXPORT_API const QByteArray & getSceneHash() const;
+    RENDER_ENGINE_EXPORT_API const QString & getPath() const;
+    RENDER_ENGINE_EXPORT_API qint64 getOffset() const;
+    RENDER_ENGINE_EXPORT_API qint64 getSize() const;
+    RENDER_ENGINE_EXPORT_API const QByteArray & getData() const;
+
+private:
+    SceneTransferMessageType::E m_type;
+    QByteArray m_sceneHash;
+    QString m_path;
+    qint64 m_offset;
+    qint64 m_size;
+    QByteArray m_data;
+};
+
+// SHA-1 of the relative paths, sizes and contents of the files under rootDirectory, in sorted order of the paths
+RENDER_ENGINE_EXPORT_API QByteArray hashSceneFiles(const QString & rootDirectory, QStringList relativePaths);
+// Relative paths must stay below the directory they are relative to, since servers write them to disk
+RENDER_ENGINE_EXPORT_API bool isSafeScenePath(const QString & relativePath);
+
+class QDataStream;
+RENDER_ENGINE_EXPORT_API QDataStream & operator << (QDataStream & out, const SceneTransferMessage & message);
+RENDER_ENGINE_EXPORT_API QDataStream & operator >> (QDataStream & in, SceneTransferMessage & message);
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "SceneTransferSender.h"
+#include <QFileInfo>
+#include <stdexcept>
+
+SceneTransferSender::SceneTransferSender( const QStringList & sceneFiles, int chunkSize ) :
+    m_totalSize(0),
+    m_chunkSize(chunkSize),
+    m_fileIndex(0),
+    m_done(false)
+{
+    if(sceneFiles.isEmpty())
+    {
+        throw std::invalid_argument("SceneTransferSender: no scene file.");
+    }
+
+    QFileInfo sceneFile(sceneFiles.first());
+    m_sceneDirectory = sceneFile.absoluteDir();
+    m_sceneFile = sceneFile.fileName();
+    for(int i = 0; i < sceneFiles.size(); ++i)
+    {
+        QFileInfo file(sceneFiles[i]);
+        QString relativePath = m_sceneDirectory.relativeFilePath(file.absoluteFilePath());
+        if(!isSafeScenePath(relativePath))
+        {
+            throw std::invalid_argument(QString("SceneTransferSender: %1 is not below the directory of the scene.")
+                .arg(sceneFiles[i]).toLatin1().constData());
+        }
+        if(!file.exists())
+        {
+            throw std::invalid_argument(QString("SceneTransferSender: %1 does not exist.").arg(sceneFiles[i]).toLatin1().constData());
+        }
+        if(m_relativePaths.contains(relativePath))
+        {
+            continue;
+        }
+        m_relativePaths.append(relativePath);
+        m_totalSize += file.size();
+    }
+
+    m_sceneHash = hashSceneFiles(m_sceneDirectory.absolutePath(), m_relativePaths);
+    if(m_sceneHash.isEmpty())
+    {
+        throw std::invalid_argument("SceneTransferSender: could not read the scene files.");
+    }
+}
+
+const QByteArray & SceneTransferSender::getSceneHash() const
+{
+    return m_sceneHash;
+}
+
+SceneTransferMessage SceneTransferSender::createQuery() const
+{
+    return SceneTransferMessage(SceneTransferMessageType::QUERY, m_sceneHash, m_sceneFile, 0, m_totalSize);
+}
+
+bool SceneTransferSender::getNextMessage( SceneTransferMessage & message )
+{
+    if(m_done)
+    {
+        return false;
+    }
+
+    if(m_fileIndex == m_relativePaths.size())
+    {
+        message = SceneTransferMessage(SceneTransferMessageType::TRANSFER_DONE, m_sceneHash);
+        m_done = true;
+        return true;
+    }
+
+    if(!m_file.isOpen())
+    {
+        m_file.setFileName(m_sceneDirectory.filePath(m_relativePaths[m_fileIndex]));
+        if(!m_file.open(QIODevice::ReadOnly))
+        {
+            throw std::exception(QString("SceneTransferSender: could not open %1.").arg(m_file.fileName()).toLatin1().constData());
+        }
+    }
+
+    // Empty files are sent as a single empty chunk so that the server creates them
+    qint64 offset = m_file.pos();
+    QByteArray data = m_file.read(m_chunkSize);
+    message = SceneTransferMessage(SceneTransferMessageType::FILE_CHUNK, m_sceneHash, m_relativePaths[m_fileIndex], offset,
+        m_file.size(), data);
+    if(m_file.atEnd())
+    {
+        m_file.close();
+        m_fileIndex++;
+    }
+    return true;
+}
+
+void SceneTransferSender::restart()
+{
+    m_file.close();
+    m_fileIndex = 0;
+    m_done = false;
+}
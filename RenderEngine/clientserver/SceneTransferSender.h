@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include "render_engine_export_api.h"
+#include "SceneTransferMessage.h"
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+
+/*
+Client side of the scene transfer. Send createQuery to a server, and when it answers CACHE_MISS send the messages
+of getNextMessage until it returns false. Files are read one chunk at a time. Each server that misses needs its own
+sender, or a call to restart in between.
+*/
+
+class SceneTransferSender
+{
+public:
+    // sceneFiles are absolute paths of the scene file and the files it uses, as in Scene::getSceneFiles
+    RENDER_ENGINE_EXPORT_API SceneTransferSender(const QStringList & sceneFiles, int chunkSize = 1 << 20);
+    RENDER_ENGINE_EXPORT_API const QByteArray & getSceneHash() const;
+    RENDER_ENGINE_EXPORT_API SceneTransferMessage createQuery() const;
+    RENDER_ENGINE_EXPORT_API bool getNextMessage(SceneTransferMessage & message);
+    RENDER_ENGINE_EXPORT_API void restart();
+
+private:
+    QDir m_sceneDirectory;
+    QString m_sceneFile;
+    QStringList m_relativePaths;
+    QByteArray m_sceneHash;
+    qint64 m_totalSize;
+    int m_chunkSize;
+    int m_fileIndex;
+    QFile m_file;
+    bool m_done;
+};
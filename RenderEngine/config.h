@@ -17,12 +17,22 @@
 #define ACCELERATION_STRUCTURE_STOCHASTIC_HASH 2
 #define ACCELERATION_STRUCTURE (ACCELERATION_STRUCTURE_UNIFORM_GRID)
 
+// Order the uniform grid cells along a Morton (Z-order) curve instead of x + y*sx + z*sx*sy, so that
+// cells close in all three axes are close in the sorted photon array and the offset table
+#define ENABLE_PHOTON_GRID_MORTON_ORDER 0
+
 #if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_STOCHASTIC_HASH
 #define MAX_PHOTONS_DEPOSITS_PER_EMITTED 1
 #else
 #define MAX_PHOTONS_DEPOSITS_PER_EMITTED 4
 #endif
 
+// Keep the imported and normalized scene in a binary file next to the scene file (see SceneCache)
+#define ENABLE_SCENE_CACHE 1
+
+// Log the area of every scene node while loading the scene
+#define ENABLE_SCENE_NODE_AREA_LOG 0
+
 #define ENABLE_RENDER_DEBUG_OUTPUT 1
 #define ENABLE_PARTICIPATING_MEDIA 0
 
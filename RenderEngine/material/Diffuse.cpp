@@ -48,3 +48,14 @@ Material* Diffuse::clone()
 {
 	return new Diffuse(*this);
 }
+
+HostMaterial Diffuse::getHostMaterial() const
+{
+    HostMaterial material;
+    material.type = HostMaterialType::DIFFUSE;
+    material.Kd = Kd;
+    material.Kr = optix::make_float3(0.f);
+    material.indexOfRefraction = 1.f;
+    material.power = optix::make_float3(0.f);
+    return material;
+}
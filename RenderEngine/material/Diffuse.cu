@@ -31,6 +31,9 @@ rtDeclareVariable(float3, shadingNormal, attribute shadingNormal, );
 
 rtDeclareVariable(uint, storefirstHitPhotons, ,);
 rtBuffer<Photon, 1> photons;
+rtDeclareVariable(uint, photonStatisticsOnly, , );
+rtBuffer<unsigned int, 1> hitCount;
+rtBuffer<float, 1> rawRadiance;
 rtBuffer<Hitpoint, 2> raytracePassOutputBuffer;
 rtDeclareVariable(rtObject, sceneRootObject, , );
 rtDeclareVariable(uint, maxPhotonDepositsPerEmitted, , );
@@ -19,4 +19,5 @@ public:
     virtual optix::Material getOptixMaterial(optix::Context & context, bool useHoleCheckProgram);
     virtual void registerGeometryInstanceValues(optix::GeometryInstance & instance);
 	virtual Material* clone();
+	virtual HostMaterial getHostMaterial() const;
 };
\ No newline at end of file
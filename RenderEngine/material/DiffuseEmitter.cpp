@@ -67,3 +67,14 @@ Material* DiffuseEmitter::clone()
 {
 	return new DiffuseEmitter(*this);
 }
+
+HostMaterial DiffuseEmitter::getHostMaterial() const
+{
+    HostMaterial material;
+    material.type = HostMaterialType::DIFFUSE_EMITTER;
+    material.Kd = m_Kd;
+    material.Kr = optix::make_float3(0.f);
+    material.indexOfRefraction = 1.f;
+    material.power = m_power;
+    return material;
+}
@@ -23,4 +23,5 @@ public:
     Vector3 getPower() const;
     void setInverseArea(float inverseArea);
 	virtual Material* clone();
+	virtual HostMaterial getHostMaterial() const;
 };
\ No newline at end of file
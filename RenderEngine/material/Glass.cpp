@@ -59,3 +59,14 @@ Material* Glass::clone()
 {
 	return new Glass(*this);
 }
+
+HostMaterial Glass::getHostMaterial() const
+{
+    HostMaterial material;
+    material.type = HostMaterialType::GLASS;
+    material.Kd = optix::make_float3(0.f);
+    material.Kr = Ks;
+    material.indexOfRefraction = indexOfRefraction;
+    material.power = optix::make_float3(0.f);
+    return material;
+}
@@ -50,3 +50,14 @@ Material* Hole::clone()
 {
 	return new Hole(*this);
 }
+
+HostMaterial Hole::getHostMaterial() const
+{
+    HostMaterial material;
+    material.type = HostMaterialType::HOLE;
+    material.Kd = optix::make_float3(0.f);
+    material.Kr = optix::make_float3(0.f);
+    material.indexOfRefraction = 1.f;
+    material.power = optix::make_float3(0.f);
+    return material;
+}
@@ -18,4 +18,5 @@ public:
     virtual optix::Material getOptixMaterial(optix::Context & context, bool useHoleCheckProgram);
     virtual void registerGeometryInstanceValues(optix::GeometryInstance & instance);
 	virtual Material* clone();
+	virtual HostMaterial getHostMaterial() const;
 };
\ No newline at end of file
@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <optixu/optixu_math_namespace.h>
+
+namespace HostMaterialType
+{
+    enum E {DIFFUSE, DIFFUSE_EMITTER, GLASS, HOLE, MIRROR, TEXTURE, PARTICIPATING_MEDIUM};
+}
+
+/*
+  Parameters of a material for the host photon tracer, mirroring the variables its photon programs
+  read, plus the power of emitters. Textures are reduced to their average texel color in Kd.
+*/
+struct HostMaterial
+{
+    HostMaterialType::E type;
+    optix::float3 Kd;
+    optix::float3 Kr;
+    float indexOfRefraction;
+    optix::float3 power;
+};
@@ -6,6 +6,7 @@
 
 #pragma once
 #include <optixu/optixpp_namespace.h>
+#include "HostMaterial.h"
 class Material
 {
 public:
@@ -13,6 +14,7 @@ public:
     virtual ~Material();
     virtual optix::Material getOptixMaterial(optix::Context & context, bool useHoleCheckProgram) = 0;
 	virtual Material* clone() = 0;
+	virtual HostMaterial getHostMaterial() const = 0;
 	void registerInstanceValues(optix::GeometryInstance & instance);
 
 	void setObjectId(unsigned int objectId);
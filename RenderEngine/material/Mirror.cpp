@@ -42,3 +42,14 @@ Material* Mirror::clone()
 {
 	return new Mirror(*this);
 }
+
+HostMaterial Mirror::getHostMaterial() const
+{
+    HostMaterial material;
+    material.type = HostMaterialType::MIRROR;
+    material.Kd = optix::make_float3(0.f);
+    material.Kr = Kr;
+    material.indexOfRefraction = 1.f;
+    material.power = optix::make_float3(0.f);
+    return material;
+}
@@ -15,6 +15,7 @@ public:
     virtual optix::Material getOptixMaterial(optix::Context & context, bool useHoleCheckProgram);
     virtual void registerGeometryInstanceValues(optix::GeometryInstance & instance);
 	virtual Material* clone();
+	virtual HostMaterial getHostMaterial() const;
 private:
     Vector3 Kr;
     static bool m_optixMaterialIsCreated;
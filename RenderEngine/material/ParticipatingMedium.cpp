@@ -53,4 +53,15 @@ void ParticipatingMedium::registerGeometryInstanceValues(optix::GeometryInstance
 Material* ParticipatingMedium::clone()
 {
 	return new ParticipatingMedium(*this);
-}
\ No newline at end of file
+}
+
+HostMaterial ParticipatingMedium::getHostMaterial() const
+{
+    HostMaterial material;
+    material.type = HostMaterialType::PARTICIPATING_MEDIUM;
+    material.Kd = optix::make_float3(0.f);
+    material.Kr = optix::make_float3(0.f);
+    material.indexOfRefraction = 1.f;
+    material.power = optix::make_float3(0.f);
+    return material;
+}
@@ -171,7 +171,7 @@ RT_PROGRAM void closestHitPhoton()
         //if(photonPrd.numStoredPhotons < maxPhotonDepositsPerEmitted)
         {
             int volumetricPhotonIdx = photonPrd.pm_index % NUM_VOLUMETRIC_PHOTONS;
-            volumetricPhotons[volumetricPhotonIdx].power = photonPrd.power;
+            volumetricPhotons[volumetricPhotonIdx].power = encodeRGBE(photonPrd.power);
             volumetricPhotons[volumetricPhotonIdx].position = scatterPosition;
             atomicAdd(&volumetricPhotons[volumetricPhotonIdx].numDeposits, 1);
         }
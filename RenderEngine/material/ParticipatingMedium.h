@@ -14,6 +14,7 @@ public:
     virtual optix::Material getOptixMaterial(optix::Context & context, bool useHoleCheckProgram);
     virtual void registerGeometryInstanceValues(optix::GeometryInstance & instance);
 	virtual Material* clone();
+	virtual HostMaterial getHostMaterial() const;
 private:
     //float indexOfRefraction;
     static bool m_optixMaterialIsCreated;
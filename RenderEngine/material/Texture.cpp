@@ -140,4 +140,26 @@ optix::Buffer Texture::createBufferFromImage(optix::Context & context, const Ima
 Material* Texture::clone()
 {
 	return new Texture(*this);
-}
\ No newline at end of file
+}
+
+HostMaterial Texture::getHostMaterial() const
+{
+    // The host tracer does not filter textures, so use the average texel color
+    double sum[3] = {0, 0, 0};
+    const unsigned char* texels = m_diffuseImage->constData();
+    unsigned int numTexels = m_diffuseImage->getWidth()*m_diffuseImage->getHeight();
+    for(unsigned int i = 0; i < numTexels; i++)
+    {
+        sum[0] += texels[4*i];
+        sum[1] += texels[4*i+1];
+        sum[2] += texels[4*i+2];
+    }
+
+    HostMaterial material;
+    material.type = HostMaterialType::TEXTURE;
+    material.Kd = optix::make_float3((float)sum[0], (float)sum[1], (float)sum[2]) / (255.f*numTexels);
+    material.Kr = optix::make_float3(0.f);
+    material.indexOfRefraction = 1.f;
+    material.power = optix::make_float3(0.f);
+    return material;
+}
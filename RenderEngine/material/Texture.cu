@@ -33,6 +33,9 @@ rtDeclareVariable(float2, textureCoordinate, attribute textureCoordinate, );
 
 rtDeclareVariable(uint, storefirstHitPhotons, ,);
 rtBuffer<Photon, 1> photons;
+rtDeclareVariable(uint, photonStatisticsOnly, , );
+rtBuffer<unsigned int, 1> hitCount;
+rtBuffer<float, 1> rawRadiance;
 rtTextureSampler<uchar4, 2, cudaReadModeNormalizedFloat> diffuseSampler;
 rtTextureSampler<uchar4, 2, cudaReadModeNormalizedFloat> normalMapSampler;
 rtDeclareVariable(unsigned int, hasNormals, , );
@@ -0,0 +1,470 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "HostBVH.h"
+#include <algorithm>
+#include <limits>
+#include <emmintrin.h>
+
+using namespace optix;
+
+static const unsigned int MAX_LEAF_TRIANGLES = 4;
+static const unsigned int MAX_BUILD_DEPTH = 60;
+static const int SAH_BINS = 16;
+
+static float surfaceArea(const float3 & bbmin, const float3 & bbmax)
+{
+    float3 extent = bbmax - bbmin;
+    return 2.f*(extent.x*extent.y + extent.y*extent.z + extent.z*extent.x);
+}
+
+static float getAxis(const float3 & v, int axis)
+{
+    return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+}
+
+HostBVH::HostBVH()
+{
+}
+
+void HostBVH::build(const std::vector<float3> & vertices)
+{
+    build(vertices, std::vector<unsigned int>(vertices.size()/3, 0));
+}
+
+void HostBVH::build(const std::vector<float3> & vertices, const std::vector<unsigned int> & objectIds)
+{
+    unsigned int numTriangles = (unsigned int)(vertices.size()/3);
+
+    m_nodes.clear();
+    m_leaves.clear();
+
+    // Leave out degenerate triangles, which OptiX never reports hits on either
+    std::vector<float3> centroids(numTriangles);
+    std::vector<float3> triangleMin(numTriangles);
+    std::vector<float3> triangleMax(numTriangles);
+    std::vector<unsigned int> triangles;
+    triangles.reserve(numTriangles);
+    for(unsigned int i = 0; i < numTriangles; i++)
+    {
+        const float3 & p0 = vertices[3*i];
+        const float3 & p1 = vertices[3*i+1];
+        const float3 & p2 = vertices[3*i+2];
+        float area = length(cross(p1 - p0, p2 - p0));
+        triangleMin[i] = fminf(fminf(p0, p1), p2);
+        triangleMax[i] = fmaxf(fmaxf(p0, p1), p2);
+        centroids[i] = (triangleMin[i] + triangleMax[i])*0.5f;
+        if(area > 0.0f && area <= std::numeric_limits<float>::max())
+        {
+            triangles.push_back(i);
+        }
+    }
+
+    if(triangles.empty())
+    {
+        return;
+    }
+
+    std::vector<BuildNode> buildNodes;
+    buildNodes.reserve(2*triangles.size());
+    buildNode(buildNodes, triangles, 0, (unsigned int)triangles.size(), 0, centroids, triangleMin, triangleMax);
+
+    m_nodes.reserve(buildNodes.size()/2 + 1);
+    m_leaves.reserve(triangles.size()/2 + 1);
+    collapseNode(buildNodes, 0, triangles, vertices, objectIds);
+}
+
+void HostBVH::buildNode(std::vector<BuildNode> & buildNodes, std::vector<unsigned int> & triangles, unsigned int from, unsigned int to,
+                        unsigned int depth, const std::vector<float3> & centroids,
+                        const std::vector<float3> & triangleMin, const std::vector<float3> & triangleMax)
+{
+    unsigned int nodeIndex = (unsigned int)buildNodes.size();
+    buildNodes.push_back(BuildNode());
+
+    float3 bbmin = make_float3(std::numeric_limits<float>::max());
+    float3 bbmax = make_float3(-std::numeric_limits<float>::max());
+    float3 centroidMin = bbmin;
+    float3 centroidMax = bbmax;
+    for(unsigned int i = from; i < to; i++)
+    {
+        unsigned int triangle = triangles[i];
+        bbmin = fminf(bbmin, triangleMin[triangle]);
+        bbmax = fmaxf(bbmax, triangleMax[triangle]);
+        centroidMin = fminf(centroidMin, centroids[triangle]);
+        centroidMax = fmaxf(centroidMax, centroids[triangle]);
+    }
+    buildNodes[nodeIndex].bbmin = bbmin;
+    buildNodes[nodeIndex].bbmax = bbmax;
+
+    unsigned int count = to - from;
+    float3 centroidExtent = centroidMax - centroidMin;
+    int axis = centroidExtent.x > centroidExtent.y ? (centroidExtent.x > centroidExtent.z ? 0 : 2) : (centroidExtent.y > centroidExtent.z ? 1 : 2);
+    float axisMin = getAxis(centroidMin, axis);
+    float axisExtent = getAxis(centroidExtent, axis);
+
+    if(count <= MAX_LEAF_TRIANGLES || depth >= MAX_BUILD_DEPTH)
+    {
+        buildNodes[nodeIndex].offset = from;
+        buildNodes[nodeIndex].numTriangles = count;
+        return;
+    }
+
+    //
+    // Bin the centroids along the longest axis and pick the split with the lowest SAH cost
+    //
+
+    unsigned int binCount[SAH_BINS] = {0};
+    float3 binMin[SAH_BINS];
+    float3 binMax[SAH_BINS];
+    for(int bin = 0; bin < SAH_BINS; bin++)
+    {
+        binMin[bin] = make_float3(std::numeric_limits<float>::max());
+        binMax[bin] = make_float3(-std::numeric_limits<float>::max());
+    }
+
+    // Without extent every centroid lands in the first bin, which falls back to a median split
+    float binScale = axisExtent > 0.0f ? SAH_BINS*0.99999f/axisExtent : 0.0f;
+    for(unsigned int i = from; i < to; i++)
+    {
+        unsigned int triangle = triangles[i];
+        int bin = (int)((getAxis(centroids[triangle], axis) - axisMin)*binScale);
+        binCount[bin]++;
+        binMin[bin] = fminf(binMin[bin], triangleMin[triangle]);
+        binMax[bin] = fmaxf(binMax[bin], triangleMax[triangle]);
+    }
+
+    float rightArea[SAH_BINS];
+    unsigned int rightCount[SAH_BINS];
+    {
+        float3 accumulatedMin = make_float3(std::numeric_limits<float>::max());
+        float3 accumulatedMax = make_float3(-std::numeric_limits<float>::max());
+        unsigned int accumulatedCount = 0;
+        for(int bin = SAH_BINS-1; bin > 0; bin--)
+        {
+            accumulatedMin = fminf(accumulatedMin, binMin[bin]);
+            accumulatedMax = fmaxf(accumulatedMax, binMax[bin]);
+            accumulatedCount += binCount[bin];
+            rightArea[bin] = accumulatedCount > 0 ? surfaceArea(accumulatedMin, accumulatedMax) : 0.0f;
+            rightCount[bin] = accumulatedCount;
+        }
+    }
+
+    int bestSplit = -1;
+    float bestCost = std::numeric_limits<float>::max();
+    {
+        float3 accumulatedMin = make_float3(std::numeric_limits<float>::max());
+        float3 accumulatedMax = make_float3(-std::numeric_limits<float>::max());
+        unsigned int accumulatedCount = 0;
+        for(int split = 1; split < SAH_BINS; split++)
+        {
+            accumulatedMin = fminf(accumulatedMin, binMin[split-1]);
+            accumulatedMax = fmaxf(accumulatedMax, binMax[split-1]);
+            accumulatedCount += binCount[split-1];
+            if(accumulatedCount == 0 || rightCount[split] == 0)
+            {
+                continue;
+            }
+            float cost = accumulatedCount*surfaceArea(accumulatedMin, accumulatedMax) + rightCount[split]*rightArea[split];
+            if(cost < bestCost)
+            {
+                bestCost = cost;
+                bestSplit = split;
+            }
+        }
+    }
+
+    unsigned int middle;
+    if(bestSplit < 0)
+    {
+        middle = from + count/2;
+        std::nth_element(triangles.begin() + from, triangles.begin() + middle, triangles.begin() + to, [&](unsigned int a, unsigned int b)
+        {
+            return getAxis(centroids[a], axis) < getAxis(centroids[b], axis);
+        });
+    }
+    else
+    {
+        auto it = std::partition(triangles.begin() + from, triangles.begin() + to, [&](unsigned int triangle)
+        {
+            return (int)((getAxis(centroids[triangle], axis) - axisMin)*binScale) < bestSplit;
+        });
+        middle = (unsigned int)(it - triangles.begin());
+    }
+
+    buildNodes[nodeIndex].numTriangles = 0;
+    buildNode(buildNodes, triangles, from, middle, depth + 1, centroids, triangleMin, triangleMax);
+    buildNodes[nodeIndex].offset = (unsigned int)buildNodes.size();
+    buildNode(buildNodes, triangles, middle, to, depth + 1, centroids, triangleMin, triangleMax);
+}
+
+static void setChildBounds(float* bbminX, float* bbminY, float* bbminZ, float* bbmaxX, float* bbmaxY, float* bbmaxZ, int slot,
+                           const float3 & bbmin, const float3 & bbmax)
+{
+    bbminX[slot] = bbmin.x;
+    bbminY[slot] = bbmin.y;
+    bbminZ[slot] = bbmin.z;
+    bbmaxX[slot] = bbmax.x;
+    bbmaxY[slot] = bbmax.y;
+    bbmaxZ[slot] = bbmax.z;
+}
+
+/*
+// Makes a 4-wide node from a binary node by opening the inner node with the largest surface area among
+// its descendants until there are four of them, and collapses the chosen descendants the same way
+*/
+unsigned int HostBVH::collapseNode(const std::vector<BuildNode> & buildNodes, unsigned int buildNodeIndex, const std::vector<unsigned int> & triangles,
+                                   const std::vector<float3> & vertices, const std::vector<unsigned int> & objectIds)
+{
+    unsigned int children[4] = {buildNodeIndex};
+    int numChildren = 1;
+    while(numChildren < 4)
+    {
+        int largest = -1;
+        float largestArea = -1.0f;
+        for(int i = 0; i < numChildren; i++)
+        {
+            const BuildNode & child = buildNodes[children[i]];
+            float area = surfaceArea(child.bbmin, child.bbmax);
+            if(child.numTriangles == 0 && area > largestArea)
+            {
+                largest = i;
+                largestArea = area;
+            }
+        }
+        if(largest < 0)
+        {
+            break;
+        }
+        unsigned int opened = children[largest];
+        children[largest] = opened + 1;
+        children[numChildren++] = buildNodes[opened].offset;
+    }
+
+    unsigned int nodeIndex = (unsigned int)m_nodes.size();
+    m_nodes.push_back(Node());
+    for(int slot = 0; slot < 4; slot++)
+    {
+        Node & node = m_nodes[nodeIndex];
+        if(slot >= numChildren)
+        {
+            setChildBounds(node.bbminX, node.bbminY, node.bbminZ, node.bbmaxX, node.bbmaxY, node.bbmaxZ, slot, make_float3(0.0f), make_float3(0.0f));
+            node.child[slot] = EMPTY_CHILD;
+            continue;
+        }
+
+        const BuildNode & child = buildNodes[children[slot]];
+        setChildBounds(node.bbminX, node.bbminY, node.bbminZ, node.bbmaxX, node.bbmaxY, node.bbmaxZ, slot, child.bbmin, child.bbmax);
+        // Children push nodes, so m_nodes[nodeIndex] is looked up again after them
+        unsigned int childIndex = child.numTriangles > 0 ?
+            createLeaf(child.offset, child.offset + child.numTriangles, triangles, vertices, objectIds) :
+            collapseNode(buildNodes, children[slot], triangles, vertices, objectIds);
+        m_nodes[nodeIndex].child[slot] = childIndex;
+    }
+    return nodeIndex;
+}
+
+/*
+// Leaves built at MAX_BUILD_DEPTH can have more than four triangles, those become 4-wide nodes over
+// groups of the triangles
+*/
+unsigned int HostBVH::createLeaf(unsigned int from, unsigned int to, const std::vector<unsigned int> & triangles,
+                                 const std::vector<float3> & vertices, const std::vector<unsigned int> & objectIds)
+{
+    unsigned int count = to - from;
+    if(count > 4)
+    {
+        unsigned int nodeIndex = (unsigned int)m_nodes.size();
+        m_nodes.push_back(Node());
+        unsigned int groupSize = (count + 3)/4;
+        for(int slot = 0; slot < 4; slot++)
+        {
+            unsigned int groupFrom = std::min(to, from + slot*groupSize);
+            unsigned int groupTo = std::min(to, groupFrom + groupSize);
+            float3 bbmin = make_float3(0.0f);
+            float3 bbmax = make_float3(0.0f);
+            unsigned int childIndex = EMPTY_CHILD;
+            if(groupFrom < groupTo)
+            {
+                bbmin = make_float3(std::numeric_limits<float>::max());
+                bbmax = make_float3(-std::numeric_limits<float>::max());
+                for(unsigned int i = groupFrom; i < groupTo; i++)
+                {
+                    for(unsigned int vertex = 0; vertex < 3; vertex++)
+                    {
+                        bbmin = fminf(bbmin, vertices[3*triangles[i]+vertex]);
+                        bbmax = fmaxf(bbmax, vertices[3*triangles[i]+vertex]);
+                    }
+                }
+                childIndex = createLeaf(groupFrom, groupTo, triangles, vertices, objectIds);
+            }
+            Node & node = m_nodes[nodeIndex];
+            setChildBounds(node.bbminX, node.bbminY, node.bbminZ, node.bbmaxX, node.bbmaxY, node.bbmaxZ, slot, bbmin, bbmax);
+            node.child[slot] = childIndex;
+        }
+        return nodeIndex;
+    }
+
+    unsigned int leafIndex = (unsigned int)m_leaves.size();
+    m_leaves.push_back(Leaf());
+    Leaf & leaf = m_leaves.back();
+    for(unsigned int lane = 0; lane < 4; lane++)
+    {
+        unsigned int triangle = triangles[from + std::min(lane, count - 1)];
+        const float3 & p0 = vertices[3*triangle];
+        const float3 & p1 = vertices[3*triangle+1];
+        const float3 & p2 = vertices[3*triangle+2];
+        float3 e0 = p1 - p0;
+        float3 e1 = p0 - p2;
+        float3 n = cross(e1, e0);
+        leaf.p0X[lane] = p0.x; leaf.p0Y[lane] = p0.y; leaf.p0Z[lane] = p0.z;
+        leaf.e0X[lane] = e0.x; leaf.e0Y[lane] = e0.y; leaf.e0Z[lane] = e0.z;
+        leaf.e1X[lane] = e1.x; leaf.e1Y[lane] = e1.y; leaf.e1Z[lane] = e1.z;
+        leaf.nX[lane] = n.x; leaf.nY[lane] = n.y; leaf.nZ[lane] = n.z;
+        leaf.triangle[lane] = triangle;
+        leaf.objectId[lane] = objectIds[triangle];
+    }
+    return LEAF_CHILD | leafIndex;
+}
+
+/*
+// Traverses the nodes nearest box first. The triangle test does the same operations in the same order as
+// intersect_triangle in the OptiX math headers, four triangles at a time, so that both tracers agree on hits.
+*/
+bool HostBVH::intersect(const float3 & origin, const float3 & direction, float tmin, float tmax, HostRayHit & hit) const
+{
+    if(m_nodes.empty())
+    {
+        return false;
+    }
+
+    const __m128 originX = _mm_set1_ps(origin.x);
+    const __m128 originY = _mm_set1_ps(origin.y);
+    const __m128 originZ = _mm_set1_ps(origin.z);
+    const __m128 directionX = _mm_set1_ps(direction.x);
+    const __m128 directionY = _mm_set1_ps(direction.y);
+    const __m128 directionZ = _mm_set1_ps(direction.z);
+    const __m128 invDirectionX = _mm_set1_ps(1.0f/direction.x);
+    const __m128 invDirectionY = _mm_set1_ps(1.0f/direction.y);
+    const __m128 invDirectionZ = _mm_set1_ps(1.0f/direction.z);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 tminV = _mm_set1_ps(tmin);
+    bool found = false;
+
+    struct StackEntry
+    {
+        unsigned int child;
+        float tenter;
+    };
+    const unsigned int STACK_SIZE = 256;
+    StackEntry stack[STACK_SIZE];
+    unsigned int stackSize = 0;
+    stack[stackSize].child = 0;
+    stack[stackSize++].tenter = tmin;
+
+    while(stackSize > 0)
+    {
+        StackEntry entry = stack[--stackSize];
+        if(entry.tenter > tmax)
+        {
+            continue;
+        }
+
+        if(entry.child & LEAF_CHILD)
+        {
+            const Leaf & leaf = m_leaves[entry.child & ~LEAF_CHILD];
+            __m128 p0X = _mm_loadu_ps(leaf.p0X), p0Y = _mm_loadu_ps(leaf.p0Y), p0Z = _mm_loadu_ps(leaf.p0Z);
+            __m128 e0X = _mm_loadu_ps(leaf.e0X), e0Y = _mm_loadu_ps(leaf.e0Y), e0Z = _mm_loadu_ps(leaf.e0Z);
+            __m128 e1X = _mm_loadu_ps(leaf.e1X), e1Y = _mm_loadu_ps(leaf.e1Y), e1Z = _mm_loadu_ps(leaf.e1Z);
+            __m128 nX = _mm_loadu_ps(leaf.nX), nY = _mm_loadu_ps(leaf.nY), nZ = _mm_loadu_ps(leaf.nZ);
+
+            // e2 = (1.0f/dot(n, direction))*(p0 - origin)
+            __m128 nDotDirection = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nX, directionX), _mm_mul_ps(nY, directionY)), _mm_mul_ps(nZ, directionZ));
+            __m128 scale = _mm_div_ps(one, nDotDirection);
+            __m128 e2X = _mm_mul_ps(scale, _mm_sub_ps(p0X, originX));
+            __m128 e2Y = _mm_mul_ps(scale, _mm_sub_ps(p0Y, originY));
+            __m128 e2Z = _mm_mul_ps(scale, _mm_sub_ps(p0Z, originZ));
+
+            // i = cross(direction, e2)
+            __m128 iX = _mm_sub_ps(_mm_mul_ps(directionY, e2Z), _mm_mul_ps(directionZ, e2Y));
+            __m128 iY = _mm_sub_ps(_mm_mul_ps(directionZ, e2X), _mm_mul_ps(directionX, e2Z));
+            __m128 iZ = _mm_sub_ps(_mm_mul_ps(directionX, e2Y), _mm_mul_ps(directionY, e2X));
+
+            __m128 beta = _mm_add_ps(_mm_add_ps(_mm_mul_ps(iX, e1X), _mm_mul_ps(iY, e1Y)), _mm_mul_ps(iZ, e1Z));
+            __m128 gamma = _mm_add_ps(_mm_add_ps(_mm_mul_ps(iX, e0X), _mm_mul_ps(iY, e0Y)), _mm_mul_ps(iZ, e0Z));
+            __m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nX, e2X), _mm_mul_ps(nY, e2Y)), _mm_mul_ps(nZ, e2Z));
+
+            __m128 valid = _mm_and_ps(_mm_cmplt_ps(t, _mm_set1_ps(tmax)), _mm_cmpgt_ps(t, tminV));
+            valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(beta, zero), _mm_cmpge_ps(gamma, zero)));
+            valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(beta, gamma), one));
+            int validMask = _mm_movemask_ps(valid);
+            if(validMask)
+            {
+                float tLanes[4], betaLanes[4], gammaLanes[4];
+                _mm_storeu_ps(tLanes, t);
+                _mm_storeu_ps(betaLanes, beta);
+                _mm_storeu_ps(gammaLanes, gamma);
+                for(int lane = 0; lane < 4; lane++)
+                {
+                    if((validMask & (1 << lane)) && tLanes[lane] < tmax)
+                    {
+                        tmax = tLanes[lane];
+                        hit.triangle = leaf.triangle[lane];
+                        hit.objectId = leaf.objectId[lane];
+                        hit.t = tLanes[lane];
+                        hit.beta = betaLanes[lane];
+                        hit.gamma = gammaLanes[lane];
+                        found = true;
+                    }
+                }
+            }
+            continue;
+        }
+
+        // Slab test of the four child boxes. _mm_min_ps and _mm_max_ps return their second operand when
+        // either is NaN (zero direction components on a box face), so the ray limits go second.
+        const Node & node = m_nodes[entry.child];
+        __m128 t0X = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bbminX), originX), invDirectionX);
+        __m128 t1X = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bbmaxX), originX), invDirectionX);
+        __m128 t0Y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bbminY), originY), invDirectionY);
+        __m128 t1Y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bbmaxY), originY), invDirectionY);
+        __m128 t0Z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bbminZ), originZ), invDirectionZ);
+        __m128 t1Z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bbmaxZ), originZ), invDirectionZ);
+        __m128 tenter = _mm_max_ps(_mm_min_ps(t0X, t1X), _mm_max_ps(_mm_min_ps(t0Y, t1Y), _mm_max_ps(_mm_min_ps(t0Z, t1Z), tminV)));
+        __m128 texit = _mm_min_ps(_mm_max_ps(t0X, t1X), _mm_min_ps(_mm_max_ps(t0Y, t1Y), _mm_min_ps(_mm_max_ps(t0Z, t1Z), _mm_set1_ps(tmax))));
+        int hitMask = _mm_movemask_ps(_mm_cmple_ps(tenter, texit));
+        if(!hitMask)
+        {
+            continue;
+        }
+
+        float tenterLanes[4];
+        _mm_storeu_ps(tenterLanes, tenter);
+
+        // Push the hit children farthest first so that the nearest one is popped next
+        StackEntry hitChildren[4];
+        int numHitChildren = 0;
+        for(int slot = 0; slot < 4; slot++)
+        {
+            if((hitMask & (1 << slot)) && node.child[slot] != EMPTY_CHILD)
+            {
+                StackEntry child = {node.child[slot], tenterLanes[slot]};
+                int i = numHitChildren++;
+                for(; i > 0 && hitChildren[i-1].tenter < child.tenter; i--)
+                {
+                    hitChildren[i] = hitChildren[i-1];
+                }
+                hitChildren[i] = child;
+            }
+        }
+        for(int i = 0; i < numHitChildren; i++)
+        {
+            stack[stackSize++] = hitChildren[i];
+        }
+    }
+
+    return found;
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+
+#include <vector>
+#include <optixu/optixu_math_namespace.h>
+#include "render_engine_export_api.h"
+
+struct HostRayHit
+{
+    unsigned int triangle;
+    // Object id of the hit triangle, as set with Material::setObjectId on the device
+    unsigned int objectId;
+    float t;
+    float beta;
+    float gamma;
+};
+
+/*
+  Bounding volume hierarchy over world space triangles (three vertices each) for tracing rays on the
+  host. It is built with binned SAH splits and then collapsed into 4-wide nodes, so that a node tests
+  its four child boxes at once with SSE. Leaves hold up to four triangles, also tested together.
+*/
+class HostBVH
+{
+public:
+    RENDER_ENGINE_EXPORT_API HostBVH();
+    RENDER_ENGINE_EXPORT_API void build(const std::vector<optix::float3> & vertices);
+    // Same as build, with the object id reported for each triangle hit
+    RENDER_ENGINE_EXPORT_API void build(const std::vector<optix::float3> & vertices, const std::vector<unsigned int> & objectIds);
+
+    // Finds the closest triangle hit in (tmin, tmax)
+    RENDER_ENGINE_EXPORT_API bool intersect(const optix::float3 & origin, const optix::float3 & direction, float tmin, float tmax, HostRayHit & hit) const;
+
+private:
+    struct BuildNode
+    {
+        optix::float3 bbmin;
+        optix::float3 bbmax;
+        // First triangle for leaves, right child for inner nodes
+        unsigned int offset;
+        // Number of triangles for leaves, 0 for inner nodes
+        unsigned int numTriangles;
+    };
+
+    // Four child boxes in structure of arrays layout
+    struct Node
+    {
+        float bbminX[4];
+        float bbminY[4];
+        float bbminZ[4];
+        float bbmaxX[4];
+        float bbmaxY[4];
+        float bbmaxZ[4];
+        // Node index for inner children, LEAF_CHILD | leaf index for leaves, EMPTY_CHILD for unused slots
+        unsigned int child[4];
+    };
+
+    // Four triangles as the values intersect_triangle computes from their vertices. Leaves with less
+    // than four triangles repeat the last one.
+    struct Leaf
+    {
+        float p0X[4], p0Y[4], p0Z[4];
+        float e0X[4], e0Y[4], e0Z[4];
+        float e1X[4], e1Y[4], e1Z[4];
+        float nX[4], nY[4], nZ[4];
+        unsigned int triangle[4];
+        unsigned int objectId[4];
+    };
+
+    static const unsigned int LEAF_CHILD = 0x80000000u;
+    static const unsigned int EMPTY_CHILD = 0xFFFFFFFFu;
+
+    void buildNode(std::vector<BuildNode> & buildNodes, std::vector<unsigned int> & triangles, unsigned int from, unsigned int to,
+                   unsigned int depth, const std::vector<optix::float3> & centroids,
+                   const std::vector<optix::float3> & triangleMin, const std::vector<optix::float3> & triangleMax);
+    unsigned int collapseNode(const std::vector<BuildNode> & buildNodes, unsigned int buildNodeIndex, const std::vector<unsigned int> & triangles,
+                              const std::vector<optix::float3> & vertices, const std::vector<unsigned int> & objectIds);
+    unsigned int createLeaf(unsigned int from, unsigned int to, const std::vector<unsigned int> & triangles,
+                            const std::vector<optix::float3> & vertices, const std::vector<unsigned int> & objectIds);
+
+    std::vector<Node> m_nodes;
+    std::vector<Leaf> m_leaves;
+};
@@ -23,6 +23,7 @@ public:
     RENDER_ENGINE_EXPORT_API virtual void initScene(Scene & scene) = 0;
     RENDER_ENGINE_EXPORT_API virtual void initialize(const ComputeDevice & device, Logger *logger) = 0;
 
+    // Traces the tile of the image in details, getWidth, getHeight and the output buffer are those of the tile
     RENDER_ENGINE_EXPORT_API virtual void renderNextIteration(unsigned long long iterationNumber, unsigned long long localIterationNumber, 
         float PPMRadius, const RenderServerRenderRequestDetails & details) = 0;
     RENDER_ENGINE_EXPORT_API virtual void getOutputBuffer(void* data) = 0;
@@ -6,11 +6,20 @@
 
 #include "PPMOptixRenderer.h"
 #include "PMOptixRenderer.h"
+#include "PhotonKdTree.h"
 #include "renderer/ppm/Photon.h"
+#include "renderer/ppm/PackedPhoton.h"
 #include "config.h"
 #include "select.h"
+#include <algorithm>
+#include <future>
+#include <limits>
+#include <vector>
+#include "util/ParallelFor.h"
 
-#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_KD_TREE_CPU
+// Ranges smaller than this are partitioned and built on the calling thread. Spawning a task
+// for them costs more than it saves.
+static const int KD_TREE_PARALLEL_MIN_PHOTONS = 1 << 16;
 
 inline RT_HOSTDEVICE int max_component(optix::float3 a)
 {
@@ -25,20 +34,127 @@ inline RT_HOSTDEVICE int max_component(optix::float3 a)
     return 2;
 }
 
-static void buildKDTree( Photon* photons, int start, int end, int depth, Photon* kd_tree, int current_root,
+/*
+  The tree is built over 16 byte records holding just the position and the index of the source
+  photon. The median searches only move these around, which keeps far more of them per cache line
+  than full photons, and the source photon is read once when its node is written out.
+*/
+struct KdTreeBuildPhoton
+{
+    optix::float3 position;
+    unsigned int index;
+};
+
+template<class Func> static int forEachChunk(int begin, int end, int numChunks, Func func)
+{
+    return parallelForChunks(begin, end, numChunks, KD_TREE_PARALLEL_MIN_PHOTONS / 4, func);
+}
+
+/*
+  Parallel counterpart of select<Elem, axis>. Each round picks a pivot and does a three-way
+  partition (less, equal, greater) of the active range: every chunk counts its elements, the counts
+  are prefix summed and the chunks scatter in parallel into a scratch buffer. The search then
+  continues in the part holding k, falling back to the serial select once the range is small.
+  Postcondition is the same as select: list[left..k-1] <= list[k] <= list[k+1..right].
+*/
+template<class Elem, int axis> static void parallelSelect(Elem* list, Elem* scratch, int left, int right, int k, int numThreads)
+{
+    while(right - left + 1 > KD_TREE_PARALLEL_MIN_PHOTONS)
+    {
+        float pivot = ElemIndex(list[(left+right)/2], axis);
+
+        std::vector<int> counts(3*numThreads, 0);
+        int numChunks = forEachChunk(left, right + 1, numThreads, [&](int chunk, int from, int to)
+        {
+            int less = 0, equal = 0;
+            for(int i = from; i < to; ++i)
+            {
+                float value = ElemIndex(list[i], axis);
+                less += value < pivot;
+                equal += value == pivot;
+            }
+            counts[3*chunk] = less;
+            counts[3*chunk+1] = equal;
+            counts[3*chunk+2] = (to - from) - less - equal;
+        });
+
+        // Exclusive scan of the counts gives the output offset of each chunk within each part
+        int numLess = 0, numEqual = 0;
+        for(int chunk = 0; chunk < numChunks; ++chunk)
+        {
+            numLess += counts[3*chunk];
+            numEqual += counts[3*chunk+1];
+        }
+        std::vector<int> offsets(3*numChunks);
+        int lessOffset = left, equalOffset = left + numLess, greaterOffset = left + numLess + numEqual;
+        for(int chunk = 0; chunk < numChunks; ++chunk)
+        {
+            offsets[3*chunk] = lessOffset;
+            offsets[3*chunk+1] = equalOffset;
+            offsets[3*chunk+2] = greaterOffset;
+            lessOffset += counts[3*chunk];
+            equalOffset += counts[3*chunk+1];
+            greaterOffset += counts[3*chunk+2];
+        }
+
+        forEachChunk(left, right + 1, numThreads, [&](int chunk, int from, int to)
+        {
+            int less = offsets[3*chunk], equal = offsets[3*chunk+1], greater = offsets[3*chunk+2];
+            for(int i = from; i < to; ++i)
+            {
+                float value = ElemIndex(list[i], axis);
+                if(value < pivot)
+                    scratch[less++] = list[i];
+                else if(value == pivot)
+                    scratch[equal++] = list[i];
+                else
+                    scratch[greater++] = list[i];
+            }
+        });
+
+        forEachChunk(left, right + 1, numThreads, [&](int, int from, int to)
+        {
+            std::copy(scratch + from, scratch + to, list + from);
+        });
+
+        int equalBegin = left + numLess;
+        int equalEnd = equalBegin + numEqual;
+        if(k < equalBegin)
+            right = equalBegin - 1;
+        else if(k >= equalEnd)
+            left = equalEnd;
+        else
+            return;
+    }
+    select<Elem, axis>(list, left, right, k);
+}
+
+struct KdTreeBuildContext
+{
+    const Photon* sourcePhotons;
+    KdTreeBuildPhoton* photons;
+    PackedPhoton* kdTree;
+    KdTreeBuildPhoton* scratch;
+    int numThreads;
+    int maxParallelDepth;
+};
+
+static void buildKDTree( const KdTreeBuildContext & context, int start, int end, int depth, int current_root,
     optix::float3 bbmin, optix::float3 bbmax)
 {
+    KdTreeBuildPhoton* photons = context.photons;
+    PackedPhoton* kd_tree = context.kdTree;
+
     // If we have zero photons, this is a NULL node
     if( end - start == 0 ) {
-        kd_tree[current_root].axis = PPM_NULL;
-        kd_tree[current_root].power = optix::make_float3( 0.0f );
+        kd_tree[current_root].objectIdAndAxis = PPM_NULL << PACKED_PHOTON_AXIS_SHIFT;
+        kd_tree[current_root].power = 0;
         return;
     }
 
     // If we have a single photon
     if( end - start == 1 ) {
-        photons[start].axis = PPM_LEAF;
-        kd_tree[current_root] = (photons[start]);
+        kd_tree[current_root] = packPhoton(context.sourcePhotons[photons[start].index], PPM_LEAF);
         return;
     }
 
@@ -48,20 +164,35 @@ static void buildKDTree( Photon* photons, int start, int end, int depth, Photon*
     optix::float3 diag = bbmax-bbmin;
     axis = max_component(diag);
 
+    // Near the root a single range spans most of the photons, so the median search itself is
+    // split across threads. Deeper down the subtrees run concurrently instead.
+    bool parallelSelectRange = end - start > KD_TREE_PARALLEL_MIN_PHOTONS && depth < context.maxParallelDepth;
+    int selectThreads = std::max(1, context.numThreads >> depth);
+
     int median = (start+end) / 2;
-    Photon* start_addr = &(photons[start]);
+    KdTreeBuildPhoton* start_addr = &(photons[start]);
+    unsigned int axisFlag = PPM_X;
     switch( axis ) {
     case 0:
-        select<Photon, 0>( start_addr, 0, end-start-1, median-start );
-        photons[median].axis = PPM_X;
+        if(parallelSelectRange)
+            parallelSelect<KdTreeBuildPhoton, 0>( photons, context.scratch, start, end-1, median, selectThreads );
+        else
+            select<KdTreeBuildPhoton, 0>( start_addr, 0, end-start-1, median-start );
+        axisFlag = PPM_X;
         break;
     case 1:
-        select<Photon, 1>( start_addr, 0, end-start-1, median-start );
-        photons[median].axis = PPM_Y;
+        if(parallelSelectRange)
+            parallelSelect<KdTreeBuildPhoton, 1>( photons, context.scratch, start, end-1, median, selectThreads );
+        else
+            select<KdTreeBuildPhoton, 1>( start_addr, 0, end-start-1, median-start );
+        axisFlag = PPM_Y;
         break;
     case 2:
-        select<Photon, 2>( start_addr, 0, end-start-1, median-start );
-        photons[median].axis = PPM_Z;
+        if(parallelSelectRange)
+            parallelSelect<KdTreeBuildPhoton, 2>( photons, context.scratch, start, end-1, median, selectThreads );
+        else
+            select<KdTreeBuildPhoton, 2>( start_addr, 0, end-start-1, median-start );
+        axisFlag = PPM_Z;
         break;
     }
     optix::float3 rightMin = bbmin;
@@ -82,48 +213,109 @@ static void buildKDTree( Photon* photons, int start, int end, int depth, Photon*
         break;
     }
 
-    kd_tree[current_root] = (photons[median]);
-    buildKDTree( photons, start, median, depth+1, kd_tree, 2*current_root+1, bbmin,  leftMax );
-    buildKDTree( photons, median+1, end, depth+1, kd_tree, 2*current_root+2, rightMin, bbmax );
+    kd_tree[current_root] = packPhoton(context.sourcePhotons[photons[median].index], axisFlag);
+
+    // Both subtrees write to disjoint photon ranges and disjoint heap slots, so the left one can
+    // be built on another thread while this one builds the right one. Past maxParallelDepth
+    // there are already enough tasks to keep every core busy and we recurse serially.
+    if(depth < context.maxParallelDepth && end - start > KD_TREE_PARALLEL_MIN_PHOTONS)
+    {
+        std::future<void> left = std::async(std::launch::async, [&]() {
+            buildKDTree( context, start, median, depth+1, 2*current_root+1, bbmin, leftMax );
+        });
+        buildKDTree( context, median+1, end, depth+1, 2*current_root+2, rightMin, bbmax );
+        left.get();
+    }
+    else
+    {
+        buildKDTree( context, start, median, depth+1, 2*current_root+1, bbmin,  leftMax );
+        buildKDTree( context, median+1, end, depth+1, 2*current_root+2, rightMin, bbmax );
+    }
 }
 
-void PPMOptixRenderer::createPhotonKdTreeOnCPU()
+unsigned int buildPhotonKdTree(const Photon* photons_host, unsigned int numPhotons, PackedPhoton* photonKdTree_host, int numThreads)
 {
-    Photon* photons_host = reinterpret_cast<Photon*>( m_photons->map() );
-    Photon* photonKdTree_host = reinterpret_cast<Photon*>( m_photonKdTree->map() );
-
-    int numValidPhotons = NUM_PHOTONS >= m_photonKdTreeSize ? m_photonKdTreeSize : NUM_PHOTONS;
-
-    for( unsigned int i = 0; i < numValidPhotons; ++i )
+    numThreads = std::max(1, numThreads);
+    int maxParallelDepth = 0;
+    while(numThreads > 1 && (1 << maxParallelDepth) < 2*numThreads)
     {
-        Photon a = photons_host[i];
+        maxParallelDepth++;
+    }
 
-        if(! (fmaxf(photons_host[i].power) > 0.0f))
+    // Count the photons with power in each chunk so every chunk knows where its build records go
+    std::vector<int> chunkValidPhotons(numThreads, 0);
+    int numChunks = forEachChunk(0, numPhotons, numThreads, [&](int chunk, int from, int to)
+    {
+        int valid = 0;
+        for(int i = from; i < to; ++i)
         {
-            photons_host[i] = photons_host[numValidPhotons-1];
-            numValidPhotons--;
-            i--;
+            valid += photonHasPower(photons_host[i]);
         }
-    }
+        chunkValidPhotons[chunk] = valid;
+    });
 
-    optix::float3 bbmin = optix::make_float3(0.0f);
-    optix::float3 bbmax = optix::make_float3(0.0f);
+    std::vector<int> chunkOffset(numChunks, 0);
+    int numValidPhotons = 0;
+    for(int chunk = 0; chunk < numChunks; ++chunk)
+    {
+        chunkOffset[chunk] = numValidPhotons;
+        numValidPhotons += chunkValidPhotons[chunk];
+    }
 
-    bbmin = optix::make_float3(  std::numeric_limits<float>::max() );
-    bbmax = optix::make_float3( -std::numeric_limits<float>::max() );
+    // Gather the build records and compute the bounds of the photons
+    std::vector<KdTreeBuildPhoton> buildPhotons(numValidPhotons);
+    std::vector<optix::float3> chunkMin(numThreads, optix::make_float3(  std::numeric_limits<float>::max() ));
+    std::vector<optix::float3> chunkMax(numThreads, optix::make_float3( -std::numeric_limits<float>::max() ));
+    forEachChunk(0, numPhotons, numThreads, [&](int chunk, int from, int to)
+    {
+        int out = chunkOffset[chunk];
+        for(int i = from; i < to; ++i)
+        {
+            if(photonHasPower(photons_host[i]))
+            {
+                optix::float3 position = (photons_host[i]).position;
+                buildPhotons[out].position = position;
+                buildPhotons[out].index = i;
+                out++;
+                chunkMin[chunk] = fminf(chunkMin[chunk], position);
+                chunkMax[chunk] = fmaxf(chunkMax[chunk], position);
+            }
+        }
+    });
 
-    // Compute the bounds of the photons
-    for(int i = 0; i < numValidPhotons; ++i)
+    optix::float3 bbmin = chunkMin[0];
+    optix::float3 bbmax = chunkMax[0];
+    for(int chunk = 1; chunk < numChunks; ++chunk)
     {
-        optix::float3 position = (photons_host[i]).position;
-        bbmin = fminf(bbmin, position);
-        bbmax = fmaxf(bbmax, position);
+        bbmin = fminf(bbmin, chunkMin[chunk]);
+        bbmax = fmaxf(bbmax, chunkMax[chunk]);
     }
 
+    std::vector<KdTreeBuildPhoton> scratch(numValidPhotons > KD_TREE_PARALLEL_MIN_PHOTONS ? numValidPhotons : 0);
+
+    KdTreeBuildContext context;
+    context.sourcePhotons = photons_host;
+    context.photons = buildPhotons.empty() ? NULL : &buildPhotons[0];
+    context.kdTree = photonKdTree_host;
+    context.scratch = scratch.empty() ? NULL : &scratch[0];
+    context.numThreads = numThreads;
+    context.maxParallelDepth = maxParallelDepth;
+
     // Now build KD tree
-    buildKDTree( photons_host, 0, numValidPhotons, 0, photonKdTree_host, 0, bbmin, bbmax );
+    buildKDTree( context, 0, numValidPhotons, 0, 0, bbmin, bbmax );
+    return numValidPhotons;
+}
+
+#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_KD_TREE_CPU
+
+void PPMOptixRenderer::createPhotonKdTreeOnCPU()
+{
+    Photon* photons_host = reinterpret_cast<Photon*>( m_photons->map() );
+    PackedPhoton* photonKdTree_host = reinterpret_cast<PackedPhoton*>( m_photonKdTree->map() );
+
+    unsigned int numPhotons = NUM_PHOTONS >= m_photonKdTreeSize ? m_photonKdTreeSize : NUM_PHOTONS;
+    m_numberOfPhotonsLastFrame = buildPhotonKdTree( photons_host, numPhotons, photonKdTree_host, getHardwareThreadCount() );
 
-    m_numberOfPhotonsLastFrame = numValidPhotons;
     m_photonKdTree->unmap();
     m_photons->unmap();
 }
@@ -131,38 +323,13 @@ void PPMOptixRenderer::createPhotonKdTreeOnCPU()
 void PMOptixRenderer::createPhotonKdTreeOnCPU()
 {
     Photon* photons_host = reinterpret_cast<Photon*>( m_photons->map() );
-    Photon* photonKdTree_host = reinterpret_cast<Photon*>( m_photonKdTree->map() );
+    PackedPhoton* photonKdTree_host = reinterpret_cast<PackedPhoton*>( m_photonKdTree->map() );
 
-    int numValidPhotons = NUM_PHOTONS >= m_photonKdTreeSize ? m_photonKdTreeSize : NUM_PHOTONS;
+    RTsize photonKdTreeSize;
+    m_photonKdTree->getSize( photonKdTreeSize );
+    unsigned int numPhotons = std::min( getNumPhotons(), (unsigned int)photonKdTreeSize );
+    buildPhotonKdTree( photons_host, numPhotons, photonKdTree_host, getHardwareThreadCount() );
 
-    for( unsigned int i = 0; i < numValidPhotons; ++i )
-    {
-        Photon a = photons_host[i];
-
-        if(! (fmaxf(photons_host[i].power) > 0.0f))
-        {
-            photons_host[i] = photons_host[numValidPhotons-1];
-            numValidPhotons--;
-            i--;
-        }
-    }
-
-    optix::float3 bbmin = optix::make_float3(0.0f);
-    optix::float3 bbmax = optix::make_float3(0.0f);
-
-    bbmin = optix::make_float3(  std::numeric_limits<float>::max() );
-    bbmax = optix::make_float3( -std::numeric_limits<float>::max() );
-
-    // Compute the bounds of the photons
-    for(int i = 0; i < numValidPhotons; ++i)
-    {
-        optix::float3 position = (photons_host[i]).position;
-        bbmin = fminf(bbmin, position);
-        bbmax = fmaxf(bbmax, position);
-    }
-
-    // Now build KD tree
-    buildKDTree( photons_host, 0, numValidPhotons, 0, photonKdTree_host, 0, bbmin, bbmax );
     m_photonKdTree->unmap();
     m_photons->unmap();
 }
@@ -23,6 +23,7 @@
 #include "renderer/Hitpoint.h"
 #include "renderer/PPMOptixRenderer.h"
 #include "renderer/PMOptixRenderer.h"
+#include "renderer/UniformGridPhotonMap.h"
 #include "util/sutil.h"
 #include "renderer/OptixEntryPoint.h"
 #include "renderer/helpers/optix.h"
@@ -41,7 +42,7 @@ static __host__ __device__ optix::uint3 ceil3f(const Vector3 & f)
     return result;
 }
 
-static optix::uint3 calculateGridSize(const Vector3 & sceneSize, const float & radius )
+optix::uint3 calculateGridSize(const Vector3 & sceneSize, const float & radius )
 {
     Vector3 f = sceneSize / radius;
     optix::uint3 result = ceil3f(f);
@@ -61,7 +62,7 @@ static __host__ __device__ Vector3 componentWiseDivide(const A & f1, const B & u
     return result;
 }
 
-static float getSmallestPossibleCellSize(const Vector3 & sceneExtent, const unsigned int maxGridSize)
+float getSmallestPossibleCellSize(const Vector3 & sceneExtent, const unsigned int maxGridSize)
 {
     float sceneVolume = sceneExtent.x*sceneExtent.y*sceneExtent.z;
     float minVolumePerCell = sceneVolume/maxGridSize;
@@ -72,6 +73,17 @@ static float getSmallestPossibleCellSize(const Vector3 & sceneExtent, const unsi
     return fmaxf(radiusEachAxis);
 }
 
+optix::uint3 calculateGridSizeWithinMaxCellKeys(const Vector3 & sceneExtent, float & cellSize, const unsigned int maxGridSize)
+{
+    optix::uint3 gridSize = calculateGridSize(sceneExtent, cellSize);
+    while(getPhotonGridNumCellKeys(gridSize) > maxGridSize)
+    {
+        cellSize *= 1.05f;
+        gridSize = calculateGridSize(sceneExtent, cellSize);
+    }
+    return gridSize;
+}
+
 #if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_UNIFORM_GRID
 
 /*
@@ -117,15 +129,15 @@ struct PhotonToAABBConverter : public thrust::unary_function<Photon, AABB>
 {
     __host__ __device__ AABB operator()(Photon photon)
     {
-        AABB a (photon.position, photon.position, fmaxf(photon.power) > 0, fmaxf(photon.power) > 0 ? 1 : 0); 
+        AABB a (photon.position, photon.position, photonHasPower(photon), photonHasPower(photon) ? 1 : 0); 
         return a;
     }
 };
 
 static AABB getPhotonsBoundingBox(thrust::device_ptr<Photon> & photons, unsigned int numValidPhotons)
 {
-    Photon photon = photons[0];
-    AABB init = AABB(photon.position, photon.position, fmaxf(photon.power) > 0, fmaxf(photon.power) > 0 ? 1 : 0);
+    // The reduction visits photons[0] again, so the initial value must not count it
+    AABB init = AABB(make_float3(0.0f), make_float3(0.0f), false, 0);
     return thrust::transform_reduce(photons, photons+numValidPhotons, PhotonToAABBConverter(), init, AABBReducer());
 }
 
@@ -160,10 +172,10 @@ __global__ void calculateHashCellsKernel(Photon* photons, unsigned int* photonsH
     {
         Photon & photon = photons[index];
         unsigned int hashCell;
-        if(fmaxf(photon.power) > 0)
+        if(photonHasPower(photon))
         {
             optix::uint3 hashGridPos = getPhotonGridIndex(photon.position, sceneOrigo, cellSize);
-            hashCell = getPhotonGridIndex1D(hashGridPos, gridSize);
+            hashCell = getPhotonGridCellKey(hashGridPos, gridSize);
             atomicAdd(hashCellHistogram+hashCell, 1);
         }
         else
@@ -208,17 +220,55 @@ static void createHashmapOffsetTable(thrust::device_ptr<unsigned int> & hashmapO
     thrust::exclusive_scan(hashmapOffsetTable, hashmapOffsetTable+numHashCells+1, hashmapOffsetTable, 0);
 }
 
-void PPMOptixRenderer::createUniformGridPhotonMap(float ppmRadius)
+/*
+// Bin photons into cells whose offsets are already known by scattering each photon to the next free slot
+// of its cell. The order of the photons within a cell is arbitrary. Photons without power are not moved,
+// the offset table ends at the last photon with power so they are never read.
+*/
+
+__global__ void scatterPhotonsByHashCellKernel(const Photon* photons, const unsigned int* photonsHashCell, unsigned int* cellCursors,
+                                               Photon* binnedPhotons, unsigned int numPhotons, const unsigned int numHashCells)
 {
-    nvtxRangePushA("Get photon AABB");
-    int deviceNumber = 0;
-    cudaSetDevice(m_optixDeviceOrdinal);
+    unsigned int index = blockIdx.x*blockDim.x + threadIdx.x;
+    if(index < numPhotons)
+    {
+        unsigned int hashCell = photonsHashCell[index];
+        if(hashCell < numHashCells)
+        {
+            unsigned int position = atomicAdd(cellCursors + hashCell, 1);
+            binnedPhotons[position] = photons[index];
+        }
+    }
+}
 
-    // Get a device_ptr to our photon list
-    thrust::device_ptr<Photon> photons = getThrustDevicePtr<Photon>(m_photons, deviceNumber);
+static void scatterPhotonsByHashCell(thrust::device_ptr<Photon> & photons, thrust::device_ptr<unsigned int> & photonsHashCell, thrust::device_ptr<unsigned int> & cellCursors,
+                                     thrust::device_ptr<Photon> & binnedPhotons, unsigned int numPhotons, const unsigned int numHashCells)
+{
+    const unsigned int blockSize = 512;
+    unsigned int numBlocks = numPhotons/blockSize + (numPhotons%blockSize == 0 ? 0 : 1);
+    scatterPhotonsByHashCellKernel<<<numBlocks, blockSize>>> (thrust::raw_pointer_cast(&photons[0]), thrust::raw_pointer_cast(&photonsHashCell[0]),
+                                                              thrust::raw_pointer_cast(&cellCursors[0]), thrust::raw_pointer_cast(&binnedPhotons[0]),
+                                                              numPhotons, numHashCells);
+}
+
+UniformGridPhotonMap buildUniformGridPhotonMapOnDevice(Photon* photonsPtr, unsigned int* photonsHashCellPtr, unsigned int* hashmapOffsetTablePtr,
+                                                       unsigned int numPhotons, unsigned int maxGridSize)
+{
+    thrust::device_ptr<Photon> photons = thrust::device_pointer_cast(photonsPtr);
+    thrust::device_ptr<unsigned int> photonsHashCell = thrust::device_pointer_cast(photonsHashCellPtr);
+    thrust::device_ptr<unsigned int> hashmapOffsetTable = thrust::device_pointer_cast(hashmapOffsetTablePtr);
+
+    nvtxRangePushA("Get photon AABB");
 
     // Get the AABB that contains all valid scene photons
-    AABB scene = getPhotonsBoundingBox(photons, NUM_PHOTONS);
+    AABB scene = getPhotonsBoundingBox(photons, numPhotons);
+    if(!scene.valid)
+    {
+        // No photon has power, grid the origin like the host build does
+        scene.first = make_float3(0.0f);
+        scene.second = make_float3(0.0f);
+        scene.numPhotons = 0;
+    }
     AABB extendedScene = padAABB(scene);
     optix::float3 sceneWorldOrigo = extendedScene.first;
     cudaDeviceSynchronize();
@@ -228,22 +278,24 @@ void PPMOptixRenderer::createUniformGridPhotonMap(float ppmRadius)
 
     // Get scene wide maximum radius squared to use for the hash map cell size
 
-    float smallestPossibleCellSize = getSmallestPossibleCellSize(sceneExtent, PHOTON_GRID_MAX_SIZE);
+    float smallestPossibleCellSize = getSmallestPossibleCellSize(sceneExtent, maxGridSize);
     float cellSize = smallestPossibleCellSize+0.001;
 
-    m_spatialHashMapCellSize = cellSize;
+    UniformGridPhotonMap result;
+    result.worldOrigo = sceneWorldOrigo;
+    result.gridSize = calculateGridSizeWithinMaxCellKeys(sceneExtent, cellSize, maxGridSize);
+    result.cellSize = cellSize;
+    result.numValidPhotons = scene.numPhotons;
 
-    m_gridSize = calculateGridSize(sceneExtent, cellSize);
-    
     // Calculate hashes for photons
     
-    unsigned int numHashCells = m_gridSize.x * m_gridSize.y * m_gridSize.z;
-    m_spatialHashMapNumCells = numHashCells;
+    unsigned int numHashCells = getPhotonGridNumCellKeys(result.gridSize);
+    result.numHashCells = numHashCells;
 
     //printf("# CellSize %.3f, %d hash values, smallestPossibleCellSize: %.3f\n", cellSize, numHashCells, smallestPossibleCellSize);
     //printf("# GridSize %d %d %d\n", gridSize.x, gridSize.y, gridSize.z);
 
-    if(numHashCells > PHOTON_GRID_MAX_SIZE)
+    if(numHashCells > maxGridSize)
     {
         throw std::exception("Too many cells in SpatialHash.cu, over defined PHOTON_GRID_MAX_SIZE.");
     }
@@ -252,17 +304,15 @@ void PPMOptixRenderer::createUniformGridPhotonMap(float ppmRadius)
     unsigned int invalidHashCellValue = numHashCells+1;
 
     nvtxRangePushA("calculateHashCells and histogram");
-    thrust::device_ptr<unsigned int> hashmapOffsetTable = getThrustDevicePtr<unsigned int>(m_hashmapOffsetTable, deviceNumber);
     thrust::fill(hashmapOffsetTable, hashmapOffsetTable+numHashCells, 0);
-    thrust::device_ptr<unsigned int> photonsHashCell = getThrustDevicePtr<unsigned int>(m_photonsHashCells, deviceNumber);
-    calculateHashCells(photons, photonsHashCell, hashmapOffsetTable, NUM_PHOTONS, m_gridSize, sceneWorldOrigo, cellSize, invalidHashCellValue);
+    calculateHashCells(photons, photonsHashCell, hashmapOffsetTable, numPhotons, result.gridSize, sceneWorldOrigo, cellSize, invalidHashCellValue);
     cudaDeviceSynchronize();
     nvtxRangePop();
 
     // Sort the photons by their hash value
 
     nvtxRangePushA("Sort photons by hash");
-    sortPhotonsByHash(photons, photonsHashCell, NUM_PHOTONS);
+    sortPhotonsByHash(photons, photonsHashCell, numPhotons);
     nvtxRangePop();
 
     // Calculate the offset table from the histogram
@@ -270,89 +320,201 @@ void PPMOptixRenderer::createUniformGridPhotonMap(float ppmRadius)
     createHashmapOffsetTable(hashmapOffsetTable, numHashCells);
     cudaDeviceSynchronize();
     nvtxRangePop();
-    
-    m_numberOfPhotonsLastFrame = scene.numPhotons;
-    //m_numberOfPhotonsInEstimate += m_numberOfPhotonsLastFrame;
-
-    // Update context variables
-
-    m_context["photonsGridCellSize"]->setFloat(cellSize);
-    m_context["photonsGridSize"]->setUint(m_gridSize);
-    m_context["photonsWorldOrigo"]->setFloat(sceneWorldOrigo);
 
+    return result;
 }
 
-void PMOptixRenderer::createUniformGridPhotonMap(float)
+void PPMOptixRenderer::createUniformGridPhotonMap(float ppmRadius)
 {
-    nvtxRangePushA("Get photon AABB");
+    if(m_buildPhotonMapOnCPU)
+    {
+        createUniformGridPhotonMapOnCPU();
+        return;
+    }
+
+    if(m_persistentPhotonGrid)
+    {
+        createPersistentUniformGridPhotonMap();
+        return;
+    }
+
     int deviceNumber = 0;
     cudaSetDevice(m_optixDeviceOrdinal);
 
-    // Get a device_ptr to our photon list
-    thrust::device_ptr<Photon> photons = getThrustDevicePtr<Photon>(m_photons, deviceNumber);
+    UniformGridPhotonMap photonMap = buildUniformGridPhotonMapOnDevice(getDevicePtr<Photon>(m_photons, deviceNumber),
+        getDevicePtr<unsigned int>(m_photonsHashCells, deviceNumber), getDevicePtr<unsigned int>(m_hashmapOffsetTable, deviceNumber),
+        NUM_PHOTONS, PHOTON_GRID_MAX_SIZE);
 
-    // Get the AABB that contains all valid scene photons
-	AABB scene = getPhotonsBoundingBox(photons, getNumPhotons());
-    AABB extendedScene = padAABB(scene);
-    optix::float3 sceneWorldOrigo = extendedScene.first;
-    cudaDeviceSynchronize();
+    m_gridSize = photonMap.gridSize;
+    m_spatialHashMapCellSize = photonMap.cellSize;
+    m_spatialHashMapNumCells = photonMap.numHashCells;
+    m_numberOfPhotonsLastFrame = photonMap.numValidPhotons;
+    //m_numberOfPhotonsInEstimate += m_numberOfPhotonsLastFrame;
 
-    optix::float3 sceneExtent = getSceneExtent(extendedScene);
-    nvtxRangePop();
+    // Update context variables
 
-    // Get scene wide maximum radius squared to use for the hash map cell size
+    m_context["photonsGridCellSize"]->setFloat(photonMap.cellSize);
+    m_context["photonsGridSize"]->setUint(photonMap.gridSize);
+    m_context["photonsWorldOrigo"]->setFloat(photonMap.worldOrigo);
+}
 
-    float smallestPossibleCellSize = getSmallestPossibleCellSize(sceneExtent, PHOTON_GRID_MAX_SIZE);
-    float cellSize = smallestPossibleCellSize+0.001;
+/*
+// Photons are only deposited on scene geometry, so a grid over the padded scene AABB holds all of them
+// and its size only depends on the scene. While the size stays the same the cells and their offset table
+// are reused: the new photons are counted per cell and scattered straight into place, which replaces the
+// AABB reduction and the sort of the full build. A changed grid size gets a full sorted build.
+*/
+void PPMOptixRenderer::createPersistentUniformGridPhotonMap()
+{
+    double buildStartTime = sutilCurrentTime();
+    int deviceNumber = 0;
+    cudaSetDevice(m_optixDeviceOrdinal);
 
-    m_spatialHashMapCellSize = cellSize;
+    AAB aabb = m_sceneAABB;
+    aabb.addPadding(0.0001f);
+    Vector3 sceneExtent = aabb.getExtent();
+    float cellSize = getSmallestPossibleCellSize(sceneExtent, PHOTON_GRID_MAX_SIZE)+0.001;
+    optix::uint3 gridSize = calculateGridSizeWithinMaxCellKeys(sceneExtent, cellSize, PHOTON_GRID_MAX_SIZE);
 
-    m_gridSize = calculateGridSize(sceneExtent, cellSize);
-    
-    // Calculate hashes for photons
-    
-    unsigned int numHashCells = m_gridSize.x * m_gridSize.y * m_gridSize.z;
-    m_spatialHashMapNumCells = numHashCells;
+    bool fullBuild = !m_persistentPhotonGridValid || gridSize.x != m_gridSize.x || gridSize.y != m_gridSize.y || gridSize.z != m_gridSize.z;
+    if(fullBuild)
+    {
+        unsigned int numHashCells = getPhotonGridNumCellKeys(gridSize);
+        if(numHashCells > PHOTON_GRID_MAX_SIZE)
+        {
+            throw std::exception("Too many cells in SpatialHash.cu, over defined PHOTON_GRID_MAX_SIZE.");
+        }
 
-    //printf("# CellSize %.3f, %d hash values, smallestPossibleCellSize: %.3f\n", cellSize, numHashCells, smallestPossibleCellSize);
-    //printf("# GridSize %d %d %d\n", gridSize.x, gridSize.y, gridSize.z);
+        m_gridSize = gridSize;
+        m_spatialHashMapCellSize = cellSize;
+        m_spatialHashMapNumCells = numHashCells;
 
-    if(numHashCells > PHOTON_GRID_MAX_SIZE)
-    {
-        throw std::exception("Too many cells in SpatialHash.cu, over defined PHOTON_GRID_MAX_SIZE.");
+        m_context["photonsGridCellSize"]->setFloat(cellSize);
+        m_context["photonsGridSize"]->setUint(m_gridSize);
+        m_context["photonsWorldOrigo"]->setFloat(aabb.min);
     }
 
-    // Calculate hash values for each photon and build the histogram
+    unsigned int numHashCells = m_spatialHashMapNumCells;
     unsigned int invalidHashCellValue = numHashCells+1;
 
-    nvtxRangePushA("calculateHashCells and histogram");
+    thrust::device_ptr<Photon> photons = getThrustDevicePtr<Photon>(m_photons, deviceNumber);
+    thrust::device_ptr<unsigned int> photonsHashCell = getThrustDevicePtr<unsigned int>(m_photonsHashCells, deviceNumber);
     thrust::device_ptr<unsigned int> hashmapOffsetTable = getThrustDevicePtr<unsigned int>(m_hashmapOffsetTable, deviceNumber);
+
+    nvtxRangePushA("calculateHashCells and histogram");
     thrust::fill(hashmapOffsetTable, hashmapOffsetTable+numHashCells, 0);
-    thrust::device_ptr<unsigned int> photonsHashCell = getThrustDevicePtr<unsigned int>(m_photonsHashCells, deviceNumber);
-	calculateHashCells(photons, photonsHashCell, hashmapOffsetTable, getNumPhotons(), m_gridSize, sceneWorldOrigo, cellSize, invalidHashCellValue);
+    calculateHashCells(photons, photonsHashCell, hashmapOffsetTable, NUM_PHOTONS, m_gridSize, aabb.min, m_spatialHashMapCellSize, invalidHashCellValue);
     cudaDeviceSynchronize();
     nvtxRangePop();
 
-    // Sort the photons by their hash value
+    if(fullBuild)
+    {
+        nvtxRangePushA("Sort photons by hash");
+        sortPhotonsByHash(photons, photonsHashCell, NUM_PHOTONS);
+        nvtxRangePop();
+
+        nvtxRangePushA("Create hashmap offset table");
+        createHashmapOffsetTable(hashmapOffsetTable, numHashCells);
+        cudaDeviceSynchronize();
+        nvtxRangePop();
+    }
+    else
+    {
+        nvtxRangePushA("Create hashmap offset table");
+        createHashmapOffsetTable(hashmapOffsetTable, numHashCells);
+        thrust::device_ptr<unsigned int> cellCursors = getThrustDevicePtr<unsigned int>(m_hashmapCellCursors, deviceNumber);
+        thrust::copy(hashmapOffsetTable, hashmapOffsetTable+numHashCells, cellCursors);
+        nvtxRangePop();
+
+        // Only the photons with power are copied back, the photon pass overwrites the rest of the buffer.
+        // The copy is part of the incremental build time.
+        nvtxRangePushA("Scatter photons into cells");
+        thrust::device_ptr<Photon> binnedPhotons = getThrustDevicePtr<Photon>(m_photonsScratch, deviceNumber);
+        scatterPhotonsByHashCell(photons, photonsHashCell, cellCursors, binnedPhotons, NUM_PHOTONS, numHashCells);
+        unsigned int numBinnedPhotons = hashmapOffsetTable[numHashCells];
+        thrust::copy(binnedPhotons, binnedPhotons+numBinnedPhotons, photons);
+        cudaDeviceSynchronize();
+        nvtxRangePop();
+    }
 
-    nvtxRangePushA("Sort photons by hash");
-    sortPhotonsByHash(photons, photonsHashCell, getNumPhotons());
-    nvtxRangePop();
+    unsigned int numValidPhotons = hashmapOffsetTable[numHashCells];
+    m_numberOfPhotonsLastFrame = numValidPhotons;
 
-    // Calculate the offset table from the histogram
-    nvtxRangePushA("Create hashmap offset table");
-    createHashmapOffsetTable(hashmapOffsetTable, numHashCells);
+    double buildTime = sutilCurrentTime() - buildStartTime;
+    if(fullBuild)
+    {
+        m_persistentPhotonGridValid = true;
+        m_lastIncrementalPhotonMapBuildTime = 0;
+    }
+    else
+    {
+        m_lastIncrementalPhotonMapBuildTime = buildTime;
+        m_statistics.incrementalPhotonMapBuilds++;
+    }
+}
+
+/*
+// Times the full sorted build of createUniformGridPhotonMap on this frame's photons, as the reference for
+// the time the incremental build of the frame saved. Runs on every PERSISTENT_PHOTON_GRID_COMPARE_INTERVAL-th
+// incremental build, after the photon map is built and outside its build time. The binned photons in the
+// scratch buffer get the empty slots of the photon pass back, so the reference build sees the same photons
+// with power and the same number of empty ones; the radix sort takes as long in any order.
+*/
+void PPMOptixRenderer::comparePersistentPhotonGridBuild()
+{
+    if(m_lastIncrementalPhotonMapBuildTime <= 0 || (m_statistics.incrementalPhotonMapBuilds-1) % PERSISTENT_PHOTON_GRID_COMPARE_INTERVAL != 0)
+    {
+        return;
+    }
+
+    nvtx::ScopedRange r("PPMOptixRenderer::comparePersistentPhotonGridBuild");
+    int deviceNumber = 0;
+    cudaSetDevice(m_optixDeviceOrdinal);
+
+    thrust::device_ptr<Photon> referencePhotons = getThrustDevicePtr<Photon>(m_photonsScratch, deviceNumber);
+    Photon emptyPhoton;
+    emptyPhoton.power = 0;
+#if ENABLE_PARTICIPATING_MEDIA
+    emptyPhoton.numDeposits = 0;
+#endif
+    thrust::fill(referencePhotons + (unsigned int)m_numberOfPhotonsLastFrame, referencePhotons + NUM_PHOTONS, emptyPhoton);
     cudaDeviceSynchronize();
-    nvtxRangePop();
-    
-    //m_numberOfPhotonsInEstimate += m_numberOfPhotonsLastFrame;
 
-    // Update context variables
+    double fullBuildStartTime = sutilCurrentTime();
+    buildUniformGridPhotonMapOnDevice(getDevicePtr<Photon>(m_photonsScratch, deviceNumber), getDevicePtr<unsigned int>(m_photonsHashCellsScratch, deviceNumber),
+        getDevicePtr<unsigned int>(m_hashmapCellCursors, deviceNumber), NUM_PHOTONS, PHOTON_GRID_MAX_SIZE);
+    double fullBuildTime = sutilCurrentTime() - fullBuildStartTime;
 
-    m_context["photonsGridCellSize"]->setFloat(cellSize);
-    m_context["photonsGridSize"]->setUint(m_gridSize);
-    m_context["photonsWorldOrigo"]->setFloat(sceneWorldOrigo);
+    m_statistics.buildPhotonMapTimeSaved += fullBuildTime - m_lastIncrementalPhotonMapBuildTime;
+    m_statistics.comparedPhotonMapBuilds++;
+    m_logger->log("Persistent photon grid build %.3f ms, full build of the same photons %.3f ms\n",
+        m_lastIncrementalPhotonMapBuildTime*1000, fullBuildTime*1000);
+}
 
+void PMOptixRenderer::createUniformGridPhotonMap(float)
+{
+    if(m_buildPhotonMapOnCPU)
+    {
+        createUniformGridPhotonMapOnCPU();
+        return;
+    }
+
+    int deviceNumber = 0;
+    cudaSetDevice(m_optixDeviceOrdinal);
+
+    UniformGridPhotonMap photonMap = buildUniformGridPhotonMapOnDevice(getDevicePtr<Photon>(m_photons, deviceNumber),
+        getDevicePtr<unsigned int>(m_photonsHashCells, deviceNumber), getDevicePtr<unsigned int>(m_hashmapOffsetTable, deviceNumber),
+        getNumPhotons(), PHOTON_GRID_MAX_SIZE);
+
+    m_gridSize = photonMap.gridSize;
+    m_spatialHashMapCellSize = photonMap.cellSize;
+    m_spatialHashMapNumCells = photonMap.numHashCells;
+
+    // Update context variables
+
+    m_context["photonsGridCellSize"]->setFloat(photonMap.cellSize);
+    m_context["photonsGridSize"]->setUint(photonMap.gridSize);
+    m_context["photonsWorldOrigo"]->setFloat(photonMap.worldOrigo);
 }
 
 #elif ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_STOCHASTIC_HASH
@@ -408,9 +570,18 @@ static void __global__ initRandomStateBuffer(RandomState* states, unsigned int s
     }
 }
 
-static void initializeRandomStateBuffer(optix::Buffer & buffer, int numStates)
+// Seed of the random states of a launch, mixed from the seed of the renderer and the number of the launch so
+// that the same seed traces the same photons again (splitmix64 finalizer)
+static unsigned int getLaunchSeed(unsigned int seed, unsigned long long launchNumber)
+{
+    unsigned long long z = seed * 0x9E3779B97F4A7C15ull + launchNumber;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return (unsigned int)(z ^ (z >> 31));
+}
+
+static void initializeRandomStateBuffer(optix::Buffer & buffer, int numStates, unsigned int seed)
 {
-    unsigned int seed = 574133*(unsigned int)clock() + 47844152748*(unsigned int)time(NULL);
     RandomState* states = getDevicePtr<RandomState>(buffer, 0);
     const int blockSize = 256;
     int numBlocks = numStates/blockSize + (numStates % blockSize == 0 ? 0 : 1);
@@ -418,19 +589,25 @@ static void initializeRandomStateBuffer(optix::Buffer & buffer, int numStates)
     cudaDeviceSynchronize();
 }
 
-void PPMOptixRenderer::initializeRandomStates()
+// Seeded from the iteration the buffers are set up on. Servers that render at the same time start on
+// different iterations, so their photons differ.
+void PPMOptixRenderer::initializeRandomStates(unsigned long long iterationNumber)
 {
+    cudaSetDevice(m_optixDeviceOrdinal);
     RTsize size[2];
     m_randomStatesBuffer->getSize(size[0], size[1]);
     int num = size[0]*size[1];
-    initializeRandomStateBuffer(m_randomStatesBuffer, num);
+    initializeRandomStateBuffer(m_randomStatesBuffer, num, getLaunchSeed(0, iterationNumber));
 }
 
+// Seeds the random states for the next launch, see setLaunchNumber
 void PMOptixRenderer::initializeRandomStates()
 {
+    cudaSetDevice(m_optixDeviceOrdinal);
     RTsize size[2];
     m_randomStatesBuffer->getSize(size[0], size[1]);
     int num = size[0]*size[1];
-    initializeRandomStateBuffer(m_randomStatesBuffer, num);
+    initializeRandomStateBuffer(m_randomStatesBuffer, num, getLaunchSeed(m_randomSeed, m_launchNumber));
+    m_launchNumber++;
 }
 
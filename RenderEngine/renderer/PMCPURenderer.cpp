@@ -0,0 +1,608 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "PMCPURenderer.h"
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include "config.h"
+#include "ComputeDevice.h"
+#include "scene/Scene.h"
+#include "util/ParallelFor.h"
+#include "util/sutil.h"
+
+using namespace optix;
+
+#include "renderer/helpers/helpers.h"
+#include "renderer/helpers/samplers.h"
+
+const unsigned int PMCPURenderer::MAX_PHOTON_COUNT = MAX_PHOTONS_DEPOSITS_PER_EMITTED;
+// No photons are kept in memory, so the photon width is only bounded by tracing time
+const unsigned int PMCPURenderer::MAX_PHOTON_WIDTH = 2048;
+
+// Photons handed to a worker thread each time it runs out of work
+static const int PHOTON_TRACING_BATCH_SIZE = 256;
+
+struct PMCPURenderer::PhotonTraceResult
+{
+	std::vector<unsigned int> hitCount;
+	std::vector<double> rawRadiance;
+	double powerEmitted;
+};
+
+/*
+// Random numbers of an emitted photon, seeded from the seed of the renderer, the launch and the photon index so
+// that the result does not depend on which thread traces the photon (xorshift64* seeded with splitmix64)
+*/
+class PhotonRandomState
+{
+public:
+	PhotonRandomState(unsigned int seed, unsigned long long launchNumber, unsigned int photonIndex)
+	{
+		unsigned long long z = (launchNumber << 32) + photonIndex + 0x9E3779B97F4A7C15ull * (seed + 1ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		m_state = (z ^ (z >> 31)) | 1;
+	}
+
+	float getFloat()
+	{
+		m_state ^= m_state >> 12;
+		m_state ^= m_state << 25;
+		m_state ^= m_state >> 27;
+		return (float)((m_state * 0x2545F4914F6CDD1Dull) >> 40) * (1.f/16777216.f);
+	}
+
+	float2 getFloat2()
+	{
+		float x = getFloat();
+		return make_float2(x, getFloat());
+	}
+
+private:
+	unsigned long long m_state;
+};
+
+PMCPURenderer::PMCPURenderer() :
+	m_geometryChanged(false),
+	m_totalLightPower(0.f),
+	m_powerEmitted(0.f),
+	m_photonWidth(0),
+	m_randomSeed(0),
+	m_launchNumber(0),
+	m_numThreads(getHardwareThreadCount()),
+	m_initialized(false),
+	m_sceneInitialized(false),
+	m_logger(NULL)
+{
+}
+
+PMCPURenderer::~PMCPURenderer()
+{
+}
+
+// There is no device to set up, the device argument is only there to fit OptixRenderer
+void PMCPURenderer::initialize(const ComputeDevice & device, Logger *logger)
+{
+	if(m_initialized)
+	{
+		throw std::exception("ERROR: Multiple PMCPURenderer::initialize!\n");
+	}
+	m_logger = logger;
+	m_logger->log("PMCPURenderer: tracing photons on %d threads\n", m_numThreads);
+	m_initialized = true;
+}
+
+void PMCPURenderer::initScene(Scene & scene)
+{
+	if(!m_initialized)
+	{
+		throw std::exception("Cannot initialize scene before PMCPURenderer.");
+	}
+
+	const QVector<Light> & sceneLights = scene.getSceneLights();
+	if(sceneLights.size() == 0)
+	{
+		throw std::exception("No lights exists in this scene.");
+	}
+
+	m_geometry = scene.getHostSceneGeometry();
+	m_sceneBoundingSphere = scene.getSceneAABB().getBoundingSphere();
+
+	auto objectIdToName = scene.getObjectIdToNameMap();
+	unsigned int sceneObjects = objectIdToName.size();
+	m_objectIdToName.assign(sceneObjects, "");
+	m_nodeNameToId.clear();
+	for(unsigned int i = 0; i < sceneObjects; ++i)
+	{
+		m_objectIdToName.at(i) = qPrintable(objectIdToName.at(i));
+		m_nodeNameToId[objectIdToName.at(i)] = i;
+	}
+	m_hitCount.assign(sceneObjects, 0);
+	m_rawRadiance.assign(sceneObjects, 0.f);
+	m_nodeTransformations.assign(sceneObjects, Matrix4x4::identity());
+
+	// PMOptixRenderer reads the lights after Scene::getSceneRootGroup, which adds the light of each
+	// emitter mesh in the scene graph once more. Add the same lights so photons get the same power.
+	m_lights.assign(sceneLights.constBegin(), sceneLights.constEnd());
+	for(size_t instanceIdx = 0; instanceIdx < m_geometry.instances.size(); ++instanceIdx)
+	{
+		const HostSceneInstance & instance = m_geometry.instances[instanceIdx];
+		if(instance.material.type == HostMaterialType::DIFFUSE_EMITTER && instance.numTriangles > 0)
+		{
+			const float3* face = &m_geometry.vertices[3*instance.firstTriangle];
+			m_lights.push_back(Light::createParalelogram(m_objectIdToName[instance.objectId].c_str(), instance.material.power,
+				face[0], face[1]-face[0], face[2]-face[0]));
+		}
+	}
+
+	m_lightIndexes.clear();
+	m_totalLightPower = 0.f;
+	for(int lightIdx = 0; lightIdx < (int)m_lights.size(); ++lightIdx)
+	{
+		m_lightIndexes[m_lights[lightIdx].name].append(lightIdx);
+		m_totalLightPower += m_lights[lightIdx].power.x + m_lights[lightIdx].power.y + m_lights[lightIdx].power.z;
+	}
+
+	// set russian roulette power
+	m_lightRussianRulette.resize(m_lights.size());
+	float power = 0;
+	for(size_t lightIdx = 0; lightIdx < m_lights.size(); ++lightIdx)
+	{
+		float lightPower = m_lights[lightIdx].power.x + m_lights[lightIdx].power.y + m_lights[lightIdx].power.z;
+		m_lightRussianRulette[lightIdx] = (power + lightPower) / m_totalLightPower;
+		power += lightPower;
+	}
+
+	m_geometryChanged = true;
+	m_sceneInitialized = true;
+}
+
+void PMCPURenderer::renderNextIteration(unsigned long long iterationNumber, unsigned long long localIterationNumber, float PPMRadius,
+	const RenderServerRenderRequestDetails & details)
+{
+	throw std::exception("PMCPURenderer does not render images.");
+}
+
+// Photons are traced on the host, there is no device to select
+void PMCPURenderer::makeCurrent()
+{
+}
+
+void PMCPURenderer::setRandomSeed(unsigned int seed)
+{
+	m_randomSeed = seed;
+}
+
+unsigned long long PMCPURenderer::getLaunchNumber() const
+{
+	return m_launchNumber;
+}
+
+void PMCPURenderer::setLaunchNumber(unsigned long long launchNumber)
+{
+	m_launchNumber = launchNumber;
+}
+
+void PMCPURenderer::buildPhotonBuffer(unsigned int photonLaunchWidth)
+{
+	tracePhotons(photonLaunchWidth, true);
+}
+
+// The photons are already counted per thread instead of stored, so both passes are the same here
+void PMCPURenderer::tracePhotonStatistics(unsigned int photonLaunchWidth)
+{
+	tracePhotons(photonLaunchWidth, true);
+}
+
+void PMCPURenderer::tracePhotons(unsigned int photonLaunchWidth, bool storefirstHitPhotons)
+{
+	if(!m_sceneInitialized)
+	{
+		throw std::exception("Traced before PMCPURenderer scene was initialized.");
+	}
+
+	if(m_geometryChanged)
+	{
+		double start = sutilCurrentTime();
+		updateSceneGeometry();
+		m_statistics.recalcAccelerationStructures += sutilCurrentTime() - start;
+	}
+
+	double start = sutilCurrentTime();
+
+	m_photonWidth = photonLaunchWidth;
+	unsigned int numEmitted = m_photonWidth * m_photonWidth;
+	float photonPowerScale = 1.0f / (numEmitted * m_totalLightPower);
+
+	std::vector<PhotonTraceResult> threadResults(m_numThreads);
+	for(int thread = 0; thread < m_numThreads; ++thread)
+	{
+		threadResults[thread].hitCount.assign(m_hitCount.size(), 0);
+		threadResults[thread].rawRadiance.assign(m_rawRadiance.size(), 0.0);
+		threadResults[thread].powerEmitted = 0.0;
+	}
+
+	parallelForDynamic(0, (int)numEmitted, m_numThreads, PHOTON_TRACING_BATCH_SIZE, [&](int thread, int from, int to)
+	{
+		for(int photonIndex = from; photonIndex < to; ++photonIndex)
+		{
+			tracePhoton(photonIndex, storefirstHitPhotons, photonPowerScale, threadResults[thread]);
+		}
+	});
+
+	double powerEmitted = 0.0;
+	std::vector<double> rawRadiance(m_rawRadiance.size(), 0.0);
+	std::fill(m_hitCount.begin(), m_hitCount.end(), 0);
+	for(int thread = 0; thread < m_numThreads; ++thread)
+	{
+		for(size_t objectId = 0; objectId < m_hitCount.size(); ++objectId)
+		{
+			m_hitCount[objectId] += threadResults[thread].hitCount[objectId];
+			rawRadiance[objectId] += threadResults[thread].rawRadiance[objectId];
+		}
+		powerEmitted += threadResults[thread].powerEmitted;
+	}
+	for(size_t objectId = 0; objectId < m_rawRadiance.size(); ++objectId)
+	{
+		m_rawRadiance[objectId] = (float)rawRadiance[objectId];
+	}
+	m_powerEmitted = (float)powerEmitted;
+
+	m_launchNumber++;
+	m_statistics.photonTracingTime += sutilCurrentTime() - start;
+}
+
+/*
+// Same steps as the generator program in PMPhotonGenerator.cu followed by the closest hit photon
+// programs of the materials, with the recursive rtTrace calls turned into a loop. The any hit programs
+// of Glass are not registered on the device, so the ray types do not change which hits are found.
+*/
+void PMCPURenderer::tracePhoton(unsigned int photonIndex, bool storefirstHitPhotons, float photonPowerScale, PhotonTraceResult & result) const
+{
+	PhotonRandomState randomState(m_randomSeed, m_launchNumber, photonIndex);
+
+	int lightIndex = 0;
+	int numLights = (int)m_lights.size();
+	if(numLights > 1)
+	{
+		float sample = randomState.getFloat();
+		while(lightIndex < numLights - 1 && sample > m_lightRussianRulette[lightIndex])
+		{
+			lightIndex++;
+		}
+	}
+	const Light & light = m_lights[lightIndex];
+
+	float3 power = light.power * photonPowerScale;
+
+	// Summed like the power of the photons added to rawRadiance
+	result.powerEmitted += power.x + power.y + power.z;
+
+	//
+	// Emission, as in generatePhotonOriginAndDirection
+	//
+
+	float3 origin = light.position;
+	float3 direction;
+	float photonPowerFactor = 1.f;
+	float2 sample1 = randomState.getFloat2();
+	float3 sphereCenter = m_sceneBoundingSphere.center;
+	float sphereRadius = m_sceneBoundingSphere.radius;
+
+	if(light.lightType == Light::AREA)
+	{
+		float2 sample2 = randomState.getFloat2();
+		origin += sample1.x*light.v1 + sample1.y*light.v2;
+		direction = sampleUnitHemisphere(light.normal, sample2);
+	}
+	else if(light.lightType == Light::POINT)
+	{
+		float3 sceneCenterToLight = light.position - sphereCenter;
+		float lightDistance = length(sceneCenterToLight);
+		sceneCenterToLight /= lightDistance;
+		if(lightDistance > 1.5*sphereRadius)
+		{
+			float3 pointOnDisc = sampleDisc(sample1, sphereCenter, sphereRadius, sceneCenterToLight);
+			direction = normalize(pointOnDisc - origin);
+			photonPowerFactor = (1 - lightDistance / sqrtf(sphereRadius*sphereRadius + lightDistance*lightDistance)) / 2.f;
+		}
+		else
+		{
+			direction = sampleUnitSphere(sample1);
+		}
+	}
+	else if(light.lightType == Light::SPOT)
+	{
+		float3 pointOnDisc = sampleDisc(sample1, origin + light.direction, sinf(light.angle/2), light.direction);
+		direction = normalize(pointOnDisc - origin);
+	}
+	else
+	{
+		direction = light.direction;
+		origin = sampleDisc(sample1, sphereCenter - sphereRadius * direction, sphereRadius, direction);
+	}
+	power *= photonPowerFactor;
+
+	//
+	// Photon path
+	//
+
+	float tmin = 0.0001f;
+	unsigned int depth = 0;
+	unsigned int numStoredPhotons = 0;
+	float weight = 1.0f;
+	int inHole = 0;
+
+	HostRayHit hit;
+	while(m_bvh.intersect(origin, direction, tmin, RT_DEFAULT_MAX, hit))
+	{
+		const HostSceneInstance & instance = m_geometry.instances[m_geometry.triangleInstance[hit.triangle]];
+		const HostMaterial & material = instance.material;
+		const float3* normals = &m_normals[3*hit.triangle];
+		float3 shadingNormal = normalize(normals[1]*hit.beta + normals[2]*hit.gamma + normals[0]*(1.0f-hit.beta-hit.gamma));
+		float3 hitPoint = origin + hit.t*direction;
+		origin = hitPoint;
+		tmin = 0.0001f;
+
+		if(material.type == HostMaterialType::DIFFUSE || material.type == HostMaterialType::TEXTURE)
+		{
+			if(inHole)
+			{
+				continue;
+			}
+
+			// Photons with power are the ones PMOptixRenderer::countHitCountPerObject counts
+			if((storefirstHitPhotons && depth == 0) || (depth >= 1 && numStoredPhotons < MAX_PHOTON_COUNT))
+			{
+				if(fmaxf(power) > 0)
+				{
+					result.hitCount[hit.objectId]++;
+					result.rawRadiance[hit.objectId] += power.x + power.y + power.z;
+				}
+				numStoredPhotons++;
+			}
+
+			power *= material.Kd;
+			weight *= fmaxf(material.Kd);
+
+			if(depth >= PHOTON_TRACING_RR_START_DEPTH)
+			{
+				float probContinue = favgf(material.Kd);
+				if(randomState.getFloat() >= probContinue)
+				{
+					return;
+				}
+				power /= probContinue;
+			}
+
+			depth++;
+			float minWeight = material.type == HostMaterialType::TEXTURE ? 0.01f : 0.001f;
+			if(depth >= MAX_PHOTON_TRACE_DEPTH || weight < minWeight || numStoredPhotons >= MAX_PHOTON_COUNT)
+			{
+				return;
+			}
+
+			direction = sampleUnitHemisphereCos(shadingNormal, randomState.getFloat2());
+			tmin = material.type == HostMaterialType::TEXTURE ? 0.01f : 0.0001f;
+		}
+		else if(material.type == HostMaterialType::MIRROR)
+		{
+			depth++;
+			if(depth > MAX_PHOTON_TRACE_DEPTH)
+			{
+				return;
+			}
+			power *= material.Kr;
+			direction = reflect(direction, shadingNormal);
+		}
+		else if(material.type == HostMaterialType::GLASS)
+		{
+			bool isHitFromOutside = hitFromOutside(direction, shadingNormal);
+			float3 N = isHitFromOutside ? shadingNormal : -shadingNormal;
+			float n1 = isHitFromOutside ? 1.f : material.indexOfRefraction;
+			float n2 = isHitFromOutside ? material.indexOfRefraction : 1.f;
+
+			float3 refractionDirection;
+			bool validRefraction = refract(refractionDirection, direction, N, n2/n1);
+			float cosThetaI = -dot(direction, N);
+			float cosThetaT = -dot(refractionDirection, N);
+
+			// Find reflection factor using Fresnel equation
+			float reflectionFactor = 1.f;
+			if(validRefraction)
+			{
+				float rp = (n2*cosThetaI - n1*cosThetaT)/(n2*cosThetaI + n1*cosThetaT);
+				float rs = (n1*cosThetaI - n2*cosThetaT)/(n1*cosThetaI + n2*cosThetaT);
+				reflectionFactor = (rp*rp + rs*rs) / 2.f;
+			}
+			bool isReflected = randomState.getFloat() <= reflectionFactor;
+			direction = isReflected ? reflect(direction, N) : refractionDirection;
+
+			depth++;
+			if(depth > MAX_PHOTON_TRACE_DEPTH)
+			{
+				return;
+			}
+		}
+		else if(material.type == HostMaterialType::HOLE)
+		{
+			inHole += hitFromOutside(direction, shadingNormal) ? 1 : -1;
+			depth++;
+			if(depth > MAX_PHOTON_TRACE_DEPTH)
+			{
+				return;
+			}
+		}
+		else
+		{
+			// Emitters absorb photons
+			return;
+		}
+	}
+}
+
+/*
+// Puts the triangles where the node transformations place them and rebuilds the BVH. Like the
+// OptiX Transform nodes, the matrix of a node applies to all the meshes below it.
+*/
+void PMCPURenderer::updateSceneGeometry()
+{
+	std::vector<Matrix4x4> worldTransformations(m_nodeTransformations.size());
+	for(size_t objectId = 0; objectId < m_nodeTransformations.size(); ++objectId)
+	{
+		// Object ids are given in pre-order, so parents come before their children
+		int parent = m_geometry.nodeParent[objectId];
+		worldTransformations[objectId] = parent < 0 ? m_nodeTransformations[objectId] : worldTransformations[parent] * m_nodeTransformations[objectId];
+	}
+
+	m_vertices.resize(m_geometry.vertices.size());
+	m_normals.resize(m_geometry.normals.size());
+	std::vector<unsigned int> triangleObjectIds(m_geometry.triangleInstance.size());
+	for(size_t instanceIdx = 0; instanceIdx < m_geometry.instances.size(); ++instanceIdx)
+	{
+		const HostSceneInstance & instance = m_geometry.instances[instanceIdx];
+		const Matrix4x4 & transformation = worldTransformations[instance.objectId];
+		Matrix4x4 normalTransformation = transformation.inverse().transpose();
+
+		unsigned int from = 3*instance.firstTriangle;
+		unsigned int to = 3*(instance.firstTriangle + instance.numTriangles);
+		for(unsigned int i = from; i < to; ++i)
+		{
+			float4 homogeneus = transformation * make_float4(m_geometry.vertices[i], 1.0f);
+			m_vertices[i] = make_float3(homogeneus / homogeneus.w);
+			m_normals[i] = make_float3(normalTransformation * make_float4(m_geometry.normals[i], 0.0f));
+		}
+		std::fill(triangleObjectIds.begin() + instance.firstTriangle, triangleObjectIds.begin() + instance.firstTriangle + instance.numTriangles,
+			instance.objectId);
+	}
+
+	m_bvh.build(m_vertices, triangleObjectIds);
+	m_geometryChanged = false;
+}
+
+unsigned int PMCPURenderer::getNodeObjectId(const QString &nodeName) const
+{
+	if (nodeName == NULL || nodeName.isEmpty())
+	{
+		throw std::invalid_argument("nodeName can't be NULL or empty");
+	}
+
+	if(!m_nodeNameToId.contains(nodeName))
+	{
+		throw std::invalid_argument((nodeName + " doesn't exists").toStdString());
+	}
+	unsigned int objectId = m_nodeNameToId[nodeName];
+	if(!m_geometry.nodeHasGeometryGroup[objectId])
+	{
+		throw std::invalid_argument((nodeName + " has no geometries").toStdString());
+	}
+	return objectId;
+}
+
+void PMCPURenderer::setNodeTransformation(const QString &nodeName, const optix::Matrix4x4 &transformation)
+{
+	unsigned int objectId = getNodeObjectId(nodeName);
+	m_nodeTransformations[objectId] = transformation;
+	m_geometryChanged = true;
+
+	// update the lights if node is a light
+	if(m_lightIndexes.contains(nodeName))
+	{
+		auto lightIndexes = m_lightIndexes[nodeName];
+		for(auto lightIndexesIt = lightIndexes.cbegin(); lightIndexesIt != lightIndexes.cend(); ++lightIndexesIt)
+		{
+			m_lights[*lightIndexesIt].setTransform(transformation);
+		}
+	}
+}
+
+void PMCPURenderer::setLightDirection(const QString &lightName, const Vector3 &direction)
+{
+	if(!m_lightIndexes.contains(lightName)){
+		throw std::invalid_argument(("Invalid light: " + lightName).toStdString());
+	}
+
+	auto lightIndexes = m_lightIndexes[lightName];
+	for(auto lightIndexesIt = lightIndexes.cbegin(); lightIndexesIt != lightIndexes.cend(); ++lightIndexesIt){
+		m_lights[*lightIndexesIt].setDirection(direction);
+	}
+}
+
+// Only the Diffuse photon program reads Kd, so like on the device other materials ignore it
+void PMCPURenderer::setNodeDiffuseMaterialKd(const QString &nodeName, optix::float3 kd)
+{
+	unsigned int objectId = getNodeObjectId(nodeName);
+	for(size_t instanceIdx = 0; instanceIdx < m_geometry.instances.size(); ++instanceIdx)
+	{
+		HostSceneInstance & instance = m_geometry.instances[instanceIdx];
+		if(instance.objectId == objectId && instance.material.type == HostMaterialType::DIFFUSE)
+		{
+			instance.material.Kd = kd;
+		}
+	}
+}
+
+std::vector<unsigned int> PMCPURenderer::getHitCount()
+{
+	return m_hitCount;
+}
+
+std::vector<float> PMCPURenderer::getRadiance()
+{
+	return m_rawRadiance;
+}
+
+float PMCPURenderer::getEmittedPower()
+{
+	return m_powerEmitted;
+}
+
+void PMCPURenderer::getOutputBuffer(void* data)
+{
+	throw std::exception("PMCPURenderer does not render images.");
+}
+
+unsigned int PMCPURenderer::getWidth() const
+{
+	return 0;
+}
+
+unsigned int PMCPURenderer::getHeight() const
+{
+	return 0;
+}
+
+unsigned int PMCPURenderer::getScreenBufferSizeBytes() const
+{
+	return 0;
+}
+
+const std::vector<std::string>& PMCPURenderer::objectToNameMapping() const
+{
+	return m_objectIdToName;
+}
+
+unsigned int PMCPURenderer::totalPhotons()
+{
+	return m_photonWidth * m_photonWidth;
+}
+
+unsigned int PMCPURenderer::getMaxPhotonWidth()
+{
+	return MAX_PHOTON_WIDTH;
+}
+
+RendererStatistics PMCPURenderer::getStatistics()
+{
+	return m_statistics;
+}
+
+// Number of threads tracing photons, 0 for one per hardware thread
+void PMCPURenderer::setNumThreads(unsigned int numThreads)
+{
+	m_numThreads = numThreads == 0 ? getHardwareThreadCount() : (int)numThreads;
+}
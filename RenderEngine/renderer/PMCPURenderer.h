@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+
+#include <optixu/optixu_math_namespace.h>
+#include <optixu/optixu_matrix_namespace.h>
+#include "render_engine_export_api.h"
+#include "PhotonRenderer.h"
+#include "HostBVH.h"
+#include "Light.h"
+#include "math/Sphere.h"
+#include "scene/HostSceneGeometry.h"
+#include "logging/Logger.h"
+#include <vector>
+#include <string>
+#include <QMap>
+#include <QList>
+#include <QString>
+#include "RendererStatistics.h"
+
+class ComputeDevice;
+class RenderServerRenderRequestDetails;
+class Scene;
+
+/*
+  Photon mapping on the host, for machines without a CUDA device. It traces the photon pass of
+  PMOptixRenderer (light emission and the photon programs of the Diffuse, Texture, Mirror, Glass, Hole
+  and DiffuseEmitter materials) on a pool of threads and counts the stored photons per object, which
+  is what buildPhotonBuffer and tracePhotonStatistics callers read back. It does not produce images.
+*/
+class PMCPURenderer: public PhotonRenderer
+{
+public:
+
+	RENDER_ENGINE_EXPORT_API PMCPURenderer();
+	RENDER_ENGINE_EXPORT_API ~PMCPURenderer();
+
+	RENDER_ENGINE_EXPORT_API void initScene(Scene & scene);
+	RENDER_ENGINE_EXPORT_API void initialize(const ComputeDevice & device, Logger *logger);
+
+	RENDER_ENGINE_EXPORT_API void renderNextIteration(unsigned long long iterationNumber, unsigned long long localIterationNumber,
+		float PPMRadius, const RenderServerRenderRequestDetails & details);
+	RENDER_ENGINE_EXPORT_API void makeCurrent();
+	RENDER_ENGINE_EXPORT_API void setRandomSeed(unsigned int seed);
+	RENDER_ENGINE_EXPORT_API unsigned long long getLaunchNumber() const;
+	RENDER_ENGINE_EXPORT_API void setLaunchNumber(unsigned long long launchNumber);
+	RENDER_ENGINE_EXPORT_API void buildPhotonBuffer(unsigned int photonLaunchWidth);
+	RENDER_ENGINE_EXPORT_API void tracePhotonStatistics(unsigned int photonLaunchWidth);
+	RENDER_ENGINE_EXPORT_API void getOutputBuffer(void* data);
+	RENDER_ENGINE_EXPORT_API std::vector<unsigned int> getHitCount();
+	RENDER_ENGINE_EXPORT_API unsigned int getWidth() const;
+	RENDER_ENGINE_EXPORT_API unsigned int getHeight() const;
+	RENDER_ENGINE_EXPORT_API unsigned int getScreenBufferSizeBytes() const;
+	RENDER_ENGINE_EXPORT_API std::vector<float> getRadiance();
+	RENDER_ENGINE_EXPORT_API float getEmittedPower();
+	RENDER_ENGINE_EXPORT_API void setLightDirection(const QString &lightName, const Vector3 &direction);
+	RENDER_ENGINE_EXPORT_API void setNodeTransformation(const QString &nodeName, const optix::Matrix4x4 &transformation);
+	RENDER_ENGINE_EXPORT_API void setNodeDiffuseMaterialKd(const QString &nodeName, optix::float3 kd);
+	RENDER_ENGINE_EXPORT_API const std::vector<std::string>& objectToNameMapping() const;
+	RENDER_ENGINE_EXPORT_API unsigned int totalPhotons();
+	RENDER_ENGINE_EXPORT_API unsigned int getMaxPhotonWidth();
+	RENDER_ENGINE_EXPORT_API RendererStatistics getStatistics();
+	RENDER_ENGINE_EXPORT_API void setNumThreads(unsigned int numThreads);
+
+private:
+	const static unsigned int MAX_PHOTON_COUNT;
+	const static unsigned int MAX_PHOTON_WIDTH;
+
+	struct PhotonTraceResult;
+
+	void tracePhotons(unsigned int photonLaunchWidth, bool storefirstHitPhotons);
+	void tracePhoton(unsigned int photonIndex, bool storefirstHitPhotons, float photonPowerScale, PhotonTraceResult & result) const;
+	void updateSceneGeometry();
+	unsigned int getNodeObjectId(const QString &nodeName) const;
+
+	HostSceneGeometry m_geometry;
+	HostBVH m_bvh;
+	// Vertices and normals of m_geometry after the node transformations
+	std::vector<optix::float3> m_vertices;
+	std::vector<optix::float3> m_normals;
+	std::vector<optix::Matrix4x4> m_nodeTransformations;
+	bool m_geometryChanged;
+
+	std::vector<Light> m_lights;
+	std::vector<float> m_lightRussianRulette;
+	QMap<QString, QList<int>> m_lightIndexes; // a mapping to Light name to light position into m_lights
+	QMap<QString, unsigned int> m_nodeNameToId;
+	Sphere m_sceneBoundingSphere;
+	float m_totalLightPower;
+
+	std::vector<unsigned int> m_hitCount;
+	std::vector<float> m_rawRadiance;
+	float m_powerEmitted;
+	unsigned int m_photonWidth;
+	unsigned int m_randomSeed;
+	unsigned long long m_launchNumber;
+	int m_numThreads;
+	bool m_initialized;
+	bool m_sceneInitialized;
+	std::vector<std::string> m_objectIdToName;
+	Logger *m_logger;
+	RendererStatistics m_statistics;
+};
@@ -5,6 +5,7 @@
 */
 
 #include <cuda.h>
+#include <cuda_runtime.h>
 #include <curand_kernel.h>
 #include "PMOptixRenderer.h"
 #include <iostream>
@@ -37,9 +38,14 @@ using namespace optix;
 
 PMOptixRenderer::PMOptixRenderer() : 
     m_initialized(false),
+	m_buildPhotonMapOnCPU(false),
+	m_photonGatherK(0),
     m_width(10),
     m_height(10),
 	m_photonWidth(10),
+	m_tracedPhotonWidth(10),
+	m_randomSeed(0),
+	m_launchNumber(0),
 	m_groups(new QMap<QString, Group>()),
 	m_lights(new QMap<QString, QList<int>>())
 {
@@ -87,9 +93,13 @@ void PMOptixRenderer::initialize(const ComputeDevice & device, Logger *logger)
     m_context["maxPhotonDepositsPerEmitted"]->setUint(MAX_PHOTON_COUNT);
     m_context["ppmRadius"]->setFloat(0.f);
     m_context["ppmRadiusSquared"]->setFloat(0.f);
+	m_context["photonGatherK"]->setUint(m_photonGatherK);
     m_context["emittedPhotonsPerIterationFloat"]->setFloat(0.f);
     m_context["photonLaunchWidth"]->setUint(0);
+    m_context["imageOffset"]->setUint(0, 0);
+    m_context["imageSize"]->setUint(m_width, m_height);
 	m_context["storefirstHitPhotons"]->setUint(0);
+	m_context["photonStatisticsOnly"]->setUint(0);
 	m_context["photonPowerScale"]->setFloat(0.f);
 	
 
@@ -134,7 +144,10 @@ void PMOptixRenderer::initialize(const ComputeDevice & device, Logger *logger)
         //m_context->setExceptionProgram(OptixEntryPoint::PPM_PHOTON_PASS, exceptionProgram);
     }
 
-    m_photons = m_context->createBuffer(RT_BUFFER_OUTPUT);
+    // Host builds write the sorted photons back, so the photon map buffers must be host writable
+    RTbuffertype photonMapBufferType = m_buildPhotonMapOnCPU ? RT_BUFFER_INPUT_OUTPUT : RT_BUFFER_OUTPUT;
+
+    m_photons = m_context->createBuffer(photonMapBufferType);
     m_photons->setFormat( RT_FORMAT_USER );
     m_photons->setElementSize( sizeof( Photon ) );
 	m_photons->setSize(getNumPhotons());
@@ -149,10 +162,10 @@ void PMOptixRenderer::initialize(const ComputeDevice & device, Logger *logger)
     m_context["photonsGridCellSize"]->setFloat(0.0f);
     m_context["photonsGridSize"]->setUint(0,0,0);
     m_context["photonsWorldOrigo"]->setFloat(make_float3(0));
-    m_photonsHashCells = m_context->createBuffer(RT_BUFFER_OUTPUT);
+    m_photonsHashCells = m_context->createBuffer(photonMapBufferType);
     m_photonsHashCells->setFormat( RT_FORMAT_UNSIGNED_INT );
 	m_photonsHashCells->setSize( getNumPhotons() );
-    m_hashmapOffsetTable = m_context->createBuffer(RT_BUFFER_OUTPUT);
+    m_hashmapOffsetTable = m_context->createBuffer(photonMapBufferType);
     m_hashmapOffsetTable->setFormat( RT_FORMAT_UNSIGNED_INT );
     m_hashmapOffsetTable->setSize( PHOTON_GRID_MAX_SIZE+1 );
     m_context["hashmapOffsetTable"]->set( m_hashmapOffsetTable );
@@ -389,7 +402,29 @@ void PMOptixRenderer::compile()
 void PMOptixRenderer::renderNextIteration(unsigned long long iterationNumber, unsigned long long localIterationNumber, float PPMRadius, 
                                         const RenderServerRenderRequestDetails & details)
 {
-	render(512, details.getHeight(), details.getWidth(), details.getCamera(), true, false);
+	// iteration numbers are unique among the servers, and the tiles of an iteration trace the same photons
+	m_launchNumber = iterationNumber;
+	renderTile(512, details.getTile(), details.getWidth(), details.getHeight(), details.getCamera(), true, false);
+}
+
+void PMOptixRenderer::makeCurrent()
+{
+	cudaSetDevice(m_optixDeviceOrdinal);
+}
+
+void PMOptixRenderer::setRandomSeed(unsigned int seed)
+{
+	m_randomSeed = seed;
+}
+
+unsigned long long PMOptixRenderer::getLaunchNumber() const
+{
+	return m_launchNumber;
+}
+
+void PMOptixRenderer::setLaunchNumber(unsigned long long launchNumber)
+{
+	m_launchNumber = launchNumber;
 }
 
 void PMOptixRenderer::buildPhotonBuffer(unsigned int photonLaunchWidth)
@@ -397,6 +432,73 @@ void PMOptixRenderer::buildPhotonBuffer(unsigned int photonLaunchWidth)
 	render(photonLaunchWidth, 10, 10, Camera(), false, true);
 }
 
+// Gives the same hit count, radiance and emitted power than buildPhotonBuffer, but the photon programs add each
+// hit to the counts of its object instead of storing it. No photon buffer is needed, so the photon pass is
+// launched in tiles that fit the random states buffer, and the launch width isn't limited by getMaxPhotonWidth.
+void PMOptixRenderer::tracePhotonStatistics(unsigned int photonLaunchWidth)
+{
+	// the random states and the hit counts are set up on the device of the renderer, whichever thread calls
+	cudaSetDevice(m_optixDeviceOrdinal);
+
+    if(!m_initialized)
+    {
+        throw std::exception("Traced before PMOptixRenderer was initialized.");
+    }
+
+	nvtx::ScopedRange r("PMOptixRenderer::TracePhotonStatistics");
+
+    try
+    {
+		unsigned int tileWidth = max(min(photonLaunchWidth, getMaxPhotonWidth()), 1u);
+		m_statistics.resizeBufferTime += calcEllapsedTime([&]()
+		{
+			this->resizeRandomStates(tileWidth, tileWidth);
+		});
+
+		m_context["storefirstHitPhotons"]->setUint(1);
+		m_context["photonStatisticsOnly"]->setUint(1);
+		m_context["photonLaunchWidth"]->setUint(tileWidth);
+		m_context["photonPowerScale"]->setFloat(1.0f / ((float)photonLaunchWidth * photonLaunchWidth * m_totalLightPower));
+
+		auto powerEmittedPtr = (float *) m_powerEmittedBuffer->map();
+		*powerEmittedPtr = 0;
+		m_powerEmittedBuffer->unmap();
+
+		m_statistics.hitCountCalculationTime += calcEllapsedTime([&](){
+			clearHitCountPerObject();
+		});
+
+		m_statistics.recalcAccelerationStructures += calcEllapsedTime([&](){
+			nvtx::ScopedRange r("Transfer photon map to GPU");
+			m_context->launch(OptixEntryPoint::PPM_INDIRECT_RADIANCE_ESTIMATION_PASS,
+				0, 0);
+		});
+
+		// the random states advance on each launch, so the tiles trace different photons
+		m_statistics.photonTracingTime += calcEllapsedTime([&](){
+			nvtx::ScopedRange r("OptixEntryPoint::PHOTON_PASS");
+			initializeRandomStates();
+			for(unsigned int y = 0; y < photonLaunchWidth; y += tileWidth)
+			{
+				for(unsigned int x = 0; x < photonLaunchWidth; x += tileWidth)
+				{
+					m_context->launch(OptixEntryPoint::PPM_PHOTON_PASS,
+						min(tileWidth, photonLaunchWidth - x),
+						min(tileWidth, photonLaunchWidth - y));
+				}
+			}
+		});
+
+		m_context["photonStatisticsOnly"]->setUint(0);
+		m_tracedPhotonWidth = photonLaunchWidth;
+    }
+    catch(const optix::Exception & e)
+    {
+        QString error = QString("An OptiX error occurred: %1").arg(e.getErrorString().c_str());
+        throw std::exception(error.toLatin1().constData());
+    }
+}
+
 double calcEllapsedTime(std::function<void(void)> process)
 {
 	double start = sutilCurrentTime();
@@ -406,6 +508,16 @@ double calcEllapsedTime(std::function<void(void)> process)
 
 void PMOptixRenderer::render(unsigned int photonLaunchWidth, unsigned int height, unsigned int width, const Camera camera, bool generateOutput, bool storefirstHitPhotons)
 {
+	renderTile(photonLaunchWidth, QRect(0, 0, width, height), width, height, camera, generateOutput, storefirstHitPhotons);
+}
+
+// Traces only the tile of the imageWidth x imageHeight image, the buffers and the output have the size of the tile
+void PMOptixRenderer::renderTile(unsigned int photonLaunchWidth, const QRect & tile, unsigned int imageWidth, unsigned int imageHeight,
+	const Camera & camera, bool generateOutput, bool storefirstHitPhotons)
+{
+	const unsigned int width = tile.width();
+	const unsigned int height = tile.height();
+
 	//storefirstHitPhotons = true;
 
 	//m_logger->log("START\n");
@@ -421,6 +533,7 @@ void PMOptixRenderer::render(unsigned int photonLaunchWidth, unsigned int height
     try
     {
 		m_context["storefirstHitPhotons"]->setUint(storefirstHitPhotons);
+		m_context["photonStatisticsOnly"]->setUint(0);
 
         // If the width and height of the current render request has changed, we must resize buffers
 		if(width != m_width || height != m_height || photonLaunchWidth != m_photonWidth)
@@ -431,7 +544,14 @@ void PMOptixRenderer::render(unsigned int photonLaunchWidth, unsigned int height
 			});
         }
 
+		// tracePhotonStatistics launches other widths
+		m_context["photonLaunchWidth"]->setUint(m_photonWidth);
+		m_context["photonPowerScale"]->setFloat(1.0f / (m_photonWidth * m_photonWidth * m_totalLightPower) );
+		m_tracedPhotonWidth = m_photonWidth;
+
         m_context["camera"]->setUserData( sizeof(Camera), &camera );
+		m_context["imageOffset"]->setUint(tile.left(), tile.top());
+		m_context["imageSize"]->setUint(imageWidth, imageHeight);
 
 		//int numSteps = generateOutput ? 7 : 2;
 
@@ -453,6 +573,7 @@ void PMOptixRenderer::render(unsigned int photonLaunchWidth, unsigned int height
         //
 		m_statistics.photonTracingTime += calcEllapsedTime([&](){
 			nvtx::ScopedRange r("OptixEntryPoint::PHOTON_PASS");
+			initializeRandomStates();
 			m_context->launch(OptixEntryPoint::PPM_PHOTON_PASS,
 				static_cast<unsigned int>(m_photonWidth),
 				static_cast<unsigned int>(m_photonWidth));
@@ -542,9 +663,7 @@ void PMOptixRenderer::resizeBuffers(unsigned int width, unsigned int height, uns
 {
 	m_photonWidth = photonWidth;
 	m_context["emittedPhotonsPerIterationFloat"]->setFloat(m_photonWidth * m_photonWidth);
-	m_context["photonLaunchWidth"]->setUint(m_photonWidth);
 	m_context["photonsSize"]->setUint(getNumPhotons());
-	m_context["photonPowerScale"]->setFloat(1.0f / (photonWidth * photonWidth * m_totalLightPower) );
 
 
 	RTsize hashCellsSize;
@@ -570,23 +689,26 @@ void PMOptixRenderer::resizeBuffers(unsigned int width, unsigned int height, uns
 		m_indirectRadianceBuffer->setSize(width, height);
 	}
 
-	auto candidateRandomStatesWidth = max(m_photonWidth, (unsigned int)width);
-	auto candidateRandomStatesHeight = max(m_photonWidth, (unsigned int)height);
+	resizeRandomStates(max(m_photonWidth, (unsigned int)width), max(m_photonWidth, (unsigned int)height));
+
+    m_width = width;
+    m_height = height;
+}
+
+void PMOptixRenderer::resizeRandomStates(unsigned int candidateRandomStatesWidth, unsigned int candidateRandomStatesHeight)
+{
 	RTsize randomStatesWidth, randomStatesHeight;
 
 	m_randomStatesBuffer->getSize(randomStatesWidth, randomStatesHeight);
 
 	if (randomStatesWidth < candidateRandomStatesWidth || randomStatesHeight < candidateRandomStatesHeight)
 	{
-		m_logger->log("Changing random state buffers -> %d %d\n", candidateRandomStatesWidth, candidateRandomStatesWidth);
-		m_randomStatesBuffer->setSize(candidateRandomStatesWidth, candidateRandomStatesWidth);
-		initializeRandomStates();
+		// never shrink the other dimension, the output and the photon launches both use the buffer
+		candidateRandomStatesWidth = max(candidateRandomStatesWidth, (unsigned int)randomStatesWidth);
+		candidateRandomStatesHeight = max(candidateRandomStatesHeight, (unsigned int)randomStatesHeight);
+		m_logger->log("Changing random state buffers -> %d %d\n", candidateRandomStatesWidth, candidateRandomStatesHeight);
+		m_randomStatesBuffer->setSize(candidateRandomStatesWidth, candidateRandomStatesHeight);
 	}
-
-
-    
-    m_width = width;
-    m_height = height;
 }
 
 unsigned int PMOptixRenderer::getWidth() const
@@ -637,7 +759,7 @@ std::vector<float> PMOptixRenderer::getRadiance()
 float PMOptixRenderer::getEmittedPower()
 {
 	auto powerEmittedPtr = (float *) m_powerEmittedBuffer->map();
-	float res = *powerEmittedPtr / 2.0f;
+	float res = *powerEmittedPtr;
 	m_powerEmittedBuffer->unmap();
 	return res;
 }
@@ -792,7 +914,7 @@ Buffer PMOptixRenderer::outputBuffer()
 
 unsigned int PMOptixRenderer::totalPhotons()
 {
-	return m_photonWidth * m_photonWidth;
+	return m_tracedPhotonWidth * m_tracedPhotonWidth;
 }
 
 unsigned int PMOptixRenderer::getMaxPhotonWidth()
@@ -818,6 +940,36 @@ RendererStatistics PMOptixRenderer::getStatistics()
 	return m_statistics;
 }
 
+// Build the uniform grid photon map on the host instead of through Thrust on the device. The photon
+// map buffers are created host writable when this is set, so it must be chosen before initialize.
+void PMOptixRenderer::setBuildPhotonMapOnCPU(bool buildOnCPU)
+{
+	if(m_initialized)
+	{
+		throw std::exception("The photon map build device must be set before PMOptixRenderer is initialized.");
+	}
+	m_buildPhotonMapOnCPU = buildOnCPU;
+}
+
+void PMOptixRenderer::setPhotonGatherMode(PhotonGatherMode::E mode, unsigned int nearestPhotons)
+{
+	unsigned int photonGatherK = 0;
+	if(mode == PhotonGatherMode::K_NEAREST_NEIGHBOURS)
+	{
+		if(nearestPhotons == 0 || nearestPhotons > PHOTON_GATHER_MAX_K)
+		{
+			throw std::exception("The number of nearest photons to gather must be between 1 and PHOTON_GATHER_MAX_K.");
+		}
+		photonGatherK = nearestPhotons;
+	}
+
+	m_photonGatherK = photonGatherK;
+	if(m_initialized)
+	{
+		m_context["photonGatherK"]->setUint(m_photonGatherK);
+	}
+}
+
 Program PMOptixRenderer::createProgram(const std::string& filename, const std::string programName)
 {
 	try {
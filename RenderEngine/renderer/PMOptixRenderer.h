@@ -9,19 +9,21 @@
 #include <optixu/optixpp_namespace.h>
 #include <optixu/optixu_aabb_namespace.h>
 #include "render_engine_export_api.h"
-#include "OptixRenderer.h"
+#include "PhotonRenderer.h"
 #include "math/AAB.h"
 #include "logging/Logger.h"
 #include <vector>
 #include <string>
 #include <functional>
 #include "RendererStatistics.h"
+#include "PhotonGatherMode.h"
 
 
 class ComputeDevice;
 class RenderServerRenderRequestDetails;
 class Scene;
 class Camera;
+class QRect;
 template <class Key, class T> class QMap;
 
 namespace optix {
@@ -29,7 +31,7 @@ namespace optix {
 	typedef Matrix<4,4> Matrix4x4;
 }
 
-class PMOptixRenderer: public OptixRenderer
+class PMOptixRenderer: public PhotonRenderer
 {
 public:
 
@@ -42,7 +44,12 @@ public:
     RENDER_ENGINE_EXPORT_API void renderNextIteration(unsigned long long iterationNumber, unsigned long long localIterationNumber, 
         float PPMRadius, const RenderServerRenderRequestDetails & details);
 	RENDER_ENGINE_EXPORT_API void render(unsigned int photonLaunchWidth, unsigned int height, unsigned int width, const Camera camera, bool generateOutput, bool storefirstHitPhotons);
+	RENDER_ENGINE_EXPORT_API void makeCurrent();
+	RENDER_ENGINE_EXPORT_API void setRandomSeed(unsigned int seed);
+	RENDER_ENGINE_EXPORT_API unsigned long long getLaunchNumber() const;
+	RENDER_ENGINE_EXPORT_API void setLaunchNumber(unsigned long long launchNumber);
 	RENDER_ENGINE_EXPORT_API void buildPhotonBuffer(unsigned int photonLaunchWidth);
+	RENDER_ENGINE_EXPORT_API void tracePhotonStatistics(unsigned int photonLaunchWidth);
     RENDER_ENGINE_EXPORT_API void getOutputBuffer(void* data);
 	RENDER_ENGINE_EXPORT_API std::vector<unsigned int> getHitCount();
     RENDER_ENGINE_EXPORT_API unsigned int getWidth() const;
@@ -60,6 +67,8 @@ public:
 	RENDER_ENGINE_EXPORT_API unsigned int totalPhotons();
 	RENDER_ENGINE_EXPORT_API unsigned int getMaxPhotonWidth();
 	RENDER_ENGINE_EXPORT_API RendererStatistics getStatistics();
+	RENDER_ENGINE_EXPORT_API void setBuildPhotonMapOnCPU(bool buildOnCPU);
+	RENDER_ENGINE_EXPORT_API void setPhotonGatherMode(PhotonGatherMode::E mode, unsigned int nearestPhotons = 0);
 
     const static unsigned int PHOTON_GRID_MAX_SIZE;
 private:
@@ -67,15 +76,20 @@ private:
     const static unsigned int MAX_PHOTON_COUNT;
 
 	unsigned int getNumPhotons() const;
+	void renderTile(unsigned int photonLaunchWidth, const QRect & tile, unsigned int imageWidth, unsigned int imageHeight,
+		const Camera & camera, bool generateOutput, bool storefirstHitPhotons);
 
     void initDevice(const ComputeDevice & device);
 	void compile();
     void loadObjGeometry( const std::string& filename, optix::Aabb& bbox );
     void initializeRandomStates();
     void createUniformGridPhotonMap(float ppmRadius);
+    void createUniformGridPhotonMapOnCPU();
     void initializeStochasticHashPhotonMap(float ppmRadius);
     void createPhotonKdTreeOnCPU();
 	void resizeBuffers(unsigned int width, unsigned int height, unsigned int generateOutput);
+	void resizeRandomStates(unsigned int width, unsigned int height);
+	void clearHitCountPerObject();
 	void countHitCountPerObject();
 	optix::Group getGroup(const QString &nodeName);
 	void transformNodeImpl(const QString &nodeName, const optix::Matrix4x4 &transformation, bool preMultiply);
@@ -106,10 +120,16 @@ private:
     unsigned int m_width;
     unsigned int m_height;
 	unsigned int m_photonWidth;
+	unsigned int m_tracedPhotonWidth;
 	unsigned int m_sceneObjects;
 	float m_totalLightPower;
     bool m_initialized;
+	bool m_buildPhotonMapOnCPU;
+	unsigned int m_photonGatherK;
     int m_optixDeviceOrdinal;
+	unsigned int m_randomSeed;
+	// Photon passes seeded so far, the random states are seeded again before each one
+	unsigned long long m_launchNumber;
 	std::vector<std::string> m_objectIdToName;
 	QMap<QString, optix::Group>* m_groups;
 	QMap<QString, QList<int>> *m_lights; // a mapping to Light name to light position into m_lightBuffer
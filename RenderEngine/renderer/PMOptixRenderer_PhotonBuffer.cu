@@ -27,39 +27,27 @@
 #include "renderer/OptixEntryPoint.h"
 #include "renderer/helpers/optix.h"
 #include "renderer/helpers/random.h"
+#include "renderer/helpers/atomic.h"
 #include "renderer/helpers/nsight.h"
 #include "math/Vector3.h"
 
-// From https://devtalk.nvidia.com/default/topic/458062/atomicadd-float-float-atomicmul-float-float-/
-__device__ inline void floatAtomicAdd(float* address, float value)
-{
-	float old = value;
-	float new_old;
-
-	do
-	{
-		new_old = atomicExch(address, 0.0f);
-		new_old += old;
-	} while ((old = atomicExch(address, new_old)) != 0.0f);
-};
-
 __global__ void sumPhotonsHitCount(Photon* photons, unsigned int numPhotons, unsigned int *hitCount, float *rawRadiance)
 {
 	unsigned int index = blockIdx.x*blockDim.x + threadIdx.x;
 	if (index < numPhotons)
 	{
 		Photon & photon = photons[index];
-		if (fmaxf(photon.power) > 0)
+		if (photonHasPower(photon))
 		{
+			float3 power = getPhotonPower(photon);
 			atomicAdd(hitCount + photon.objectId, 1);
-			floatAtomicAdd(rawRadiance + photon.objectId, photon.power.x + photon.power.y + photon.power.z);
+			floatAtomicAdd(rawRadiance + photon.objectId, power.x + power.y + power.z);
 		}
 	}
 }
 
-void PMOptixRenderer::countHitCountPerObject()
+void PMOptixRenderer::clearHitCountPerObject()
 {
-	nvtxRangePushA("countHitCountPerObject");
 	int deviceNumber = 0;
 	cudaSetDevice(m_optixDeviceOrdinal);
 
@@ -68,6 +56,16 @@ void PMOptixRenderer::countHitCountPerObject()
 
 	thrust::device_ptr<float> rawRadiance = getThrustDevicePtr<float>(m_rawRadianceBuffer, deviceNumber);
 	thrust::fill(rawRadiance, rawRadiance + m_sceneObjects, 0);
+}
+
+void PMOptixRenderer::countHitCountPerObject()
+{
+	nvtxRangePushA("countHitCountPerObject");
+	int deviceNumber = 0;
+	clearHitCountPerObject();
+
+	thrust::device_ptr<unsigned int> hitCount = getThrustDevicePtr<unsigned int>(m_hitCountBuffer, deviceNumber);
+	thrust::device_ptr<float> rawRadiance = getThrustDevicePtr<float>(m_rawRadianceBuffer, deviceNumber);
 
 	unsigned int numPhotons = getNumPhotons();
 	const unsigned int blockSize = 512;
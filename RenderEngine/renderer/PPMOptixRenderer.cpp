@@ -17,6 +17,7 @@
 #include "renderer/OptixEntryPoint.h"
 #include "renderer/Hitpoint.h"
 #include "renderer/ppm/Photon.h"
+#include "renderer/ppm/PackedPhoton.h"
 #include "Camera.h"
 #include <QThread>
 #include <sstream>
@@ -38,6 +39,8 @@ const unsigned int PPMOptixRenderer::PHOTON_GRID_MAX_SIZE = 0;
 const unsigned int PPMOptixRenderer::MAX_PHOTON_COUNT = MAX_PHOTONS_DEPOSITS_PER_EMITTED;
 const unsigned int PPMOptixRenderer::PHOTON_LAUNCH_WIDTH = 512;
 const unsigned int PPMOptixRenderer::PHOTON_LAUNCH_HEIGHT = 512;
+// Incremental persistent photon grid builds per comparison with a full build, see comparePersistentPhotonGridBuild
+const unsigned int PPMOptixRenderer::PERSISTENT_PHOTON_GRID_COMPARE_INTERVAL = 16;
 // Ensure that NUM PHOTONS are a power of 2 for stochastic hash
 
 const unsigned int PPMOptixRenderer::EMITTED_PHOTONS_PER_ITERATION = PPMOptixRenderer::PHOTON_LAUNCH_WIDTH*PPMOptixRenderer::PHOTON_LAUNCH_HEIGHT;
@@ -63,6 +66,11 @@ inline float max(float a, float b)
 
 PPMOptixRenderer::PPMOptixRenderer() : 
     m_initialized(false),
+    m_buildPhotonMapOnCPU(false),
+    m_photonGatherK(0),
+    m_persistentPhotonGrid(false),
+    m_persistentPhotonGridValid(false),
+    m_lastIncrementalPhotonMapBuildTime(0),
     m_width(10),
     m_height(10)
 {
@@ -111,9 +119,12 @@ void PPMOptixRenderer::initialize(const ComputeDevice & device, Logger *logger)
     m_context["totalEmitted"]->setFloat(0.0f);
     m_context["iterationNumber"]->setFloat(0.0f);
     m_context["localIterationNumber"]->setUint(0);
+    m_context["imageOffset"]->setUint(0, 0);
+    m_context["imageSize"]->setUint(m_width, m_height);
     m_context["ppmRadius"]->setFloat(0.f);
     m_context["ppmRadiusSquared"]->setFloat(0.f);
     m_context["ppmRadiusSquaredNew"]->setFloat(0.f);
+    m_context["photonGatherK"]->setUint(m_photonGatherK);
     m_context["ppmDefaultRadius2"]->setFloat(0.f);
     m_context["emittedPhotonsPerIteration"]->setUint(EMITTED_PHOTONS_PER_ITERATION);
     m_context["emittedPhotonsPerIterationFloat"]->setFloat(float(EMITTED_PHOTONS_PER_ITERATION));
@@ -121,6 +132,14 @@ void PPMOptixRenderer::initialize(const ComputeDevice & device, Logger *logger)
     m_context["participatingMedium"]->setUint(0);
 	m_context["storefirstHitPhotons"]->setUint(0);
 
+    // The Diffuse and Texture photon programs can count hits per object instead of storing photons, which only
+    // PMOptixRenderer uses. The PPM context never does, but the variables and buffers must still be bound.
+    m_context["photonStatisticsOnly"]->setUint(0);
+    optix::Buffer hitCountBuffer = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_UNSIGNED_INT, 1);
+    m_context["hitCount"]->set(hitCountBuffer);
+    optix::Buffer rawRadianceBuffer = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_FLOAT, 1);
+    m_context["rawRadiance"]->set(rawRadianceBuffer);
+
     // An empty scene root node
     optix::Group group = m_context->createGroup();
     m_context["sceneRootObject"]->set(group);
@@ -171,7 +190,10 @@ void PPMOptixRenderer::initialize(const ComputeDevice & device, Logger *logger)
         //m_context->setExceptionProgram(OptixEntryPoint::PPM_PHOTON_PASS, exceptionProgram);
     }
 
-    m_photons = m_context->createBuffer(RT_BUFFER_OUTPUT);
+    // Host builds write the sorted photons back, so the photon map buffers must be host writable
+    RTbuffertype photonMapBufferType = m_buildPhotonMapOnCPU ? RT_BUFFER_INPUT_OUTPUT : RT_BUFFER_OUTPUT;
+
+    m_photons = m_context->createBuffer(photonMapBufferType);
     m_photons->setFormat( RT_FORMAT_USER );
     m_photons->setElementSize( sizeof( Photon ) );
     m_photons->setSize( NUM_PHOTONS );
@@ -196,7 +218,7 @@ void PPMOptixRenderer::initialize(const ComputeDevice & device, Logger *logger)
     m_photonKdTreeSize = pow2roundup( NUM_PHOTONS + 1 ) - 1;
     m_photonKdTree = m_context->createBuffer( RT_BUFFER_INPUT );
     m_photonKdTree->setFormat( RT_FORMAT_USER );
-    m_photonKdTree->setElementSize( sizeof( Photon ) );
+    m_photonKdTree->setElementSize( sizeof( PackedPhoton ) );
     m_photonKdTree->setSize( m_photonKdTreeSize );
     m_context["photonKdTree"]->set( m_photonKdTree );
 
@@ -205,14 +227,25 @@ void PPMOptixRenderer::initialize(const ComputeDevice & device, Logger *logger)
     m_context["photonsGridCellSize"]->setFloat(0.0f);
     m_context["photonsGridSize"]->setUint(0,0,0);
     m_context["photonsWorldOrigo"]->setFloat(make_float3(0));
-    m_photonsHashCells = m_context->createBuffer(RT_BUFFER_OUTPUT);
+    m_photonsHashCells = m_context->createBuffer(photonMapBufferType);
     m_photonsHashCells->setFormat( RT_FORMAT_UNSIGNED_INT );
     m_photonsHashCells->setSize( NUM_PHOTONS );
-    m_hashmapOffsetTable = m_context->createBuffer(RT_BUFFER_OUTPUT);
+    m_hashmapOffsetTable = m_context->createBuffer(photonMapBufferType);
     m_hashmapOffsetTable->setFormat( RT_FORMAT_UNSIGNED_INT );
     m_hashmapOffsetTable->setSize( PHOTON_GRID_MAX_SIZE+1 );
     m_context["hashmapOffsetTable"]->set( m_hashmapOffsetTable );
 
+    if(m_persistentPhotonGrid)
+    {
+        // Scatter targets for binning into the persistent grid, kept for the lifetime of the renderer
+        m_photonsScratch = m_context->createBuffer(RT_BUFFER_OUTPUT);
+        m_photonsScratch->setFormat( RT_FORMAT_USER );
+        m_photonsScratch->setElementSize( sizeof( Photon ) );
+        m_photonsScratch->setSize( NUM_PHOTONS );
+        m_photonsHashCellsScratch = m_context->createBuffer(RT_BUFFER_OUTPUT, RT_FORMAT_UNSIGNED_INT, NUM_PHOTONS);
+        m_hashmapCellCursors = m_context->createBuffer(RT_BUFFER_OUTPUT, RT_FORMAT_UNSIGNED_INT, PHOTON_GRID_MAX_SIZE+1);
+    }
+
 #endif
 
     //
@@ -385,6 +418,7 @@ void PPMOptixRenderer::initScene( Scene & scene )
         m_sceneRootGroup = scene.getSceneRootGroup(m_context);
         m_context["sceneRootObject"]->set(m_sceneRootGroup);
         m_sceneAABB = scene.getSceneAABB();
+        m_persistentPhotonGridValid = false;
         Sphere sceneBoundingSphere = m_sceneAABB.getBoundingSphere();
         m_context["sceneBoundingSphere"]->setUserData(sizeof(Sphere), &sceneBoundingSphere);
 
@@ -435,11 +469,15 @@ void PPMOptixRenderer::renderNextIteration(unsigned long long iterationNumber, u
     {
 		m_context["storefirstHitPhotons"]->setUint(0); // don't store first hits as it will use radiance to calculate shadows
 
-        // If the width and height of the current render request has changed, we must resize buffers
-        if(details.getWidth() != m_width || details.getHeight() != m_height)
+        // Only the tile of the image the request asks for is traced, so the buffers and launches have the size of
+        // the tile. If it has changed, we must resize buffers.
+        const QRect tile = details.getTile();
+        if((unsigned int)tile.width() != m_width || (unsigned int)tile.height() != m_height)
         {
-            this->resizeBuffers(details.getWidth(), details.getHeight());
+            this->resizeBuffers(tile.width(), tile.height(), iterationNumber);
         }
+        m_context["imageOffset"]->setUint(tile.left(), tile.top());
+        m_context["imageSize"]->setUint(details.getWidth(), details.getHeight());
 
         const Camera & camera = details.getCamera();
         const RenderMethod::E renderMethod = details.getRenderMethod();
@@ -516,12 +554,20 @@ void PPMOptixRenderer::renderNextIteration(unsigned long long iterationNumber, u
             //
             {
                 nvtx::ScopedRange r( "Creating photon map" );
+                double buildStartTime = sutilCurrentTime();
 #if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_KD_TREE_CPU
                 createPhotonKdTreeOnCPU();
 #elif ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_UNIFORM_GRID
                 createUniformGridPhotonMap(PPMRadius);
 #endif
+                m_statistics.buildPhotonMapTime += sutilCurrentTime() - buildStartTime;
+            }
+#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_UNIFORM_GRID
+            if(m_persistentPhotonGrid && !m_buildPhotonMapOnCPU)
+            {
+                comparePersistentPhotonGridBuild();
             }
+#endif
 
 
 #if ENABLE_PARTICIPATING_MEDIA
@@ -567,6 +613,9 @@ void PPMOptixRenderer::renderNextIteration(unsigned long long iterationNumber, u
                 m_context->launch(OptixEntryPoint::PPM_INDIRECT_RADIANCE_ESTIMATION_PASS,
                     m_width, m_height);
             }
+#if ENABLE_RENDER_DEBUG_OUTPUT
+            countIndirectRadianceGatherVisits();
+#endif
 
             //
             // Direct Radiance Estimation
@@ -602,15 +651,16 @@ static inline unsigned int max(unsigned int a, unsigned int b)
     return a > b ? a : b;
 }
 
-void PPMOptixRenderer::resizeBuffers(unsigned int width, unsigned int height)
+void PPMOptixRenderer::resizeBuffers(unsigned int width, unsigned int height, unsigned long long iterationNumber)
 {
     m_outputBuffer->setSize( width, height );
     m_raytracePassOutputBuffer->setSize( width, height );
     m_outputBuffer->setSize( width, height );
     m_directRadianceBuffer->setSize( width, height );
     m_indirectRadianceBuffer->setSize( width, height );
-    m_randomStatesBuffer->setSize(max(PHOTON_LAUNCH_WIDTH, (unsigned int)1280), max(PHOTON_LAUNCH_HEIGHT,  (unsigned int)768));
-    initializeRandomStates();
+    // The photon pass and the ray trace pass both index the random states by their launch index
+    m_randomStatesBuffer->setSize(max(PHOTON_LAUNCH_WIDTH, width), max(PHOTON_LAUNCH_HEIGHT, height));
+    initializeRandomStates(iterationNumber);
     m_width = width;
     m_height = height;
 }
@@ -637,6 +687,62 @@ unsigned int PPMOptixRenderer::getScreenBufferSizeBytes() const
     return m_width*m_height*sizeof(optix::float3);
 }
 
+// Build the uniform grid photon map on the host instead of through Thrust on the device. The photon
+// map buffers are created host writable when this is set, so it must be chosen before initialize.
+void PPMOptixRenderer::setBuildPhotonMapOnCPU(bool buildOnCPU)
+{
+    if(m_initialized)
+    {
+        throw std::exception("The photon map build device must be set before PPMOptixRenderer is initialized.");
+    }
+    m_buildPhotonMapOnCPU = buildOnCPU;
+}
+
+/*
+// Keep the uniform grid dimensioned to the scene bounds across iterations, so that each iteration only
+// bins its new photons into the existing cells with a counting sort. The grid is only dimensioned again,
+// with a full sorted build, when its size changes. Applies to the device grid build.
+*/
+void PPMOptixRenderer::setPersistentPhotonGrid(bool persistent)
+{
+    if(m_initialized)
+    {
+        throw std::exception("The persistent photon grid must be set before PPMOptixRenderer is initialized.");
+    }
+    m_persistentPhotonGrid = persistent;
+}
+
+RendererStatistics PPMOptixRenderer::getStatistics() const
+{
+    return m_statistics;
+}
+
+/*
+// K_NEAREST_NEIGHBOURS estimates the radiance from the nearestPhotons closest photons within the PPM
+// radius instead of from all of them, adapting the estimate radius to the local photon density.
+*/
+void PPMOptixRenderer::setPhotonGatherMode(PhotonGatherMode::E mode, unsigned int nearestPhotons)
+{
+    unsigned int photonGatherK = 0;
+    if(mode == PhotonGatherMode::K_NEAREST_NEIGHBOURS)
+    {
+#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_STOCHASTIC_HASH
+        throw std::exception("The k-nearest-neighbour photon gather is not supported with the stochastic hash photon map.");
+#endif
+        if(nearestPhotons == 0 || nearestPhotons > PHOTON_GATHER_MAX_K)
+        {
+            throw std::exception("The number of nearest photons to gather must be between 1 and PHOTON_GATHER_MAX_K.");
+        }
+        photonGatherK = nearestPhotons;
+    }
+
+    m_photonGatherK = photonGatherK;
+    if(m_initialized)
+    {
+        m_context["photonGatherK"]->setUint(m_photonGatherK);
+    }
+}
+
 void PPMOptixRenderer::debugOutputPhotonTracing()
 {
 #if ENABLE_RENDER_DEBUG_OUTPUT
@@ -740,6 +846,37 @@ void PPMOptixRenderer::debugOutputPhotonTracing()
 #endif
 }
 
+/*
+// Adds the cells and photons the last indirect radiance pass visited to the statistics. The debug buffers
+// are larger than the launch, so they are read row by row.
+*/
+void PPMOptixRenderer::countIndirectRadianceGatherVisits()
+{
+#if ENABLE_RENDER_DEBUG_OUTPUT
+    optix::Buffer cellsBuffer = m_context["debugIndirectRadianceCellsVisisted"]->getBuffer();
+    optix::Buffer photonsBuffer = m_context["debugIndirectRadiancePhotonsVisisted"]->getBuffer();
+    RTsize bufferWidth, bufferHeight;
+    cellsBuffer->getSize(bufferWidth, bufferHeight);
+    const unsigned int* cellsVisited = (const unsigned int*)cellsBuffer->map();
+    const unsigned int* photonsVisited = (const unsigned int*)photonsBuffer->map();
+    for(unsigned int y = 0; y < m_height; y++)
+    {
+        for(unsigned int x = 0; x < m_width; x++)
+        {
+            size_t index = y*bufferWidth + x;
+            if(cellsVisited[index] > 0 || photonsVisited[index] > 0)
+            {
+                m_statistics.indirectRadianceHitpoints++;
+                m_statistics.indirectRadianceCellsVisited += cellsVisited[index];
+                m_statistics.indirectRadiancePhotonsVisited += photonsVisited[index];
+            }
+        }
+    }
+    photonsBuffer->unmap();
+    cellsBuffer->unmap();
+#endif
+}
+
 void PPMOptixRenderer::createGpuDebugBuffers()
 {
 #if ENABLE_RENDER_DEBUG_OUTPUT
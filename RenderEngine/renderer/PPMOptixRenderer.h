@@ -12,6 +12,8 @@
 #include "OptixRenderer.h"
 #include "math/AAB.h"
 #include "logging/Logger.h"
+#include "PhotonGatherMode.h"
+#include "RendererStatistics.h"
 
 class ComputeDevice;
 class RenderServerRenderRequestDetails;
@@ -35,6 +37,10 @@ public:
     RENDER_ENGINE_EXPORT_API unsigned int getWidth() const;
     RENDER_ENGINE_EXPORT_API unsigned int getHeight() const;
     RENDER_ENGINE_EXPORT_API unsigned int getScreenBufferSizeBytes() const;
+    RENDER_ENGINE_EXPORT_API void setBuildPhotonMapOnCPU(bool buildOnCPU);
+    RENDER_ENGINE_EXPORT_API void setPhotonGatherMode(PhotonGatherMode::E mode, unsigned int nearestPhotons = 0);
+    RENDER_ENGINE_EXPORT_API void setPersistentPhotonGrid(bool persistent);
+    RENDER_ENGINE_EXPORT_API RendererStatistics getStatistics() const;
 
     const static unsigned int NUM_PHOTONS;
     const static float PPM_INITIAL_RADIUS;
@@ -45,8 +51,11 @@ private:
     void initDevice(const ComputeDevice & device);
     void compile();
     void loadObjGeometry( const std::string& filename, optix::Aabb& bbox );
-    void initializeRandomStates();
+    void initializeRandomStates(unsigned long long iterationNumber);
     void createUniformGridPhotonMap(float ppmRadius);
+    void createUniformGridPhotonMapOnCPU();
+    void createPersistentUniformGridPhotonMap();
+    void comparePersistentPhotonGridBuild();
     void initializeStochasticHashPhotonMap(float ppmRadius);
     void createPhotonKdTreeOnCPU();
 
@@ -62,6 +71,9 @@ private:
     optix::Buffer m_volumetricPhotonsBuffer;
     optix::Buffer m_lightBuffer;
     optix::Buffer m_randomStatesBuffer;
+    optix::Buffer m_photonsScratch;
+    optix::Buffer m_photonsHashCellsScratch;
+    optix::Buffer m_hashmapCellCursors;
 
     unsigned int m_photonKdTreeSize;
     unsigned long long m_numberOfPhotonsLastFrame;
@@ -74,14 +86,23 @@ private:
     unsigned int m_height;
 
     bool m_initialized;
+    bool m_buildPhotonMapOnCPU;
+    unsigned int m_photonGatherK;
+    bool m_persistentPhotonGrid;
+    bool m_persistentPhotonGridValid;
+    // Time of the last persistent photon grid build when it binned into the existing grid, 0 otherwise
+    double m_lastIncrementalPhotonMapBuildTime;
+    RendererStatistics m_statistics;
 
     const static unsigned int MAX_BOUNCES;
     const static unsigned int MAX_PHOTON_COUNT;
     const static unsigned int PHOTON_LAUNCH_WIDTH;
     const static unsigned int PHOTON_LAUNCH_HEIGHT;
+    const static unsigned int PERSISTENT_PHOTON_GRID_COMPARE_INTERVAL;
    
-    void resizeBuffers(unsigned int width, unsigned int height);
+    void resizeBuffers(unsigned int width, unsigned int height, unsigned long long iterationNumber);
     void debugOutputPhotonTracing();
+    void countIndirectRadianceGatherVisits();
     optix::Context m_context;
     int m_optixDeviceOrdinal;
 
@@ -0,0 +1,21 @@
+/* 
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+
+// Largest k supported by the k-nearest-neighbour gather, bounded by the per-thread heap size
+#define PHOTON_GATHER_MAX_K 32
+
+namespace PhotonGatherMode
+{
+    enum E
+    {
+        // Gather every photon within the PPM radius
+        FIXED_RADIUS,
+        // Gather the k nearest photons within the PPM radius, estimating over the distance to the k-th
+        K_NEAREST_NEIGHBOURS
+    };
+}
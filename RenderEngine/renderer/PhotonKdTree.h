@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+
+#include "render_engine_export_api.h"
+
+struct Photon;
+struct PackedPhoton;
+
+/*
+  Builds the left-balanced kd-tree heap expected by the indirect radiance estimation programs out of the
+  photons with power, see OptixRenderer_CPUKdTree.cpp: the root is at index 0 and the children of node i are
+  at 2*i+1 and 2*i+2. photonKdTree must hold pow2roundup(numPhotons+1)-1 nodes. Near the root the median
+  searches are split across numThreads and subtrees are built as concurrent tasks, numThreads 1 builds on
+  the calling thread only. Photons whose coordinates are distinct along every axis give the same tree for
+  any numThreads. Returns the number of photons with power stored in the tree.
+*/
+RENDER_ENGINE_EXPORT_API unsigned int buildPhotonKdTree(const Photon* photons, unsigned int numPhotons, PackedPhoton* photonKdTree,
+                                                        int numThreads);
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+
+#include <optixu/optixu_math_namespace.h>
+#include <optixu/optixu_matrix_namespace.h>
+#include "render_engine_export_api.h"
+#include "OptixRenderer.h"
+#include "RendererStatistics.h"
+#include "math/Vector3.h"
+#include <vector>
+#include <string>
+
+class QString;
+
+/*
+  A renderer that traces photons and counts where they are stored, per object. Both PMOptixRenderer and
+  PMCPURenderer implement it, so the RPSolver conditions and objectives can run on either of them.
+  A renderer is not thread safe, its OptiX context must not be used by two threads at once. It can move
+  between threads, but a thread other than the one that initialized it must call makeCurrent first.
+*/
+class PhotonRenderer: public OptixRenderer
+{
+protected:
+	PhotonRenderer()
+	{
+	}
+public:
+	// Selects the device of the renderer for the CUDA calls of the calling thread
+	RENDER_ENGINE_EXPORT_API virtual void makeCurrent() = 0;
+	// The random numbers of a launch only depend on the seed and the number of the launch. Restoring the
+	// launch number, as a checkpoint does, traces the same photons as the run it was taken from.
+	RENDER_ENGINE_EXPORT_API virtual void setRandomSeed(unsigned int seed) = 0;
+	RENDER_ENGINE_EXPORT_API virtual unsigned long long getLaunchNumber() const = 0;
+	RENDER_ENGINE_EXPORT_API virtual void setLaunchNumber(unsigned long long launchNumber) = 0;
+	RENDER_ENGINE_EXPORT_API virtual void buildPhotonBuffer(unsigned int photonLaunchWidth) = 0;
+	// Same results as buildPhotonBuffer without keeping the photons, so its memory doesn't grow with the width
+	RENDER_ENGINE_EXPORT_API virtual void tracePhotonStatistics(unsigned int photonLaunchWidth) = 0;
+	RENDER_ENGINE_EXPORT_API virtual std::vector<unsigned int> getHitCount() = 0;
+	RENDER_ENGINE_EXPORT_API virtual std::vector<float> getRadiance() = 0;
+	RENDER_ENGINE_EXPORT_API virtual float getEmittedPower() = 0;
+	RENDER_ENGINE_EXPORT_API virtual unsigned int totalPhotons() = 0;
+	RENDER_ENGINE_EXPORT_API virtual unsigned int getMaxPhotonWidth() = 0;
+	RENDER_ENGINE_EXPORT_API virtual void setLightDirection(const QString &lightName, const Vector3 &direction) = 0;
+	RENDER_ENGINE_EXPORT_API virtual void setNodeTransformation(const QString &nodeName, const optix::Matrix4x4 &transformation) = 0;
+	RENDER_ENGINE_EXPORT_API virtual void setNodeDiffuseMaterialKd(const QString &nodeName, optix::float3 kd) = 0;
+	RENDER_ENGINE_EXPORT_API virtual const std::vector<std::string>& objectToNameMapping() const = 0;
+	RENDER_ENGINE_EXPORT_API virtual RendererStatistics getStatistics() = 0;
+};
@@ -11,7 +11,13 @@ struct RendererStatistics {
 		directRadiancePassTime(0),
 		indirectRadiancePassTime(0),
 		outputPassTime(0),
-		recalcAccelerationStructures(0)
+		recalcAccelerationStructures(0),
+		buildPhotonMapTimeSaved(0),
+		incrementalPhotonMapBuilds(0),
+		comparedPhotonMapBuilds(0),
+		indirectRadianceHitpoints(0),
+		indirectRadianceCellsVisited(0),
+		indirectRadiancePhotonsVisited(0)
 	{
 
 	}
@@ -26,4 +32,15 @@ struct RendererStatistics {
 	double indirectRadiancePassTime;
 	double outputPassTime;
 	double recalcAccelerationStructures;
+	// Build time saved by binning into a persistent photon grid instead of rebuilding it, measured against
+	// a full build of the same photons in the same frame on comparedPhotonMapBuilds of the
+	// incrementalPhotonMapBuilds. Divide by comparedPhotonMapBuilds for the saving per iteration.
+	double buildPhotonMapTimeSaved;
+	unsigned int incrementalPhotonMapBuilds;
+	unsigned int comparedPhotonMapBuilds;
+	// Cost of the indirect radiance gathers, from the debugIndirectRadiance*Visisted counters and so only
+	// counted with ENABLE_RENDER_DEBUG_OUTPUT. Hitpoints are those that visited any cell or photon.
+	unsigned long long indirectRadianceHitpoints;
+	unsigned long long indirectRadianceCellsVisited;
+	unsigned long long indirectRadiancePhotonsVisited;
 };
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "config.h"
+#include <cuda.h>
+#include <optix_world.h>
+#include "renderer/ppm/Photon.h"
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <vector>
+#include "renderer/ppm/PhotonGrid.h"
+#include "renderer/UniformGridPhotonMap.h"
+#include "renderer/PPMOptixRenderer.h"
+#include "renderer/PMOptixRenderer.h"
+#include "renderer/helpers/nsight.h"
+#include "util/ParallelFor.h"
+
+#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_UNIFORM_GRID
+
+using namespace optix;
+
+// Smallest number of photons handed to a worker thread
+static const int UNIFORM_GRID_MIN_CHUNK_PHOTONS = 1 << 14;
+
+struct HashedPhoton
+{
+    unsigned int hashCell;
+    unsigned int index;
+};
+
+/*
+  Stable LSD radix sort on the cell keys, 8 bits per pass and only as many passes as maxKey needs.
+  Every pass counts digits per chunk, scans the counts digit-major so that equal digits keep their
+  chunk order, and scatters the chunks in parallel. Stability matters: thrust::sort_by_key on
+  unsigned keys is a stable radix sort too, which is what makes both builds produce the same order.
+*/
+static void radixSortByHashCell(std::vector<HashedPhoton> & keys, std::vector<HashedPhoton> & scratch, unsigned int maxKey, int numThreads)
+{
+    const int RADIX_BITS = 8;
+    const int RADIX = 1 << RADIX_BITS;
+    int numKeys = (int)keys.size();
+
+    for(int shift = 0; shift < 32 && (maxKey >> shift) != 0; shift += RADIX_BITS)
+    {
+        std::vector<unsigned int> chunkOffsets(numThreads*RADIX, 0);
+        int numChunks = parallelForChunks(0, numKeys, numThreads, UNIFORM_GRID_MIN_CHUNK_PHOTONS, [&](int chunk, int from, int to)
+        {
+            unsigned int* histogram = &chunkOffsets[chunk*RADIX];
+            for(int i = from; i < to; ++i)
+            {
+                histogram[(keys[i].hashCell >> shift) & (RADIX-1)]++;
+            }
+        });
+
+        unsigned int offset = 0;
+        for(int digit = 0; digit < RADIX; ++digit)
+        {
+            for(int chunk = 0; chunk < numChunks; ++chunk)
+            {
+                unsigned int count = chunkOffsets[chunk*RADIX + digit];
+                chunkOffsets[chunk*RADIX + digit] = offset;
+                offset += count;
+            }
+        }
+
+        parallelForChunks(0, numKeys, numThreads, UNIFORM_GRID_MIN_CHUNK_PHOTONS, [&](int chunk, int from, int to)
+        {
+            unsigned int* offsets = &chunkOffsets[chunk*RADIX];
+            for(int i = from; i < to; ++i)
+            {
+                scratch[offsets[(keys[i].hashCell >> shift) & (RADIX-1)]++] = keys[i];
+            }
+        });
+
+        keys.swap(scratch);
+    }
+}
+
+UniformGridPhotonMap buildUniformGridPhotonMapOnCPU(Photon* photons, unsigned int* photonsHashCell, unsigned int* hashmapOffsetTable,
+                                                    unsigned int numPhotons, unsigned int maxGridSize)
+{
+    int numThreads = getHardwareThreadCount();
+    int n = (int)numPhotons;
+
+    //
+    // Get the AABB that contains all valid scene photons
+    //
+
+    std::vector<float3> chunkMin(numThreads, make_float3(  std::numeric_limits<float>::max() ));
+    std::vector<float3> chunkMax(numThreads, make_float3( -std::numeric_limits<float>::max() ));
+    std::vector<unsigned int> chunkValidPhotons(numThreads, 0);
+    int numChunks = parallelForChunks(0, n, numThreads, UNIFORM_GRID_MIN_CHUNK_PHOTONS, [&](int chunk, int from, int to)
+    {
+        for(int i = from; i < to; ++i)
+        {
+            if(photonHasPower(photons[i]))
+            {
+                chunkMin[chunk] = fminf(chunkMin[chunk], photons[i].position);
+                chunkMax[chunk] = fmaxf(chunkMax[chunk], photons[i].position);
+                chunkValidPhotons[chunk]++;
+            }
+        }
+    });
+
+    UniformGridPhotonMap result;
+    float3 bbmin = chunkMin[0];
+    float3 bbmax = chunkMax[0];
+    result.numValidPhotons = chunkValidPhotons[0];
+    for(int chunk = 1; chunk < numChunks; ++chunk)
+    {
+        bbmin = fminf(bbmin, chunkMin[chunk]);
+        bbmax = fmaxf(bbmax, chunkMax[chunk]);
+        result.numValidPhotons += chunkValidPhotons[chunk];
+    }
+    if(result.numValidPhotons == 0)
+    {
+        bbmin = make_float3(0.0f);
+        bbmax = make_float3(0.0f);
+    }
+
+    // Same padding as padAABB so the grid has empty cells on the surface of the volume
+    bbmin = bbmin - 0.0000001f;
+    bbmax = bbmax + 0.0000001f;
+    float3 sceneExtent = bbmax - bbmin;
+
+    float smallestPossibleCellSize = getSmallestPossibleCellSize(sceneExtent, maxGridSize);
+    float cellSize = smallestPossibleCellSize+0.001;
+
+    result.worldOrigo = bbmin;
+    result.gridSize = calculateGridSizeWithinMaxCellKeys(sceneExtent, cellSize, maxGridSize);
+    result.cellSize = cellSize;
+    result.numHashCells = getPhotonGridNumCellKeys(result.gridSize);
+
+    if(result.numHashCells > maxGridSize)
+    {
+        throw std::exception("Too many cells in UniformGridPhotonMap.cpp, over defined PHOTON_GRID_MAX_SIZE.");
+    }
+
+    //
+    // Calculate the hash cell of each photon
+    //
+
+    unsigned int invalidHashCellValue = result.numHashCells+1;
+    std::vector<HashedPhoton> keys(n);
+    std::vector<HashedPhoton> scratch(n);
+    parallelForChunks(0, n, numThreads, UNIFORM_GRID_MIN_CHUNK_PHOTONS, [&](int, int from, int to)
+    {
+        for(int i = from; i < to; ++i)
+        {
+            if(photonHasPower(photons[i]))
+            {
+                uint3 hashGridPos = getPhotonGridIndex(photons[i].position, result.worldOrigo, cellSize);
+                keys[i].hashCell = getPhotonGridCellKey(hashGridPos, result.gridSize);
+            }
+            else
+            {
+                keys[i].hashCell = invalidHashCellValue;
+            }
+            keys[i].index = i;
+        }
+    });
+
+    //
+    // Sort the photons by their hash value
+    //
+
+    radixSortByHashCell(keys, scratch, invalidHashCellValue, numThreads);
+
+    std::vector<Photon> sortedPhotons(n);
+    parallelForChunks(0, n, numThreads, UNIFORM_GRID_MIN_CHUNK_PHOTONS, [&](int, int from, int to)
+    {
+        for(int i = from; i < to; ++i)
+        {
+            sortedPhotons[i] = photons[keys[i].index];
+            photonsHashCell[i] = keys[i].hashCell;
+        }
+    });
+    parallelForChunks(0, n, numThreads, UNIFORM_GRID_MIN_CHUNK_PHOTONS, [&](int, int from, int to)
+    {
+        std::copy(sortedPhotons.begin() + from, sortedPhotons.begin() + to, photons + from);
+    });
+
+    //
+    // Create the offset table. The exclusive prefix sum of the cell histogram is the index of the
+    // first sorted photon in each cell, so every photon that starts a new cell writes its index
+    // into the cells between the previous key and its own. The entry at numHashCells ends up
+    // holding the number of valid photons, as on the device.
+    //
+
+    parallelForChunks(0, n, numThreads, UNIFORM_GRID_MIN_CHUNK_PHOTONS, [&](int, int from, int to)
+    {
+        for(int i = from; i < to; ++i)
+        {
+            unsigned int firstCell = i == 0 ? 0 : keys[i-1].hashCell + 1;
+            unsigned int lastCell = std::min(keys[i].hashCell, result.numHashCells);
+            for(unsigned int cell = firstCell; cell <= lastCell; ++cell)
+            {
+                hashmapOffsetTable[cell] = i;
+            }
+        }
+    });
+
+    unsigned int firstTrailingCell = n == 0 ? 0 : keys[n-1].hashCell + 1;
+    for(unsigned int cell = firstTrailingCell; cell <= result.numHashCells; ++cell)
+    {
+        hashmapOffsetTable[cell] = n;
+    }
+
+    return result;
+}
+
+void PPMOptixRenderer::createUniformGridPhotonMapOnCPU()
+{
+    nvtx::ScopedRange r("PPMOptixRenderer::createUniformGridPhotonMapOnCPU");
+
+    Photon* photons = static_cast<Photon*>( m_photons->map() );
+    unsigned int* photonsHashCell = static_cast<unsigned int*>( m_photonsHashCells->map() );
+    unsigned int* hashmapOffsetTable = static_cast<unsigned int*>( m_hashmapOffsetTable->map() );
+
+    UniformGridPhotonMap photonMap;
+    try
+    {
+        photonMap = buildUniformGridPhotonMapOnCPU(photons, photonsHashCell, hashmapOffsetTable, NUM_PHOTONS, PHOTON_GRID_MAX_SIZE);
+    }
+    catch(const std::exception &)
+    {
+        m_hashmapOffsetTable->unmap();
+        m_photonsHashCells->unmap();
+        m_photons->unmap();
+        throw;
+    }
+
+    m_hashmapOffsetTable->unmap();
+    m_photonsHashCells->unmap();
+    m_photons->unmap();
+
+    m_spatialHashMapCellSize = photonMap.cellSize;
+    m_gridSize = photonMap.gridSize;
+    m_spatialHashMapNumCells = photonMap.numHashCells;
+    m_numberOfPhotonsLastFrame = photonMap.numValidPhotons;
+
+    m_context["photonsGridCellSize"]->setFloat(photonMap.cellSize);
+    m_context["photonsGridSize"]->setUint(photonMap.gridSize);
+    m_context["photonsWorldOrigo"]->setFloat(photonMap.worldOrigo);
+}
+
+void PMOptixRenderer::createUniformGridPhotonMapOnCPU()
+{
+    nvtx::ScopedRange r("PMOptixRenderer::createUniformGridPhotonMapOnCPU");
+
+    Photon* photons = static_cast<Photon*>( m_photons->map() );
+    unsigned int* photonsHashCell = static_cast<unsigned int*>( m_photonsHashCells->map() );
+    unsigned int* hashmapOffsetTable = static_cast<unsigned int*>( m_hashmapOffsetTable->map() );
+
+    UniformGridPhotonMap photonMap;
+    try
+    {
+        photonMap = buildUniformGridPhotonMapOnCPU(photons, photonsHashCell, hashmapOffsetTable, getNumPhotons(), PHOTON_GRID_MAX_SIZE);
+    }
+    catch(const std::exception &)
+    {
+        m_hashmapOffsetTable->unmap();
+        m_photonsHashCells->unmap();
+        m_photons->unmap();
+        throw;
+    }
+
+    m_hashmapOffsetTable->unmap();
+    m_photonsHashCells->unmap();
+    m_photons->unmap();
+
+    m_spatialHashMapCellSize = photonMap.cellSize;
+    m_gridSize = photonMap.gridSize;
+    m_spatialHashMapNumCells = photonMap.numHashCells;
+
+    m_context["photonsGridCellSize"]->setFloat(photonMap.cellSize);
+    m_context["photonsGridSize"]->setUint(photonMap.gridSize);
+    m_context["photonsWorldOrigo"]->setFloat(photonMap.worldOrigo);
+}
+
+#endif
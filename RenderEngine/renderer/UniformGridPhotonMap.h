@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+
+#include <optixu/optixpp_namespace.h>
+#include "math/Vector3.h"
+#include "render_engine_export_api.h"
+
+struct Photon;
+
+// Grid dimensioning shared by the device and host builds, defined in OptixRenderer_SpatialHash.cu
+float getSmallestPossibleCellSize(const Vector3 & sceneExtent, const unsigned int maxGridSize);
+optix::uint3 calculateGridSize(const Vector3 & sceneSize, const float & radius);
+// Grid size for cellSize, growing cellSize until the grid has at most maxGridSize cell keys
+optix::uint3 calculateGridSizeWithinMaxCellKeys(const Vector3 & sceneExtent, float & cellSize, const unsigned int maxGridSize);
+
+/*
+  Result of a uniform grid photon map build: the values uploaded to the photonsGridCellSize,
+  photonsGridSize and photonsWorldOrigo context variables, plus the number of photons with power.
+*/
+struct UniformGridPhotonMap
+{
+    optix::float3 worldOrigo;
+    float cellSize;
+    optix::uint3 gridSize;
+    unsigned int numHashCells;
+    unsigned int numValidPhotons;
+};
+
+/*
+  Host implementation of the device uniform grid build in OptixRenderer_SpatialHash.cu, producing
+  the same layout: photons sorted by cell key (stable, photons without power last), photonsHashCell
+  holding the sorted cell keys and hashmapOffsetTable[0..numHashCells] the first photon of each
+  cell key. hashmapOffsetTable must hold maxGridSize+1 entries. Throws if the grid would need more
+  than maxGridSize cells.
+*/
+RENDER_ENGINE_EXPORT_API UniformGridPhotonMap buildUniformGridPhotonMapOnCPU(Photon* photons, unsigned int* photonsHashCell, unsigned int* hashmapOffsetTable,
+                                                    unsigned int numPhotons, unsigned int maxGridSize);
+
+/*
+  The device build in OptixRenderer_SpatialHash.cu, on device pointers of the current CUDA device.
+  Takes and produces the same layout as buildUniformGridPhotonMapOnCPU.
+*/
+RENDER_ENGINE_EXPORT_API UniformGridPhotonMap buildUniformGridPhotonMapOnDevice(Photon* photons, unsigned int* photonsHashCell, unsigned int* hashmapOffsetTable,
+                                                       unsigned int numPhotons, unsigned int maxGridSize);
@@ -0,0 +1,20 @@
+/* 
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+
+// From https://devtalk.nvidia.com/default/topic/458062/atomicadd-float-float-atomicmul-float-float-/
+static __device__ inline void floatAtomicAdd(float* address, float value)
+{
+	float old = value;
+	float new_old;
+
+	do
+	{
+		new_old = atomicExch(address, 0.0f);
+		new_old += old;
+	}while ((old = atomicExch(address, new_old))!=0.0f);
+};
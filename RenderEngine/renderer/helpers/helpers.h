@@ -18,7 +18,7 @@
 
 // Create ONB from normalized normal (code: Physically Based Rendering, Pharr & Humphreys pg. 63)
 
-static  __device__ __inline__ void createCoordinateSystem( const optix::float3& N, optix::float3& U, optix::float3& V/*, optix::float3& W*/ )
+static  __device__ __host__ __inline__ void createCoordinateSystem( const optix::float3& N, optix::float3& U, optix::float3& V/*, optix::float3& W*/ )
 {
     using namespace optix;
 
@@ -52,7 +52,7 @@ static __device__ __inline__ int intmin(int a, int b)
     return a < b ? a : b;
 }
 
-static __device__ __inline__ float favgf(const optix::float3 & v )
+static __device__ __host__ __inline__ float favgf(const optix::float3 & v )
 {
     return (v.x+v.y+v.z)*0.3333333333f;
 }
\ No newline at end of file
@@ -10,7 +10,7 @@
 // Get a random direction from the hemisphere of direction around normalized normal, 
 // sampled with the cosine distribution p(theta, phi) = cos(theta)/PI
 
-static __device__ __inline__ optix::float3 sampleUnitHemisphereCos(const optix::float3 & normal, const optix::float2& sample)
+static __device__ __host__ __inline__ optix::float3 sampleUnitHemisphereCos(const optix::float3 & normal, const optix::float2& sample)
 {
     using namespace optix;
 
@@ -28,7 +28,7 @@ static __device__ __inline__ optix::float3 sampleUnitHemisphereCos(const optix::
 
 // Sample unit hemisphere around (normalized) normal
 
-static __device__ __inline__ optix::float3 sampleUnitHemisphere(const optix::float3 & normal, const optix::float2& sample)
+static __device__ __host__ __inline__ optix::float3 sampleUnitHemisphere(const optix::float3 & normal, const optix::float2& sample)
 {
     optix::float3 U, V;
     createCoordinateSystem( normal, U, V);
@@ -41,7 +41,7 @@ static __device__ __inline__ optix::float3 sampleUnitHemisphere(const optix::flo
     return optix::normalize(U*x + V*y + normal*z);
 }
 
-static __device__ __inline__ optix::float3 sampleUnitSphere(const optix::float2& sample)
+static __device__ __host__ __inline__ optix::float3 sampleUnitSphere(const optix::float2& sample)
 {
     optix::float3 v;
     v.z = sample.x;
@@ -52,7 +52,7 @@ static __device__ __inline__ optix::float3 sampleUnitSphere(const optix::float2&
     return v;
 }
 
-static __device__ __inline__ optix::float2 sampleUnitDisc(const optix::float2& sample)
+static __device__ __host__ __inline__ optix::float2 sampleUnitDisc(const optix::float2& sample)
 {
     float r = sqrtf(sample.x);
     float theta = 2.f*M_PIf*sample.y;
@@ -63,7 +63,7 @@ static __device__ __inline__ optix::float2 sampleUnitDisc(const optix::float2& s
 
 // Sample disc (normal must be normalized)
 
-static __device__ float3 sampleDisc(const float2 & sample, const float3 & center, const float radius, const float3 & normal)
+static __device__ __host__ float3 sampleDisc(const float2 & sample, const float3 & center, const float radius, const float3 & normal)
 {
     float3 U, V;
     createCoordinateSystem( normal, U, V);
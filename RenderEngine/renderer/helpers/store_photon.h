@@ -6,15 +6,38 @@
 
 #pragma once
 #include "renderer/ppm/PhotonGrid.h"
+#include "renderer/helpers/atomic.h"
 
 // Unfortunately, we need a macro for photon storing code
+// When photonStatisticsOnly is set the photon isn't stored, its hit is added to the hitCount and rawRadiance
+// of its object right away, like PMOptixRenderer::countHitCountPerObject does with the stored ones
+
+#define COUNT_PHOTON_HIT(photon) \
+    if(photonHasPower(photon)) \
+    { \
+    float3 countedPower = getPhotonPower(photon); \
+    atomicAdd(&hitCount[photon.objectId], 1); \
+    floatAtomicAdd(&rawRadiance[photon.objectId], countedPower.x + countedPower.y + countedPower.z); \
+    }
 
 #if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_UNIFORM_GRID || ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_KD_TREE_CPU
 #define STORE_PHOTON(photon) \
+    if(photonStatisticsOnly) \
+    { \
+    COUNT_PHOTON_HIT(photon) \
+    } \
+    else \
+    { \
     photons[photonPrd.pm_index + photonPrd.numStoredPhotons] = photon; \
+    } \
     photonPrd.numStoredPhotons++;
 #else
 #define STORE_PHOTON(photon) \
+    if(photonStatisticsOnly) \
+    { \
+    COUNT_PHOTON_HIT(photon) \
+    } \
+    else \
     { \
     uint3 gridLoc = getPhotonGridIndex(photon.position, photonsWorldOrigo, photonsGridCellSize); \
     uint hash = getHashValue(gridLoc, photonsGridSize, photonsSize); \
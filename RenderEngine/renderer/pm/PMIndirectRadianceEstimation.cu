@@ -29,6 +29,8 @@ rtDeclareVariable(float, alpha, , );
 rtDeclareVariable(float, emittedPhotonsPerIterationFloat, , );
 rtDeclareVariable(float, ppmRadius, ,);
 rtDeclareVariable(float, ppmRadiusSquared, ,);
+// Number of nearest photons to gather, or 0 to gather every photon within ppmRadius
+rtDeclareVariable(uint, photonGatherK, , );
 
 rtDeclareVariable(uint3, photonsGridSize, , );
 rtDeclareVariable(float3, photonsWorldOrigo, ,);
@@ -38,19 +40,22 @@ rtBuffer<uint, 1> hashmapOffsetTable;
 
 __device__ __inline float validPhoton(const Photon & photon, const float distance2, const float radius2, const float3 & hitNormal)
 {
-    return distance2 <= radius2 && dot(-photon.rayDirection, hitNormal) >= 0; 
+    return distance2 <= radius2 && dot(-getPhotonDirection(photon), hitNormal) >= 0; 
 }
 
-__device__ __inline float3 photonPower(const Photon & photon, const float distance2, const float radius2)
+__device__ __inline float3 photonPower(const float3 & power, const float distance2, const float radius2)
 {
     // Use the gaussian filter from Realistic Image Synthesis Using Photon Mapping, Wann Jensen
     const float alpha = 1.818;
     const float beta = 1.953;
     const float expNegativeBeta = 0.141847;
     float weight = alpha*(1 - (1-exp(-beta*distance2/(2*radius2)))/(1-expNegativeBeta));
-    return photon.power*weight;
+    return power*weight;
 }
 
+#define PHOTON_KNN_GATHER_UNIFORM_GRID
+#include "renderer/ppm/PhotonKNNGather.h"
+
 RT_PROGRAM void kernel()
 {
     Hitpoint rec = raytracePassOutputBuffer[launchIndex];
@@ -60,7 +65,17 @@ RT_PROGRAM void kernel()
     int _dPhotonsVisited = 0;
     int _dCellsVisited = 0;
 
-    if(rec.flags & PRD_HIT_NON_SPECULAR)
+    // Squared radius the accumulated power is spread over
+    float estimateRadius2 = ppmRadiusSquared;
+
+    if((rec.flags & PRD_HIT_NON_SPECULAR) && photonGatherK > 0)
+    {
+        PhotonKNNHeap heap;
+        heap.init(photonGatherK, ppmRadiusSquared);
+        gatherNearestPhotonsUniformGrid(heap, rec, ppmRadius, _dCellsVisited, _dPhotonsVisited);
+        indirectAccumulatedPower = accumulateNearestPhotons(heap, estimateRadius2);
+    }
+    else if(rec.flags & PRD_HIT_NON_SPECULAR)
     {
         float radius2 = ppmRadiusSquared;
         float radius = ppmRadius;
@@ -75,6 +90,34 @@ RT_PROGRAM void kernel()
         unsigned int y_hi = (unsigned int)min(photonsGridSize.y-1, (unsigned int)((normalizedPosition.y + radius) * invCellSize));
         unsigned int z_hi = (unsigned int)min(photonsGridSize.z-1, (unsigned int)((normalizedPosition.z + radius) * invCellSize));    
 
+#if ENABLE_PHOTON_GRID_MORTON_ORDER
+        if(x_lo <= x_hi && y_lo <= y_hi && z_lo <= z_hi)
+        {
+            // Cells with consecutive Morton keys are adjacent in the offset table, so each run of
+            // them is a single contiguous range of photons
+            PhotonGridMortonRange cells(make_uint3(x_lo, y_lo, z_lo), make_uint3(x_hi, y_hi, z_hi));
+            unsigned int from, to;
+            while(cells.next(from, to))
+            {
+                unsigned int offset = hashmapOffsetTable[from];
+                unsigned int offsetTo = hashmapOffsetTable[to+1];
+
+                _dCellsVisited++;
+
+                for(unsigned int i = offset; i < offsetTo; i++)
+                {
+                    const Photon & photon = photons[i];
+                    float3 diff = rec.position - photon.position;
+                    float distance2 = dot(diff, diff);
+                    if(validPhoton(photon, distance2, radius2, rec.normal))
+                    {
+                        indirectAccumulatedPower += photonPower(getPhotonPower(photon), distance2, radius2);
+                    }
+                    _dPhotonsVisited++;
+                }
+            }
+        }
+#else
         if(x_lo <= x_hi)
         {
             for(unsigned int z = z_lo; z <= z_hi; z++)
@@ -101,7 +144,7 @@ RT_PROGRAM void kernel()
                         float distance2 = dot(diff, diff);
                         if(validPhoton(photon, distance2, radius2, rec.normal))
                         {
-                            indirectAccumulatedPower += photonPower(photon, distance2, radius2);
+                            indirectAccumulatedPower += photonPower(getPhotonPower(photon), distance2, radius2);
                         }
                         _dPhotonsVisited++;
                     }
@@ -109,11 +152,12 @@ RT_PROGRAM void kernel()
                 }
             }
         }
+#endif
 
 
     }
 
-    float3 indirectRadiance = indirectAccumulatedPower * rec.attenuation * (1.0f/(M_PIf*ppmRadiusSquared)) *  (1.0f/emittedPhotonsPerIterationFloat);
+    float3 indirectRadiance = indirectAccumulatedPower * rec.attenuation * (1.0f/(M_PIf*estimateRadius2)) *  (1.0f/emittedPhotonsPerIterationFloat);
 
     indirectRadianceBuffer[launchIndex] = indirectRadiance;
 }
\ No newline at end of file
@@ -15,6 +15,7 @@
 #include "renderer/helpers/helpers.h"
 #include "renderer/helpers/samplers.h"
 #include "renderer/helpers/random.h"
+#include "renderer/helpers/atomic.h"
 #include "renderer/ppm/Photon.h"
 #include "renderer/ppm/PhotonPRD.h"
 #include "math/Sphere.h"
@@ -33,20 +34,7 @@ rtDeclareVariable(Sphere, sceneBoundingSphere, , );
 rtBuffer<float> powerEmitted;
 rtBuffer<float, 1> lightRussianRulette;
 rtDeclareVariable(float, photonPowerScale, , );
-
-// From https://devtalk.nvidia.com/default/topic/458062/atomicadd-float-float-atomicmul-float-float-/
-__device__ inline void floatAtomicAdd(float* address, float value)
-{
-	float old = value;
-	float new_old;
-
-	do
-	{
-		new_old = atomicExch(address, 0.0f);
-		new_old += old;
-	}while ((old = atomicExch(address, new_old))!=0.0f);
-};
-
+rtDeclareVariable(uint, photonStatisticsOnly, , );
 
 static __device__ void generatePhotonOriginAndDirection(const Light& light, RandomState& state, const Sphere & boundingSphere, 
     float3& origin, float3& direction, float& photonPowerFactor)
@@ -136,7 +124,8 @@ RT_PROGRAM void generator()
 
     photonPrd.power = light.power * photonPowerScale;
 
-	floatAtomicAdd(&powerEmitted[0], photonPrd.power.x + photonPrd.power.y + photonPrd.power.y);
+	// Summed like the power of the photons added to rawRadiance
+	floatAtomicAdd(&powerEmitted[0], photonPrd.power.x + photonPrd.power.y + photonPrd.power.z);
 
     float3 rayOrigin, rayDirection;
    
@@ -148,11 +137,14 @@ RT_PROGRAM void generator()
     Ray photon = Ray(rayOrigin, rayDirection, RayType::PHOTON, 0.0001, RT_DEFAULT_MAX );
 
 #if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_KD_TREE_CPU || ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_UNIFORM_GRID
-    // Clear photons owned by this thread
-    for(unsigned int i = 0; i < maxPhotonDepositsPerEmitted; ++i)
+    // Clear photons owned by this thread, the photon buffer isn't used when only counting hits
+    if(!photonStatisticsOnly)
     {
-        photons[photonPrd.pm_index+i].position = make_float3(0.0f);
-        photons[photonPrd.pm_index+i].power = make_float3(0.0f);
+        for(unsigned int i = 0; i < maxPhotonDepositsPerEmitted; ++i)
+        {
+            photons[photonPrd.pm_index+i].position = make_float3(0.0f);
+            photons[photonPrd.pm_index+i].power = 0;
+        }
     }
 #endif
 
@@ -23,6 +23,9 @@ rtBuffer<RandomState, 2> randomStates;
 rtDeclareVariable(Camera, camera, , );
 rtDeclareVariable(float, camera_aperture, , );
 rtDeclareVariable(uint2, launchIndex, rtLaunchIndex, );
+// The launch covers the tile of the image at imageOffset, see RenderServerRenderRequestDetails::getTile
+rtDeclareVariable(uint2, imageOffset, , );
+rtDeclareVariable(uint2, imageSize, , );
 rtDeclareVariable(float, iterationNumber, , );
 rtDeclareVariable(RadiancePRD, radiancePrd, rtPayload, );
 rtDeclareVariable(optix::Ray, ray, rtCurrentRay, );
@@ -36,9 +39,9 @@ RT_PROGRAM void generateRay()
     radiancePrd.flags = 0;
     radiancePrd.randomState = randomStates[launchIndex];
 
-    float2 screen = make_float2(raytracePassOutputBuffer.size());
+    float2 screen = make_float2(imageSize);
     float2 sample = getRandomUniformFloat2(&radiancePrd.randomState);
-    float2 d = ( make_float2(launchIndex) + sample ) / screen * 2.0f - 1.0f;
+    float2 d = ( make_float2(launchIndex + imageOffset) + sample ) / screen * 2.0f - 1.0f;
     float3 rayOrigin = camera.eye;
     float3 rayDirection = normalize(d.x*camera.camera_u + d.y*camera.camera_v + camera.lookdir);
 
@@ -12,6 +12,7 @@
 #include "config.h"
 #include "renderer/Light.h"
 #include "renderer/ppm/Photon.h"
+#include "renderer/ppm/PackedPhoton.h"
 #include "renderer/RayType.h"
 #include "renderer/Hitpoint.h"
 #include "renderer/ppm/PhotonGrid.h"
@@ -30,6 +31,8 @@ rtDeclareVariable(float, emittedPhotonsPerIterationFloat, , );
 rtDeclareVariable(float, ppmRadius, ,);
 rtDeclareVariable(float, ppmRadiusSquared, ,);
 rtDeclareVariable(float, ppmRadiusSquaredNew, ,);
+// Number of nearest photons to gather, or 0 to gather every photon within ppmRadius
+rtDeclareVariable(uint, photonGatherK, , );
 
 #if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_UNIFORM_GRID
 rtDeclareVariable(uint3, photonsGridSize, , );
@@ -43,7 +46,7 @@ rtDeclareVariable(float, photonsGridCellSize, ,);
 rtDeclareVariable(unsigned int, photonsSize, ,);
 rtBuffer<unsigned int, 1> photonsHashTableCount;
 #elif ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_KD_TREE_CPU
-rtBuffer<Photon, 1> photonKdTree;
+rtBuffer<PackedPhoton, 1> photonKdTree;
 #endif
 
 #if ENABLE_RENDER_DEBUG_OUTPUT
@@ -53,19 +56,26 @@ rtBuffer<uint, 2> debugIndirectRadiancePhotonsVisisted;
 
 __device__ __inline float validPhoton(const Photon & photon, const float distance2, const float radius2, const float3 & hitNormal)
 {
-    return distance2 <= radius2 && dot(-photon.rayDirection, hitNormal) >= 0; 
+    return distance2 <= radius2 && dot(-getPhotonDirection(photon), hitNormal) >= 0; 
 }
 
-__device__ __inline float3 photonPower(const Photon & photon, const float distance2, const float radius2)
+__device__ __inline float3 photonPower(const float3 & power, const float distance2, const float radius2)
 {
     // Use the gaussian filter from Realistic Image Synthesis Using Photon Mapping, Wann Jensen
     const float alpha = 1.818;
     const float beta = 1.953;
     const float expNegativeBeta = 0.141847;
     float weight = alpha*(1 - (1-exp(-beta*distance2/(2*radius2)))/(1-expNegativeBeta));
-    return photon.power*weight;
+    return power*weight;
 }
 
+#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_UNIFORM_GRID
+#define PHOTON_KNN_GATHER_UNIFORM_GRID
+#elif ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_KD_TREE_CPU
+#define PHOTON_KNN_GATHER_KD_TREE
+#endif
+#include "renderer/ppm/PhotonKNNGather.h"
+
 RT_PROGRAM void kernel()
 {
     clock_t start = clock();
@@ -76,6 +86,23 @@ RT_PROGRAM void kernel()
     int _dPhotonsVisited = 0;
     int _dCellsVisited = 0;
 
+    // Squared radius the accumulated power is spread over
+    float estimateRadius2 = ppmRadiusSquared;
+
+#if defined(PHOTON_KNN_GATHER_UNIFORM_GRID) || defined(PHOTON_KNN_GATHER_KD_TREE)
+    if((rec.flags & PRD_HIT_NON_SPECULAR) && photonGatherK > 0)
+    {
+        PhotonKNNHeap heap;
+        heap.init(photonGatherK, ppmRadiusSquared);
+#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_UNIFORM_GRID
+        gatherNearestPhotonsUniformGrid(heap, rec, ppmRadius, _dCellsVisited, _dPhotonsVisited);
+#else
+        gatherNearestPhotonsKdTree(heap, rec, _dPhotonsVisited);
+#endif
+        indirectAccumulatedPower = accumulateNearestPhotons(heap, estimateRadius2);
+    }
+    else
+#endif
     if(rec.flags & PRD_HIT_NON_SPECULAR)
     {
         float radius2 = ppmRadiusSquared;
@@ -93,6 +120,34 @@ RT_PROGRAM void kernel()
         unsigned int y_hi = (unsigned int)min(photonsGridSize.y-1, (unsigned int)((normalizedPosition.y + radius) * invCellSize));
         unsigned int z_hi = (unsigned int)min(photonsGridSize.z-1, (unsigned int)((normalizedPosition.z + radius) * invCellSize));    
 
+#if ENABLE_PHOTON_GRID_MORTON_ORDER
+        if(x_lo <= x_hi && y_lo <= y_hi && z_lo <= z_hi)
+        {
+            // Cells with consecutive Morton keys are adjacent in the offset table, so each run of
+            // them is a single contiguous range of photons
+            PhotonGridMortonRange cells(make_uint3(x_lo, y_lo, z_lo), make_uint3(x_hi, y_hi, z_hi));
+            unsigned int from, to;
+            while(cells.next(from, to))
+            {
+                unsigned int offset = hashmapOffsetTable[from];
+                unsigned int offsetTo = hashmapOffsetTable[to+1];
+
+                _dCellsVisited++;
+
+                for(unsigned int i = offset; i < offsetTo; i++)
+                {
+                    const Photon & photon = photons[i];
+                    float3 diff = rec.position - photon.position;
+                    float distance2 = dot(diff, diff);
+                    if(validPhoton(photon, distance2, radius2, rec.normal))
+                    {
+                        indirectAccumulatedPower += photonPower(getPhotonPower(photon), distance2, radius2);
+                    }
+                    _dPhotonsVisited++;
+                }
+            }
+        }
+#else
         if(x_lo <= x_hi)
         {
             for(unsigned int z = z_lo; z <= z_hi; z++)
@@ -119,7 +174,7 @@ RT_PROGRAM void kernel()
                         float distance2 = dot(diff, diff);
                         if(validPhoton(photon, distance2, radius2, rec.normal))
                         {
-                            indirectAccumulatedPower += photonPower(photon, distance2, radius2);
+                            indirectAccumulatedPower += photonPower(getPhotonPower(photon), distance2, radius2);
                         }
                         _dPhotonsVisited++;
                     }
@@ -127,6 +182,7 @@ RT_PROGRAM void kernel()
                 }
             }
         }
+#endif
 
 #elif ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_STOCHASTIC_HASH 
         
@@ -155,7 +211,7 @@ RT_PROGRAM void kernel()
                     float distance2 = dot(diff, diff);
                     if(validPhoton(photon, distance2, radius2, rec.normal))
                     {
-                        indirectAccumulatedPower += photonPower(photon, distance2, radius2)*float(photonsHashTableCount[hash]);
+                        indirectAccumulatedPower += photonPower(getPhotonPower(photon), distance2, radius2)*float(photonsHashTableCount[hash]);
                     }
                 }
             }
@@ -175,16 +231,16 @@ RT_PROGRAM void kernel()
         push_node(0);
         do 
         {
-            Photon& photon = photonKdTree[ node ];
+            const PackedPhoton& photon = photonKdTree[ node ];
             _dPhotonsVisited++;
-            uint axis = photon.axis;
+            uint axis = getPackedPhotonAxis(photon);
             if( !( axis & PPM_NULL ) )
             {
                 float3 diff = rec.position - photon.position;
                 float distance2 = dot(diff, diff);
-                if(validPhoton(photon, distance2, radius2, rec.normal))
+                if(distance2 <= radius2 && dot(-decodeOctahedral(photon.direction), rec.normal) >= 0)
                 {
-                    indirectAccumulatedPower += photonPower(photon, distance2, radius2);
+                    indirectAccumulatedPower += photonPower(decodeRGBE(photon.power), distance2, radius2);
                 }
 
                 // Recurse
@@ -210,7 +266,7 @@ RT_PROGRAM void kernel()
 #endif
     }
 
-    float3 indirectRadiance = indirectAccumulatedPower * rec.attenuation * (1.0f/(M_PIf*ppmRadiusSquared)) *  (1.0f/emittedPhotonsPerIterationFloat);
+    float3 indirectRadiance = indirectAccumulatedPower * rec.attenuation * (1.0f/(M_PIf*estimateRadius2)) *  (1.0f/emittedPhotonsPerIterationFloat);
 
     // Add contribution from volumetric radiance
 #if ENABLE_PARTICIPATING_MEDIA
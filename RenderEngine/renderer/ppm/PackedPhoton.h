@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <optixu/optixu_math_namespace.h>
+#include "config.h"
+#include "renderer/ppm/Photon.h"
+
+/*
+  Photon record of the kd-tree. It has the encoded fields of Photon, with the kd-tree PPM_* axis flags in
+  the high 5 bits of objectIdAndAxis and the objectId in the low 27, so it is 24 bytes too.
+*/
+struct PackedPhoton
+{
+    optix::float3 position;
+    optix::uint   power;
+    optix::uint   direction;
+    optix::uint   objectIdAndAxis;
+};
+
+#define PACKED_PHOTON_AXIS_SHIFT 27
+#define PACKED_PHOTON_OBJECT_ID_MASK ((1u << PACKED_PHOTON_AXIS_SHIFT) - 1)
+
+static RT_HOSTDEVICE __inline PackedPhoton packPhoton(const Photon & photon, optix::uint axis)
+{
+    PackedPhoton packed;
+    packed.position = photon.position;
+    packed.power = photon.power;
+    packed.direction = photon.rayDirection;
+    packed.objectIdAndAxis = (photon.objectId & PACKED_PHOTON_OBJECT_ID_MASK) | (axis << PACKED_PHOTON_AXIS_SHIFT);
+    return packed;
+}
+
+static RT_HOSTDEVICE __inline optix::uint getPackedPhotonAxis(const PackedPhoton & photon)
+{
+    return photon.objectIdAndAxis >> PACKED_PHOTON_AXIS_SHIFT;
+}
+
+static RT_HOSTDEVICE __inline optix::uint getPackedPhotonObjectId(const PackedPhoton & photon)
+{
+    return photon.objectIdAndAxis & PACKED_PHOTON_OBJECT_ID_MASK;
+}
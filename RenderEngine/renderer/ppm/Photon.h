@@ -6,29 +6,46 @@
 
 #pragma once
 #include "config.h"
+#include "renderer/ppm/PhotonEncoding.h"
 
+/*
+  A stored photon. Power and direction are kept encoded (see PhotonEncoding.h) so a photon takes 24 bytes
+  instead of 40, use getPhotonPower and getPhotonDirection to read them. A photon without power is an
+  empty slot of the photon buffer.
+*/
 struct Photon
 {
-#ifdef __CUDACC__
-    __device__ __inline Photon(const optix::float3 & power, const optix::float3 & position, const optix::float3 & rayDirection, const optix::uint & objectId)
-        : power(power), position(position), rayDirection(rayDirection), objectId(objectId)
+    RT_HOSTDEVICE __inline Photon(const optix::float3 & power, const optix::float3 & position, const optix::float3 & rayDirection, const optix::uint & objectId)
+        : position(position), power(encodeRGBE(power)), rayDirection(encodeOctahedral(rayDirection)), objectId(objectId)
     {
 
     }
 
-    __device__ __inline Photon(void)
+    RT_HOSTDEVICE __inline Photon(void)
     {
 
     }
-#endif
-    optix::float3 power;
+
     optix::float3 position;
-    optix::float3 rayDirection;
+    optix::uint   power;
+    optix::uint   rayDirection;
 	optix::uint   objectId; 
-#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_KD_TREE_CPU
-    optix::uint   axis;
-#endif
 #if ENABLE_PARTICIPATING_MEDIA
     optix::uint numDeposits;
 #endif
 };
+
+static RT_HOSTDEVICE __inline optix::float3 getPhotonPower(const Photon & photon)
+{
+    return decodeRGBE(photon.power);
+}
+
+static RT_HOSTDEVICE __inline optix::float3 getPhotonDirection(const Photon & photon)
+{
+    return decodeOctahedral(photon.rayDirection);
+}
+
+static RT_HOSTDEVICE __inline bool photonHasPower(const Photon & photon)
+{
+    return photon.power != 0;
+}
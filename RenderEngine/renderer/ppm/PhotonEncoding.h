@@ -0,0 +1,87 @@
+/* 
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <optixu/optixu_math_namespace.h>
+
+/*
+  Reduced precision encodings of the photon power and direction, shared by Photon and PackedPhoton:
+
+  - power as shared-exponent RGBE (8 bit mantissas, relative error below 1/256 of the largest channel)
+  - direction octahedral encoded into two 16 bit unit coordinates
+*/
+
+static RT_HOSTDEVICE __inline optix::uint encodeRGBE(const optix::float3 & color)
+{
+    float r = fmaxf(color.x, 0.0f);
+    float g = fmaxf(color.y, 0.0f);
+    float b = fmaxf(color.z, 0.0f);
+    float maxComponent = fmaxf(r, fmaxf(g, b));
+    if(!(maxComponent > 1e-32f))
+    {
+        return 0;
+    }
+    int exponent;
+    frexpf(maxComponent, &exponent);
+    exponent = exponent < -127 ? -127 : (exponent > 127 ? 127 : exponent);
+    float scale = ldexpf(1.0f, 8 - exponent);
+    optix::uint ri = (optix::uint)fminf(r*scale, 255.0f);
+    optix::uint gi = (optix::uint)fminf(g*scale, 255.0f);
+    optix::uint bi = (optix::uint)fminf(b*scale, 255.0f);
+    return ri | (gi << 8) | (bi << 16) | (optix::uint(exponent + 128) << 24);
+}
+
+static RT_HOSTDEVICE __inline float decodeRGBEMantissa(optix::uint mantissa)
+{
+    return mantissa == 0 ? 0.0f : float(mantissa) + 0.5f;
+}
+
+static RT_HOSTDEVICE __inline optix::float3 decodeRGBE(optix::uint rgbe)
+{
+    optix::uint exponent = rgbe >> 24;
+    if(exponent == 0)
+    {
+        return optix::make_float3(0.0f);
+    }
+    // Sample at the middle of the quantization step to halve the worst case error. A zero mantissa
+    // stays zero, so a channel without power doesn't pick up energy from the others.
+    float scale = ldexpf(1.0f, int(exponent) - (128 + 8));
+    return optix::make_float3(decodeRGBEMantissa(rgbe & 0xff), decodeRGBEMantissa((rgbe >> 8) & 0xff),
+        decodeRGBEMantissa((rgbe >> 16) & 0xff))*scale;
+}
+
+static RT_HOSTDEVICE __inline optix::uint encodeOctahedral(const optix::float3 & direction)
+{
+    float invL1Norm = 1.0f/(fabsf(direction.x) + fabsf(direction.y) + fabsf(direction.z));
+    float u = direction.x*invL1Norm;
+    float v = direction.y*invL1Norm;
+    if(direction.z < 0.0f)
+    {
+        // Fold the lower hemisphere over the diagonals
+        float foldedU = (1.0f - fabsf(v))*(u >= 0.0f ? 1.0f : -1.0f);
+        float foldedV = (1.0f - fabsf(u))*(v >= 0.0f ? 1.0f : -1.0f);
+        u = foldedU;
+        v = foldedV;
+    }
+    optix::uint ui = (optix::uint)(optix::clamp(u*0.5f + 0.5f, 0.0f, 1.0f)*65535.0f + 0.5f);
+    optix::uint vi = (optix::uint)(optix::clamp(v*0.5f + 0.5f, 0.0f, 1.0f)*65535.0f + 0.5f);
+    return ui | (vi << 16);
+}
+
+static RT_HOSTDEVICE __inline optix::float3 decodeOctahedral(optix::uint encoded)
+{
+    float u = float(encoded & 0xffff)*(2.0f/65535.0f) - 1.0f;
+    float v = float(encoded >> 16)*(2.0f/65535.0f) - 1.0f;
+    float z = 1.0f - fabsf(u) - fabsf(v);
+    if(z < 0.0f)
+    {
+        float unfoldedU = (1.0f - fabsf(v))*(u >= 0.0f ? 1.0f : -1.0f);
+        float unfoldedV = (1.0f - fabsf(u))*(v >= 0.0f ? 1.0f : -1.0f);
+        u = unfoldedU;
+        v = unfoldedV;
+    }
+    return optix::normalize(optix::make_float3(u, v, z));
+}
@@ -124,7 +124,7 @@ RT_PROGRAM void generator()
     for(unsigned int i = 0; i < maxPhotonDepositsPerEmitted; ++i)
     {
         photons[photonPrd.pm_index+i].position = make_float3(0.0f);
-        photons[photonPrd.pm_index+i].power = make_float3(0.0f);
+        photons[photonPrd.pm_index+i].power = 0;
     }
 #endif
 
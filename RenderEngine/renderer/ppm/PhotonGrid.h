@@ -31,3 +31,142 @@ __host__ __device__ __inline unsigned int getHashValue(const optix::uint3 & grid
 {
     return getPhotonGridIndex1D(gridPosition, gridSize) & (max-1);
 }
+
+/*
+// Morton (Z-order) cell keys. Each axis gets 10 bits, interleaved as ...z1y1x1z0y0x0.
+*/
+
+#define PHOTON_GRID_MORTON_X_MASK 0x09249249u
+#define PHOTON_GRID_MORTON_Y_MASK 0x12492492u
+#define PHOTON_GRID_MORTON_Z_MASK 0x24924924u
+
+// Spreads the low 10 bits of v so that there are two zero bits between each of them
+__host__ __device__ __inline unsigned int mortonExpandBits(unsigned int v)
+{
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000FF;
+    v = (v | (v <<  8)) & 0x0300F00F;
+    v = (v | (v <<  4)) & 0x030C30C3;
+    v = (v | (v <<  2)) & 0x09249249;
+    return v;
+}
+
+__host__ __device__ __inline unsigned int getPhotonGridMortonIndex(const optix::uint3 & gridPosition)
+{
+    return mortonExpandBits(gridPosition.x) | (mortonExpandBits(gridPosition.y) << 1) | (mortonExpandBits(gridPosition.z) << 2);
+}
+
+// Key used to sort the photons into cells and to index hashmapOffsetTable
+__host__ __device__ __inline unsigned int getPhotonGridCellKey(const optix::uint3 & gridPosition, const optix::uint3& gridSize)
+{
+#if ENABLE_PHOTON_GRID_MORTON_ORDER
+    return getPhotonGridMortonIndex(gridPosition);
+#else
+    return getPhotonGridIndex1D(gridPosition, gridSize);
+#endif
+}
+
+// Number of distinct cell keys of the grid. Morton keys are sparse unless every axis is a power of two,
+// and cannot address more than 1024 cells per axis.
+__host__ __device__ __inline unsigned int getPhotonGridNumCellKeys(const optix::uint3& gridSize)
+{
+#if ENABLE_PHOTON_GRID_MORTON_ORDER
+    if(gridSize.x > 1024 || gridSize.y > 1024 || gridSize.z > 1024)
+    {
+        return 0xffffffff;
+    }
+    return getPhotonGridMortonIndex(optix::make_uint3(gridSize.x-1, gridSize.y-1, gridSize.z-1)) + 1;
+#else
+    return gridSize.x*gridSize.y*gridSize.z;
+#endif
+}
+
+__host__ __device__ __inline bool isMortonIndexInBox(unsigned int key, unsigned int keyMin, unsigned int keyMax)
+{
+    // Masking keeps the bits of one axis in place, and comparing those preserves the order of that axis
+    unsigned int x = key & PHOTON_GRID_MORTON_X_MASK;
+    unsigned int y = key & PHOTON_GRID_MORTON_Y_MASK;
+    unsigned int z = key & PHOTON_GRID_MORTON_Z_MASK;
+    return x >= (keyMin & PHOTON_GRID_MORTON_X_MASK) && x <= (keyMax & PHOTON_GRID_MORTON_X_MASK)
+        && y >= (keyMin & PHOTON_GRID_MORTON_Y_MASK) && y <= (keyMax & PHOTON_GRID_MORTON_Y_MASK)
+        && z >= (keyMin & PHOTON_GRID_MORTON_Z_MASK) && z <= (keyMax & PHOTON_GRID_MORTON_Z_MASK);
+}
+
+/*
+// Smallest Morton key greater than key that lies in the box spanned by keyMin and keyMax (BIGMIN of
+// Tropf and Herzog). key must lie outside the box and between keyMin and keyMax.
+*/
+__host__ __device__ __inline unsigned int getNextMortonIndexInBox(unsigned int key, unsigned int keyMin, unsigned int keyMax)
+{
+    unsigned int bigMin = keyMax;
+    for(int bit = 29; bit >= 0; bit--)
+    {
+        unsigned int mask = 1u << bit;
+        // The lower bits of the same axis as this bit
+        unsigned int axisLowerBits = (PHOTON_GRID_MORTON_X_MASK << (bit % 3)) & (mask - 1);
+        bool keyBit = (key & mask) != 0;
+        bool minBit = (keyMin & mask) != 0;
+        bool maxBit = (keyMax & mask) != 0;
+
+        if(!keyBit && !minBit && maxBit)
+        {
+            bigMin = (keyMin & ~axisLowerBits) | mask;
+            keyMax = (keyMax & ~mask) | axisLowerBits;
+        }
+        else if(!keyBit && minBit && maxBit)
+        {
+            return keyMin;
+        }
+        else if(keyBit && !minBit && !maxBit)
+        {
+            return bigMin;
+        }
+        else if(keyBit && !minBit && maxBit)
+        {
+            keyMin = (keyMin & ~axisLowerBits) | mask;
+        }
+    }
+    return bigMin;
+}
+
+/*
+// Walks the cells of the box [lo, hi] in Morton order. Each call to next() returns a run of cells
+// with consecutive keys, whose photons are the contiguous range
+// photons[hashmapOffsetTable[from]..hashmapOffsetTable[to+1]).
+*/
+struct PhotonGridMortonRange
+{
+    unsigned int keyMin;
+    unsigned int keyMax;
+    unsigned int nextKey;
+
+    __host__ __device__ __inline PhotonGridMortonRange(const optix::uint3 & lo, const optix::uint3 & hi)
+    {
+        keyMin = getPhotonGridMortonIndex(lo);
+        keyMax = getPhotonGridMortonIndex(hi);
+        nextKey = keyMin;
+    }
+
+    __host__ __device__ __inline bool next(unsigned int & from, unsigned int & to)
+    {
+        if(nextKey > keyMax)
+        {
+            return false;
+        }
+        from = nextKey;
+        to = nextKey;
+        while(to < keyMax && isMortonIndexInBox(to + 1, keyMin, keyMax))
+        {
+            to++;
+        }
+        if(to >= keyMax)
+        {
+            nextKey = keyMax + 1;
+        }
+        else
+        {
+            nextKey = getNextMortonIndexInBox(to + 1, keyMin, keyMax);
+        }
+        return true;
+    }
+};
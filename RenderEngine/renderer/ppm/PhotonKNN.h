@@ -0,0 +1,91 @@
+/* 
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include "renderer/PhotonGatherMode.h"
+
+/*
+// Bounded max-heap holding the k nearest photons found so far. The root is the farthest of them,
+// so once the heap is full its distance is the radius any closer photon has to be within.
+*/
+struct PhotonKNNHeap
+{
+    float distance2[PHOTON_GATHER_MAX_K];
+    unsigned int index[PHOTON_GATHER_MAX_K];
+    unsigned int size;
+    unsigned int k;
+    float maxDistance2;
+
+    __host__ __device__ __inline void init(unsigned int nearestPhotons, float maxRadius2)
+    {
+        size = 0;
+        k = nearestPhotons < PHOTON_GATHER_MAX_K ? nearestPhotons : PHOTON_GATHER_MAX_K;
+        maxDistance2 = maxRadius2;
+    }
+
+    __host__ __device__ __inline bool isFull() const
+    {
+        return size == k;
+    }
+
+    // Squared radius photons must be within to enter the heap
+    __host__ __device__ __inline float searchRadius2() const
+    {
+        return isFull() ? distance2[0] : maxDistance2;
+    }
+
+    __host__ __device__ __inline void insert(float photonDistance2, unsigned int photonIndex)
+    {
+        if(!(photonDistance2 < searchRadius2()))
+        {
+            return;
+        }
+
+        unsigned int node;
+        if(!isFull())
+        {
+            // Sift the new photon up from the end
+            node = size++;
+            while(node > 0)
+            {
+                unsigned int parent = (node - 1) / 2;
+                if(distance2[parent] >= photonDistance2)
+                {
+                    break;
+                }
+                distance2[node] = distance2[parent];
+                index[node] = index[parent];
+                node = parent;
+            }
+        }
+        else
+        {
+            // Replace the farthest photon and sift down from the root
+            node = 0;
+            while(true)
+            {
+                unsigned int child = 2*node + 1;
+                if(child >= size)
+                {
+                    break;
+                }
+                if(child + 1 < size && distance2[child + 1] > distance2[child])
+                {
+                    child++;
+                }
+                if(distance2[child] <= photonDistance2)
+                {
+                    break;
+                }
+                distance2[node] = distance2[child];
+                index[node] = index[child];
+                node = child;
+            }
+        }
+        distance2[node] = photonDistance2;
+        index[node] = photonIndex;
+    }
+};
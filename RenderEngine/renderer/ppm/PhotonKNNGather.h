@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+/*
+// k-nearest-neighbour gathers over the photon map. They read the photon map buffers and variables of
+// the including program, so this header must be included after those are declared and after defining
+// PHOTON_KNN_GATHER_UNIFORM_GRID (photons, hashmapOffsetTable and photonsGrid*) or
+// PHOTON_KNN_GATHER_KD_TREE (photonKdTree) for the photon map it uses.
+*/
+
+#pragma once
+#include "renderer/ppm/PhotonKNN.h"
+#include "renderer/ppm/PhotonGrid.h"
+
+#if defined(PHOTON_KNN_GATHER_UNIFORM_GRID)
+
+__device__ __inline void gatherNearestPhotonsInCells(PhotonKNNHeap & heap, unsigned int from, unsigned int to, const Hitpoint & rec, int & photonsVisited)
+{
+    unsigned int offset = hashmapOffsetTable[from];
+    unsigned int offsetTo = hashmapOffsetTable[to+1];
+    for(unsigned int i = offset; i < offsetTo; i++)
+    {
+        const Photon & photon = photons[i];
+        if(dot(-getPhotonDirection(photon), rec.normal) >= 0)
+        {
+            float3 diff = rec.position - photon.position;
+            heap.insert(dot(diff, diff), i);
+        }
+        photonsVisited++;
+    }
+}
+
+__device__ __inline void gatherNearestPhotonsInRow(PhotonKNNHeap & heap, int x_lo, int x_hi, int y, int z, const Hitpoint & rec, int & cellsVisited, int & photonsVisited)
+{
+#if ENABLE_PHOTON_GRID_MORTON_ORDER
+    for(int x = x_lo; x <= x_hi; x++)
+    {
+        unsigned int key = getPhotonGridCellKey(make_uint3(x, y, z), photonsGridSize);
+        gatherNearestPhotonsInCells(heap, key, key, rec, photonsVisited);
+        cellsVisited++;
+    }
+#else
+    unsigned int from = getPhotonGridCellKey(make_uint3(x_lo, y, z), photonsGridSize);
+    gatherNearestPhotonsInCells(heap, from, from + (x_hi - x_lo), rec, photonsVisited);
+    cellsVisited++;
+#endif
+}
+
+/*
+// Visits the cells in shells of growing Chebyshev distance around the cell of the hitpoint. Cells of
+// shell s are at least s-1 whole cells away, so the search stops once the heap is full and that
+// distance reaches its radius, or when the shells cover the whole maxRadius box.
+*/
+__device__ __inline void gatherNearestPhotonsUniformGrid(PhotonKNNHeap & heap, const Hitpoint & rec, float maxRadius, int & cellsVisited, int & photonsVisited)
+{
+    float invCellSize = 1.f/photonsGridCellSize;
+    float3 normalizedPosition = rec.position - photonsWorldOrigo;
+    int x_lo = max(0, (int)((normalizedPosition.x - maxRadius) * invCellSize));
+    int y_lo = max(0, (int)((normalizedPosition.y - maxRadius) * invCellSize));
+    int z_lo = max(0, (int)((normalizedPosition.z - maxRadius) * invCellSize));
+    int x_hi = min((int)photonsGridSize.x-1, (int)((normalizedPosition.x + maxRadius) * invCellSize));
+    int y_hi = min((int)photonsGridSize.y-1, (int)((normalizedPosition.y + maxRadius) * invCellSize));
+    int z_hi = min((int)photonsGridSize.z-1, (int)((normalizedPosition.z + maxRadius) * invCellSize));
+
+    if(x_lo > x_hi || y_lo > y_hi || z_lo > z_hi)
+    {
+        return;
+    }
+
+    int cx = clamp((int)(normalizedPosition.x * invCellSize), x_lo, x_hi);
+    int cy = clamp((int)(normalizedPosition.y * invCellSize), y_lo, y_hi);
+    int cz = clamp((int)(normalizedPosition.z * invCellSize), z_lo, z_hi);
+    int maxShell = max(max(max(cx - x_lo, x_hi - cx), max(cy - y_lo, y_hi - cy)), max(cz - z_lo, z_hi - cz));
+
+    for(int shell = 0; shell <= maxShell; shell++)
+    {
+        float shellDistance = (shell - 1)*photonsGridCellSize;
+        if(shell > 1 && heap.isFull() && shellDistance*shellDistance >= heap.searchRadius2())
+        {
+            break;
+        }
+
+        int shellXLo = max(x_lo, cx - shell);
+        int shellXHi = min(x_hi, cx + shell);
+        for(int z = max(z_lo, cz - shell); z <= min(z_hi, cz + shell); z++)
+        {
+            for(int y = max(y_lo, cy - shell); y <= min(y_hi, cy + shell); y++)
+            {
+                if(abs(z - cz) == shell || abs(y - cy) == shell)
+                {
+                    gatherNearestPhotonsInRow(heap, shellXLo, shellXHi, y, z, rec, cellsVisited, photonsVisited);
+                }
+                else
+                {
+                    // Inside the shell in y and z, so only its two x faces belong to it
+                    if(cx - shell >= x_lo)
+                    {
+                        gatherNearestPhotonsInRow(heap, cx - shell, cx - shell, y, z, rec, cellsVisited, photonsVisited);
+                    }
+                    if(cx + shell <= x_hi)
+                    {
+                        gatherNearestPhotonsInRow(heap, cx + shell, cx + shell, y, z, rec, cellsVisited, photonsVisited);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Adds up the power of the gathered photons, returning the squared radius of the estimate in estimateRadius2
+__device__ __inline float3 accumulateNearestPhotons(const PhotonKNNHeap & heap, float & estimateRadius2)
+{
+    estimateRadius2 = heap.isFull() ? fmaxf(heap.distance2[0], 1e-12f) : heap.maxDistance2;
+    float3 power = make_float3(0.0f);
+    for(unsigned int i = 0; i < heap.size; i++)
+    {
+        power += photonPower(getPhotonPower(photons[heap.index[i]]), heap.distance2[i], estimateRadius2);
+    }
+    return power;
+}
+
+#elif defined(PHOTON_KNN_GATHER_KD_TREE)
+
+/*
+// Same walk as the fixed radius kd-tree gather, but the far child is only pushed when it is within
+// the current heap radius, which shrinks as closer photons are found.
+*/
+__device__ __inline void gatherNearestPhotonsKdTree(PhotonKNNHeap & heap, const Hitpoint & rec, int & photonsVisited)
+{
+    const size_t MAX_DEPTH = 21;
+    unsigned int stack[MAX_DEPTH];
+    unsigned int stack_current = 0;
+    unsigned int node = 0;
+
+    stack[stack_current++] = 0;
+    do
+    {
+        const PackedPhoton& photon = photonKdTree[ node ];
+        photonsVisited++;
+        uint axis = getPackedPhotonAxis(photon);
+        if( !( axis & PPM_NULL ) )
+        {
+            float3 diff = rec.position - photon.position;
+            if(dot(-decodeOctahedral(photon.direction), rec.normal) >= 0)
+            {
+                heap.insert(dot(diff, diff), node);
+            }
+
+            if( !( axis & PPM_LEAF ) ) {
+                float d;
+                if      ( axis & PPM_X ) d = diff.x;
+                else if ( axis & PPM_Y ) d = diff.y;
+                else                     d = diff.z;
+                int selector = d < 0.0f ? 0 : 1;
+                if( d*d < heap.searchRadius2() ) {
+                    stack[stack_current++] = (node<<1) + 2 - selector;
+                }
+                node = (node<<1) + 1 + selector;
+            } else {
+                node = stack[--stack_current];
+            }
+        } else {
+            node = stack[--stack_current];
+        }
+    }
+    while ( node );
+}
+
+__device__ __inline float3 accumulateNearestPhotons(const PhotonKNNHeap & heap, float & estimateRadius2)
+{
+    estimateRadius2 = heap.isFull() ? fmaxf(heap.distance2[0], 1e-12f) : heap.maxDistance2;
+    float3 power = make_float3(0.0f);
+    for(unsigned int i = 0; i < heap.size; i++)
+    {
+        power += photonPower(decodeRGBE(photonKdTree[heap.index[i]].power), heap.distance2[i], estimateRadius2);
+    }
+    return power;
+}
+
+#endif
@@ -18,7 +18,7 @@ rtDeclareVariable(uint1, launchIndex, rtLaunchIndex, );
 
 RT_PROGRAM void kernel()
 {
-    Photon photon = Photon(make_float3(0), make_float3(0), make_float3(0), make_float3(0));
+    Photon photon = Photon(make_float3(0), make_float3(0), make_float3(0), 0);
     photon.numDeposits = 0;
     volumetricPhotons[launchIndex.x] = photon;
 }
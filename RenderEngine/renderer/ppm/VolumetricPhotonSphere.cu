@@ -39,7 +39,7 @@ RT_PROGRAM void intersect(int primIdx)
         {
             photonId = primIdx;
             photonPosition = photon.position;
-            photonPower = photon.power*photon.numDeposits;
+            photonPower = getPhotonPower(photon)*photon.numDeposits;
             if( rtReportIntersection( 0 ) )
                 check_second = false;
         } 
@@ -51,7 +51,7 @@ RT_PROGRAM void intersect(int primIdx)
             {
                 photonId = primIdx;
                 photonPosition = photon.position;
-                photonPower = photon.power*photon.numDeposits;
+                photonPower = getPhotonPower(photon)*photon.numDeposits;
                 rtReportIntersection( 0 );
             }
         }
@@ -61,7 +61,7 @@ RT_PROGRAM void intersect(int primIdx)
 RT_PROGRAM void boundingBox(int primIdx, float result[6])
 {
     Photon & photon = photonsBuffer[primIdx];
-    if(fmaxf(photon.power) > 0)
+    if(photonHasPower(photon))
     {
         const float3 radius3 = make_float3(volumetricRadius);
         float3 min_ = photon.position - radius3;
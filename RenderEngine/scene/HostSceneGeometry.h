@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+
+#include <vector>
+#include <optixu/optixu_math_namespace.h>
+#include "material/HostMaterial.h"
+
+/*
+  A mesh of a node as placed in the OptiX scene graph: its triangles are
+  [firstTriangle, firstTriangle+numTriangles) of HostSceneGeometry.
+*/
+struct HostSceneInstance
+{
+    unsigned int objectId;
+    unsigned int firstTriangle;
+    unsigned int numTriangles;
+    HostMaterial material;
+};
+
+/*
+  Host copy of the scene geometry that Scene::getSceneRootGroup hands to OptiX, for renderers that
+  trace rays on the CPU. Triangles are in world space (meshes are normalized on load) with three
+  vertices and three shading normals each. Nodes are indexed by object id.
+*/
+struct HostSceneGeometry
+{
+    std::vector<optix::float3> vertices;
+    std::vector<optix::float3> normals;
+    std::vector<unsigned int> triangleInstance;
+    std::vector<HostSceneInstance> instances;
+
+    // Object id of the parent of each node, -1 for the root
+    std::vector<int> nodeParent;
+    // Whether the node has a non empty group in the scene graph, so it can be transformed
+    std::vector<bool> nodeHasGeometryGroup;
+};
@@ -24,6 +24,10 @@
 #include <optixu_matrix_namespace.h>
 #include <sstream>
 #include "util/RelPath.h"
+#include "SceneCache.h"
+#include "util/ParallelFor.h"
+#include <algorithm>
+#include <emmintrin.h>
 
 Scene::Scene(Logger *logger)
     : m_scene(NULL),
@@ -31,14 +35,19 @@ Scene::Scene(Logger *logger)
       m_numTriangles(0),
       m_sceneFile(NULL),
 	  m_logger(logger),
-	  m_hasAnyHoleMaterial(false)
+	  m_hasAnyHoleMaterial(false),
+	  m_sceneFromCache(false)
 {
 
 }
 
 Scene::~Scene(void)
 {
-    // deleting m_importer also deletes the scene
+    // deleting m_importer also deletes the scene, unless it was loaded from the cache
+    if(m_sceneFromCache)
+    {
+        delete m_scene;
+    }
     delete m_importer;
     for(int i = 0; i < m_materials.size(); i++)
     {
@@ -48,6 +57,16 @@ Scene::~Scene(void)
     delete m_sceneFile;
 }
 
+// Vertices or faces handed to a thread at once when normalizing meshes and calculating areas
+static const unsigned int MESH_RANGE_SIZE = 1 << 16;
+
+struct MeshRange
+{
+	unsigned int mesh;
+	unsigned int from;
+	unsigned int to;
+};
+
 static optix::float3 toFloat3( aiVector3D vector)
 {
     return optix::make_float3(vector.x, vector.y, vector.z);
@@ -90,15 +109,19 @@ Scene* Scene::createFromFile(Logger *logger, const char* filename )
 
 	QScopedPointer<Scene> scenePtr (new Scene(logger));
     scenePtr->m_sceneFile = new QFileInfo(filename);
+	scenePtr->m_sceneFiles.append(scenePtr->m_sceneFile->absoluteFilePath());
+	// Assimp does not tell which files it read, Wavefront material libraries are usually named after the scene
+	QFileInfo materialLibrary(scenePtr->m_sceneFile->absoluteDir(), scenePtr->m_sceneFile->completeBaseName() + ".mtl");
+	if(scenePtr->m_sceneFile->suffix().toLower() == "obj" && materialLibrary.exists())
+	{
+		scenePtr->m_sceneFiles.append(materialLibrary.absoluteFilePath());
+	}
 
     // Remove point and lines from the model
-    scenePtr->m_importer->SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, 
-        aiPrimitiveType_POINT | aiPrimitiveType_LINE );
-
-	QTime readFileTimer;
-	readFileTimer.start();
+    const int removedPrimitiveTypes = aiPrimitiveType_POINT | aiPrimitiveType_LINE;
+    scenePtr->m_importer->SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, removedPrimitiveTypes);
 
-    scenePtr->m_scene = (aiScene *) scenePtr->m_importer->ReadFile( filename,
+    const unsigned int importFlags = 
         aiProcess_Triangulate            |
         aiProcess_CalcTangentSpace       | 
         aiProcess_FindInvalidData        |
@@ -109,10 +132,24 @@ Scene* Scene::createFromFile(Logger *logger, const char* filename )
         //aiProcess_OptimizeGraph          | 
         aiProcess_OptimizeMeshes         |
         //aiProcess_PreTransformVertices   |
-        aiProcess_GenSmoothNormals                              
-        );
+        aiProcess_GenSmoothNormals;
+
+	QTime readFileTimer;
+	readFileTimer.start();
+
+#if ENABLE_SCENE_CACHE
+	SceneCache sceneCache(logger, scenePtr->m_sceneFile->absoluteFilePath(), importFlags, removedPrimitiveTypes);
+	scenePtr->m_scene = sceneCache.load();
+	scenePtr->m_sceneFromCache = scenePtr->m_scene != NULL;
+#endif
 
-	logger->log("Scene createFromFile ReadFile: ellapsed %5.2fs\n", readFileTimer.elapsed() / 1000.0f);
+	if(!scenePtr->m_sceneFromCache)
+	{
+		scenePtr->m_scene = (aiScene *) scenePtr->m_importer->ReadFile( filename, importFlags );
+	}
+
+	scenePtr->m_loadStatistics.readFileTime = readFileTimer.elapsed() / 1000.0;
+	scenePtr->m_loadStatistics.loadedFromCache = scenePtr->m_sceneFromCache;
         
     if(!scenePtr->m_scene)
     {
@@ -120,6 +157,15 @@ Scene* Scene::createFromFile(Logger *logger, const char* filename )
         throw std::exception(error.toUtf8().constData());
     }
 
+	// cached scenes are stored already normalized
+	if(!scenePtr->m_sceneFromCache)
+	{
+		QTime normalizeTimer;
+		normalizeTimer.start();
+		normalizeMeshes(scenePtr->m_scene);
+		scenePtr->m_loadStatistics.normalizeMeshesTime = normalizeTimer.elapsed() / 1000.0;
+	}
+
 	// gets the mapping from object id to node names and viceversa
 	{
 		QMap<unsigned int, aiNode *> objectIdToNode;
@@ -132,24 +178,35 @@ Scene* Scene::createFromFile(Logger *logger, const char* filename )
 		}
 	}
 
-	normalizeMeshes(scenePtr->m_scene);
-
     // Load materials
 
     scenePtr->loadSceneMaterials();
+
+#if ENABLE_SCENE_CACHE
+	// Saved once the materials have added their textures to the scene files, which key the cache
+	if(!scenePtr->m_sceneFromCache)
+	{
+		sceneCache.save(scenePtr->m_scene, scenePtr->m_sceneFiles);
+	}
+#endif
     
     // Load lights from file
 
     scenePtr->loadLightSources();
 
 
-	// walks to calculate area
-	scenePtr->m_objectArea.resize(scenePtr->m_nodes.size());
-	scenePtr->walkNode(scenePtr->m_scene, scenePtr->m_scene->mRootNode, 0);
+	QTime areaTimer;
+	areaTimer.start();
+	scenePtr->calcObjectAreas();
+	scenePtr->m_loadStatistics.objectAreaTime = areaTimer.elapsed() / 1000.0;
 
 	scenePtr->loadDiffuseEmmiters(scenePtr->m_scene->mRootNode);
 	scenePtr->countTriangles();
+
+	QTime aabbTimer;
+	aabbTimer.start();
 	scenePtr->calcAABB();
+	scenePtr->m_loadStatistics.aabbTime = aabbTimer.elapsed() / 1000.0;
 
     if(scenePtr->m_scene->mNumCameras > 0)
     {
@@ -158,7 +215,8 @@ Scene* Scene::createFromFile(Logger *logger, const char* filename )
 
     scenePtr->m_sceneName = QByteArray(scenePtr->m_sceneFile->absoluteFilePath().toLatin1().constData());
 
-	logger->log("Scene createFromFile Total: ellapsed %5.2fs\n", timerTotal.elapsed() / 1000.0f);
+	scenePtr->m_loadStatistics.totalTime = timerTotal.elapsed() / 1000.0;
+	scenePtr->logLoadStatistics();
 
     return scenePtr.take();
 }
@@ -196,6 +254,7 @@ void Scene::loadSceneMaterials()
         if(material->Get(AI_MATKEY_TEXTURE(aiTextureType_DIFFUSE, 0), textureName) == AI_SUCCESS)
         {
             QString textureAbsoluteFilePath = QString("%1/%2").arg(m_sceneFile->absoluteDir().absolutePath(), textureName.C_Str());
+            addSceneFile(textureAbsoluteFilePath);
             
             // Use the displacement map as a normal map (in the crytek sponza test scene)
             aiString normalsName;
@@ -204,6 +263,7 @@ void Scene::loadSceneMaterials()
             {
                 m_logger->log("Found normal map %s!\n", normalsName.C_Str());
                 QString normalsAbsoluteFilePath = QString("%1/%2").arg(m_sceneFile->absoluteDir().absolutePath(), normalsName.C_Str());
+                addSceneFile(normalsAbsoluteFilePath);
                 matl = new Texture(textureAbsoluteFilePath, normalsAbsoluteFilePath);
             }
             else
@@ -630,6 +690,20 @@ Camera Scene::getDefaultCamera() const
     return m_defaultCamera;
 }
 
+const QStringList & Scene::getSceneFiles() const
+{
+	return m_sceneFiles;
+}
+
+void Scene::addSceneFile(const QString & file)
+{
+	QString absoluteFilePath = QFileInfo(file).absoluteFilePath();
+	if(!m_sceneFiles.contains(absoluteFilePath))
+	{
+		m_sceneFiles.append(absoluteFilePath);
+	}
+}
+
 const char* Scene::getSceneName() const
 {
     return m_sceneName.constData();
@@ -645,18 +719,21 @@ AAB Scene::getSceneAABB() const
     return m_sceneAABB;
 }
 
-void Scene::walkNode(const aiScene *scene, const aiNode *node, int depth)
+void Scene::walkNode(const aiScene *scene, const aiNode *node, int depth, const QVector<double> & meshAreas,
+	const QVector<unsigned int> & meshNonTriangleFace)
 {
 	if(!node)
 		return;
+	
+	float area = getNodeArea(node, meshAreas, meshNonTriangleFace);
+
+#if ENABLE_SCENE_NODE_AREA_LOG
 	for(int i = 0; i < depth; ++i)
 	{
 		m_logger->log(" ");
 	}
-	
-	float area = getNodeArea(scene, node);
-
 	m_logger->log("%s: area %f\n", node->mName.C_Str(), area);
+#endif
 
 	unsigned int nodeId = m_nodeToId.value((aiNode *) node, UINT_MAX);
 	if(nodeId != UINT_MAX)
@@ -666,43 +743,115 @@ void Scene::walkNode(const aiScene *scene, const aiNode *node, int depth)
 
 	for(unsigned int i = 0; i < node->mNumChildren; ++i)
 	{
-		walkNode(scene, node->mChildren[i], depth+1);
+		walkNode(scene, node->mChildren[i], depth+1, meshAreas, meshNonTriangleFace);
 	}
 }
 
-float Scene::getNodeArea(const aiScene *scene, const aiNode *node)
+float Scene::getNodeArea(const aiNode *node, const QVector<double> & meshAreas, const QVector<unsigned int> & meshNonTriangleFace)
 {
 	double area = 0;
 
 	for(unsigned int meshIdx = 0; meshIdx < node->mNumMeshes; ++meshIdx)
 	{
-		auto mesh = m_scene->mMeshes[node->mMeshes[meshIdx]];
-		for(unsigned faceIdx = 0; faceIdx < mesh->mNumFaces; ++ faceIdx)
+		unsigned int mesh = node->mMeshes[meshIdx];
+		if (meshNonTriangleFace[mesh] != 0){
+			std::stringstream ss;
+			ss << "Non-triangle face in mesh " << node->mName.C_Str() << ". Got " << meshNonTriangleFace[mesh] << " vertex(es).";
+			throw std::invalid_argument(ss.str().c_str());
+		}
+		area += meshAreas[mesh];
+	}
+
+	return area;
+}
+
+/*
+// Splits the elements of every mesh into ranges of at most rangeSize, so that threads share the work
+// of big meshes and pick up small meshes whole
+*/
+static QVector<MeshRange> getMeshRanges(const QVector<unsigned int> & meshElements, unsigned int rangeSize)
+{
+	QVector<MeshRange> ranges;
+	for(int mesh = 0; mesh < meshElements.size(); ++mesh)
+	{
+		for(unsigned int from = 0; from < meshElements[mesh]; from += rangeSize)
 		{
-			auto face = mesh->mFaces[faceIdx];
-			if (face.mNumIndices != 3){
-				std::stringstream ss;
-				ss << "Non-triangle face in mesh " << node->mName.C_Str() << ". Got " << face.mNumIndices << " vertex(es).";
-				throw std::invalid_argument(ss.str().c_str());
-			}
-			
-			auto A = mesh->mVertices[face.mIndices[0]];
-			auto B = mesh->mVertices[face.mIndices[1]];
-			auto C = mesh->mVertices[face.mIndices[2]];
+			MeshRange range = {(unsigned int)mesh, from, std::min(meshElements[mesh], from + rangeSize)};
+			ranges.push_back(range);
+		}
+	}
+	return ranges;
+}
 
-			float c = (B - A).Length();
-			float b = (C - A).Length();
-			float a = (C - B).Length();
+/*
+// Areas of all meshes, with the cross product of the triangle edges. Meshes are already normalized so the
+// area is the same in every node using them. Faces which are not triangles have their index count stored
+// in meshNonTriangleFace, for walkNode to report.
+*/
+void Scene::calcObjectAreas()
+{
+	QVector<unsigned int> meshFaces(m_scene->mNumMeshes);
+	for(unsigned int i = 0; i < m_scene->mNumMeshes; ++i)
+	{
+		meshFaces[i] = m_scene->mMeshes[i]->mNumFaces;
+	}
+	QVector<MeshRange> ranges = getMeshRanges(meshFaces, MESH_RANGE_SIZE);
+	QVector<double> rangeAreas(ranges.size(), 0.0);
+	QVector<unsigned int> rangeNonTriangleFace(ranges.size(), 0);
 
-			float det = 2*b*b*c*c + 2*c*c*a*a + 2*a*a*b*b - a*a*a*a - b*b*b*b - c*c*c*c;
-			if(det >= 0.0)
+	parallelForDynamic(0, ranges.size(), getHardwareThreadCount(), 1, [&](int thread, int from, int to)
+	{
+		for(int rangeIdx = from; rangeIdx < to; ++rangeIdx)
+		{
+			const MeshRange & range = ranges[rangeIdx];
+			const aiMesh *mesh = m_scene->mMeshes[range.mesh];
+			double area = 0;
+			for(unsigned int faceIdx = range.from; faceIdx < range.to; ++faceIdx)
 			{
-				area += 0.25 * sqrt(det);
+				const aiFace & face = mesh->mFaces[faceIdx];
+				if(face.mNumIndices != 3)
+				{
+					rangeNonTriangleFace[rangeIdx] = face.mNumIndices;
+					break;
+				}
+				const aiVector3D & A = mesh->mVertices[face.mIndices[0]];
+				const aiVector3D & B = mesh->mVertices[face.mIndices[1]];
+				const aiVector3D & C = mesh->mVertices[face.mIndices[2]];
+				area += 0.5 * ((B - A) ^ (C - A)).Length();
 			}
+			rangeAreas[rangeIdx] = area;
+		}
+	});
+
+	QVector<double> meshAreas(m_scene->mNumMeshes, 0.0);
+	QVector<unsigned int> meshNonTriangleFace(m_scene->mNumMeshes, 0);
+	for(int rangeIdx = 0; rangeIdx < ranges.size(); ++rangeIdx)
+	{
+		unsigned int mesh = ranges[rangeIdx].mesh;
+		meshAreas[mesh] += rangeAreas[rangeIdx];
+		if(meshNonTriangleFace[mesh] == 0)
+		{
+			meshNonTriangleFace[mesh] = rangeNonTriangleFace[rangeIdx];
 		}
 	}
 
-	return area;
+	m_objectArea.resize(m_nodes.size());
+	walkNode(m_scene, m_scene->mRootNode, 0, meshAreas, meshNonTriangleFace);
+}
+
+const SceneLoadStatistics & Scene::getLoadStatistics() const
+{
+	return m_loadStatistics;
+}
+
+void Scene::logLoadStatistics()
+{
+	const SceneLoadStatistics & statistics = m_loadStatistics;
+	m_logger->log("Scene createFromFile ReadFile: ellapsed %5.2fs%s\n", statistics.readFileTime, statistics.loadedFromCache ? " (from cache)" : "");
+	m_logger->log("Scene createFromFile Normalize meshes: ellapsed %5.2fs\n", statistics.normalizeMeshesTime);
+	m_logger->log("Scene createFromFile Object areas: ellapsed %5.2fs\n", statistics.objectAreaTime);
+	m_logger->log("Scene createFromFile AABB: ellapsed %5.2fs\n", statistics.aabbTime);
+	m_logger->log("Scene createFromFile Total: ellapsed %5.2fs\n", statistics.totalTime);
 }
 
 float Scene::getSceneInitialPPMRadiusEstimate() const
@@ -715,12 +864,37 @@ float Scene::getSceneInitialPPMRadiusEstimate() const
     return radius;
 }
 
+/*
+// Transforms the meshes to world space. A mesh used by several nodes gets each node transformation
+// in turn, in node order, as if the nodes were visited one after another.
+*/
 void Scene::normalizeMeshes(aiScene *scene)
 {
-	normalizeMeshes(scene, aiMatrix4x4(), scene->mRootNode);
+	QVector<QVector<aiMatrix4x4>> meshTransformations(scene->mNumMeshes);
+	getMeshTransformations(scene->mRootNode, aiMatrix4x4(), meshTransformations);
+
+	QVector<unsigned int> meshVertices(scene->mNumMeshes);
+	for(unsigned int i = 0; i < scene->mNumMeshes; ++i)
+	{
+		meshVertices[i] = scene->mMeshes[i]->mNumVertices;
+	}
+	QVector<MeshRange> ranges = getMeshRanges(meshVertices, MESH_RANGE_SIZE);
+
+	parallelForDynamic(0, ranges.size(), getHardwareThreadCount(), 1, [&](int thread, int from, int to)
+	{
+		for(int rangeIdx = from; rangeIdx < to; ++rangeIdx)
+		{
+			const MeshRange & range = ranges[rangeIdx];
+			const QVector<aiMatrix4x4> & transformations = meshTransformations[range.mesh];
+			for(int i = 0; i < transformations.size(); ++i)
+			{
+				normalizeMesh(scene->mMeshes[range.mesh], transformations[i], range.from, range.to);
+			}
+		}
+	});
 }
 
-void Scene::normalizeMeshes(aiScene *scene, aiMatrix4x4 transformation, aiNode *node)
+void Scene::getMeshTransformations(const aiNode *node, aiMatrix4x4 transformation, QVector<QVector<aiMatrix4x4>> & meshTransformations)
 {
 	if(node == NULL)
 		return;
@@ -729,34 +903,66 @@ void Scene::normalizeMeshes(aiScene *scene, aiMatrix4x4 transformation, aiNode *
 	
 	for(unsigned int i = 0; i < node->mNumMeshes; ++i)
 	{
-		normalizeMesh(scene->mMeshes[node->mMeshes[i]], transformation);
+		meshTransformations[node->mMeshes[i]].push_back(transformation);
 	}
 
 	for(unsigned int i = 0; i < node->mNumChildren; ++i)
 	{
-		normalizeMeshes(scene, transformation, node->mChildren[i]);
+		getMeshTransformations(node->mChildren[i], transformation, meshTransformations);
 	}
 }
 
-void Scene::normalizeMesh(aiMesh *mesh, aiMatrix4x4 transformation)
+// Applies an affine matrix to an array of vectors, four at a time with SSE. Each component is computed
+// with the same operations in the same order as aiMatrix4x4 * aiVector3D, so results are unchanged.
+static void transformVectors(aiVector3D *vectors, unsigned int count, const aiMatrix4x4 & m)
 {
-	aiMatrix4x4 centeredTransformation = getCenteredMatrix(transformation);
+	const __m128 a1 = _mm_set1_ps(m.a1), a2 = _mm_set1_ps(m.a2), a3 = _mm_set1_ps(m.a3), a4 = _mm_set1_ps(m.a4);
+	const __m128 b1 = _mm_set1_ps(m.b1), b2 = _mm_set1_ps(m.b2), b3 = _mm_set1_ps(m.b3), b4 = _mm_set1_ps(m.b4);
+	const __m128 c1 = _mm_set1_ps(m.c1), c2 = _mm_set1_ps(m.c2), c3 = _mm_set1_ps(m.c3), c4 = _mm_set1_ps(m.c4);
 
-	for(unsigned int i = 0; i < mesh->mNumVertices; ++i)
+	unsigned int i = 0;
+	for(; i + 4 <= count; i += 4)
 	{
-		mesh->mVertices[i] = transformation * mesh->mVertices[i];
+		// Four packed vectors x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3 to one register per component
+		float *data = &vectors[i].x;
+		__m128 v0 = _mm_loadu_ps(data);
+		__m128 v1 = _mm_loadu_ps(data + 4);
+		__m128 v2 = _mm_loadu_ps(data + 8);
+		__m128 x = _mm_shuffle_ps(v0, _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(0, 1, 0, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+		__m128 y = _mm_shuffle_ps(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 z = _mm_shuffle_ps(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(v2, v2, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+
+		__m128 rx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a1, x), _mm_mul_ps(a2, y)), _mm_mul_ps(a3, z)), a4);
+		__m128 ry = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(b1, x), _mm_mul_ps(b2, y)), _mm_mul_ps(b3, z)), b4);
+		__m128 rz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c1, x), _mm_mul_ps(c2, y)), _mm_mul_ps(c3, z)), c4);
+
+		__m128 xyLow = _mm_unpacklo_ps(rx, ry);
+		__m128 xyHigh = _mm_unpackhi_ps(rx, ry);
+		_mm_storeu_ps(data, _mm_shuffle_ps(xyLow, _mm_shuffle_ps(rz, xyLow, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0)));
+		_mm_storeu_ps(data + 4, _mm_shuffle_ps(_mm_shuffle_ps(xyLow, rz, _MM_SHUFFLE(1, 1, 3, 3)), xyHigh, _MM_SHUFFLE(1, 0, 2, 0)));
+		_mm_storeu_ps(data + 8, _mm_shuffle_ps(_mm_shuffle_ps(rz, xyHigh, _MM_SHUFFLE(2, 2, 2, 2)), _mm_shuffle_ps(xyHigh, rz, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
 	}
+
+	for(; i < count; ++i)
+	{
+		vectors[i] = m * vectors[i];
+	}
+}
+
+void Scene::normalizeMesh(aiMesh *mesh, const aiMatrix4x4 & transformation, unsigned int fromVertex, unsigned int toVertex)
+{
+	aiMatrix4x4 centeredTransformation = getCenteredMatrix(transformation);
+	unsigned int numVertices = toVertex - fromVertex;
+
+	transformVectors(mesh->mVertices + fromVertex, numVertices, transformation);
 	
 	if(mesh->HasNormals())
 	{
-		for(unsigned int i = 0; i < mesh->mNumVertices; ++i)
+		transformVectors(mesh->mNormals + fromVertex, numVertices, centeredTransformation);
+		if(mesh->mTangents != NULL)
 		{
-			mesh->mNormals[i] = centeredTransformation * mesh->mNormals[i];
-			if(mesh->mTangents != NULL)
-			{
-				mesh->mTangents[i] = centeredTransformation * mesh->mTangents[i];
-				mesh->mBitangents[i] = centeredTransformation * mesh->mBitangents[i];
-			}
+			transformVectors(mesh->mTangents + fromVertex, numVertices, centeredTransformation);
+			transformVectors(mesh->mBitangents + fromVertex, numVertices, centeredTransformation);
 		}
 	}
 }
@@ -918,4 +1124,85 @@ QVector<QString> Scene::getObjectIdToNameMap() const
 		res.append((*it)->mName.C_Str());
 	}
 	return res;
-}
\ No newline at end of file
+}
+
+HostSceneGeometry Scene::getHostSceneGeometry() const
+{
+	HostSceneGeometry geometry;
+	geometry.nodeParent.resize(m_nodes.size(), -1);
+	geometry.nodeHasGeometryGroup.resize(m_nodes.size(), false);
+	for(int objectId = 0; objectId < m_nodes.size(); ++objectId)
+	{
+		aiNode *parent = m_nodes[objectId]->mParent;
+		if(parent != NULL)
+		{
+			geometry.nodeParent[objectId] = m_nodeToId.value(parent);
+		}
+	}
+
+	addHostSceneNode(m_scene->mRootNode, geometry);
+	return geometry;
+}
+
+// Same rules as getGroupFromNode: nodes with meshes do not include their children
+void Scene::addHostSceneNode(aiNode *node, HostSceneGeometry & geometry) const
+{
+	if (QString(node->mName.C_Str()).toLower().endsWith("__geometry") || !node->mNumMeshes && !node->mNumChildren)
+	{
+		return;
+	}
+
+	unsigned int objectId = m_nodeToId.value(node);
+	geometry.nodeHasGeometryGroup[objectId] = true;
+
+	if(node->mNumMeshes > 0)
+	{
+		for(unsigned int i = 0; i < node->mNumMeshes; ++i)
+		{
+			aiMesh* mesh = m_scene->mMeshes[node->mMeshes[i]];
+
+			HostSceneInstance instance;
+			instance.objectId = objectId;
+			instance.firstTriangle = (unsigned int)geometry.triangleInstance.size();
+			instance.numTriangles = mesh->mNumFaces;
+			instance.material = m_materials.at(mesh->mMaterialIndex)->getHostMaterial();
+
+			for(unsigned int faceIdx = 0; faceIdx < mesh->mNumFaces; ++faceIdx)
+			{
+				const aiFace & face = mesh->mFaces[faceIdx];
+				optix::float3 p0 = toFloat3(mesh->mVertices[face.mIndices[0]]);
+				optix::float3 p1 = toFloat3(mesh->mVertices[face.mIndices[1]]);
+				optix::float3 p2 = toFloat3(mesh->mVertices[face.mIndices[2]]);
+				geometry.vertices.push_back(p0);
+				geometry.vertices.push_back(p1);
+				geometry.vertices.push_back(p2);
+
+				if(mesh->HasNormals())
+				{
+					for(unsigned int vertex = 0; vertex < 3; ++vertex)
+					{
+						geometry.normals.push_back(toFloat3(mesh->mNormals[face.mIndices[vertex]]));
+					}
+				}
+				else
+				{
+					optix::float3 normal = optix::normalize(optix::cross(p1 - p0, p2 - p0));
+					geometry.normals.push_back(normal);
+					geometry.normals.push_back(normal);
+					geometry.normals.push_back(normal);
+				}
+
+				geometry.triangleInstance.push_back((unsigned int)geometry.instances.size());
+			}
+
+			geometry.instances.push_back(instance);
+		}
+	}
+	else
+	{
+		for(unsigned int i = 0; i < node->mNumChildren; ++i)
+		{
+			addHostSceneNode(node->mChildren[i], geometry);
+		}
+	}
+}
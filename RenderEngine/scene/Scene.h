@@ -11,12 +11,15 @@
 #include <QVector>
 #include <QByteArray>
 #include <QMap>
+#include <QStringList>
 #include <optixu/optixpp_namespace.h>
 #include "renderer/Camera.h"
 #include "renderer/Light.h"
 #include "render_engine_export_api.h"
 #include "math/AAB.h"
 #include "math/Vector3.h"
+#include "scene/HostSceneGeometry.h"
+#include "scene/SceneLoadStatistics.h"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/material.h>
@@ -43,6 +46,9 @@ public:
     RENDER_ENGINE_EXPORT_API virtual unsigned int getNumTriangles() const;
 	RENDER_ENGINE_EXPORT_API float getSceneInitialPPMRadiusEstimate() const;
 	RENDER_ENGINE_EXPORT_API QVector<QString> getObjectIdToNameMap() const;
+	RENDER_ENGINE_EXPORT_API const SceneLoadStatistics & getLoadStatistics() const;
+	// Absolute paths of the scene file and the files it refers to, for sending the scene to render servers
+	RENDER_ENGINE_EXPORT_API const QStringList & getSceneFiles() const;
 
 
 	// Scene object information
@@ -51,6 +57,9 @@ public:
 	RENDER_ENGINE_EXPORT_API unsigned int getObjectId(const QString& objectName) const;
 	RENDER_ENGINE_EXPORT_API QString getObjectName(int objectId) const;
 
+	// Scene geometry for tracing on the host
+	RENDER_ENGINE_EXPORT_API HostSceneGeometry getHostSceneGeometry() const;
+
 private:
 	Scene(Logger *logger);
     optix::Geometry Scene::createGeometryFromMesh(aiMesh* mesh, optix::Context & context);
@@ -60,23 +69,28 @@ private:
     bool colorHasAnyComponent(const aiColor3D & color);
     void loadSceneMaterials();
     void loadLightSources();
-	void walkNode(const aiScene *scene, const aiNode *node, int depth);
+	void walkNode(const aiScene *scene, const aiNode *node, int depth, const QVector<double> & meshAreas, const QVector<unsigned int> & meshNonTriangleFace);
+	void calcObjectAreas();
 	void mapNodeObjectId(aiNode *node, unsigned int& objectIdCumulative, QMap<unsigned int, aiNode *> &objectIdToNode);
 	aiMatrix4x4 getTransformation(aiNode *node);
 	void printMatrix(const aiMatrix4x4 &matrix);
-	float getNodeArea(const aiScene *scene, const aiNode *node);
+	float getNodeArea(const aiNode *node, const QVector<double> & meshAreas, const QVector<unsigned int> & meshNonTriangleFace);
 	static aiMatrix4x4 getCenteredMatrix(const aiMatrix4x4 &matrix);
 	static void normalizeMeshes(aiScene *scene);
-	static void normalizeMeshes(aiScene *scene, aiMatrix4x4 transformation, aiNode *node);
-	static void normalizeMesh(aiMesh *mesh, aiMatrix4x4 transformation);
+	static void getMeshTransformations(const aiNode *node, aiMatrix4x4 transformation, QVector<QVector<aiMatrix4x4>> & meshTransformations);
+	static void normalizeMesh(aiMesh *mesh, const aiMatrix4x4 & transformation, unsigned int fromVertex, unsigned int toVertex);
 	void countTriangles();
 	void calcAABB();
 	void loadDiffuseEmmiters(const aiNode *fromNode);
+	void addHostSceneNode(aiNode *node, HostSceneGeometry & geometry) const;
+	void logLoadStatistics();
+	void addSceneFile(const QString & file);
 
     QVector<Material*> m_materials;
     QVector<Light> m_lights;
     QByteArray m_sceneName;
     QFileInfo* m_sceneFile; 
+	QStringList m_sceneFiles;
     Assimp::Importer* m_importer;
     aiScene* m_scene;
     optix::Program m_intersectionProgram;
@@ -85,6 +99,8 @@ private:
     AAB m_sceneAABB;
     unsigned int m_numTriangles;
 	bool m_hasAnyHoleMaterial;
+	bool m_sceneFromCache;
+	SceneLoadStatistics m_loadStatistics;
 	Logger *m_logger;
 
 	// mappings to retrieve object info
@@ -0,0 +1,498 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "SceneCache.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QCryptographicHash>
+#include <QScopedPointer>
+#include <cstring>
+#include <exception>
+#include "logging/Logger.h"
+
+// Bump whenever the layout below or the processing done before save changes
+static const unsigned int SCENE_CACHE_VERSION = 2;
+static const char SCENE_CACHE_MAGIC[8] = {'O', 'P', 'P', 'S', 'C', 'E', 'N', 'E'};
+
+namespace
+{
+	enum MeshArrays
+	{
+		MESH_HAS_NORMALS = 1 << 0,
+		MESH_HAS_TANGENTS = 1 << 1
+	};
+
+	class CacheWriter
+	{
+	public:
+		template<class T> void write(const T & value)
+		{
+			writeArray(&value, 1);
+		}
+
+		template<class T> void writeArray(const T* values, unsigned int count)
+		{
+			m_data.append(reinterpret_cast<const char*>(values), (int)(sizeof(T)*count));
+		}
+
+		// Only the used characters of the 1KB aiString buffer
+		void writeString(const aiString & string)
+		{
+			write(string.length);
+			writeArray(string.data, string.length);
+		}
+
+		const QByteArray & data() const
+		{
+			return m_data;
+		}
+
+	private:
+		QByteArray m_data;
+	};
+
+	class CacheReader
+	{
+	public:
+		CacheReader(const uchar* data, qint64 size) :
+			m_data(data), m_size(size), m_position(0)
+		{
+		}
+
+		template<class T> T read()
+		{
+			T value;
+			readArray(&value, 1);
+			return value;
+		}
+
+		template<class T> void readArray(T* values, unsigned int count)
+		{
+			qint64 bytes = (qint64)sizeof(T)*count;
+			if(m_position + bytes > m_size)
+			{
+				throw std::exception("Scene cache file is truncated");
+			}
+			memcpy(values, m_data + m_position, (size_t)bytes);
+			m_position += bytes;
+		}
+
+		aiString readString()
+		{
+			unsigned int length = read<unsigned int>();
+			if(length >= MAXLEN)
+			{
+				throw std::exception("Scene cache string is too long");
+			}
+			aiString string;
+			readArray(string.data, length);
+			string.data[length] = '\0';
+			string.length = length;
+			return string;
+		}
+
+		template<class T> T* readNewArray(unsigned int count)
+		{
+			QScopedArrayPointer<T> values(new T[count]);
+			readArray(values.data(), count);
+			return values.take();
+		}
+
+	private:
+		const uchar* m_data;
+		qint64 m_size;
+		qint64 m_position;
+	};
+}
+
+static void writeNode(CacheWriter & writer, const aiNode *node)
+{
+	writer.writeString(node->mName);
+	writer.write(node->mTransformation);
+	writer.write(node->mNumMeshes);
+	writer.writeArray(node->mMeshes, node->mNumMeshes);
+	writer.write(node->mNumChildren);
+	for(unsigned int i = 0; i < node->mNumChildren; ++i)
+	{
+		writeNode(writer, node->mChildren[i]);
+	}
+}
+
+static aiNode* readNode(CacheReader & reader, aiNode *parent)
+{
+	QScopedPointer<aiNode> node(new aiNode());
+	node->mParent = parent;
+	node->mName = reader.readString();
+	node->mTransformation = reader.read<aiMatrix4x4>();
+	node->mNumMeshes = reader.read<unsigned int>();
+	node->mMeshes = reader.readNewArray<unsigned int>(node->mNumMeshes);
+
+	unsigned int numChildren = reader.read<unsigned int>();
+	node->mChildren = new aiNode*[numChildren];
+	for(unsigned int i = 0; i < numChildren; ++i)
+	{
+		// mNumChildren only counts read children, so ~aiNode cleans up after a truncated file
+		node->mChildren[i] = readNode(reader, node.data());
+		node->mNumChildren++;
+	}
+	return node.take();
+}
+
+static void writeMesh(CacheWriter & writer, const aiMesh *mesh)
+{
+	writer.writeString(mesh->mName);
+	writer.write(mesh->mPrimitiveTypes);
+	writer.write(mesh->mMaterialIndex);
+	writer.write(mesh->mNumVertices);
+	writer.write(mesh->mNumFaces);
+
+	unsigned int arrays = (mesh->HasNormals() ? MESH_HAS_NORMALS : 0) | (mesh->HasTangentsAndBitangents() ? MESH_HAS_TANGENTS : 0);
+	writer.write(arrays);
+	writer.writeArray(mesh->mVertices, mesh->mNumVertices);
+	if(arrays & MESH_HAS_NORMALS)
+	{
+		writer.writeArray(mesh->mNormals, mesh->mNumVertices);
+	}
+	if(arrays & MESH_HAS_TANGENTS)
+	{
+		writer.writeArray(mesh->mTangents, mesh->mNumVertices);
+		writer.writeArray(mesh->mBitangents, mesh->mNumVertices);
+	}
+
+	for(unsigned int set = 0; set < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++set)
+	{
+		unsigned int uvComponents = mesh->HasTextureCoords(set) ? mesh->mNumUVComponents[set] : 0;
+		writer.write(uvComponents);
+		if(mesh->HasTextureCoords(set))
+		{
+			writer.writeArray(mesh->mTextureCoords[set], mesh->mNumVertices);
+		}
+	}
+
+	for(unsigned int set = 0; set < AI_MAX_NUMBER_OF_COLOR_SETS; ++set)
+	{
+		unsigned int hasColors = mesh->HasVertexColors(set) ? 1 : 0;
+		writer.write(hasColors);
+		if(hasColors)
+		{
+			writer.writeArray(mesh->mColors[set], mesh->mNumVertices);
+		}
+	}
+
+	// Index counts of all faces first, then all the indices
+	for(unsigned int i = 0; i < mesh->mNumFaces; ++i)
+	{
+		writer.write(mesh->mFaces[i].mNumIndices);
+	}
+	for(unsigned int i = 0; i < mesh->mNumFaces; ++i)
+	{
+		writer.writeArray(mesh->mFaces[i].mIndices, mesh->mFaces[i].mNumIndices);
+	}
+}
+
+static aiMesh* readMesh(CacheReader & reader)
+{
+	QScopedPointer<aiMesh> mesh(new aiMesh());
+	mesh->mName = reader.readString();
+	mesh->mPrimitiveTypes = reader.read<unsigned int>();
+	mesh->mMaterialIndex = reader.read<unsigned int>();
+	mesh->mNumVertices = reader.read<unsigned int>();
+	unsigned int numFaces = reader.read<unsigned int>();
+
+	unsigned int arrays = reader.read<unsigned int>();
+	mesh->mVertices = reader.readNewArray<aiVector3D>(mesh->mNumVertices);
+	if(arrays & MESH_HAS_NORMALS)
+	{
+		mesh->mNormals = reader.readNewArray<aiVector3D>(mesh->mNumVertices);
+	}
+	if(arrays & MESH_HAS_TANGENTS)
+	{
+		mesh->mTangents = reader.readNewArray<aiVector3D>(mesh->mNumVertices);
+		mesh->mBitangents = reader.readNewArray<aiVector3D>(mesh->mNumVertices);
+	}
+
+	for(unsigned int set = 0; set < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++set)
+	{
+		unsigned int uvComponents = reader.read<unsigned int>();
+		if(uvComponents > 0)
+		{
+			mesh->mNumUVComponents[set] = uvComponents;
+			mesh->mTextureCoords[set] = reader.readNewArray<aiVector3D>(mesh->mNumVertices);
+		}
+	}
+
+	for(unsigned int set = 0; set < AI_MAX_NUMBER_OF_COLOR_SETS; ++set)
+	{
+		if(reader.read<unsigned int>())
+		{
+			mesh->mColors[set] = reader.readNewArray<aiColor4D>(mesh->mNumVertices);
+		}
+	}
+
+	mesh->mFaces = new aiFace[numFaces];
+	mesh->mNumFaces = numFaces;
+	for(unsigned int i = 0; i < numFaces; ++i)
+	{
+		mesh->mFaces[i].mNumIndices = reader.read<unsigned int>();
+	}
+	for(unsigned int i = 0; i < numFaces; ++i)
+	{
+		mesh->mFaces[i].mIndices = reader.readNewArray<unsigned int>(mesh->mFaces[i].mNumIndices);
+	}
+	return mesh.take();
+}
+
+static void writeMaterial(CacheWriter & writer, const aiMaterial *material)
+{
+	writer.write(material->mNumProperties);
+	for(unsigned int i = 0; i < material->mNumProperties; ++i)
+	{
+		const aiMaterialProperty *property = material->mProperties[i];
+		writer.writeString(property->mKey);
+		writer.write(property->mSemantic);
+		writer.write(property->mIndex);
+		writer.write(property->mType);
+		writer.write(property->mDataLength);
+		writer.writeArray(property->mData, property->mDataLength);
+	}
+}
+
+static aiMaterial* readMaterial(CacheReader & reader)
+{
+	QScopedPointer<aiMaterial> material(new aiMaterial());
+	unsigned int numProperties = reader.read<unsigned int>();
+	for(unsigned int i = 0; i < numProperties; ++i)
+	{
+		aiString key = reader.readString();
+		unsigned int semantic = reader.read<unsigned int>();
+		unsigned int index = reader.read<unsigned int>();
+		aiPropertyTypeInfo type = reader.read<aiPropertyTypeInfo>();
+		unsigned int dataLength = reader.read<unsigned int>();
+		QScopedArrayPointer<char> data(reader.readNewArray<char>(dataLength));
+		material->AddBinaryProperty(data.data(), dataLength, key.C_Str(), semantic, index, type);
+	}
+	return material.take();
+}
+
+SceneCache::SceneCache(Logger *logger, const QString & sceneFile, unsigned int importFlags, int removedPrimitiveTypes) :
+	m_logger(logger),
+	m_sceneFile(sceneFile),
+	m_cacheFile(sceneFile + ".scenecache"),
+	m_importFlags(importFlags),
+	m_removedPrimitiveTypes(removedPrimitiveTypes)
+{
+}
+
+// Hashes the path and contents of each file, so renaming a texture also invalidates the cache.
+// Returns an empty hash if any of the files can not be read
+QByteArray SceneCache::getSceneFilesHash(const QStringList & relativeFilePaths) const
+{
+	QDir sceneDirectory = QFileInfo(m_sceneFile).absoluteDir();
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	foreach(const QString & relativeFilePath, relativeFilePaths)
+	{
+		QFile file(sceneDirectory.absoluteFilePath(relativeFilePath));
+		if(!file.open(QIODevice::ReadOnly))
+		{
+			return QByteArray();
+		}
+		QByteArray path = relativeFilePath.toUtf8();
+		const unsigned int pathLength = path.size();
+		const qint64 fileSize = file.size();
+		hash.addData(reinterpret_cast<const char*>(&pathLength), sizeof(pathLength));
+		hash.addData(path);
+		hash.addData(reinterpret_cast<const char*>(&fileSize), sizeof(fileSize));
+		while(!file.atEnd())
+		{
+			hash.addData(file.read(1 << 20));
+		}
+	}
+	return hash.result();
+}
+
+/*
+// Layout: magic, version, import flags, removed primitive types, the scene files relative to the scene
+// directory, their hash, then the scene flags,
+// meshes, materials, lights, cameras and the node tree
+*/
+aiScene* SceneCache::load()
+{
+	QFile cacheFile(m_cacheFile);
+	if(!cacheFile.open(QIODevice::ReadOnly))
+	{
+		return NULL;
+	}
+
+	const uchar* data = cacheFile.map(0, cacheFile.size());
+	if(data == NULL)
+	{
+		m_logger->log("Scene cache %s could not be mapped\n", qPrintable(m_cacheFile));
+		return NULL;
+	}
+
+	QScopedPointer<aiScene> scene;
+	try
+	{
+		CacheReader reader(data, cacheFile.size());
+		char magic[sizeof(SCENE_CACHE_MAGIC)];
+		reader.readArray(magic, sizeof(magic));
+		if(memcmp(magic, SCENE_CACHE_MAGIC, sizeof(magic)) != 0 ||
+			reader.read<unsigned int>() != SCENE_CACHE_VERSION ||
+			reader.read<unsigned int>() != m_importFlags ||
+			reader.read<int>() != m_removedPrimitiveTypes)
+		{
+			m_logger->log("Scene cache %s is from another version or import settings\n", qPrintable(m_cacheFile));
+			return NULL;
+		}
+
+		QStringList sceneFiles;
+		unsigned int numSceneFiles = reader.read<unsigned int>();
+		for(unsigned int i = 0; i < numSceneFiles; ++i)
+		{
+			aiString sceneFile = reader.readString();
+			sceneFiles.append(QString::fromUtf8(sceneFile.data, sceneFile.length));
+		}
+
+		QByteArray sceneFilesHash = getSceneFilesHash(sceneFiles);
+		char cachedHash[20];
+		reader.readArray(cachedHash, sizeof(cachedHash));
+		if(sceneFilesHash.size() != sizeof(cachedHash) || memcmp(cachedHash, sceneFilesHash.constData(), sizeof(cachedHash)) != 0)
+		{
+			m_logger->log("Scene cache %s is out of date\n", qPrintable(m_cacheFile));
+			return NULL;
+		}
+
+		// Counts are set as elements are read so that ~aiScene only deletes what exists
+		scene.reset(new aiScene());
+		scene->mFlags = reader.read<unsigned int>();
+
+		unsigned int numMeshes = reader.read<unsigned int>();
+		scene->mMeshes = new aiMesh*[numMeshes];
+		for(unsigned int i = 0; i < numMeshes; ++i)
+		{
+			scene->mMeshes[i] = readMesh(reader);
+			scene->mNumMeshes++;
+		}
+
+		unsigned int numMaterials = reader.read<unsigned int>();
+		scene->mMaterials = new aiMaterial*[numMaterials];
+		for(unsigned int i = 0; i < numMaterials; ++i)
+		{
+			scene->mMaterials[i] = readMaterial(reader);
+			scene->mNumMaterials++;
+		}
+
+		unsigned int numLights = reader.read<unsigned int>();
+		scene->mLights = new aiLight*[numLights];
+		for(unsigned int i = 0; i < numLights; ++i)
+		{
+			scene->mLights[i] = new aiLight(reader.read<aiLight>());
+			scene->mNumLights++;
+		}
+
+		unsigned int numCameras = reader.read<unsigned int>();
+		scene->mCameras = new aiCamera*[numCameras];
+		for(unsigned int i = 0; i < numCameras; ++i)
+		{
+			scene->mCameras[i] = new aiCamera(reader.read<aiCamera>());
+			scene->mNumCameras++;
+		}
+
+		scene->mRootNode = readNode(reader, NULL);
+	}
+	catch(const std::exception & e)
+	{
+		m_logger->log("Scene cache %s could not be read: %s\n", qPrintable(m_cacheFile), e.what());
+		return NULL;
+	}
+
+	m_logger->log("Scene loaded from cache %s\n", qPrintable(m_cacheFile));
+	return scene.take();
+}
+
+void SceneCache::save(const aiScene *scene, const QStringList & sceneFiles)
+{
+	QDir sceneDirectory = QFileInfo(m_sceneFile).absoluteDir();
+	QStringList relativeFilePaths;
+	foreach(const QString & sceneFile, sceneFiles)
+	{
+		relativeFilePaths.append(sceneDirectory.relativeFilePath(sceneFile));
+		if(relativeFilePaths.last().toUtf8().size() >= MAXLEN)
+		{
+			m_logger->log("Scene cache %s not written, the path %s is too long\n", qPrintable(m_cacheFile), qPrintable(sceneFile));
+			return;
+		}
+	}
+
+	QByteArray sceneFilesHash = getSceneFilesHash(relativeFilePaths);
+	if(sceneFilesHash.isEmpty())
+	{
+		return;
+	}
+
+	CacheWriter writer;
+	writer.writeArray(SCENE_CACHE_MAGIC, sizeof(SCENE_CACHE_MAGIC));
+	writer.write(SCENE_CACHE_VERSION);
+	writer.write(m_importFlags);
+	writer.write(m_removedPrimitiveTypes);
+	writer.write((unsigned int)relativeFilePaths.size());
+	foreach(const QString & relativeFilePath, relativeFilePaths)
+	{
+		QByteArray path = relativeFilePath.toUtf8();
+		aiString string;
+		string.Set(std::string(path.constData(), path.size()));
+		writer.writeString(string);
+	}
+	writer.writeArray(sceneFilesHash.constData(), sceneFilesHash.size());
+	writer.write(scene->mFlags);
+
+	writer.write(scene->mNumMeshes);
+	for(unsigned int i = 0; i < scene->mNumMeshes; ++i)
+	{
+		writeMesh(writer, scene->mMeshes[i]);
+	}
+
+	writer.write(scene->mNumMaterials);
+	for(unsigned int i = 0; i < scene->mNumMaterials; ++i)
+	{
+		writeMaterial(writer, scene->mMaterials[i]);
+	}
+
+	// Lights and cameras have no pointers, so they are stored as they are in memory
+	writer.write(scene->mNumLights);
+	for(unsigned int i = 0; i < scene->mNumLights; ++i)
+	{
+		writer.write(*scene->mLights[i]);
+	}
+
+	writer.write(scene->mNumCameras);
+	for(unsigned int i = 0; i < scene->mNumCameras; ++i)
+	{
+		writer.write(*scene->mCameras[i]);
+	}
+
+	writeNode(writer, scene->mRootNode);
+
+	// Write to a temporary file first so that an interrupted save never leaves a partial cache behind
+	QString temporaryFile = m_cacheFile + ".tmp";
+	QFile file(temporaryFile);
+	if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(writer.data()) != writer.data().size())
+	{
+		m_logger->log("Scene cache %s could not be written\n", qPrintable(m_cacheFile));
+		file.close();
+		QFile::remove(temporaryFile);
+		return;
+	}
+	file.close();
+
+	QFile::remove(m_cacheFile);
+	if(!QFile::rename(temporaryFile, m_cacheFile))
+	{
+		m_logger->log("Scene cache %s could not be written\n", qPrintable(m_cacheFile));
+		QFile::remove(temporaryFile);
+	}
+}
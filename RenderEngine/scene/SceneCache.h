@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <assimp/scene.h>
+
+class Logger;
+
+/*
+  Binary cache of an imported scene, stored next to the scene file. It holds the aiScene as Scene uses it,
+  after the Assimp post-processing and normalizeMeshes, so a cache hit skips both. Entries are keyed by
+  the import settings and the SHA-1 of every file the scene was built from (the scene file, material
+  libraries and textures, see Scene::getSceneFiles), and are read from a memory mapping with one copy
+  per array.
+*/
+class SceneCache
+{
+public:
+	SceneCache(Logger *logger, const QString & sceneFile, unsigned int importFlags, int removedPrimitiveTypes);
+
+	// Returns the cached scene, owned by the caller, or NULL if there is no valid cache entry
+	aiScene* load();
+	// sceneFiles are all the files the scene depends on, the list is stored in the cache to validate it on load
+	void save(const aiScene *scene, const QStringList & sceneFiles);
+
+private:
+	QByteArray getSceneFilesHash(const QStringList & relativeFilePaths) const;
+
+	Logger *m_logger;
+	QString m_sceneFile;
+	QString m_cacheFile;
+	unsigned int m_importFlags;
+	int m_removedPrimitiveTypes;
+};
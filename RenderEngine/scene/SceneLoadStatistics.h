@@ -0,0 +1,23 @@
+#pragma once
+
+// Seconds spent in each step of Scene::createFromFile
+struct SceneLoadStatistics {
+	SceneLoadStatistics():
+		readFileTime(0),
+		normalizeMeshesTime(0),
+		objectAreaTime(0),
+		aabbTime(0),
+		totalTime(0),
+		loadedFromCache(false)
+	{
+
+	}
+
+	// Assimp import and post-processing, or reading the scene cache
+	double readFileTime;
+	double normalizeMeshesTime;
+	double objectAreaTime;
+	double aabbTime;
+	double totalTime;
+	bool loadedFromCache;
+};
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2013 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
+inline int getHardwareThreadCount()
+{
+    unsigned int threads = std::thread::hardware_concurrency();
+    return threads == 0 ? 1 : (int)threads;
+}
+
+/*
+  Splits [begin, end) into at most maxChunks chunks of at least minChunkSize elements and runs
+  func(chunkIndex, chunkBegin, chunkEnd) on each of them, the first one on the calling thread.
+  Returns the number of chunks used, so per-chunk results can be combined afterwards.
+*/
+template<class Func> int parallelForChunks(int begin, int end, int maxChunks, int minChunkSize, Func func)
+{
+    int count = end - begin;
+    int numChunks = std::max(1, std::min(maxChunks, count / std::max(1, minChunkSize)));
+    std::vector<std::future<void>> tasks;
+    tasks.reserve(numChunks - 1);
+    for(int chunk = 1; chunk < numChunks; ++chunk)
+    {
+        int chunkBegin = begin + (int)((long long)count * chunk / numChunks);
+        int chunkEnd = begin + (int)((long long)count * (chunk + 1) / numChunks);
+        tasks.push_back(std::async(std::launch::async, func, chunk, chunkBegin, chunkEnd));
+    }
+    func(0, begin, begin + (int)((long long)count / numChunks));
+    for(size_t i = 0; i < tasks.size(); ++i)
+    {
+        tasks[i].get();
+    }
+    return numChunks;
+}
+
+
+/*
+  Runs func(threadIndex, batchBegin, batchEnd) over [begin, end) on numThreads threads that take
+  batches of batchSize elements from a shared counter until none are left, so that threads which
+  get cheap batches take more of them. Use when the cost per element varies a lot.
+*/
+template<class Func> void parallelForDynamic(int begin, int end, int numThreads, int batchSize, Func func)
+{
+    std::atomic<int> next(begin);
+    auto worker = [&](int thread)
+    {
+        for(int batchBegin = next.fetch_add(batchSize); batchBegin < end; batchBegin = next.fetch_add(batchSize))
+        {
+            func(thread, batchBegin, std::min(end, batchBegin + batchSize));
+        }
+    };
+
+    std::vector<std::future<void>> tasks;
+    tasks.reserve(std::max(0, numThreads - 1));
+    for(int thread = 1; thread < numThreads; ++thread)
+    {
+        tasks.push_back(std::async(std::launch::async, worker, thread));
+    }
+    worker(0);
+    for(size_t i = 0; i < tasks.size(); ++i)
+    {
+        tasks[i].get();
+    }
+}
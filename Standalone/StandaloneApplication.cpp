@@ -13,8 +13,8 @@ StandaloneApplication::StandaloneApplication(QApplication & qApplication, const
     : Application(qApplication),
       m_renderManager(qApplication, *this, device)
 {
-    connect(&m_renderManager, SIGNAL(newFrameReadyForDisplay(const float*, unsigned long long)), 
-            this, SIGNAL(newFrameReadyForDisplay(const float*, unsigned long long)));
+    connect(&m_renderManager, SIGNAL(newFrameReadyForDisplay(const float*, unsigned long long, unsigned int, unsigned int)), 
+            this, SIGNAL(newFrameReadyForDisplay(const float*, unsigned long long, unsigned int, unsigned int)));
 
     // Run render manager in thread
 
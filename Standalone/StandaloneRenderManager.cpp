@@ -16,15 +16,34 @@
 #include <QApplication>
 #include "Application.hxx"
 
+// Buffers in the output ring, one each for the renderer, the latest frame and the display
+static const int NUM_OUTPUT_BUFFERS = 3;
+static const double DEFAULT_DISPLAY_TARGET_FPS = 30.0;
+
 StandaloneRenderManager::StandaloneRenderManager(QApplication & qApplication, Application & application, const ComputeDevice& device) :
     m_device(device),
     m_renderer(NULL), 
     m_nextIterationNumber(0),
-    m_outputBuffer(NULL),
+    m_outputBuffers(NUM_OUTPUT_BUFFERS),
+    m_renderBufferIndex(0),
+    m_latestBufferIndex(-1),
+    m_displayBufferIndex(-1),
+    m_latestIterationNumber(0),
+    m_numDroppedFrames(0),
+    m_numDisplayedFrames(0),
+    m_displayTargetFPS(DEFAULT_DISPLAY_TARGET_FPS),
+    m_hasUndisplayedIteration(false),
+    m_lastRenderedIterationNumber(0),
+    m_rateNumIterations(0),
+    m_rateNumDisplayedFrames(0),
     m_currentScene(NULL),
     m_compileScene(false),
     m_application(application),
     m_noEmittedSignals(true),
+    m_rendererBuildPhotonMapOnCPU(false),
+    m_rendererPersistentPhotonGrid(false),
+    m_rendererPhotonGatherMode(PhotonGatherMode::FIXED_RADIUS),
+    m_rendererNearestPhotons(0),
 	m_logger()
 {
     connect(&application, SIGNAL(sequenceNumberIncremented()), this, SLOT(onSequenceNumberIncremented()));
@@ -37,6 +56,10 @@ StandaloneRenderManager::StandaloneRenderManager(QApplication & qApplication, Ap
     connect(this, SIGNAL(continueRayTracing()), 
             this, SLOT(onContinueRayTracing()), 
             Qt::QueuedConnection);
+
+    // The display acknowledges each frame once it has copied it, see Application::frameDisplayed. The slot runs on
+    // the GUI thread, so that the next frame is handed over without waiting for the current iteration to finish.
+    connect(&application, SIGNAL(frameDisplayed()), this, SLOT(onFrameDisplayed()), Qt::DirectConnection);
 }
 
 SignalLogger& StandaloneRenderManager::logger()
@@ -46,11 +69,11 @@ SignalLogger& StandaloneRenderManager::logger()
 
 StandaloneRenderManager::~StandaloneRenderManager()
 {
-    if(m_outputBuffer != NULL)
+    for(int i = 0; i < m_outputBuffers.size(); ++i)
     {
-        delete[] m_outputBuffer;
-        m_outputBuffer = NULL;
+        delete[] m_outputBuffers[i].data;
     }
+    m_outputBuffers.clear();
 }
 
 void StandaloneRenderManager::start()
@@ -71,11 +94,68 @@ void StandaloneRenderManager::reinitRenderer(OptixRenderer *newRenderer)
 		delete m_renderer;
 	}
 	m_renderer = newRenderer;
+	m_hasUndisplayedIteration = false;
 	m_application.setRendererStatus(RendererStatus::INITIALIZING_ENGINE);
 	m_renderer->initialize(m_device, &m_logger);
 	m_compileScene = true;
 }
 
+// A new renderer is needed when the render method changes or a setting that is only taken at initialize does
+bool StandaloneRenderManager::isRendererOutdated() const
+{
+	const PPMSettingsModel & settings = m_application.getPPMSettingsModel();
+	if(m_application.getRenderMethod() == RenderMethod::PHOTON_MAPPING ? !dynamic_cast<PMOptixRenderer *>(m_renderer)
+		: !dynamic_cast<PPMOptixRenderer *>(m_renderer))
+	{
+		return true;
+	}
+	return settings.getBuildPhotonMapOnCPU() != m_rendererBuildPhotonMapOnCPU
+		|| settings.getPersistentPhotonGrid() != m_rendererPersistentPhotonGrid;
+}
+
+// Renderer for the current render method, with the photon map settings applied before it is initialized
+OptixRenderer* StandaloneRenderManager::createRenderer()
+{
+	const PPMSettingsModel & settings = m_application.getPPMSettingsModel();
+	m_rendererBuildPhotonMapOnCPU = settings.getBuildPhotonMapOnCPU();
+	m_rendererPersistentPhotonGrid = settings.getPersistentPhotonGrid();
+	m_rendererPhotonGatherMode = PhotonGatherMode::FIXED_RADIUS;
+	m_rendererNearestPhotons = 0;
+	if(m_application.getRenderMethod() == RenderMethod::PHOTON_MAPPING)
+	{
+		PMOptixRenderer* renderer = new PMOptixRenderer();
+		renderer->setBuildPhotonMapOnCPU(m_rendererBuildPhotonMapOnCPU);
+		return renderer;
+	}
+	PPMOptixRenderer* renderer = new PPMOptixRenderer();
+	renderer->setBuildPhotonMapOnCPU(m_rendererBuildPhotonMapOnCPU);
+	renderer->setPersistentPhotonGrid(m_rendererPersistentPhotonGrid);
+	return renderer;
+}
+
+// The gather mode can be changed on an initialized renderer, so it is applied when the setting changes
+void StandaloneRenderManager::applyPhotonGatherMode()
+{
+	const PPMSettingsModel & settings = m_application.getPPMSettingsModel();
+	PhotonGatherMode::E photonGatherMode = settings.getPhotonGatherMode();
+	unsigned int nearestPhotons = settings.getNearestPhotons();
+	if(photonGatherMode == m_rendererPhotonGatherMode && nearestPhotons == m_rendererNearestPhotons)
+	{
+		return;
+	}
+
+	if(PPMOptixRenderer* renderer = dynamic_cast<PPMOptixRenderer *>(m_renderer))
+	{
+		renderer->setPhotonGatherMode(photonGatherMode, nearestPhotons);
+	}
+	else if(PMOptixRenderer* renderer = dynamic_cast<PMOptixRenderer *>(m_renderer))
+	{
+		renderer->setPhotonGatherMode(photonGatherMode, nearestPhotons);
+	}
+	m_rendererPhotonGatherMode = photonGatherMode;
+	m_rendererNearestPhotons = nearestPhotons;
+}
+
 void StandaloneRenderManager::onContinueRayTracing()
 {
     renderNextIteration();
@@ -115,14 +195,11 @@ void StandaloneRenderManager::renderNextIteration()
         {
             m_noEmittedSignals = true;
 
-			if(m_application.getRenderMethod() == RenderMethod::PHOTON_MAPPING && !dynamic_cast<PMOptixRenderer *>(m_renderer))
-			{
-				reinitRenderer(new PMOptixRenderer());
-			}
-			else if(m_application.getRenderMethod() != RenderMethod::PHOTON_MAPPING && !dynamic_cast<PPMOptixRenderer *>(m_renderer))
+			if(isRendererOutdated())
 			{
-				reinitRenderer(new PPMOptixRenderer());
+				reinitRenderer(createRenderer());
 			}
+			applyPhotonGatherMode();
 
             if(m_compileScene)
             {
@@ -147,13 +224,12 @@ void StandaloneRenderManager::renderNextIteration()
             const double ppmRadiusSquaredNew = ppmRadiusSquared*(m_nextIterationNumber+PPMAlpha)/double(m_nextIterationNumber+1);
             m_PPMRadius = sqrt(ppmRadiusSquaredNew);
 
-            // Transfer the output buffer to CPU and signal ready for display
-            if(m_outputBuffer == NULL)
+            m_hasUndisplayedIteration = true;
+            m_lastRenderedIterationNumber = m_nextIterationNumber;
+            if(isDisplayFrameDue())
             {
-                m_outputBuffer = new float[2000*2000*3];
+                displayLastIteration();
             }
-            m_renderer->getOutputBuffer(m_outputBuffer);
-            emit newFrameReadyForDisplay(m_outputBuffer, m_nextIterationNumber);
 
             fillRenderStatistics();
             m_nextIterationNumber++;
@@ -170,8 +246,123 @@ void StandaloneRenderManager::renderNextIteration()
     }
 }
 
+// The first iteration of a sequence is always shown so that camera changes show up at once
+bool StandaloneRenderManager::isDisplayFrameDue() const
+{
+    return m_nextIterationNumber == 0 || m_displayTargetFPS <= 0 || !m_displayTimer.isValid()
+        || m_displayTimer.elapsed() >= 1000.0/m_displayTargetFPS;
+}
+
+// Transfers the output buffer of the last rendered iteration to the CPU and signals it ready for display
+void StandaloneRenderManager::displayLastIteration()
+{
+    m_renderer->getOutputBuffer(getRenderBuffer(m_renderer->getWidth(), m_renderer->getHeight()));
+    publishFrame(m_lastRenderedIterationNumber);
+    m_displayTimer.start();
+    m_hasUndisplayedIteration = false;
+}
+
+void StandaloneRenderManager::setDisplayTargetFPS(double displayTargetFPS)
+{
+    m_displayTargetFPS = displayTargetFPS;
+}
+
+// The buffer to read the next frame back into, grown to width x height if needed. The render buffer is never
+// held by the display, so it can be reallocated here.
+float* StandaloneRenderManager::getRenderBuffer(unsigned int width, unsigned int height)
+{
+    QMutexLocker locker(&m_outputBuffersMutex);
+    OutputBuffer & buffer = m_outputBuffers[m_renderBufferIndex];
+    size_t numFloats = (size_t)width*height*3;
+    if(buffer.capacity < numFloats)
+    {
+        delete[] buffer.data;
+        buffer.capacity = qMax(numFloats, buffer.capacity + buffer.capacity/2);
+        buffer.data = new float[buffer.capacity];
+    }
+    buffer.width = width;
+    buffer.height = height;
+    return buffer.data;
+}
+
+// Makes the buffer just read back the latest frame and continues in a free buffer. A latest frame the display
+// never took is dropped, so rendering does not wait for a display that falls behind.
+void StandaloneRenderManager::publishFrame(unsigned long long iterationNumber)
+{
+    QMutexLocker locker(&m_outputBuffersMutex);
+    int previousLatestIndex = m_latestBufferIndex;
+    m_latestBufferIndex = m_renderBufferIndex;
+    m_latestIterationNumber = iterationNumber;
+    if(previousLatestIndex != -1)
+    {
+        m_renderBufferIndex = previousLatestIndex;
+        m_numDroppedFrames++;
+    }
+    else
+    {
+        for(int i = 0; i < m_outputBuffers.size(); ++i)
+        {
+            if(i != m_latestBufferIndex && i != m_displayBufferIndex)
+            {
+                m_renderBufferIndex = i;
+                break;
+            }
+        }
+    }
+    if(m_displayBufferIndex == -1)
+    {
+        handLatestFrameToDisplay();
+    }
+}
+
+// Gives the latest frame to the display, which owns it until onFrameDisplayed. Called with the mutex locked.
+void StandaloneRenderManager::handLatestFrameToDisplay()
+{
+    m_displayBufferIndex = m_latestBufferIndex;
+    m_latestBufferIndex = -1;
+    const OutputBuffer & buffer = m_outputBuffers[m_displayBufferIndex];
+    emit newFrameReadyForDisplay(buffer.data, m_latestIterationNumber, buffer.width, buffer.height);
+}
+
+// Runs on the GUI thread when the display has copied the frame it was handed and no longer reads the buffer
+void StandaloneRenderManager::onFrameDisplayed()
+{
+    QMutexLocker locker(&m_outputBuffersMutex);
+    m_displayBufferIndex = -1;
+    m_numDisplayedFrames++;
+    if(m_latestBufferIndex != -1)
+    {
+        handLatestFrameToDisplay();
+    }
+}
+
+void StandaloneRenderManager::updateRates()
+{
+    m_rateNumIterations++;
+    if(!m_rateTimer.isValid())
+    {
+        m_rateTimer.start();
+        return;
+    }
+    double seconds = m_rateTimer.elapsed()/1000.0;
+    if(seconds >= 1.0)
+    {
+        unsigned long long numDisplayedFrames;
+        {
+            QMutexLocker locker(&m_outputBuffersMutex);
+            numDisplayedFrames = m_numDisplayedFrames;
+        }
+        m_application.getRenderStatisticsModel().setIterationsPerSecond(m_rateNumIterations/seconds);
+        m_application.getRenderStatisticsModel().setDisplayedFramesPerSecond((numDisplayedFrames - m_rateNumDisplayedFrames)/seconds);
+        m_rateNumIterations = 0;
+        m_rateNumDisplayedFrames = numDisplayedFrames;
+        m_rateTimer.start();
+    }
+}
+
 void StandaloneRenderManager::fillRenderStatistics()
 {
+    updateRates();
     m_application.getRenderStatisticsModel().setNumIterations(m_nextIterationNumber);
     m_application.getRenderStatisticsModel().setCurrentPPMRadius(m_PPMRadius);
 
@@ -193,6 +384,7 @@ void StandaloneRenderManager::fillRenderStatistics()
 void StandaloneRenderManager::onSequenceNumberIncremented()
 {
     m_nextIterationNumber = 0;
+    m_hasUndisplayedIteration = false;
     m_PPMRadius = m_application.getPPMSettingsModel().getPPMInitialRadius();
     m_camera = m_application.getCamera();
     continueRayTracingIfRunningAsync();
@@ -231,6 +423,18 @@ void StandaloneRenderManager::continueRayTracingIfRunningAsync()
 
 void StandaloneRenderManager::onRunningStatusChanged()
 {
+    // Show the last iteration when rendering is paused between two display frames
+    if(m_application.getRunningStatus() != RunningStatus::RUNNING && m_hasUndisplayedIteration && m_renderer != NULL)
+    {
+        try
+        {
+            displayLastIteration();
+        }
+        catch(const std::exception & E)
+        {
+            emit renderManagerError(QString("%1").arg(E.what()));
+        }
+    }
     continueRayTracingIfRunningAsync();
 }
 
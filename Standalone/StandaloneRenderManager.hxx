@@ -6,11 +6,14 @@
 
 #include <QObject>
 #include <QTime>
+#include <QElapsedTimer>
 #include <QMutex>
+#include <QVector>
 #include "RunningStatus.h"
 #include <optixu/optixpp_namespace.h>
 #include "renderer/OptixRenderer.h"
 #include "renderer/Camera.h"
+#include "renderer/PhotonGatherMode.h"
 #include "logging/SignalLogger.hxx"
 
 class Scene;
@@ -26,6 +29,9 @@ public:
     virtual ~StandaloneRenderManager();
     void renderNextIteration();
     void wait();
+    // Frames per second the display is updated at, at most. Iterations in between are rendered but not read back.
+    // 0 displays every iteration.
+    void setDisplayTargetFPS(double displayTargetFPS);
 
 	SignalLogger &logger();
 
@@ -33,7 +39,9 @@ public slots:
     void start();
 
 signals:
-    void newFrameReadyForDisplay(const float* cpuBuffer, unsigned long long iterationNumber);
+    // The frame is width x height, which can differ from the output settings while they are changed
+    // cpuBuffer stays valid until the display answers with Application::frameDisplayed
+    void newFrameReadyForDisplay(const float* cpuBuffer, unsigned long long iterationNumber, unsigned int width, unsigned int height);
     void continueRayTracing();
     void renderManagerError(QString);
 
@@ -43,11 +51,21 @@ private slots:
     void onContinueRayTracing();
     void onSequenceNumberIncremented();
     void onRunningStatusChanged();
+    void onFrameDisplayed();
 
 private:
     void fillRenderStatistics();
     void continueRayTracingIfRunningAsync();
 	void reinitRenderer(OptixRenderer *newRenderer);
+	bool isRendererOutdated() const;
+	OptixRenderer* createRenderer();
+	void applyPhotonGatherMode();
+    bool isDisplayFrameDue() const;
+    void displayLastIteration();
+    void updateRates();
+    float* getRenderBuffer(unsigned int width, unsigned int height);
+    void publishFrame(unsigned long long iterationNumber);
+    void handLatestFrameToDisplay();
 
     Application & m_application;
     unsigned long long m_nextIterationNumber;
@@ -55,11 +73,43 @@ private:
     OptixRenderer *m_renderer;
     Camera m_camera;
     QTime renderTime;
-    float* m_outputBuffer;
+    // Ring of output buffers: the renderer reads back into one while the display holds another, the third one has
+    // the latest frame the display has not taken yet. Indexes are -1 when no buffer has the role.
+    struct OutputBuffer
+    {
+        OutputBuffer() : data(NULL), capacity(0), width(0), height(0) {}
+        float* data;
+        // Floats allocated, which grow geometrically so that stepping through resolutions reallocates rarely
+        size_t capacity;
+        // Size of the frame in the buffer
+        unsigned int width;
+        unsigned int height;
+    };
+    QVector<OutputBuffer> m_outputBuffers;
+    QMutex m_outputBuffersMutex;
+    int m_renderBufferIndex;
+    int m_latestBufferIndex;
+    int m_displayBufferIndex;
+    unsigned long long m_latestIterationNumber;
+    unsigned long long m_numDroppedFrames;
+    unsigned long long m_numDisplayedFrames;
+
+    double m_displayTargetFPS;
+    QElapsedTimer m_displayTimer;
+    bool m_hasUndisplayedIteration;
+    unsigned long long m_lastRenderedIterationNumber;
+    QElapsedTimer m_rateTimer;
+    unsigned long long m_rateNumIterations;
+    unsigned long long m_rateNumDisplayedFrames;
     Scene* m_currentScene;
     const ComputeDevice & m_device;
     double m_PPMRadius;
     bool m_compileScene;
     bool m_noEmittedSignals;
+    // Photon map settings applied to the renderer
+    bool m_rendererBuildPhotonMapOnCPU;
+    bool m_rendererPersistentPhotonGrid;
+    PhotonGatherMode::E m_rendererPhotonGatherMode;
+    unsigned int m_rendererNearestPhotons;
 	SignalLogger m_logger;
 };
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "HostBVHTest.hxx"
+#include <QtTest/QtTest>
+#include <QElapsedTimer>
+#include <limits>
+#include <random>
+#include "logging/DummyLogger.h"
+#include "renderer/HostBVH.h"
+#include "scene/Scene.h"
+
+using namespace optix;
+
+Q_DECLARE_METATYPE(std::vector<optix::float3>)
+
+static const float rayTmax = std::numeric_limits<float>::max();
+
+struct TestRay
+{
+    float3 origin;
+    float3 direction;
+};
+
+/*
+  Same operations in the same order as HostBVH::intersect (and intersect_triangle of the OptiX math
+  headers), so that both agree on the hit distance to the last bit.
+*/
+static bool intersectTriangle(const float3 & origin, const float3 & direction, const float3 & p0, const float3 & p1, const float3 & p2,
+                              float tmin, float tmax, float & t)
+{
+    float3 e0 = p1 - p0;
+    float3 e1 = p0 - p2;
+    float3 n = cross(e1, e0);
+    float nDotDirection = n.x*direction.x + n.y*direction.y + n.z*direction.z;
+    float scale = 1.0f/nDotDirection;
+    float3 e2 = make_float3(scale*(p0.x - origin.x), scale*(p0.y - origin.y), scale*(p0.z - origin.z));
+    float3 i = make_float3(direction.y*e2.z - direction.z*e2.y, direction.z*e2.x - direction.x*e2.z, direction.x*e2.y - direction.y*e2.x);
+    float beta = i.x*e1.x + i.y*e1.y + i.z*e1.z;
+    float gamma = i.x*e0.x + i.y*e0.y + i.z*e0.z;
+    t = n.x*e2.x + n.y*e2.y + n.z*e2.z;
+    return t < tmax && t > tmin && beta >= 0.0f && gamma >= 0.0f && beta + gamma <= 1.0f;
+}
+
+static bool intersectAllTriangles(const std::vector<float3> & vertices, const TestRay & ray, float tmin, float tmax, HostRayHit & hit)
+{
+    bool found = false;
+    for(unsigned int triangle = 0; triangle < vertices.size()/3; ++triangle)
+    {
+        float t;
+        if(intersectTriangle(ray.origin, ray.direction, vertices[3*triangle], vertices[3*triangle+1], vertices[3*triangle+2], tmin, tmax, t))
+        {
+            tmax = t;
+            hit.triangle = triangle;
+            hit.t = t;
+            found = true;
+        }
+    }
+    return found;
+}
+
+// Small triangles scattered in the unit cube, so that rays miss as well as hit
+static std::vector<float3> generateTriangles(int numTriangles, unsigned int seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<float3> vertices(3*numTriangles);
+    for(int triangle = 0; triangle < numTriangles; ++triangle)
+    {
+        float3 center = make_float3(uniform(generator), uniform(generator), uniform(generator));
+        for(int vertex = 0; vertex < 3; ++vertex)
+        {
+            vertices[3*triangle+vertex] = center + 0.05f*make_float3(uniform(generator) - 0.5f, uniform(generator) - 0.5f, uniform(generator) - 0.5f);
+        }
+    }
+    return vertices;
+}
+
+// Origins inside the bounds of the triangles and uniformly distributed directions
+static std::vector<TestRay> generateRays(const std::vector<float3> & vertices, int numRays, unsigned int seed)
+{
+    float3 bbmin = make_float3(std::numeric_limits<float>::max());
+    float3 bbmax = make_float3(-std::numeric_limits<float>::max());
+    for(size_t i = 0; i < vertices.size(); ++i)
+    {
+        bbmin = fminf(bbmin, vertices[i]);
+        bbmax = fmaxf(bbmax, vertices[i]);
+    }
+
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<TestRay> rays(numRays);
+    for(int i = 0; i < numRays; ++i)
+    {
+        float3 position = make_float3(uniform(generator), uniform(generator), uniform(generator));
+        rays[i].origin = bbmin + position*(bbmax - bbmin);
+        float z = 2.0f*uniform(generator) - 1.0f;
+        float phi = 2.0f*M_PIf*uniform(generator);
+        float r = sqrtf(fmaxf(0.0f, 1.0f - z*z));
+        rays[i].direction = make_float3(r*cosf(phi), r*sinf(phi), z);
+    }
+    return rays;
+}
+
+void HostBVHTest::initTestCase()
+{
+    QString sceneFile = QString::fromLocal8Bit(qgetenv("TEST_SCENE"));
+    if(sceneFile.isEmpty())
+    {
+        sceneFile = QFINDTESTDATA("../RPSolver/examples/cornell.dae");
+    }
+    QVERIFY2(QFileInfo(sceneFile).exists(), "Set TEST_SCENE to the scene to trace");
+
+    DummyLogger logger;
+    Scene* scene = Scene::createFromFile(&logger, sceneFile.toLocal8Bit().constData());
+    m_sceneVertices = scene->getHostSceneGeometry().vertices;
+    delete scene;
+    QVERIFY(!m_sceneVertices.empty());
+}
+
+void HostBVHTest::closestHitMatchesBruteForce_data()
+{
+    QTest::addColumn<std::vector<optix::float3> >("vertices");
+
+    QTest::newRow("random triangles") << generateTriangles(5000, 3);
+    QTest::newRow("scene") << m_sceneVertices;
+}
+
+void HostBVHTest::closestHitMatchesBruteForce()
+{
+    QFETCH(std::vector<optix::float3>, vertices);
+
+    HostBVH bvh;
+    bvh.build(vertices);
+
+    const float tmin = 1e-4f;
+    std::vector<TestRay> rays = generateRays(vertices, 10000, 5);
+    for(size_t i = 0; i < rays.size(); ++i)
+    {
+        HostRayHit bvhHit, bruteForceHit;
+        bool bvhFound = bvh.intersect(rays[i].origin, rays[i].direction, tmin, rayTmax, bvhHit);
+        bool bruteForceFound = intersectAllTriangles(vertices, rays[i], tmin, rayTmax, bruteForceHit);
+        QCOMPARE(bvhFound, bruteForceFound);
+        if(!bvhFound)
+        {
+            continue;
+        }
+        QCOMPARE(bvhHit.t, bruteForceHit.t);
+
+        // Triangles sharing an edge can be hit at the same distance, then either one is the closest
+        if(bvhHit.triangle != bruteForceHit.triangle)
+        {
+            float t;
+            unsigned int triangle = bvhHit.triangle;
+            QVERIFY(intersectTriangle(rays[i].origin, rays[i].direction, vertices[3*triangle], vertices[3*triangle+1], vertices[3*triangle+2],
+                tmin, rayTmax, t));
+            QCOMPARE(t, bruteForceHit.t);
+        }
+    }
+}
+
+void HostBVHTest::raysPerSecond()
+{
+    HostBVH bvh;
+    bvh.build(m_sceneVertices);
+    std::vector<TestRay> rays = generateRays(m_sceneVertices, 1 << 20, 7);
+
+    unsigned int hits = 0;
+    qint64 elapsedNanoseconds = 0;
+    int rounds = 0;
+    QBENCHMARK
+    {
+        QElapsedTimer timer;
+        timer.start();
+        for(size_t i = 0; i < rays.size(); ++i)
+        {
+            HostRayHit hit;
+            hits += bvh.intersect(rays[i].origin, rays[i].direction, 1e-4f, rayTmax, hit);
+        }
+        elapsedNanoseconds += timer.nsecsElapsed();
+        rounds++;
+    }
+    QVERIFY(hits > 0);
+
+    double raysPerSecond = double(rays.size())*rounds/(elapsedNanoseconds*1e-9);
+    qDebug("%u triangles: %.2f Mrays/s", unsigned(m_sceneVertices.size()/3), raysPerSecond*1e-6);
+}
@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <QObject>
+#include <vector>
+#include <optixu/optixu_math_namespace.h>
+
+/*
+  The host BVH of PMCPURenderer (renderer/HostBVH.h) must report the same closest hit as testing every
+  triangle, on a random triangle soup and on the triangles of the scene in TEST_SCENE (the Cornell box of
+  the RPSolver examples by default). The benchmark traces random rays through the scene and reports the
+  rays traced per second.
+*/
+class HostBVHTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void closestHitMatchesBruteForce_data();
+    void closestHitMatchesBruteForce();
+    void raysPerSecond();
+private:
+    std::vector<optix::float3> m_sceneVertices;
+};
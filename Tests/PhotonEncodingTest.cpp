@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "PhotonEncodingTest.hxx"
+#include <QtTest/QtTest>
+#include <random>
+#include <algorithm>
+#include "renderer/ppm/PackedPhoton.h"
+#include "renderer/ppm/Photon.h"
+
+using namespace optix;
+
+static const int samples = 100000;
+// Channels smaller than 1/256 of the largest one decode to zero, so their error can reach 1/128 of it
+static const float rgbeChannelErrorBound = 1.0f/128;
+static const float rgbeMaxChannelErrorBound = 1.0f/256;
+static const float octahedralAngleErrorBound = 1e-3f;
+
+static float randomPower(std::mt19937 & generator)
+{
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    return uniform(generator)*powf(10.0f, uniform(generator)*20.0f - 10.0f);
+}
+
+static float3 randomDirection(std::mt19937 & generator)
+{
+    std::normal_distribution<float> normal;
+    return normalize(make_float3(normal(generator), normal(generator), normal(generator)));
+}
+
+static float angleBetween(const float3 & a, const float3 & b)
+{
+    return acosf(std::min(1.0f, dot(a, b)));
+}
+
+void PhotonEncodingTest::rgbeRoundTripErrorBound()
+{
+    std::mt19937 generator(1);
+    for(int i = 0; i < samples; ++i)
+    {
+        float3 power = make_float3(randomPower(generator), randomPower(generator), randomPower(generator));
+        float3 decoded = decodeRGBE(encodeRGBE(power));
+        float maxComponent = fmaxf(power.x, fmaxf(power.y, power.z));
+
+        QVERIFY(fabsf(decoded.x - power.x) <= maxComponent*rgbeChannelErrorBound);
+        QVERIFY(fabsf(decoded.y - power.y) <= maxComponent*rgbeChannelErrorBound);
+        QVERIFY(fabsf(decoded.z - power.z) <= maxComponent*rgbeChannelErrorBound);
+        QVERIFY(fabsf(fmaxf(decoded.x, fmaxf(decoded.y, decoded.z)) - maxComponent) <= maxComponent*rgbeMaxChannelErrorBound);
+    }
+}
+
+void PhotonEncodingTest::rgbeKeepsZeroChannels()
+{
+    float3 red = decodeRGBE(encodeRGBE(make_float3(0.37f, 0.0f, 0.0f)));
+    QVERIFY(red.x > 0.0f);
+    QCOMPARE(red.y, 0.0f);
+    QCOMPARE(red.z, 0.0f);
+
+    float3 cyan = decodeRGBE(encodeRGBE(make_float3(0.0f, 1e-5f, 2e-5f)));
+    QCOMPARE(cyan.x, 0.0f);
+    QVERIFY(cyan.y > 0.0f && cyan.z > 0.0f);
+}
+
+void PhotonEncodingTest::rgbeEncodesBlackAsZero()
+{
+    QCOMPARE(encodeRGBE(make_float3(0.0f)), 0u);
+    QCOMPARE(encodeRGBE(make_float3(-1.0f, 0.0f, -2.0f)), 0u);
+    float3 black = decodeRGBE(0);
+    QCOMPARE(black.x + black.y + black.z, 0.0f);
+}
+
+void PhotonEncodingTest::octahedralRoundTripErrorBound()
+{
+    std::mt19937 generator(2);
+    for(int i = 0; i < samples; ++i)
+    {
+        float3 direction = randomDirection(generator);
+        float3 decoded = decodeOctahedral(encodeOctahedral(direction));
+        QVERIFY(angleBetween(direction, decoded) <= octahedralAngleErrorBound);
+    }
+}
+
+void PhotonEncodingTest::octahedralAxes()
+{
+    const float3 axes[] = {
+        make_float3(1, 0, 0), make_float3(-1, 0, 0),
+        make_float3(0, 1, 0), make_float3(0, -1, 0),
+        make_float3(0, 0, 1), make_float3(0, 0, -1)
+    };
+    for(const float3 & axis : axes)
+    {
+        QVERIFY(angleBetween(axis, decodeOctahedral(encodeOctahedral(axis))) <= octahedralAngleErrorBound);
+    }
+}
+
+void PhotonEncodingTest::photonRoundTrip()
+{
+    QCOMPARE((int)sizeof(Photon), ENABLE_PARTICIPATING_MEDIA ? 28 : 24);
+
+    float3 power = make_float3(0.25f, 0.5f, 0.0f);
+    float3 position = make_float3(1.0f, -2.0f, 3.5f);
+    float3 direction = normalize(make_float3(0.3f, -0.9f, 0.1f));
+    Photon photon(power, position, direction, 42);
+
+    QVERIFY(photonHasPower(photon));
+    QCOMPARE(photon.position.x, position.x);
+    QCOMPARE(photon.position.y, position.y);
+    QCOMPARE(photon.position.z, position.z);
+    QCOMPARE(photon.objectId, 42u);
+    float3 decodedPower = getPhotonPower(photon);
+    QVERIFY(fabsf(decodedPower.x - power.x) <= 0.5f*rgbeMaxChannelErrorBound);
+    QVERIFY(fabsf(decodedPower.y - power.y) <= 0.5f*rgbeMaxChannelErrorBound);
+    QCOMPARE(decodedPower.z, 0.0f);
+    QVERIFY(angleBetween(direction, getPhotonDirection(photon)) <= octahedralAngleErrorBound);
+
+    QVERIFY(!photonHasPower(Photon(make_float3(0.0f), position, direction, 42)));
+}
+
+void PhotonEncodingTest::packedPhotonKeepsPhotonFields()
+{
+    QCOMPARE(sizeof(PackedPhoton), (size_t)24);
+
+    Photon photon(make_float3(1.0f, 2.0f, 3.0f), make_float3(4.0f, 5.0f, 6.0f), make_float3(0.0f, 0.0f, -1.0f), 12345);
+    PackedPhoton packed = packPhoton(photon, PPM_Z);
+
+    QCOMPARE(packed.power, photon.power);
+    QCOMPARE(packed.direction, photon.rayDirection);
+    QCOMPARE(packed.position.y, photon.position.y);
+    QCOMPARE(getPackedPhotonObjectId(packed), 12345u);
+    QCOMPARE(getPackedPhotonAxis(packed), (uint)PPM_Z);
+}
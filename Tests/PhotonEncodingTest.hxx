@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <QObject>
+
+// Round trip and error bounds of the photon power and direction encodings, see renderer/ppm/PhotonEncoding.h
+class PhotonEncodingTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void rgbeRoundTripErrorBound();
+    void rgbeKeepsZeroChannels();
+    void rgbeEncodesBlackAsZero();
+    void octahedralRoundTripErrorBound();
+    void octahedralAxes();
+    void photonRoundTrip();
+    void packedPhotonKeepsPhotonFields();
+};
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "PhotonGatherCostTest.hxx"
+#include <QtTest/QtTest>
+#include <cmath>
+#include "config.h"
+#include "ComputeDeviceRepository.h"
+#include "clientserver/RenderServerRenderRequestDetails.h"
+#include "logging/DummyLogger.h"
+#include "renderer/PPMOptixRenderer.h"
+#include "scene/Scene.h"
+
+Q_DECLARE_METATYPE(PhotonGatherMode::E)
+
+static const unsigned int width = 512;
+static const unsigned int height = 512;
+static const int iterations = 8;
+
+PhotonGatherCostTest::PhotonGatherCostTest()
+    : m_logger(NULL),
+      m_scene(NULL),
+      m_renderer(NULL)
+{
+}
+
+void PhotonGatherCostTest::initTestCase()
+{
+#if !ENABLE_RENDER_DEBUG_OUTPUT
+    QSKIP("The photons visited are only counted with ENABLE_RENDER_DEBUG_OUTPUT");
+#endif
+    std::vector<ComputeDevice> & devices = ComputeDeviceRepository::get().getComputeDevices();
+    if(devices.empty())
+    {
+        QSKIP("No CUDA device to render on");
+    }
+
+    QString sceneFile = QString::fromLocal8Bit(qgetenv("TEST_SCENE"));
+    if(sceneFile.isEmpty())
+    {
+        sceneFile = QFINDTESTDATA("../RPSolver/examples/cornell.dae");
+    }
+    QVERIFY2(QFileInfo(sceneFile).exists(), "Set TEST_SCENE to the scene to render");
+
+    // One renderer for every row, since the gather mode can be changed on an initialized renderer
+    m_logger = new DummyLogger();
+    m_scene = Scene::createFromFile(m_logger, sceneFile.toLocal8Bit().constData());
+    m_renderer = new PPMOptixRenderer();
+    m_renderer->initialize(devices.front(), m_logger);
+    m_renderer->initScene(*m_scene);
+}
+
+void PhotonGatherCostTest::cleanupTestCase()
+{
+    delete m_renderer;
+    delete m_scene;
+    delete m_logger;
+}
+
+void PhotonGatherCostTest::photonsVisitedPerHitpoint_data()
+{
+    QTest::addColumn<PhotonGatherMode::E>("mode");
+    QTest::addColumn<unsigned int>("nearestPhotons");
+
+    QTest::newRow("fixed radius") << PhotonGatherMode::FIXED_RADIUS << 0u;
+#if ACCELERATION_STRUCTURE != ACCELERATION_STRUCTURE_STOCHASTIC_HASH
+    QTest::newRow("k nearest, k = 8") << PhotonGatherMode::K_NEAREST_NEIGHBOURS << 8u;
+    QTest::newRow("k nearest, k = 16") << PhotonGatherMode::K_NEAREST_NEIGHBOURS << 16u;
+    QTest::newRow("k nearest, k = 32") << PhotonGatherMode::K_NEAREST_NEIGHBOURS << 32u;
+#endif
+}
+
+void PhotonGatherCostTest::photonsVisitedPerHitpoint()
+{
+    QFETCH(PhotonGatherMode::E, mode);
+    QFETCH(unsigned int, nearestPhotons);
+
+    m_renderer->setPhotonGatherMode(mode, nearestPhotons);
+
+    Camera camera = m_scene->getDefaultCamera();
+    camera.setAspectRatio(float(width)/height);
+    RenderServerRenderRequestDetails details(camera, QByteArray(m_scene->getSceneName()), RenderMethod::PROGRESSIVE_PHOTON_MAPPING,
+        width, height, 2.0/3.0);
+
+    // Same radius sequence for every row, so that the rows only differ in the gather
+    RendererStatistics before = m_renderer->getStatistics();
+    double ppmRadius = m_scene->getSceneInitialPPMRadiusEstimate();
+    for(int iteration = 0; iteration < iterations; ++iteration)
+    {
+        m_renderer->renderNextIteration(iteration, iteration, ppmRadius, details);
+        ppmRadius = sqrt(ppmRadius*ppmRadius*(iteration + details.getPPMAlpha())/(iteration + 1));
+    }
+    RendererStatistics after = m_renderer->getStatistics();
+
+    unsigned long long hitpoints = after.indirectRadianceHitpoints - before.indirectRadianceHitpoints;
+    unsigned long long photonsVisited = after.indirectRadiancePhotonsVisited - before.indirectRadiancePhotonsVisited;
+    unsigned long long cellsVisited = after.indirectRadianceCellsVisited - before.indirectRadianceCellsVisited;
+    QVERIFY(hitpoints > 0);
+
+    qDebug("%.2f cells and %.2f photons visited per hitpoint", double(cellsVisited)/hitpoints, double(photonsVisited)/hitpoints);
+    QTest::setBenchmarkResult(double(photonsVisited)/hitpoints, QTest::Events);
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <QObject>
+
+class ComputeDevice;
+class PPMOptixRenderer;
+class Scene;
+class DummyLogger;
+
+/*
+  Cost of the fixed radius and k-nearest-neighbour indirect radiance gathers, as the photons visited per
+  hitpoint reported by the debugIndirectRadiancePhotonsVisisted counters. Each row renders a few
+  progressive photon mapping iterations of the scene in TEST_SCENE (the Cornell box of the RPSolver
+  examples by default) and reports the photons visited per hitpoint as its benchmark result.
+*/
+class PhotonGatherCostTest : public QObject
+{
+    Q_OBJECT
+public:
+    PhotonGatherCostTest();
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void photonsVisitedPerHitpoint_data();
+    void photonsVisitedPerHitpoint();
+private:
+    DummyLogger* m_logger;
+    Scene* m_scene;
+    PPMOptixRenderer* m_renderer;
+};
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "PhotonGridMortonTest.hxx"
+#include <QtTest/QtTest>
+#include <cuda_runtime.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "config.h"
+#include "renderer/ppm/Photon.h"
+#include "renderer/ppm/PhotonGrid.h"
+
+using namespace optix;
+
+static const unsigned int cacheLineSize = 64;
+
+// Lower and upper sides of the grid that every box of a row must touch
+enum BoxBoundary
+{
+    NO_BOUNDARY = 0,
+    LOWER_BOUNDARY = 1,
+    UPPER_BOUNDARY = 2
+};
+
+static void generateAxisRange(std::mt19937 & generator, unsigned int gridSize, int boundary, unsigned int & lo, unsigned int & hi)
+{
+    std::uniform_int_distribution<unsigned int> cell(0, gridSize-1);
+    // Gathers span a few cells, keep the boxes small enough to enumerate
+    std::uniform_int_distribution<unsigned int> extent(0, std::min(gridSize-1, 15u));
+    unsigned int boxExtent = extent(generator);
+    lo = std::min(cell(generator), gridSize-1-boxExtent);
+    if(boundary & LOWER_BOUNDARY)
+    {
+        lo = 0;
+    }
+    if(boundary & UPPER_BOUNDARY)
+    {
+        lo = (boundary & LOWER_BOUNDARY) ? 0 : gridSize-1-boxExtent;
+        boxExtent = gridSize-1-lo;
+    }
+    hi = lo + boxExtent;
+}
+
+void PhotonGridMortonTest::bigMinWalkMatchesBruteForce_data()
+{
+    QTest::addColumn<unsigned int>("gridSize");
+    QTest::addColumn<int>("boundary");
+
+    QTest::newRow("interior boxes, 100 cells") << 100u << int(NO_BOUNDARY);
+    QTest::newRow("boxes at the lower bounds, 100 cells") << 100u << int(LOWER_BOUNDARY);
+    QTest::newRow("boxes at the upper bounds, 100 cells") << 100u << int(UPPER_BOUNDARY);
+    QTest::newRow("boxes at the upper bounds, 64 cells") << 64u << int(UPPER_BOUNDARY);
+    QTest::newRow("boxes at the upper bounds, 1024 cells") << 1024u << int(UPPER_BOUNDARY);
+    QTest::newRow("whole grid, 10 cells") << 10u << int(LOWER_BOUNDARY | UPPER_BOUNDARY);
+}
+
+void PhotonGridMortonTest::bigMinWalkMatchesBruteForce()
+{
+    QFETCH(unsigned int, gridSize);
+    QFETCH(int, boundary);
+
+    std::mt19937 generator(gridSize + boundary);
+    for(int box = 0; box < 1000; ++box)
+    {
+        uint3 lo, hi;
+        generateAxisRange(generator, gridSize, boundary, lo.x, hi.x);
+        generateAxisRange(generator, gridSize, boundary, lo.y, hi.y);
+        generateAxisRange(generator, gridSize, boundary, lo.z, hi.z);
+
+        std::vector<unsigned int> expectedKeys;
+        for(unsigned int z = lo.z; z <= hi.z; z++)
+        {
+            for(unsigned int y = lo.y; y <= hi.y; y++)
+            {
+                for(unsigned int x = lo.x; x <= hi.x; x++)
+                {
+                    expectedKeys.push_back(getPhotonGridMortonIndex(make_uint3(x, y, z)));
+                }
+            }
+        }
+        std::sort(expectedKeys.begin(), expectedKeys.end());
+
+        std::vector<unsigned int> keys;
+        PhotonGridMortonRange cells(lo, hi);
+        unsigned int from, to;
+        while(cells.next(from, to))
+        {
+            QVERIFY(from <= to);
+            // Adjacent runs would have been returned as one
+            QVERIFY(keys.empty() || from > keys.back() + 1);
+            for(unsigned int key = from; key <= to; key++)
+            {
+                keys.push_back(key);
+            }
+        }
+
+        if(keys != expectedKeys)
+        {
+            QFAIL(qPrintable(QString("Wrong cells for the box (%1, %2, %3) - (%4, %5, %6)")
+                .arg(lo.x).arg(lo.y).arg(lo.z).arg(hi.x).arg(hi.y).arg(hi.z)));
+        }
+    }
+}
+
+void PhotonGridMortonTest::cacheLinesPerGather_data()
+{
+    QTest::addColumn<bool>("mortonOrder");
+    QTest::addColumn<float>("radiusInCells");
+
+    QTest::newRow("row major, radius 1 cell") << false << 1.0f;
+    QTest::newRow("morton, radius 1 cell") << true << 1.0f;
+    QTest::newRow("row major, radius 2 cells") << false << 2.0f;
+    QTest::newRow("morton, radius 2 cells") << true << 2.0f;
+}
+
+/*
+  Photons deposited on two walls and a cluster of a unit box, sorted into a 64^3 grid by either cell key
+  the way UniformGridPhotonMap does, gathered around points of those walls. Reports the distinct cache
+  lines of the photons and offset table entries read per gather.
+*/
+void PhotonGridMortonTest::cacheLinesPerGather()
+{
+    QFETCH(bool, mortonOrder);
+    QFETCH(float, radiusInCells);
+
+    const uint3 gridSize = make_uint3(64, 64, 64);
+    const float cellSize = 1.0f/64;
+    const int numPhotons = 1 << 20;
+    const int numGathers = 1 << 14;
+
+    std::mt19937 generator(17);
+    std::uniform_real_distribution<float> uniform(0.0f, 0.999f);
+    std::normal_distribution<float> normal(0.0f, 0.02f);
+    auto generatePosition = [&](int i)
+    {
+        float3 position = make_float3(uniform(generator), uniform(generator), uniform(generator));
+        switch(i % 3)
+        {
+        case 0: position.y = 0.0f; break;
+        case 1: position.x = 0.999f; break;
+        default: position = fminf(make_float3(0.999f), fmaxf(make_float3(0.0f),
+            make_float3(0.3f, 0.6f, 0.4f) + make_float3(normal(generator), normal(generator), normal(generator))));
+        }
+        return position;
+    };
+    auto getCellKey = [&](const uint3 & cell)
+    {
+        return mortonOrder ? getPhotonGridMortonIndex(cell) : getPhotonGridIndex1D(cell, gridSize);
+    };
+
+    unsigned int numCellKeys = mortonOrder ? getPhotonGridMortonIndex(make_uint3(63, 63, 63)) + 1 : gridSize.x*gridSize.y*gridSize.z;
+    std::vector<unsigned int> offsetTable(numCellKeys + 1, 0);
+    for(int i = 0; i < numPhotons; ++i)
+    {
+        uint3 cell = getPhotonGridIndex(generatePosition(i), make_float3(0.0f), cellSize);
+        offsetTable[getCellKey(cell) + 1]++;
+    }
+    for(unsigned int key = 0; key < numCellKeys; ++key)
+    {
+        offsetTable[key + 1] += offsetTable[key];
+    }
+
+    std::vector<unsigned int> photonLines;
+    std::vector<unsigned int> tableLines;
+    auto touch = [&](unsigned int from, unsigned int to)
+    {
+        tableLines.push_back(from*sizeof(unsigned int)/cacheLineSize);
+        tableLines.push_back((to + 1)*sizeof(unsigned int)/cacheLineSize);
+        unsigned int offset = offsetTable[from];
+        unsigned int offsetTo = offsetTable[to + 1];
+        if(offsetTo > offset)
+        {
+            for(unsigned int line = offset*sizeof(Photon)/cacheLineSize; line <= (offsetTo*sizeof(Photon) - 1)/cacheLineSize; line++)
+            {
+                photonLines.push_back(line);
+            }
+        }
+    };
+    auto countDistinct = [](std::vector<unsigned int> & lines)
+    {
+        std::sort(lines.begin(), lines.end());
+        return (unsigned long long)(std::unique(lines.begin(), lines.end()) - lines.begin());
+    };
+
+    unsigned long long photonLinesTouched = 0;
+    unsigned long long tableLinesTouched = 0;
+    unsigned long long runs = 0;
+    float radius = radiusInCells*cellSize;
+    for(int gather = 0; gather < numGathers; ++gather)
+    {
+        float3 position = generatePosition(gather);
+        uint3 lo = getPhotonGridIndex(fmaxf(make_float3(0.0f), position - make_float3(radius)), make_float3(0.0f), cellSize);
+        uint3 hi = getPhotonGridIndex(position + make_float3(radius), make_float3(0.0f), cellSize);
+        hi = make_uint3(std::min(hi.x, gridSize.x-1), std::min(hi.y, gridSize.y-1), std::min(hi.z, gridSize.z-1));
+
+        photonLines.clear();
+        tableLines.clear();
+        if(mortonOrder)
+        {
+            PhotonGridMortonRange cells(lo, hi);
+            unsigned int from, to;
+            while(cells.next(from, to))
+            {
+                touch(from, to);
+                runs++;
+            }
+        }
+        else
+        {
+            // Same rows as the gather of IndirectRadianceEstimation.cu
+            for(unsigned int z = lo.z; z <= hi.z; z++)
+            {
+                for(unsigned int y = lo.y; y <= hi.y; y++)
+                {
+                    unsigned int from = getPhotonGridIndex1D(make_uint3(lo.x, y, z), gridSize);
+                    touch(from, from + (hi.x - lo.x));
+                    runs++;
+                }
+            }
+        }
+        photonLinesTouched += countDistinct(photonLines);
+        tableLinesTouched += countDistinct(tableLines);
+    }
+
+    qDebug("%.2f ranges, %.2f photon and %.2f offset table cache lines per gather", double(runs)/numGathers,
+        double(photonLinesTouched)/numGathers, double(tableLinesTouched)/numGathers);
+    QTest::setBenchmarkResult(double(photonLinesTouched + tableLinesTouched)/numGathers, QTest::Events);
+}
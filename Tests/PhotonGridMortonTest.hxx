@@ -0,0 +1,24 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <QObject>
+
+/*
+  PhotonGridMortonRange (renderer/ppm/PhotonGrid.h) must return the cells of a box as runs of consecutive
+  Morton keys, with nothing outside the box and nothing missing, as enumerating the box cell by cell does.
+  The benchmark counts the cache lines of the photons and of the offset table that a gather touches with
+  the Morton and the row major cell order.
+*/
+class PhotonGridMortonTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void bigMinWalkMatchesBruteForce_data();
+    void bigMinWalkMatchesBruteForce();
+    void cacheLinesPerGather_data();
+    void cacheLinesPerGather();
+};
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "PhotonKdTreeTest.hxx"
+#include <QtTest/QtTest>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <cstring>
+#include "config.h"
+#include "renderer/ppm/Photon.h"
+#include "renderer/ppm/PackedPhoton.h"
+#include "renderer/PhotonKdTree.h"
+#include "util/ParallelFor.h"
+
+using namespace optix;
+
+static unsigned int getKdTreeSize(unsigned int numPhotons)
+{
+    unsigned int size = 1;
+    while(size < numPhotons + 1)
+    {
+        size <<= 1;
+    }
+    return size - 1;
+}
+
+/*
+  Every axis holds a shuffled permutation of distinct coordinates, so no two photons tie on any axis and
+  the median of every range is unique whatever the order the partitions leave the photons in.
+*/
+static std::vector<Photon> generatePhotons(int numPhotons, unsigned int seed, float emptyFraction)
+{
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<int> coordinates[3];
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        coordinates[axis].resize(numPhotons);
+        for(int i = 0; i < numPhotons; ++i)
+        {
+            coordinates[axis][i] = i;
+        }
+        std::shuffle(coordinates[axis].begin(), coordinates[axis].end(), generator);
+    }
+
+    std::vector<Photon> photons(numPhotons);
+    for(int i = 0; i < numPhotons; ++i)
+    {
+        float3 position = make_float3(coordinates[0][i] + 0.5f, coordinates[1][i] + 0.5f, coordinates[2][i] + 0.5f)/float(numPhotons);
+        float3 power = uniform(generator) < emptyFraction ? make_float3(0.0f)
+            : make_float3(uniform(generator), uniform(generator), uniform(generator));
+        float3 direction = normalize(make_float3(uniform(generator) - 0.5f, uniform(generator) - 0.5f, uniform(generator) - 0.5f));
+        photons[i] = Photon(power, position, direction, i % 7);
+#if ENABLE_PARTICIPATING_MEDIA
+        photons[i].numDeposits = 0;
+#endif
+    }
+    return photons;
+}
+
+void PhotonKdTreeTest::parallelBuildMatchesSerial_data()
+{
+    QTest::addColumn<int>("numPhotons");
+    QTest::addColumn<int>("numThreads");
+
+    // Above KD_TREE_PARALLEL_MIN_PHOTONS, so that the parallel median searches and subtree tasks run
+    QTest::newRow("300000 photons, 2 threads") << 300000 << 2;
+    QTest::newRow("300000 photons, 4 threads") << 300000 << 4;
+    QTest::newRow("300000 photons, 8 threads") << 300000 << 8;
+    QTest::newRow("1000 photons, 4 threads") << 1000 << 4;
+}
+
+void PhotonKdTreeTest::parallelBuildMatchesSerial()
+{
+    QFETCH(int, numPhotons);
+    QFETCH(int, numThreads);
+
+    std::vector<Photon> photons = generatePhotons(numPhotons, 7, 0.1f);
+    unsigned int kdTreeSize = getKdTreeSize(numPhotons);
+
+    // Zeroed, so that the unused nodes compare equal too
+    std::vector<PackedPhoton> serialTree(kdTreeSize);
+    std::vector<PackedPhoton> parallelTree(kdTreeSize);
+    memset(serialTree.data(), 0, kdTreeSize*sizeof(PackedPhoton));
+    memset(parallelTree.data(), 0, kdTreeSize*sizeof(PackedPhoton));
+
+    unsigned int serialValidPhotons = buildPhotonKdTree(photons.data(), numPhotons, serialTree.data(), 1);
+    unsigned int parallelValidPhotons = buildPhotonKdTree(photons.data(), numPhotons, parallelTree.data(), numThreads);
+
+    QCOMPARE(parallelValidPhotons, serialValidPhotons);
+    for(unsigned int i = 0; i < kdTreeSize; ++i)
+    {
+        if(memcmp(&serialTree[i], &parallelTree[i], sizeof(PackedPhoton)) != 0)
+        {
+            QFAIL(qPrintable(QString("Kd-tree node %1 differs from the serial build").arg(i)));
+        }
+    }
+}
+
+void PhotonKdTreeTest::build_data()
+{
+    QTest::addColumn<int>("numPhotons");
+    QTest::addColumn<int>("numThreads");
+
+    int photonCounts[] = { 1 << 18, 1 << 20, 1 << 21 };
+    std::vector<int> threadCounts;
+    threadCounts.push_back(1);
+    threadCounts.push_back(2);
+    threadCounts.push_back(4);
+    if(getHardwareThreadCount() > 4)
+    {
+        threadCounts.push_back(getHardwareThreadCount());
+    }
+    for(int photonCount : photonCounts)
+    {
+        for(int threadCount : threadCounts)
+        {
+            QTest::newRow(qPrintable(QString("%1 photons, %2 threads").arg(photonCount).arg(threadCount)))
+                << photonCount << threadCount;
+        }
+    }
+}
+
+void PhotonKdTreeTest::build()
+{
+    QFETCH(int, numPhotons);
+    QFETCH(int, numThreads);
+
+    std::vector<Photon> photons = generatePhotons(numPhotons, 11, 0.1f);
+    std::vector<PackedPhoton> kdTree(getKdTreeSize(numPhotons));
+    unsigned int validPhotons = 0;
+
+    QBENCHMARK
+    {
+        validPhotons = buildPhotonKdTree(photons.data(), numPhotons, kdTree.data(), numThreads);
+    }
+    QVERIFY(validPhotons > 0);
+}
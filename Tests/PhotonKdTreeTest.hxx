@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <QObject>
+
+/*
+  The host kd-tree build (renderer/PhotonKdTree.h) splits the median searches and the subtrees across
+  threads. On photons without coordinate ties the tree must not depend on the thread count, and the build
+  time is reported for a few photon and thread counts.
+*/
+class PhotonKdTreeTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void parallelBuildMatchesSerial_data();
+    void parallelBuildMatchesSerial();
+    void build_data();
+    void build();
+};
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "RadiosityEstimateTest.hxx"
+#include <QtTest/QtTest>
+#include "Interval.h"
+#include "optimizations/RadiosityEstimate.h"
+
+Q_DECLARE_METATYPE(RadiosityEstimate::StopReason)
+
+static const unsigned int photonsPerLaunch = 4096;
+static const float emittedPower = 1000.0f;
+static const int maxLaunches = 16;
+
+void RadiosityEstimateTest::stopsAfterLaunches_data()
+{
+    QTest::addColumn<unsigned int>("hitsPerLaunch");
+    QTest::addColumn<float>("thresholdBottom");
+    QTest::addColumn<float>("maxWidth");
+    QTest::addColumn<int>("expectedLaunches");
+    QTest::addColumn<RadiosityEstimate::StopReason>("expectedReason");
+
+    // Radiosity 10, far below the threshold
+    QTest::newRow("below at once") << 41u << 500.0f << 0.0f << 1 << RadiosityEstimate::BELOW_THRESHOLD;
+    // Radiosity 100, below 105 once the interval shrinks under 5
+    QTest::newRow("below later") << 410u << 105.0f << 0.0f << 4 << RadiosityEstimate::BELOW_THRESHOLD;
+    QTest::newRow("below before narrow") << 41u << 500.0f << 1000.0f << 1 << RadiosityEstimate::BELOW_THRESHOLD;
+    // Radiosity 300, intervals 28, 20, 16 and 14 wide
+    QTest::newRow("narrow") << 1229u << 0.0f << 15.0f << 4 << RadiosityEstimate::NARROW_ENOUGH;
+    // Without hits the normal interval has no width, the Wilson one is 0.94 and then 0.47 wide
+    QTest::newRow("narrow without hits") << 0u << -1.0f << 0.5f << 2 << RadiosityEstimate::NARROW_ENOUGH;
+    QTest::newRow("no width") << 1229u << 0.0f << 0.0f << maxLaunches << RadiosityEstimate::CONTINUE;
+}
+
+void RadiosityEstimateTest::stopsAfterLaunches()
+{
+    QFETCH(unsigned int, hitsPerLaunch);
+    QFETCH(float, thresholdBottom);
+    QFETCH(float, maxWidth);
+    QFETCH(int, expectedLaunches);
+    QFETCH(RadiosityEstimate::StopReason, expectedReason);
+
+    Interval threshold = Interval::fromTwoPoints(thresholdBottom, thresholdBottom + 2000.0f);
+    RadiosityEstimate estimate(1.0f);
+    RadiosityEstimate::StopReason reason = RadiosityEstimate::CONTINUE;
+    int launches = 0;
+    while(launches < maxLaunches && reason == RadiosityEstimate::CONTINUE)
+    {
+        // Every photon carries emittedPower/photonsPerLaunch, so the radiance is that of the hits
+        estimate.addLaunch(hitsPerLaunch, photonsPerLaunch, emittedPower*hitsPerLaunch/photonsPerLaunch, emittedPower);
+        reason = estimate.getStopReason(threshold, maxWidth);
+        launches++;
+    }
+
+    QCOMPARE(launches, expectedLaunches);
+    QCOMPARE(reason, expectedReason);
+    QCOMPARE(estimate.hitCount(), hitsPerLaunch*launches);
+    QCOMPARE(estimate.totalPhotons(), photonsPerLaunch*launches);
+    QVERIFY(qAbs(estimate.radiosity() - emittedPower*hitsPerLaunch/photonsPerLaunch) < 1e-3f);
+    if(reason == RadiosityEstimate::NARROW_ENOUGH)
+    {
+        QVERIFY(2*qMax(estimate.normalRadius(), estimate.wilsonRadius()) < maxWidth);
+    }
+}
@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <QObject>
+
+/*
+  Stopping rules of SurfaceRadiosity::evaluateSequential, see RPSolver/optimizations/RadiosityEstimate.h.
+  Synthetic launches with a fixed fraction of hits on the surface are added until the estimate tells to
+  stop, which must happen after the expected number of launches and for the expected reason.
+*/
+class RadiosityEstimateTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void stopsAfterLaunches_data();
+    void stopsAfterLaunches();
+};
@@ -0,0 +1,372 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "RenderIterationSchedulerTest.hxx"
+#include <QtTest/QtTest>
+#include <random>
+#include <queue>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include "clientserver/RenderIterationScheduler.h"
+#include "clientserver/RenderResultPacket.h"
+#include "clientserver/RenderResultPacketCoalescer.h"
+
+static const unsigned long long simulatedIterations = 20000;
+// Output of the packets of the simulation, the scheduler does not look at it but the coalescer merges it
+static const int simulatedOutputSize = 64*3*sizeof(float);
+
+namespace
+{
+    // A render server of the simulation, renders its requests one after the other
+    struct SimulatedServer
+    {
+        double secondsPerIteration;
+        double overheadSeconds;
+        // Chance that a request takes stallFactor times longer, like a server that is busy with something else
+        double stallProbability;
+        double stallFactor;
+        double busyUntil;
+    };
+
+    // A packet the client gets at time
+    struct Answer
+    {
+        double time;
+        int serverId;
+        QVector<unsigned long long> iterationNumbers;
+        double sentTime;
+        double renderSeconds;
+        double totalSeconds;
+
+        bool operator > (const Answer & other) const
+        {
+            return time > other.time;
+        }
+    };
+
+    struct SimulationResult
+    {
+        double seconds;
+        unsigned long long iterations;
+        QVector<int> timesRendered;
+        QVector<double> requestLatencies;
+        unsigned long long stolenRequests;
+        // Iterations per second of all servers together if they never waited and never stalled
+        double idealIterationsPerSecond;
+    };
+}
+
+static QVector<SimulatedServer> createServers(const QString & cluster)
+{
+    QVector<SimulatedServer> servers;
+    if(cluster == "uniform")
+    {
+        for(int i = 0; i < 4; ++i)
+        {
+            SimulatedServer server = {0.02, 0.01, 0.0, 1.0, 0.0};
+            servers.append(server);
+        }
+    }
+    else
+    {
+        SimulatedServer fast = {0.005, 0.01, 0.0, 1.0, 0.0};
+        SimulatedServer medium = {0.02, 0.02, 0.0, 1.0, 0.0};
+        SimulatedServer slow = {0.1, 0.05, 0.0, 1.0, 0.0};
+        servers << fast << medium << medium << slow;
+        if(cluster == "stragglers")
+        {
+            servers[1].stallProbability = 0.05;
+            servers[1].stallFactor = 20.0;
+            servers[3].stallProbability = 0.05;
+            servers[3].stallFactor = 20.0;
+        }
+    }
+    return servers;
+}
+
+/*
+// Runs the scheduler against the servers on a simulated clock until numIterations iterations are received. The
+// servers are asked for work after every answer, as the client does when a packet comes in, and the answers are
+// given to the scheduler in the order they complete.
+*/
+static RenderResultPacket createPacket(unsigned long long sequenceNumber, const QVector<unsigned long long> & iterationNumbers,
+    double renderSeconds, double totalSeconds)
+{
+    RenderResultPacket packet(sequenceNumber, iterationNumbers, QByteArray(simulatedOutputSize, '\0'));
+    packet.setRenderTimeSeconds((float)renderSeconds);
+    packet.setTotalTimeSeconds((float)totalSeconds);
+    return packet;
+}
+
+/*
+// Renders a request on the server starting at start. Without coalescing the server answers with one packet when the
+// request is done. Otherwise every iteration goes through the coalescer of the server and each packet it flushes is
+// an answer at the time its last iteration was done.
+*/
+static void renderRequest(SimulatedServer & server, RenderResultPacketCoalescer* coalescer, int serverId,
+    const QVector<unsigned long long> & iterationNumbers, double now, std::mt19937 & generator,
+    std::priority_queue<Answer, std::vector<Answer>, std::greater<Answer> > & answers)
+{
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    double stallFactor = uniform(generator) < server.stallProbability ? server.stallFactor : 1.0;
+    double start = std::max(now, server.busyUntil);
+    double time = start + server.overheadSeconds;
+    double requestRenderSeconds = 0;
+    for(int i = 0; i < iterationNumbers.size(); ++i)
+    {
+        double renderSeconds = server.secondsPerIteration*(0.9 + 0.2*uniform(generator))*stallFactor;
+        time += renderSeconds;
+        requestRenderSeconds += renderSeconds;
+        if(coalescer != NULL)
+        {
+            // The overhead of the request is counted with its first iteration
+            double totalSeconds = renderSeconds + (i == 0 ? server.overheadSeconds : 0.0);
+            coalescer->add(createPacket(1, QVector<unsigned long long>() << iterationNumbers[i], renderSeconds, totalSeconds),
+                iterationNumbers.first());
+            while(coalescer->shouldFlush() || (i == iterationNumbers.size() - 1 && coalescer->hasPending()))
+            {
+                RenderResultPacket packet = coalescer->flush();
+                Answer answer = {time, serverId, packet.getIterationNumbersInPacket(), now, packet.getRenderTimeSeconds(),
+                    packet.getTotalTimeSeconds()};
+                answers.push(answer);
+            }
+        }
+    }
+    server.busyUntil = time;
+    if(coalescer == NULL)
+    {
+        Answer answer = {time, serverId, iterationNumbers, now, requestRenderSeconds, time - start};
+        answers.push(answer);
+    }
+}
+
+static SimulationResult simulate(QVector<SimulatedServer> servers, unsigned long long numIterations, int coalescedIterations = 0)
+{
+    std::mt19937 generator(1);
+    double now = 0;
+    // Only the iteration count and the request boundaries flush, the delay of the policy is in real time
+    QVector<RenderResultPacketCoalescer> coalescers(servers.size(), RenderResultPacketCoalescer(
+        RenderResultPacketCoalescingPolicy(qMax(1, coalescedIterations), std::numeric_limits<qint64>::max(), 1e9)));
+
+    RenderIterationScheduler scheduler;
+    scheduler.setClock([&now]() { return now; });
+    scheduler.reset(1);
+    for(int serverId = 0; serverId < servers.size(); ++serverId)
+    {
+        scheduler.addServer(serverId);
+    }
+
+    SimulationResult result;
+    result.seconds = 0;
+    result.iterations = 0;
+    result.timesRendered.fill(0, (int)numIterations);
+    result.idealIterationsPerSecond = 0;
+    for(int serverId = 0; serverId < servers.size(); ++serverId)
+    {
+        result.idealIterationsPerSecond += 1.0/servers[serverId].secondsPerIteration;
+    }
+
+    std::priority_queue<Answer, std::vector<Answer>, std::greater<Answer> > answers;
+    while(result.iterations < numIterations)
+    {
+        for(int serverId = 0; serverId < servers.size(); ++serverId)
+        {
+            for(;;)
+            {
+                QVector<unsigned long long> iterationNumbers = scheduler.getNextIterations(serverId);
+                if(iterationNumbers.isEmpty())
+                {
+                    break;
+                }
+                renderRequest(servers[serverId], coalescedIterations > 0 ? &coalescers[serverId] : NULL, serverId,
+                    iterationNumbers, now, generator, answers);
+            }
+        }
+        if(answers.empty())
+        {
+            // Nothing in flight and nothing handed out, the scheduler would stall the client
+            break;
+        }
+
+        Answer answer = answers.top();
+        answers.pop();
+        now = answer.time;
+        if(scheduler.onPacketReceived(answer.serverId, createPacket(1, answer.iterationNumbers, answer.renderSeconds, answer.totalSeconds)))
+        {
+            for(int i = 0; i < answer.iterationNumbers.size(); ++i)
+            {
+                if(answer.iterationNumbers[i] < numIterations)
+                {
+                    result.timesRendered[(int)answer.iterationNumbers[i]]++;
+                    result.iterations++;
+                }
+            }
+            result.requestLatencies.append(now - answer.sentTime);
+        }
+    }
+    result.seconds = now;
+    result.stolenRequests = scheduler.getNumStolenRequests();
+    return result;
+}
+
+static double percentile(QVector<double> values, double fraction)
+{
+    if(values.isEmpty())
+    {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (int)(fraction*values.size()))];
+}
+
+static void addClusterRows()
+{
+    QTest::addColumn<QString>("cluster");
+    QTest::addColumn<int>("coalescedIterations");
+    QTest::newRow("uniform") << QString("uniform") << 0;
+    QTest::newRow("heterogeneous") << QString("heterogeneous") << 0;
+    QTest::newRow("stragglers") << QString("stragglers") << 0;
+    QTest::newRow("heterogeneous, coalesced by 4") << QString("heterogeneous") << 4;
+    QTest::newRow("stragglers, coalesced by 4") << QString("stragglers") << 4;
+}
+
+void RenderIterationSchedulerTest::packetMustBeWithinOneRequest()
+{
+    RenderIterationScheduler scheduler;
+    double now = 0;
+    scheduler.setClock([&now]() { return now; });
+    scheduler.reset(1);
+    scheduler.addServer(0);
+
+    // The first request of an unmeasured server is a single iteration, its answer makes the batches grow
+    QVector<unsigned long long> first = scheduler.getNextIterations(0);
+    QCOMPARE(first.size(), 1);
+    now = 0.01;
+    QVERIFY(scheduler.onPacketReceived(0, createPacket(1, first, 0.01, 0.01)));
+
+    QVector<unsigned long long> batch = scheduler.getNextIterations(0);
+    QVERIFY(batch.size() > 2);
+
+    // Iterations past the request, twice the same iteration, or iterations received before are all rejected
+    QVERIFY(!scheduler.onPacketReceived(0, createPacket(1, QVector<unsigned long long>() << batch.last() << batch.last() + 1, 0.01, 0.01)));
+    QVERIFY(!scheduler.onPacketReceived(0, createPacket(1, QVector<unsigned long long>() << batch[1] << batch[1], 0.01, 0.01)));
+    QVERIFY(scheduler.onPacketReceived(0, createPacket(1, QVector<unsigned long long>() << batch[1] << batch[0], 0.02, 0.02)));
+    QVERIFY(!scheduler.onPacketReceived(0, createPacket(1, QVector<unsigned long long>() << batch[1], 0.01, 0.01)));
+    QCOMPARE(scheduler.getNumRequestsInFlight(), 1);
+
+    // The request is done once the rest of its iterations are in
+    QVERIFY(scheduler.onPacketReceived(0, createPacket(1, batch.mid(2), 0.01*(batch.size() - 2), 0.01*(batch.size() - 2))));
+    QCOMPARE(scheduler.getNumRequestsInFlight(), 0);
+    QVERIFY(!scheduler.onPacketReceived(0, createPacket(1, batch, 0.01, 0.01)));
+}
+
+void RenderIterationSchedulerTest::coalescerFlushesAtRequestBoundary()
+{
+    RenderResultPacketCoalescer coalescer(RenderResultPacketCoalescingPolicy(16, std::numeric_limits<qint64>::max(), 1e9));
+    coalescer.add(createPacket(1, QVector<unsigned long long>() << 0, 0.01, 0.01), 0);
+    coalescer.add(createPacket(1, QVector<unsigned long long>() << 1, 0.01, 0.01), 0);
+    QVERIFY(!coalescer.shouldFlush());
+
+    // The first iteration of the next request must not be merged with the last request
+    coalescer.add(createPacket(1, QVector<unsigned long long>() << 2, 0.01, 0.01), 2);
+    QVERIFY(coalescer.shouldFlush());
+    RenderResultPacket firstRequest = coalescer.flush();
+    QCOMPARE(firstRequest.getIterationNumbersInPacket(), QVector<unsigned long long>() << 0 << 1);
+    QVERIFY(!coalescer.shouldFlush());
+    QVERIFY(coalescer.hasPending());
+    QCOMPARE(coalescer.flush().getIterationNumbersInPacket(), QVector<unsigned long long>() << 2);
+    QVERIFY(!coalescer.hasPending());
+
+    // Packets of an old sequence are dropped
+    coalescer.add(createPacket(1, QVector<unsigned long long>() << 3, 0.01, 0.01), 3);
+    coalescer.add(createPacket(2, QVector<unsigned long long>() << 0, 0.01, 0.01), 0);
+    QVERIFY(!coalescer.shouldFlush());
+    RenderResultPacket newSequence = coalescer.flush();
+    QCOMPARE(newSequence.getSequenceNumber(), 2ull);
+    QVERIFY(!coalescer.hasPending());
+}
+
+void RenderIterationSchedulerTest::coalescerFlushesOnSizeChange()
+{
+    RenderResultPacketCoalescer coalescer(RenderResultPacketCoalescingPolicy(16, std::numeric_limits<qint64>::max(), 1e9));
+    coalescer.add(createPacket(1, QVector<unsigned long long>() << 0, 0.01, 0.01), 0);
+    RenderResultPacket resized(1, QVector<unsigned long long>() << 1, QByteArray(2*simulatedOutputSize, '\0'));
+    coalescer.add(resized, 0);
+
+    QVERIFY(coalescer.shouldFlush());
+    QCOMPARE(coalescer.flush().getIterationNumbersInPacket(), QVector<unsigned long long>() << 0);
+    RenderResultPacket last = coalescer.flush();
+    QCOMPARE(last.getIterationNumbersInPacket(), QVector<unsigned long long>() << 1);
+    QCOMPARE(last.getOutput().size(), 2*simulatedOutputSize);
+}
+
+void RenderIterationSchedulerTest::packetOfOldSequenceIsDropped()
+{
+    RenderIterationScheduler scheduler;
+    scheduler.reset(1);
+    scheduler.addServer(0);
+    QVector<unsigned long long> iterations = scheduler.getNextIterations(0);
+    scheduler.reset(2);
+    QVERIFY(!scheduler.onPacketReceived(0, createPacket(1, iterations, 0.01, 0.01)));
+
+    // The new sequence starts at the same iteration, only its own request is answered
+    QVector<unsigned long long> newIterations = scheduler.getNextIterations(0);
+    QCOMPARE(newIterations, iterations);
+    QVERIFY(scheduler.onPacketReceived(0, createPacket(2, newIterations, 0.01, 0.01)));
+}
+
+void RenderIterationSchedulerTest::simulationRendersEveryIterationOnce_data()
+{
+    addClusterRows();
+}
+
+void RenderIterationSchedulerTest::simulationRendersEveryIterationOnce()
+{
+    QFETCH(QString, cluster);
+    QFETCH(int, coalescedIterations);
+    SimulationResult result = simulate(createServers(cluster), simulatedIterations, coalescedIterations);
+    QCOMPARE(result.iterations, simulatedIterations);
+    for(int i = 0; i < result.timesRendered.size(); ++i)
+    {
+        QCOMPARE(result.timesRendered[i], 1);
+    }
+}
+
+void RenderIterationSchedulerTest::simulatedThroughput_data()
+{
+    addClusterRows();
+}
+
+// Iterations per second received by the client in simulated time
+void RenderIterationSchedulerTest::simulatedThroughput()
+{
+    QFETCH(QString, cluster);
+    QFETCH(int, coalescedIterations);
+    SimulationResult result = simulate(createServers(cluster), simulatedIterations, coalescedIterations);
+    QVERIFY(result.seconds > 0);
+    double iterationsPerSecond = result.iterations/result.seconds;
+    qDebug("%.0f iterations per second, %.2f of the servers together, %llu requests taken over", iterationsPerSecond,
+        iterationsPerSecond/result.idealIterationsPerSecond, result.stolenRequests);
+    QTest::setBenchmarkResult(iterationsPerSecond, QTest::Events);
+}
+
+void RenderIterationSchedulerTest::simulatedTailLatency_data()
+{
+    addClusterRows();
+}
+
+// 99th percentile of the time from sending a request to receiving its answer, in simulated milliseconds
+void RenderIterationSchedulerTest::simulatedTailLatency()
+{
+    QFETCH(QString, cluster);
+    QFETCH(int, coalescedIterations);
+    SimulationResult result = simulate(createServers(cluster), simulatedIterations, coalescedIterations);
+    double median = percentile(result.requestLatencies, 0.5);
+    double tail = percentile(result.requestLatencies, 0.99);
+    qDebug("Request latency median %.1f ms, 99th percentile %.1f ms", 1000*median, 1000*tail);
+    QTest::setBenchmarkResult(1000*tail, QTest::WalltimeMilliseconds);
+}
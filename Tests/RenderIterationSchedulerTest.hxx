@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <QObject>
+
+/*
+  RenderIterationScheduler, see clientserver/RenderIterationScheduler.h. The simulation runs the scheduler on a
+  simulated clock against synthetic servers of different speeds, some of which stall now and then, and reports the
+  throughput and the tail latency of the requests. The servers send one packet per request, or one per iteration
+  through a RenderResultPacketCoalescer, like the render servers do.
+*/
+class RenderIterationSchedulerTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void packetMustBeWithinOneRequest();
+    void coalescerFlushesAtRequestBoundary();
+    void coalescerFlushesOnSizeChange();
+    void packetOfOldSequenceIsDropped();
+    void simulationRendersEveryIterationOnce_data();
+    void simulationRendersEveryIterationOnce();
+    void simulatedThroughput_data();
+    void simulatedThroughput();
+    void simulatedTailLatency_data();
+    void simulatedTailLatency();
+};
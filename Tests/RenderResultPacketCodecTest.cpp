@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "RenderResultPacketCodecTest.hxx"
+#include <QtTest/QtTest>
+#include <QDataStream>
+#include <QBuffer>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include "clientserver/RenderResultPacket.h"
+#include "clientserver/RenderResultPacketCodec.h"
+#if defined(_MSC_VER) && defined(_DEBUG)
+#include <crtdbg.h>
+#define COUNT_HEAP_ALLOCATIONS 1
+#endif
+
+Q_DECLARE_METATYPE(PixelEncoding::E)
+
+static const int width = 512;
+static const int height = 512;
+static const int numFrames = 8;
+// Relative error of each encoding for values in the range of the test frames
+static const float halfErrorBound = 1.0f/1024;
+static const float rgb9e5ErrorBound = 1.0f/256;
+// Frames until the buffers of the codecs and the pool have their size, the second one is the first delta frame
+static const int warmupFrames = 2;
+
+#if COUNT_HEAP_ALLOCATIONS
+// Allocations of the debug CRT, which Qt and RenderEngine share with the test
+static long heapAllocations = 0;
+
+static int __cdecl countHeapAllocations(int allocType, void* userData, size_t size, int blockType, long requestNumber,
+    const unsigned char* filename, int lineNumber)
+{
+    if(blockType != _CRT_BLOCK && (allocType == _HOOK_ALLOC || allocType == _HOOK_REALLOC))
+    {
+        heapAllocations++;
+    }
+    return TRUE;
+}
+#endif
+
+/*
+// Output of an iteration of a render: a smooth image with per pixel noise, whose noise changes between
+// iterations like the progressive estimate of the renderers does
+*/
+static QByteArray createFrame(std::mt19937 & generator)
+{
+    std::uniform_real_distribution<float> noise(0.9f, 1.1f);
+    QByteArray output(width*height*3*sizeof(float), Qt::Uninitialized);
+    float* values = (float*)output.data();
+    for(int y = 0; y < height; ++y)
+    {
+        for(int x = 0; x < width; ++x)
+        {
+            float base = 0.05f + 4.0f*float(x)/width*float(y)/height;
+            float* pixel = values + 3*(y*width + x);
+            pixel[0] = base*noise(generator);
+            pixel[1] = 0.5f*base*noise(generator);
+            pixel[2] = 0.25f*base*noise(generator);
+        }
+    }
+    return output;
+}
+
+static QVector<RenderResultPacket> createPackets(const RenderResultPacketEncoding & encoding)
+{
+    std::mt19937 generator(1);
+    QVector<RenderResultPacket> packets;
+    for(int i = 0; i < numFrames; ++i)
+    {
+        RenderResultPacket packet(1, QVector<unsigned long long>() << (unsigned long long)i, createFrame(generator));
+        packet.setEncoding(encoding);
+        packets.append(packet);
+    }
+    return packets;
+}
+
+// Reads a packet written by RenderResultPacketCodec::write, which starts with its size
+static bool readPacket(QDataStream & in, RenderResultPacketCodec & codec, RenderResultPacket & packet)
+{
+    quint64 size;
+    in >> size;
+    codec.read(in, packet);
+    return in.status() == QDataStream::Ok;
+}
+
+static void addEncodingRows()
+{
+    QTest::addColumn<PixelEncoding::E>("pixelEncoding");
+    QTest::addColumn<bool>("deltaCoding");
+    QTest::addColumn<bool>("compression");
+
+    QTest::newRow("float32") << PixelEncoding::FLOAT32 << false << false;
+    QTest::newRow("float32 compressed") << PixelEncoding::FLOAT32 << false << true;
+    QTest::newRow("half") << PixelEncoding::HALF_FLOAT << false << false;
+    QTest::newRow("half compressed") << PixelEncoding::HALF_FLOAT << false << true;
+    QTest::newRow("half delta compressed") << PixelEncoding::HALF_FLOAT << true << true;
+    QTest::newRow("rgb9e5") << PixelEncoding::RGB9E5 << false << false;
+    QTest::newRow("rgb9e5 compressed") << PixelEncoding::RGB9E5 << false << true;
+    QTest::newRow("rgb9e5 delta compressed") << PixelEncoding::RGB9E5 << true << true;
+}
+
+void RenderResultPacketCodecTest::loopbackErrorBound_data()
+{
+    addEncodingRows();
+}
+
+void RenderResultPacketCodecTest::loopbackErrorBound()
+{
+    QFETCH(PixelEncoding::E, pixelEncoding);
+    QFETCH(bool, deltaCoding);
+    QFETCH(bool, compression);
+    QVector<RenderResultPacket> packets = createPackets(RenderResultPacketEncoding(pixelEncoding, deltaCoding, compression));
+    float errorBound = pixelEncoding == PixelEncoding::FLOAT32 ? 0.0f : pixelEncoding == PixelEncoding::HALF_FLOAT ? halfErrorBound : rgb9e5ErrorBound;
+
+    QByteArray wire;
+    QDataStream out(&wire, QIODevice::WriteOnly);
+    QDataStream in(&wire, QIODevice::ReadOnly);
+    RenderResultPacketCodec writer;
+    RenderResultPacketCodec reader;
+    RenderResultPacket received;
+    for(int i = 0; i < packets.size(); ++i)
+    {
+        writer.write(out, packets[i]);
+        QVERIFY(readPacket(in, reader, received));
+        QCOMPARE(received.getIterationNumbersInPacket(), packets[i].getIterationNumbersInPacket());
+        QCOMPARE(received.getOutput().size(), packets[i].getOutput().size());
+
+        const float* sent = (const float*)packets[i].getOutput().constData();
+        const float* decoded = (const float*)received.getOutput().constData();
+        int numPixels = received.getOutput().size()/(3*sizeof(float));
+        for(int p = 0; p < numPixels; ++p)
+        {
+            // RGB9E5 shares the exponent of the largest channel, so its error is relative to that
+            float maxChannel = std::max(sent[3*p], std::max(sent[3*p+1], sent[3*p+2]));
+            for(int c = 0; c < 3; ++c)
+            {
+                float scale = pixelEncoding == PixelEncoding::RGB9E5 ? maxChannel : sent[3*p+c];
+                QVERIFY(fabsf(decoded[3*p+c] - sent[3*p+c]) <= scale*errorBound);
+            }
+        }
+        reader.recycle(received);
+    }
+}
+
+void RenderResultPacketCodecTest::corruptCompressedOutputFailsPacket()
+{
+    QVector<RenderResultPacket> packets = createPackets(RenderResultPacketEncoding(PixelEncoding::HALF_FLOAT, false, true));
+    QByteArray wire;
+    QDataStream out(&wire, QIODevice::WriteOnly);
+    RenderResultPacketCodec writer;
+    writer.write(out, packets[0]);
+
+    // Write the packet again with the last bytes of its zlib stream cut off, so that qUncompress returns less
+    // than the uncompressed size stored in front of it
+    QDataStream parse(&wire, QIODevice::ReadOnly);
+    quint64 size;
+    quint64 sequenceNumber;
+    QVector<unsigned long long> iterationNumbers;
+    float renderTimeSeconds;
+    float totalTimeSeconds;
+    quint8 pixelEncoding;
+    quint8 flags;
+    QByteArray encoded;
+    parse >> size >> sequenceNumber >> iterationNumbers >> renderTimeSeconds >> totalTimeSeconds >> pixelEncoding >> flags >> encoded;
+    QVERIFY(parse.status() == QDataStream::Ok);
+
+    QByteArray truncated;
+    QDataStream rewrite(&truncated, QIODevice::WriteOnly);
+    rewrite << size << sequenceNumber << iterationNumbers << renderTimeSeconds << totalTimeSeconds << pixelEncoding << flags
+        << encoded.left(encoded.size() - 64);
+
+    QDataStream in(&truncated, QIODevice::ReadOnly);
+    RenderResultPacketCodec reader;
+    RenderResultPacket received;
+    QVERIFY(!readPacket(in, reader, received));
+    QCOMPARE(in.status(), QDataStream::ReadCorruptData);
+}
+
+void RenderResultPacketCodecTest::steadyStateDoesNotAllocate_data()
+{
+    QTest::addColumn<PixelEncoding::E>("pixelEncoding");
+    QTest::addColumn<bool>("deltaCoding");
+
+    QTest::newRow("float32") << PixelEncoding::FLOAT32 << false;
+    QTest::newRow("float32 delta") << PixelEncoding::FLOAT32 << true;
+    QTest::newRow("half") << PixelEncoding::HALF_FLOAT << false;
+    QTest::newRow("half delta") << PixelEncoding::HALF_FLOAT << true;
+    QTest::newRow("rgb9e5") << PixelEncoding::RGB9E5 << false;
+    QTest::newRow("rgb9e5 delta") << PixelEncoding::RGB9E5 << true;
+}
+
+/*
+// Writes and reads frames through one codec per end like a connection does, into one packet that the reading
+// side recycles. The stream device has room for a frame, so only the codecs could allocate.
+*/
+void RenderResultPacketCodecTest::steadyStateDoesNotAllocate()
+{
+#if !COUNT_HEAP_ALLOCATIONS
+    QSKIP("Counting heap allocations needs the debug CRT");
+#else
+    QFETCH(PixelEncoding::E, pixelEncoding);
+    QFETCH(bool, deltaCoding);
+    QVector<RenderResultPacket> packets = createPackets(RenderResultPacketEncoding(pixelEncoding, deltaCoding, false));
+
+    QByteArray wire;
+    wire.reserve(2*packets[0].getOutput().size());
+    QBuffer device(&wire);
+    device.open(QIODevice::ReadWrite);
+    QDataStream out(&device);
+    QDataStream in(&device);
+    RenderResultPacketCodec writer;
+    RenderResultPacketCodec reader;
+    RenderResultPacket received;
+
+    bool allRead = true;
+    long steadyStateAllocations = 0;
+    heapAllocations = 0;
+    _CRT_ALLOC_HOOK previousHook = _CrtSetAllocHook(countHeapAllocations);
+    for(int frame = 0; frame < warmupFrames + numFrames; ++frame)
+    {
+        long allocationsBefore = heapAllocations;
+        device.seek(0);
+        writer.write(out, packets[frame % packets.size()]);
+        device.seek(0);
+        allRead = readPacket(in, reader, received) && allRead;
+        reader.recycle(received);
+        if(frame >= warmupFrames)
+        {
+            steadyStateAllocations += heapAllocations - allocationsBefore;
+        }
+    }
+    _CrtSetAllocHook(previousHook);
+
+    QVERIFY(allRead);
+    QCOMPARE(steadyStateAllocations, 0L);
+#endif
+}
+
+void RenderResultPacketCodecTest::loopbackThroughput_data()
+{
+    addEncodingRows();
+}
+
+// Time to write and read back numFrames frames, the reading side recycles its output like the client does
+void RenderResultPacketCodecTest::loopbackThroughput()
+{
+    QFETCH(PixelEncoding::E, pixelEncoding);
+    QFETCH(bool, deltaCoding);
+    QFETCH(bool, compression);
+    QVector<RenderResultPacket> packets = createPackets(RenderResultPacketEncoding(pixelEncoding, deltaCoding, compression));
+
+    QByteArray wire;
+    RenderResultPacketCodec writer;
+    RenderResultPacketCodec reader;
+    RenderResultPacket received;
+    QBENCHMARK
+    {
+        wire.clear();
+        QDataStream out(&wire, QIODevice::WriteOnly);
+        QDataStream in(&wire, QIODevice::ReadOnly);
+        for(int i = 0; i < packets.size(); ++i)
+        {
+            writer.write(out, packets[i]);
+            QVERIFY(readPacket(in, reader, received));
+            reader.recycle(received);
+        }
+    }
+    qDebug("%.1f MB of float output per pass", double(numFrames)*width*height*3*sizeof(float)/(1 << 20));
+}
+
+void RenderResultPacketCodecTest::bytesOnTheWire_data()
+{
+    addEncodingRows();
+}
+
+// Average encoded bytes per frame, the float output of a frame is width*height*12 bytes
+void RenderResultPacketCodecTest::bytesOnTheWire()
+{
+    QFETCH(PixelEncoding::E, pixelEncoding);
+    QFETCH(bool, deltaCoding);
+    QFETCH(bool, compression);
+    QVector<RenderResultPacket> packets = createPackets(RenderResultPacketEncoding(pixelEncoding, deltaCoding, compression));
+
+    QByteArray wire;
+    QDataStream out(&wire, QIODevice::WriteOnly);
+    RenderResultPacketCodec writer;
+    for(int i = 0; i < packets.size(); ++i)
+    {
+        writer.write(out, packets[i]);
+    }
+
+    double bytesPerFrame = double(wire.size())/numFrames;
+    qDebug("%.0f bytes per frame, %.3f of the float output", bytesPerFrame, double(writer.getEncodedBytes())/writer.getOutputBytes());
+    QTest::setBenchmarkResult(bytesPerFrame, QTest::Events);
+}
@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <QObject>
+
+/*
+  Loopback of RenderResultPackets through a writing and a reading RenderResultPacketCodec, see
+  clientserver/RenderResultPacketCodec.h. Uncompressed frames are checked not to allocate once the buffers of the
+  codecs have grown, which counts the allocations of the debug CRT. The benchmarks report the encode and decode time of a frame and the
+  bytes each encoding puts on the wire.
+*/
+class RenderResultPacketCodecTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void loopbackErrorBound_data();
+    void loopbackErrorBound();
+    void corruptCompressedOutputFailsPacket();
+    void steadyStateDoesNotAllocate_data();
+    void steadyStateDoesNotAllocate();
+    void loopbackThroughput_data();
+    void loopbackThroughput();
+    void bytesOnTheWire_data();
+    void bytesOnTheWire();
+};
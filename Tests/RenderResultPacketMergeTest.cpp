@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "RenderResultPacketMergeTest.hxx"
+#include <QtTest/QtTest>
+#include <random>
+#include <cmath>
+#include <exception>
+#include "clientserver/RenderResultPacket.h"
+
+static QByteArray createOutput(int numPixels, std::mt19937 & generator)
+{
+    std::uniform_real_distribution<float> uniform(0.0f, 4.0f);
+    QByteArray output(numPixels*3*sizeof(float), Qt::Uninitialized);
+    float* values = (float*)output.data();
+    for(int i = 0; i < 3*numPixels; ++i)
+    {
+        values[i] = uniform(generator);
+    }
+    return output;
+}
+
+// Packets of consecutive iterations, packet i has i+1 iterations so that the weights differ
+static QVector<RenderResultPacket> createPackets(int numPackets, int numPixels)
+{
+    std::mt19937 generator(1);
+    QVector<RenderResultPacket> packets;
+    unsigned long long iterationNumber = 0;
+    for(int i = 0; i < numPackets; ++i)
+    {
+        QVector<unsigned long long> iterationNumbers;
+        for(int j = 0; j <= i; ++j)
+        {
+            iterationNumbers.append(iterationNumber++);
+        }
+        packets.append(RenderResultPacket(0, iterationNumbers, createOutput(numPixels, generator)));
+    }
+    return packets;
+}
+
+// The merge of RenderResultPacket before mergeMany, one packet at a time over the pixels
+static void scalarMerge(QByteArray & output, int & outputIterations, const RenderResultPacket & other)
+{
+    int otherIterations = other.getNumIterationsInPacket();
+    int numFloats = output.size()/sizeof(float);
+    const float* inputData = (const float*)other.getOutput().constData();
+    float* outputData = (float*)output.data();
+    float scale = 1.f/(outputIterations + otherIterations);
+    for(int i = 0; i < numFloats; i += 3)
+    {
+        outputData[i]   = (outputIterations*outputData[i]   + otherIterations*inputData[i]  ) * scale;
+        outputData[i+1] = (outputIterations*outputData[i+1] + otherIterations*inputData[i+1]) * scale;
+        outputData[i+2] = (outputIterations*outputData[i+2] + otherIterations*inputData[i+2]) * scale;
+    }
+    outputIterations += otherIterations;
+}
+
+void RenderResultPacketMergeTest::emptyPacketIsIdentity()
+{
+    QVector<RenderResultPacket> packets = createPackets(3, 1000);
+
+    RenderResultPacket merged;
+    merged.merge(packets[0]);
+    QCOMPARE(merged.getOutput(), packets[0].getOutput());
+    QCOMPARE(merged.getIterationNumbersInPacket(), packets[0].getIterationNumbersInPacket());
+
+    RenderResultPacket unchanged = packets[1];
+    unchanged.merge(RenderResultPacket());
+    QCOMPARE(unchanged.getOutput(), packets[1].getOutput());
+    QCOMPARE(unchanged.getIterationNumbersInPacket(), packets[1].getIterationNumbersInPacket());
+
+    RenderResultPacket mergedMany;
+    mergedMany.mergeMany(QVector<RenderResultPacket>() << RenderResultPacket() << packets[1] << RenderResultPacket() << packets[2]);
+    RenderResultPacket expected = packets[1];
+    expected.merge(packets[2]);
+    QCOMPARE(mergedMany.getOutput(), expected.getOutput());
+    QCOMPARE(mergedMany.getIterationNumbersInPacket(), expected.getIterationNumbersInPacket());
+
+    RenderResultPacket empty;
+    empty.mergeMany(QVector<RenderResultPacket>() << RenderResultPacket() << RenderResultPacket());
+    QCOMPARE(empty.getNumIterationsInPacket(), 0);
+    QVERIFY(empty.getOutput().isEmpty());
+}
+
+void RenderResultPacketMergeTest::differentSizesThrow()
+{
+    RenderResultPacket small = createPackets(1, 100)[0];
+    RenderResultPacket large = createPackets(1, 200)[0];
+    bool thrown = false;
+    try
+    {
+        small.merge(large);
+    }
+    catch(const std::exception &)
+    {
+        thrown = true;
+    }
+    QVERIFY(thrown);
+}
+
+// With one packet mergeMany does the same operations in the same order as the scalar merge
+void RenderResultPacketMergeTest::mergeManyMatchesScalarMerge()
+{
+    QVector<RenderResultPacket> packets = createPackets(8, 512*512);
+
+    RenderResultPacket merged = packets[0];
+    merged.merge(packets[1]);
+    QByteArray expected = packets[0].getOutput();
+    int expectedIterations = packets[0].getNumIterationsInPacket();
+    scalarMerge(expected, expectedIterations, packets[1]);
+    QCOMPARE(merged.getOutput(), expected);
+
+    // Several packets are summed before one final scale, so the result only matches up to rounding
+    RenderResultPacket mergedMany = packets[0];
+    mergedMany.mergeMany(packets.mid(1));
+    expected = packets[0].getOutput();
+    expectedIterations = packets[0].getNumIterationsInPacket();
+    for(int i = 1; i < packets.size(); ++i)
+    {
+        scalarMerge(expected, expectedIterations, packets[i]);
+    }
+    QCOMPARE(mergedMany.getNumIterationsInPacket(), expectedIterations);
+    const float* values = (const float*)mergedMany.getOutput().constData();
+    const float* expectedValues = (const float*)expected.constData();
+    for(int i = 0; i < expected.size()/(int)sizeof(float); ++i)
+    {
+        QVERIFY(fabsf(values[i] - expectedValues[i]) <= 1e-5f*fabsf(expectedValues[i]) + 1e-6f);
+    }
+}
+
+void RenderResultPacketMergeTest::merge_data()
+{
+    QTest::addColumn<bool>("scalar");
+    QTest::addColumn<int>("numPackets");
+    QTest::addColumn<int>("numPixels");
+
+    const int sizes[] = {512*512, 1920*1080};
+    const int numPackets[] = {2, 4, 8};
+    for(int s = 0; s < 2; ++s)
+    {
+        for(int n = 0; n < 3; ++n)
+        {
+            QByteArray scalarName = QString("scalar, %1 packets of %2 pixels").arg(numPackets[n]).arg(sizes[s]).toLatin1();
+            QByteArray mergeManyName = QString("mergeMany, %1 packets of %2 pixels").arg(numPackets[n]).arg(sizes[s]).toLatin1();
+            QTest::newRow(scalarName.constData()) << true << numPackets[n] << sizes[s];
+            QTest::newRow(mergeManyName.constData()) << false << numPackets[n] << sizes[s];
+        }
+    }
+}
+
+// Merges numPackets - 1 packets into the first one, each pass starts from a copy of its output
+void RenderResultPacketMergeTest::merge()
+{
+    QFETCH(bool, scalar);
+    QFETCH(int, numPackets);
+    QFETCH(int, numPixels);
+    QVector<RenderResultPacket> packets = createPackets(numPackets, numPixels);
+    QVector<RenderResultPacket> others = packets.mid(1);
+
+    if(scalar)
+    {
+        QBENCHMARK
+        {
+            QByteArray output = packets[0].getOutput();
+            int outputIterations = packets[0].getNumIterationsInPacket();
+            for(int i = 0; i < others.size(); ++i)
+            {
+                scalarMerge(output, outputIterations, others[i]);
+            }
+        }
+    }
+    else
+    {
+        QBENCHMARK
+        {
+            RenderResultPacket merged = packets[0];
+            merged.mergeMany(others);
+        }
+    }
+}
@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <QObject>
+
+/*
+  RenderResultPacket::merge and mergeMany, see clientserver/RenderResultPacket.h. The benchmarks compare
+  mergeMany against merging the packets one at a time with the scalar loop merge used before it.
+*/
+class RenderResultPacketMergeTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void emptyPacketIsIdentity();
+    void differentSizesThrow();
+    void mergeManyMatchesScalarMerge();
+    void merge_data();
+    void merge();
+};
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "RenderTileAssemblerTest.hxx"
+#include <QtTest/QtTest>
+#include <random>
+#include "clientserver/RenderResultPacket.h"
+#include "clientserver/RenderTileAssembler.h"
+
+static QByteArray createFrame(unsigned int width, unsigned int height)
+{
+    std::mt19937 generator(width*height);
+    std::uniform_real_distribution<float> uniform(0.0f, 4.0f);
+    QByteArray output(width*height*3*sizeof(float), Qt::Uninitialized);
+    float* values = (float*)output.data();
+    for(unsigned int i = 0; i < 3*width*height; ++i)
+    {
+        values[i] = uniform(generator);
+    }
+    return output;
+}
+
+void RenderTileAssemblerTest::splitImageTilesStitchToFrame_data()
+{
+    QTest::addColumn<unsigned int>("width");
+    QTest::addColumn<unsigned int>("height");
+    QTest::addColumn<int>("numTiles");
+
+    QTest::newRow("640x480, 4 tiles") << 640u << 480u << 4;
+    QTest::newRow("640x481, 4 tiles") << 640u << 481u << 4;
+    QTest::newRow("641x479, 3 tiles") << 641u << 479u << 3;
+    QTest::newRow("33x100, 7 tiles") << 33u << 100u << 7;
+    QTest::newRow("1x1, 1 tile") << 1u << 1u << 1;
+    // More tiles than rows, splitImage gives one row per tile
+    QTest::newRow("5x3, 8 tiles") << 5u << 3u << 8;
+}
+
+void RenderTileAssemblerTest::splitImageTilesStitchToFrame()
+{
+    QFETCH(unsigned int, width);
+    QFETCH(unsigned int, height);
+    QFETCH(int, numTiles);
+
+    QByteArray frame = createFrame(width, height);
+    QVector<QRect> tiles = RenderTileAssembler::splitImage(width, height, numTiles);
+    QCOMPARE(tiles.size(), qMin(numTiles, (int)height));
+
+    // The bands cover every row once, top to bottom
+    int nextRow = 0;
+    for(int i = 0; i < tiles.size(); ++i)
+    {
+        QCOMPARE(tiles[i].left(), 0);
+        QCOMPARE(tiles[i].width(), (int)width);
+        QCOMPARE(tiles[i].top(), nextRow);
+        QVERIFY(tiles[i].height() > 0);
+        nextRow = tiles[i].bottom() + 1;
+    }
+    QCOMPARE(nextRow, (int)height);
+
+    // Added last tile first, as the packets of the servers come in any order
+    RenderTileAssembler assembler(width, height);
+    for(int i = tiles.size() - 1; i >= 0; --i)
+    {
+        QVector<unsigned long long> iterationNumbers;
+        iterationNumbers.append(0);
+        RenderResultPacket packet(0, iterationNumbers, RenderTileAssembler::extractTile(frame, width, tiles[i]));
+        assembler.addTile(tiles[i], packet);
+    }
+    QVERIFY(assembler.getOutput() == frame);
+}
+
+void RenderTileAssemblerTest::rectangularTilesStitchToFrame_data()
+{
+    QTest::addColumn<unsigned int>("width");
+    QTest::addColumn<unsigned int>("height");
+    QTest::addColumn<int>("tileWidth");
+    QTest::addColumn<int>("tileHeight");
+
+    QTest::newRow("640x480, 64x64 tiles") << 640u << 480u << 64 << 64;
+    QTest::newRow("100x75, 32x32 tiles") << 100u << 75u << 32 << 32;
+    QTest::newRow("97x61, 13x7 tiles") << 97u << 61u << 13 << 7;
+    QTest::newRow("10x10, tile larger than the image") << 10u << 10u << 16 << 16;
+}
+
+void RenderTileAssemblerTest::rectangularTilesStitchToFrame()
+{
+    QFETCH(unsigned int, width);
+    QFETCH(unsigned int, height);
+    QFETCH(int, tileWidth);
+    QFETCH(int, tileHeight);
+
+    QByteArray frame = createFrame(width, height);
+    RenderTileAssembler assembler(width, height);
+    QRect image(0, 0, width, height);
+    for(int top = 0; top < (int)height; top += tileHeight)
+    {
+        for(int left = 0; left < (int)width; left += tileWidth)
+        {
+            // The tiles of the last column and row are cut at the border of the image
+            QRect tile = QRect(left, top, tileWidth, tileHeight).intersected(image);
+            QByteArray tileOutput = RenderTileAssembler::extractTile(frame, width, tile);
+            QCOMPARE(tileOutput.size(), tile.width()*tile.height()*3*(int)sizeof(float));
+            assembler.addTile(tile, tileOutput);
+        }
+    }
+    QVERIFY(assembler.getOutput() == frame);
+}
@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <QObject>
+
+/*
+  RenderTileAssembler (clientserver/RenderTileAssembler.h) must stitch the tiles cut out of a frame back into
+  the same frame, for the bands of splitImage and for rectangular tiles, also when the tile size does not
+  divide the image size.
+*/
+class RenderTileAssemblerTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void splitImageTilesStitchToFrame_data();
+    void splitImageTilesStitchToFrame();
+    void rectangularTilesStitchToFrame_data();
+    void rectangularTilesStitchToFrame();
+};
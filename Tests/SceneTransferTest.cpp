@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "SceneTransferTest.hxx"
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include "clientserver/SceneTransferMessage.h"
+#include "clientserver/SceneTransferSender.h"
+#include "clientserver/RenderServerSceneCache.h"
+
+static void writeFile(const QString & path, const QByteArray & contents)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    QCOMPARE(file.write(contents), qint64(contents.size()));
+}
+
+static QByteArray readFile(const QString & path)
+{
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+// A scene file with a texture in a subdirectory and an empty file
+static QStringList createScene(const QString & directory, int textureSize)
+{
+    QByteArray texture(textureSize, Qt::Uninitialized);
+    for(int i = 0; i < texture.size(); ++i)
+    {
+        texture[i] = char(i*31 + i/7);
+    }
+    QStringList files;
+    files << QDir(directory).filePath("scene.dae") << QDir(directory).filePath("textures/wood.png")
+          << QDir(directory).filePath("empty.mtl");
+    writeFile(files[0], "<COLLADA/>");
+    writeFile(files[1], texture);
+    writeFile(files[2], QByteArray());
+    return files;
+}
+
+// Sends the message the way a connection would, so that the operators are part of the loopback
+static SceneTransferMessage sendOverStream(const SceneTransferMessage & message)
+{
+    QByteArray bytes;
+    {
+        QDataStream out(&bytes, QIODevice::WriteOnly);
+        out << message;
+    }
+    QDataStream in(bytes);
+    SceneTransferMessage received;
+    in >> received;
+    return received;
+}
+
+void SceneTransferTest::loopbackTransfer_data()
+{
+    QTest::addColumn<int>("textureSize");
+    QTest::addColumn<int>("chunkSize");
+
+    QTest::newRow("single chunk") << 1000 << (1 << 20);
+    QTest::newRow("many chunks") << 100000 << 4096;
+    QTest::newRow("chunk boundary") << 8192 << 4096;
+}
+
+void SceneTransferTest::loopbackTransfer()
+{
+    QFETCH(int, textureSize);
+    QFETCH(int, chunkSize);
+
+    QTemporaryDir clientDirectory;
+    QTemporaryDir serverDirectory;
+    QVERIFY(clientDirectory.isValid() && serverDirectory.isValid());
+    QStringList sceneFiles = createScene(clientDirectory.path(), textureSize);
+
+    SceneTransferSender sender(sceneFiles, chunkSize);
+    QCOMPARE(sender.getSceneHash().size(), 20);
+    RenderServerSceneCache cache(serverDirectory.path(), 1 << 30);
+
+    SceneTransferMessage answer = cache.answerQuery(sendOverStream(sender.createQuery()));
+    QCOMPARE(answer.getType(), SceneTransferMessageType::CACHE_MISS);
+    QCOMPARE(answer.getSceneHash(), sender.getSceneHash());
+
+    SceneTransferMessage message;
+    bool answerNeeded = false;
+    while(sender.getNextMessage(message))
+    {
+        answer = cache.receive(sendOverStream(message), answerNeeded);
+        QCOMPARE(answerNeeded, message.getType() == SceneTransferMessageType::TRANSFER_DONE);
+    }
+    QCOMPARE(answer.getType(), SceneTransferMessageType::CACHE_HIT);
+
+    QString cachedSceneFile = cache.getSceneFile(sender.getSceneHash());
+    QVERIFY(!cachedSceneFile.isEmpty());
+    QDir cachedSceneDirectory = QFileInfo(cachedSceneFile).absoluteDir();
+    QDir clientSceneDirectory(clientDirectory.path());
+    for(int i = 0; i < sceneFiles.size(); ++i)
+    {
+        QString relativePath = clientSceneDirectory.relativeFilePath(sceneFiles[i]);
+        QVERIFY(QFile::exists(cachedSceneDirectory.filePath(relativePath)));
+        QCOMPARE(readFile(cachedSceneDirectory.filePath(relativePath)), readFile(sceneFiles[i]));
+    }
+
+    // A second client with the same scene must not send it again, also after a restart of the server
+    RenderServerSceneCache restartedCache(serverDirectory.path(), 1 << 30);
+    QCOMPARE(restartedCache.answerQuery(sendOverStream(sender.createQuery())).getType(), SceneTransferMessageType::CACHE_HIT);
+}
+
+void SceneTransferTest::corruptChunkFailsTransfer()
+{
+    QTemporaryDir clientDirectory;
+    QTemporaryDir serverDirectory;
+    QVERIFY(clientDirectory.isValid() && serverDirectory.isValid());
+    QStringList sceneFiles = createScene(clientDirectory.path(), 10000);
+
+    SceneTransferSender sender(sceneFiles, 4096);
+    RenderServerSceneCache cache(serverDirectory.path(), 1 << 30);
+    QCOMPARE(cache.answerQuery(sender.createQuery()).getType(), SceneTransferMessageType::CACHE_MISS);
+
+    SceneTransferMessage message;
+    SceneTransferMessage answer;
+    bool answerNeeded = false;
+    bool corrupted = false;
+    while(sender.getNextMessage(message))
+    {
+        if(!corrupted && message.getType() == SceneTransferMessageType::FILE_CHUNK && !message.getData().isEmpty())
+        {
+            QByteArray data = message.getData();
+            data[0] = ~data[0];
+            message = SceneTransferMessage(message.getType(), message.getSceneHash(), message.getPath(), message.getOffset(),
+                message.getSize(), data);
+            corrupted = true;
+        }
+        answer = cache.receive(message, answerNeeded);
+    }
+    QVERIFY(corrupted);
+    QCOMPARE(answer.getType(), SceneTransferMessageType::TRANSFER_FAILED);
+    QVERIFY(cache.getSceneFile(sender.getSceneHash()).isEmpty());
+    QCOMPARE(QDir(serverDirectory.path()).entryList(QDir::Dirs | QDir::NoDotAndDotDot), QStringList());
+}
+
+void SceneTransferTest::invalidHashIsRefused_data()
+{
+    QTest::addColumn<QByteArray>("sceneHash");
+
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("short") << QByteArray(19, 'a');
+    QTest::newRow("long") << QByteArray(21, 'a');
+    QTest::newRow("path") << QByteArray("../../../../../../..");
+}
+
+void SceneTransferTest::invalidHashIsRefused()
+{
+    QFETCH(QByteArray, sceneHash);
+
+    QTemporaryDir serverDirectory;
+    QVERIFY(serverDirectory.isValid());
+    RenderServerSceneCache cache(serverDirectory.path(), 1 << 30);
+
+    SceneTransferMessage query(SceneTransferMessageType::QUERY, sceneHash, "scene.dae", 0, 10);
+    QCOMPARE(cache.answerQuery(query).getType(), SceneTransferMessageType::TRANSFER_FAILED);
+    bool answerNeeded = false;
+    SceneTransferMessage chunk(SceneTransferMessageType::FILE_CHUNK, sceneHash, "scene.dae", 0, 10, "<COLLADA/>");
+    QCOMPARE(cache.receive(chunk, answerNeeded).getType(), SceneTransferMessageType::TRANSFER_FAILED);
+    QVERIFY(answerNeeded);
+    QVERIFY(cache.getSceneFile(sceneHash).isEmpty());
+    QCOMPARE(QDir(serverDirectory.path()).entryList(QDir::AllEntries | QDir::Hidden | QDir::NoDotAndDotDot), QStringList());
+}
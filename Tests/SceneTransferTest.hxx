@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <QObject>
+
+/*
+  Scene transfer between SceneTransferSender and RenderServerSceneCache, see clientserver/SceneTransferMessage.h.
+  The messages go through the QDataStream operators in memory instead of a socket.
+*/
+class SceneTransferTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void loopbackTransfer_data();
+    void loopbackTransfer();
+    void corruptChunkFailsTransfer();
+    void invalidHashIsRefused_data();
+    void invalidHashIsRefused();
+};
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "UniformGridPhotonMapTest.hxx"
+#include <QtTest/QtTest>
+#include <QFile>
+#include <cuda_runtime.h>
+#include <random>
+#include <vector>
+#include <cstring>
+#include "config.h"
+#include "renderer/ppm/Photon.h"
+#include "renderer/ppm/PhotonGrid.h"
+#include "renderer/UniformGridPhotonMap.h"
+
+using namespace optix;
+
+Q_DECLARE_METATYPE(std::vector<Photon>)
+
+// PPMOptixRenderer::PHOTON_GRID_MAX_SIZE
+static const unsigned int maxGridSize = 100*100*100;
+
+/*
+  Photons deposited on a few planes and clusters of a unit box, like the photons of a scene, with a
+  fraction of empty slots that must end up last.
+*/
+static std::vector<Photon> generatePhotons(int numPhotons, unsigned int seed, float emptyFraction)
+{
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::normal_distribution<float> normal(0.0f, 0.02f);
+    std::vector<Photon> photons(numPhotons);
+    for(int i = 0; i < numPhotons; ++i)
+    {
+        float3 position = make_float3(uniform(generator), uniform(generator), uniform(generator));
+        switch(i % 4)
+        {
+        case 0: position.y = 0.0f; break;
+        case 1: position.x = 1.0f; break;
+        case 2: position = make_float3(0.3f, 0.6f, 0.4f) + make_float3(normal(generator), normal(generator), normal(generator)); break;
+        default: break;
+        }
+        float3 power = uniform(generator) < emptyFraction ? make_float3(0.0f)
+            : make_float3(uniform(generator), uniform(generator), uniform(generator));
+        float3 direction = normalize(make_float3(uniform(generator) - 0.5f, uniform(generator) - 0.5f, uniform(generator) - 0.5f));
+        photons[i] = Photon(power, position, direction, i % 7);
+#if ENABLE_PARTICIPATING_MEDIA
+        photons[i].numDeposits = 0;
+#endif
+    }
+    return photons;
+}
+
+static std::vector<Photon> readPhotonDump(const QString & fileName)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        return std::vector<Photon>();
+    }
+    QByteArray data = file.readAll();
+    std::vector<Photon> photons(data.size()/sizeof(Photon));
+    memcpy(photons.data(), data.constData(), photons.size()*sizeof(Photon));
+    return photons;
+}
+
+void UniformGridPhotonMapTest::initTestCase()
+{
+#if ACCELERATION_STRUCTURE != ACCELERATION_STRUCTURE_UNIFORM_GRID
+    QSKIP("The uniform grid photon map is not the configured ACCELERATION_STRUCTURE");
+#endif
+    int numDevices = 0;
+    if(cudaGetDeviceCount(&numDevices) != cudaSuccess || numDevices == 0)
+    {
+        QSKIP("No CUDA device to build the photon map on");
+    }
+}
+
+void UniformGridPhotonMapTest::hostAndDeviceBuildsMatch_data()
+{
+    QTest::addColumn<std::vector<Photon> >("photons");
+
+    QTest::newRow("one photon") << generatePhotons(1, 1, 0.0f);
+    QTest::newRow("no photon with power") << generatePhotons(1000, 2, 1.0f);
+    QTest::newRow("scene, 10% empty") << generatePhotons(1 << 20, 3, 0.1f);
+    QTest::newRow("scene, 60% empty") << generatePhotons((1 << 20) + 123, 4, 0.6f);
+
+    QString dumpFile = QString::fromLocal8Bit(qgetenv("PHOTON_DUMP"));
+    if(!dumpFile.isEmpty())
+    {
+        QTest::newRow("recorded dump") << readPhotonDump(dumpFile);
+    }
+}
+
+void UniformGridPhotonMapTest::hostAndDeviceBuildsMatch()
+{
+#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_UNIFORM_GRID
+    QFETCH(std::vector<Photon>, photons);
+    QVERIFY(!photons.empty());
+    unsigned int numPhotons = (unsigned int)photons.size();
+
+    std::vector<Photon> hostPhotons = photons;
+    std::vector<unsigned int> hostHashCells(numPhotons);
+    std::vector<unsigned int> hostOffsetTable(maxGridSize+1);
+    UniformGridPhotonMap hostMap = buildUniformGridPhotonMapOnCPU(hostPhotons.data(), hostHashCells.data(), hostOffsetTable.data(),
+                                                                  numPhotons, maxGridSize);
+
+    Photon* devicePhotons = NULL;
+    unsigned int* deviceHashCells = NULL;
+    unsigned int* deviceOffsetTable = NULL;
+    QCOMPARE(cudaMalloc(&devicePhotons, numPhotons*sizeof(Photon)), cudaSuccess);
+    QCOMPARE(cudaMalloc(&deviceHashCells, numPhotons*sizeof(unsigned int)), cudaSuccess);
+    QCOMPARE(cudaMalloc(&deviceOffsetTable, (maxGridSize+1)*sizeof(unsigned int)), cudaSuccess);
+    cudaMemcpy(devicePhotons, photons.data(), numPhotons*sizeof(Photon), cudaMemcpyHostToDevice);
+    UniformGridPhotonMap deviceMap = buildUniformGridPhotonMapOnDevice(devicePhotons, deviceHashCells, deviceOffsetTable,
+                                                                       numPhotons, maxGridSize);
+
+    std::vector<Photon> deviceSortedPhotons(numPhotons);
+    std::vector<unsigned int> deviceHashCellsHost(numPhotons);
+    std::vector<unsigned int> deviceOffsetTableHost(deviceMap.numHashCells+1);
+    cudaMemcpy(deviceSortedPhotons.data(), devicePhotons, numPhotons*sizeof(Photon), cudaMemcpyDeviceToHost);
+    cudaMemcpy(deviceHashCellsHost.data(), deviceHashCells, numPhotons*sizeof(unsigned int), cudaMemcpyDeviceToHost);
+    cudaMemcpy(deviceOffsetTableHost.data(), deviceOffsetTable, (deviceMap.numHashCells+1)*sizeof(unsigned int), cudaMemcpyDeviceToHost);
+    cudaFree(devicePhotons);
+    cudaFree(deviceHashCells);
+    cudaFree(deviceOffsetTable);
+
+    QVERIFY(memcmp(&hostMap.worldOrigo, &deviceMap.worldOrigo, sizeof(hostMap.worldOrigo)) == 0);
+    QVERIFY(memcmp(&hostMap.cellSize, &deviceMap.cellSize, sizeof(hostMap.cellSize)) == 0);
+    QVERIFY(memcmp(&hostMap.gridSize, &deviceMap.gridSize, sizeof(hostMap.gridSize)) == 0);
+    QCOMPARE(hostMap.numHashCells, deviceMap.numHashCells);
+    QCOMPARE(hostMap.numValidPhotons, deviceMap.numValidPhotons);
+
+    QVERIFY(memcmp(hostPhotons.data(), deviceSortedPhotons.data(), numPhotons*sizeof(Photon)) == 0);
+    QVERIFY(memcmp(hostHashCells.data(), deviceHashCellsHost.data(), numPhotons*sizeof(unsigned int)) == 0);
+    QVERIFY(memcmp(hostOffsetTable.data(), deviceOffsetTableHost.data(), (hostMap.numHashCells+1)*sizeof(unsigned int)) == 0);
+#endif
+}
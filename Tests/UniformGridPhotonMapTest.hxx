@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <QObject>
+
+/*
+  The host and device uniform grid photon map builds (renderer/UniformGridPhotonMap.h) must produce
+  the same photon map bit for bit. Besides the generated photon sets, the photons of a recorded dump are
+  compared when the PHOTON_DUMP environment variable names one: a raw array of Photon structs, as
+  mapped from the photons buffer of a renderer.
+*/
+class UniformGridPhotonMapTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void hostAndDeviceBuildsMatch_data();
+    void hostAndDeviceBuildsMatch();
+};
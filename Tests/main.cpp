@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include <QCoreApplication>
+#include <QtTest/QtTest>
+#include "PhotonEncodingTest.hxx"
+#include "UniformGridPhotonMapTest.hxx"
+#include "PhotonGatherCostTest.hxx"
+#include "RenderResultPacketCodecTest.hxx"
+#include "RenderResultPacketMergeTest.hxx"
+#include "RenderIterationSchedulerTest.hxx"
+#include "SceneTransferTest.hxx"
+#include "PhotonKdTreeTest.hxx"
+#include "HostBVHTest.hxx"
+#include "PhotonGridMortonTest.hxx"
+#include "RenderTileAssemblerTest.hxx"
+#include "RadiosityEstimateTest.hxx"
+
+/*
+  Runs every test of the solution, returns the number of failed tests. The arguments are those of QTest,
+  e.g. -iterations 10 for more stable benchmarks.
+*/
+int main(int argc, char** argv)
+{
+    QCoreApplication application(argc, argv);
+    int failures = 0;
+
+    PhotonEncodingTest photonEncodingTest;
+    failures += QTest::qExec(&photonEncodingTest, argc, argv);
+
+    UniformGridPhotonMapTest uniformGridPhotonMapTest;
+    failures += QTest::qExec(&uniformGridPhotonMapTest, argc, argv);
+
+    PhotonGatherCostTest photonGatherCostTest;
+    failures += QTest::qExec(&photonGatherCostTest, argc, argv);
+
+    RenderResultPacketCodecTest renderResultPacketCodecTest;
+    failures += QTest::qExec(&renderResultPacketCodecTest, argc, argv);
+
+    RenderResultPacketMergeTest renderResultPacketMergeTest;
+    failures += QTest::qExec(&renderResultPacketMergeTest, argc, argv);
+
+    RenderIterationSchedulerTest renderIterationSchedulerTest;
+    failures += QTest::qExec(&renderIterationSchedulerTest, argc, argv);
+
+    SceneTransferTest sceneTransferTest;
+    failures += QTest::qExec(&sceneTransferTest, argc, argv);
+
+    PhotonKdTreeTest photonKdTreeTest;
+    failures += QTest::qExec(&photonKdTreeTest, argc, argv);
+
+    HostBVHTest hostBVHTest;
+    failures += QTest::qExec(&hostBVHTest, argc, argv);
+
+    PhotonGridMortonTest photonGridMortonTest;
+    failures += QTest::qExec(&photonGridMortonTest, argc, argv);
+
+    RenderTileAssemblerTest renderTileAssemblerTest;
+    failures += QTest::qExec(&renderTileAssemblerTest, argc, argv);
+
+    RadiosityEstimateTest radiosityEstimateTest;
+    failures += QTest::qExec(&radiosityEstimateTest, argc, argv);
+
+    return failures;
+}